@@ -210,6 +210,11 @@
  * ========================================================================== **
  */
 
+/* The library always provides the out-of-line versions of the functions
+ * that ubi_BinTree.h can optionally inline.  See UBI_INLINE.
+ */
+#undef UBI_INLINE
+
 #include "ubi_BinTree.h"  /* Header for this module.   */
 
 
@@ -614,10 +614,6 @@ typedef ubi_btRoot *ubi_btRootPtr;
  * Function Prototypes.
  */
 
-long ubi_btSgn( register long x );
-
-ubi_btNodePtr ubi_btInitNode( ubi_btNodePtr NodePtr );
-
 ubi_btRootPtr  ubi_btInitTree( ubi_btRootPtr   RootPtr,
                                ubi_btCompFunc  CompFunc,
                                char            Flags );
@@ -637,14 +633,6 @@ ubi_btNodePtr ubi_btLocate( ubi_btRootPtr RootPtr,
 ubi_btNodePtr ubi_btFind( ubi_btRootPtr RootPtr,
                           ubi_btItemPtr FindMe );
 
-ubi_btNodePtr ubi_btNext( ubi_btNodePtr P );
-
-ubi_btNodePtr ubi_btPrev( ubi_btNodePtr P );
-
-ubi_btNodePtr ubi_btFirst( ubi_btNodePtr P );
-
-ubi_btNodePtr ubi_btLast( ubi_btNodePtr P );
-
 ubi_btNodePtr ubi_btFirstOf( ubi_btRootPtr RootPtr,
                              ubi_btItemPtr MatchMe,
                              ubi_btNodePtr p );
@@ -665,6 +653,131 @@ ubi_btNodePtr ubi_btLeafNode( ubi_btNodePtr leader );
 int ubi_btModuleID( int size, char *list[] );
 
 
+/* -------------------------------------------------------------------------- **
+ * Inline Functions.
+ *//**
+ * @def     UBI_INLINE
+ * @brief   Compile the small tree walking functions inline.
+ * @details If \c UBI_INLINE is defined before this header is included,
+ *          \c #ubi_btSgn(), \c #ubi_btInitNode(), \c #ubi_btNext(),
+ *          \c #ubi_btPrev(), \c #ubi_btFirst() and \c #ubi_btLast() are
+ *          provided as static inline functions instead of as calls into
+ *          the library.  These are the functions that get called once per
+ *          step when walking a tree, so the savings add up quickly in a
+ *          tight iteration loop.
+ *
+ *          The library itself always exports the out-of-line versions, so
+ *          code compiled without \c UBI_INLINE continues to link against
+ *          \c libubiqx.a exactly as before.  The two styles may be mixed
+ *          within a single program.
+ *
+ *          The inline versions require a C99 compiler (or GCC).
+ *
+ * @def     ubi_trINLINE
+ * @brief   Storage class used for the inline functions.
+ */
+
+#if defined( UBI_INLINE )
+
+#if defined( __STDC_VERSION__ ) && (__STDC_VERSION__ >= 199901L)
+#define ubi_trINLINE static inline
+#elif defined( __GNUC__ )
+#define ubi_trINLINE static __inline__
+#else
+#define ubi_trINLINE static
+#endif
+
+ubi_trINLINE long ubi_btSgn( long x )
+  /* Return the sign of x.  See ubi_BinTree.c. */
+  {
+  return( x ? ((x>0)?1:-1) : 0 );
+  } /* ubi_btSgn */
+
+ubi_trINLINE ubi_btNodePtr ubi_btInitNode( ubi_btNodePtr NodePtr )
+  /* Initialize a tree node.  See ubi_BinTree.c. */
+  {
+  NodePtr->Link[ ubi_trLEFT ]   = NULL;
+  NodePtr->Link[ ubi_trPARENT ] = NULL;
+  NodePtr->Link[ ubi_trRIGHT ]  = NULL;
+  NodePtr->gender               = ubi_trEQUAL;
+  NodePtr->balance              = ubi_trEQUAL;
+  return( NodePtr );
+  } /* ubi_btInitNode */
+
+ubi_trINLINE ubi_btNodePtr ubi_btSubSlide( ubi_btNodePtr P, int whichway )
+  /* Slide down the side of a subtree.  Inline copy of SubSlide(), which
+   * is private to ubi_BinTree.c.
+   */
+  {
+  if( NULL != P )
+    while( NULL != P->Link[ whichway ] )
+      P = P->Link[ whichway ];
+  return( P );
+  } /* ubi_btSubSlide */
+
+ubi_trINLINE ubi_btNodePtr ubi_btNeighbor( ubi_btNodePtr P, int whichway )
+  /* Return the (key order) next or preceeding node.  Inline copy of
+   * Neighbor(), which is private to ubi_BinTree.c.
+   */
+  {
+  if( P )
+    {
+    if( NULL != P->Link[ whichway ] )
+      return( ubi_btSubSlide( P->Link[ whichway ],
+                              (char)ubi_trRevWay(whichway) ) );
+    else
+      while( NULL != P->Link[ ubi_trPARENT ] )
+        {
+        if( whichway == P->gender )
+          P = P->Link[ ubi_trPARENT ];
+        else
+          return( P->Link[ ubi_trPARENT ] );
+        }
+    }
+  return( NULL );
+  } /* ubi_btNeighbor */
+
+ubi_trINLINE ubi_btNodePtr ubi_btNext( ubi_btNodePtr P )
+  /* Return the next node in the tree.  See ubi_BinTree.c. */
+  {
+  return( ubi_btNeighbor( P, ubi_trRIGHT ) );
+  } /* ubi_btNext */
+
+ubi_trINLINE ubi_btNodePtr ubi_btPrev( ubi_btNodePtr P )
+  /* Return the previous node in the tree.  See ubi_BinTree.c. */
+  {
+  return( ubi_btNeighbor( P, ubi_trLEFT ) );
+  } /* ubi_btPrev */
+
+ubi_trINLINE ubi_btNodePtr ubi_btFirst( ubi_btNodePtr P )
+  /* Return the first node in a subtree.  See ubi_BinTree.c. */
+  {
+  return( ubi_btSubSlide( P, ubi_trLEFT ) );
+  } /* ubi_btFirst */
+
+ubi_trINLINE ubi_btNodePtr ubi_btLast( ubi_btNodePtr P )
+  /* Return the last node in a subtree.  See ubi_BinTree.c. */
+  {
+  return( ubi_btSubSlide( P, ubi_trRIGHT ) );
+  } /* ubi_btLast */
+
+#else /* UBI_INLINE */
+
+long ubi_btSgn( register long x );
+
+ubi_btNodePtr ubi_btInitNode( ubi_btNodePtr NodePtr );
+
+ubi_btNodePtr ubi_btNext( ubi_btNodePtr P );
+
+ubi_btNodePtr ubi_btPrev( ubi_btNodePtr P );
+
+ubi_btNodePtr ubi_btFirst( ubi_btNodePtr P );
+
+ubi_btNodePtr ubi_btLast( ubi_btNodePtr P );
+
+#endif /* UBI_INLINE */
+
+
 /* -------------------------------------------------------------------------- **
  * Masquarade...
  *
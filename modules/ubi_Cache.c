@@ -52,19 +52,509 @@
  * ========================================================================== **
  */
 
+#include <stddef.h>       /* offsetof()                    */
+#include <stdio.h>        /* sprintf()                     */
+#include <string.h>       /* memset(), strlen()            */
 #include "ubi_Cache.h"    /* Header for *this* module. */
+#include "ubi_CachePriv.h" /* Cache internals.             */
+#include "ubi_AVLtree.h"  /* AVL index.                    */
 
 /* -------------------------------------------------------------------------- **
  * Static data...
+ *
+ *  StatsDecay    - Per-sample decay factors for the moving averages, in
+ *                  fixed point (see STATS_SHIFT, below): exp( -5/60 ) and
+ *                  exp( -5/300 ).  The Unix load average uses the same.
+ *  EvictReasons  - Names of the eviction reasons, for export.
  */
 
 static char ModuleID[] =
   "$Id: ubi_Cache.c; 2020-08-05 16:43:13 -0500; Christopher R. Hertel$\n";
 
+static const ubi_cacheCounter StatsDecay[ 2 ] = { 1884, 2014 };
+
+static const char *const EvictReasons[ ubi_cacheEVICT_REASONS ] =
+  { "size", "reduce", "expired", "rejected", "pool" };
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ *
+ *  TimerEntry  - Given a pointer to the timer field of an extended entry,
+ *                return a pointer to the entry.
+ */
+
+#define TimerEntry( T ) \
+  ((ubi_cacheEntryPtr)((char *)(T) - offsetof( ubi_cacheEntryExt, timer )))
+
+/* -------------------------------------------------------------------------- **
+ * Constants...
+ *
+ *  SKETCH_MAX  - The largest value a TinyLFU sketch counter can hold.
+ *  STATS_SHIFT - Number of fraction bits in the moving averages.
+ *  STATS_ONE   - 1.0, in fixed point.
+ *  DUMP_END    - Dump record tag: the end of the dump.
+ */
+
+#define SKETCH_MAX  15
+
+#define STATS_SHIFT 11
+#define STATS_ONE   (1 << STATS_SHIFT)
+
+#define DUMP_END    '.'
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Flight    - A load in progress, for ubi_cacheGetOrLoad().  Flights live
+ *              on the loading thread's stack, and are indexed by the hash
+ *              of the key being loaded.
+ *  Dumper    - The state of a ubi_cacheDump() in progress.
+ */
+
+typedef struct
+  {
+  ubi_btNode    node;           /* Index node, keyed by hash.           */
+  unsigned long hash;           /* Hash of the key being loaded.        */
+  unsigned long waiters;        /* Threads waiting for the load.        */
+  ubi_trBool    done;           /* TRUE once the load has finished.     */
+  } Flight;
+
+typedef struct
+  {
+  ubi_cacheRootPtr       cache;   /* The cache being dumped.            */
+  FILE                  *stream;  /* Where the dump is written.         */
+  ubi_cacheSerializeFunc func;    /* Writes one entry.                  */
+  void                  *context; /* Passed to func.                    */
+  unsigned long          count;   /* Entries written so far.            */
+  ubi_trBool             failed;  /* TRUE once a write has failed.      */
+  unsigned long          lo;      /* Heat: the band being written...    */
+  unsigned long          hi;      /*       ...is ranks lo to hi - 1.    */
+  unsigned long          top;     /* Heat: the hottest entry's heat().  */
+  ubi_trBool             more;    /* Heat: entries are left for later.  */
+  } Dumper;
+
 /* -------------------------------------------------------------------------- **
  * Internal functions...
  */
 
+static int flight_cmp( ubi_btItemPtr ItemPtr, ubi_btNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare a hash value against the hash of a load in progress.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Flight *)NodePtr)->hash;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* flight_cmp */
+
+static void sketch_index( ubi_cacheSketch *Sketch,
+                          unsigned long    Hash,
+                          unsigned long   *H1,
+                          unsigned long   *H2 )
+  /* ------------------------------------------------------------------------ **
+   * Derive the two sketch hashes from a key hash.
+   *
+   *  Input:  Sketch  - A pointer to the sketch.
+   *          Hash    - The key hash, as returned by the cache's hash
+   *                    function.
+   *          H1, H2  - Pointers to the two results.
+   *
+   *  Output: none.
+   *
+   *  Notes:  The key hash is re-mixed, in case the caller's hash function
+   *          leaves the low-order bits poorly distributed.  Row i of the
+   *          sketch uses (H1 + i * H2), which is the usual double hashing
+   *          trick.  H2 is odd, so the rows never all use the same column.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Hash ^= (Hash >> 16) >> 16;
+  Hash ^= Hash >> 16;
+  Hash *= 0x45D9F3BUL;
+  Hash ^= Hash >> 16;
+  *H1   = Hash & Sketch->mask;
+  Hash *= 0x45D9F3BUL;
+  Hash ^= Hash >> 16;
+  *H2   = (Hash | 1) & Sketch->mask;
+  } /* sketch_index */
+
+static void sketch_clear( ubi_cacheSketch *Sketch )
+  /* ------------------------------------------------------------------------ **
+   * Zero the counters and the doorkeeper of a sketch.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( Sketch->counts )
+    {
+    (void)memset( Sketch->counts, 0, 4 * (Sketch->mask + 1) );
+    (void)memset( Sketch->door, 0, (Sketch->mask + 1) / 8 );
+    }
+  Sketch->adds = 0;
+  } /* sketch_clear */
+
+static void sketch_add( ubi_cacheSketch *Sketch, unsigned long Hash )
+  /* ------------------------------------------------------------------------ **
+   * Count one access to a key.
+   *
+   *  Input:  Sketch  - A pointer to the sketch.
+   *          Hash    - The key hash.
+   *
+   *  Output: none.
+   *
+   *  Notes:  The first access only sets the key's doorkeeper bits.  Most
+   *          keys are never seen again, so they never reach the counters.
+   *          After ten additions per column, the sketch is aged: every
+   *          counter is halved and the doorkeeper is cleared, so that old
+   *          popularity fades.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long h1, h2, col, i;
+  unsigned char *c;
+
+  sketch_index( Sketch, Hash, &h1, &h2 );
+  if( !(Sketch->door[h1 >> 3] & (1 << (h1 & 7)))
+   || !(Sketch->door[h2 >> 3] & (1 << (h2 & 7))) )
+    {
+    Sketch->door[h1 >> 3] |= (unsigned char)(1 << (h1 & 7));
+    Sketch->door[h2 >> 3] |= (unsigned char)(1 << (h2 & 7));
+    }
+  else
+    {
+    for( i = 0; i < 4; i++ )
+      {
+      col = (h1 + (i * h2)) & Sketch->mask;
+      c   = &Sketch->counts[(i * (Sketch->mask + 1)) + col];
+      if( *c < SKETCH_MAX )
+        (*c)++;
+      }
+    }
+
+  if( ++(Sketch->adds) >= (10 * (Sketch->mask + 1)) )
+    {
+    for( i = 0; i < (4 * (Sketch->mask + 1)); i++ )
+      Sketch->counts[i] >>= 1;
+    (void)memset( Sketch->door, 0, (Sketch->mask + 1) / 8 );
+    Sketch->adds >>= 1;
+    }
+  } /* sketch_add */
+
+static unsigned int sketch_estimate( ubi_cacheSketch *Sketch,
+                                     unsigned long    Hash )
+  /* ------------------------------------------------------------------------ **
+   * Estimate how often a key has been accessed, recently.
+   *
+   *  Input:  Sketch  - A pointer to the sketch.
+   *          Hash    - The key hash.
+   *
+   *  Output: The smallest of the key's four counters, plus one if the key
+   *          is in the doorkeeper.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long h1, h2, col, i;
+  unsigned int  min = SKETCH_MAX;
+
+  sketch_index( Sketch, Hash, &h1, &h2 );
+  for( i = 0; i < 4; i++ )
+    {
+    col = (h1 + (i * h2)) & Sketch->mask;
+    if( Sketch->counts[(i * (Sketch->mask + 1)) + col] < min )
+      min = Sketch->counts[(i * (Sketch->mask + 1)) + col];
+    }
+  if( (Sketch->door[h1 >> 3] & (1 << (h1 & 7)))
+   && (Sketch->door[h2 >> 3] & (1 << (h2 & 7))) )
+    min++;
+  return( min );
+  } /* sketch_estimate */
+
+static unsigned long window_max( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Return the maximum length of the TinyLFU window: 1% of the cache.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long n;
+
+  n = CachePtr->max_entries ? CachePtr->max_entries
+                            : ubi_cacheGetEntryCount( CachePtr );
+  return( (n >= 200) ? (n / 100) : 1 );
+  } /* window_max */
+
+static unsigned long mark( unsigned long Limit, unsigned int Percent )
+  /* ------------------------------------------------------------------------ **
+   * Return Percent percent of Limit, without overflowing.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( ((Limit / 100) * Percent) + (((Limit % 100) * Percent) / 100) );
+  } /* mark */
+
+static ubi_trBool over_mark( ubi_cacheRootPtr CachePtr, unsigned int Percent )
+  /* ------------------------------------------------------------------------ **
+   * Return TRUE if the cache holds more than Percent percent of its maximum
+   * number of entries, or uses more than Percent percent of its maximum
+   * memory.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( ( CachePtr->max_entries
+     && (mark( CachePtr->max_entries, Percent ) < CachePtr->root.count) )
+   || ( CachePtr->max_memory
+     && (mark( CachePtr->max_memory, Percent ) < CachePtr->mem_used) ) )
+    return( ubi_trTRUE );
+  return( ubi_trFALSE );
+  } /* over_mark */
+
+static ubi_trBool over_limit( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Return TRUE if the cache holds too many entries or uses too much memory.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( ( CachePtr->max_entries
+     && (CachePtr->max_entries < CachePtr->root.count) )
+   || ( CachePtr->max_memory
+     && (CachePtr->max_memory < CachePtr->mem_used) ) )
+    return( ubi_trTRUE );
+  return( ubi_trFALSE );
+  } /* over_limit */
+
+ubi_cacheEntryPtr ubi_cacheIndexFind( ubi_cacheRootPtr CachePtr,
+                                      ubi_trItemPtr    Key,
+                                      unsigned long    Hash,
+                                      ubi_trBool       Splay )
+  /* ------------------------------------------------------------------------ **
+   * Find an entry in the cache's index.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          Key       - The key to look for.
+   *          Hash      - The hash of the key (used by the hash index only).
+   *          Splay     - If TRUE, a splay tree is splayed around the entry.
+   *
+   *  Output: A pointer to the entry, or NULL if it is not in the cache.
+   *
+   *  Notes:  Hash chains are linked through the LEFT link of the entry's
+   *          tree node.  The stored hash is compared before the key.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_btNodePtr p;
+
+  switch( CachePtr->index )
+    {
+    case ubi_cacheINDEX_HASH:
+      for( p = CachePtr->buckets[Hash % CachePtr->bucket_count];
+           NULL != p;
+           p = p->Link[ ubi_trLEFT ] )
+        {
+        if( (((ubi_cacheEntryPtr)p)->hash == Hash)
+         && (0 == (*CachePtr->root.cmp)( Key, p )) )
+          return( (ubi_cacheEntryPtr)p );
+        }
+      return( NULL );
+    case ubi_cacheINDEX_SPLAY:
+      if( Splay )
+        return( (ubi_cacheEntryPtr)ubi_sptFind( (ubi_btRootPtr)CachePtr,
+                                                Key ) );
+      /* Fall through. */
+    default:
+      return( (ubi_cacheEntryPtr)ubi_btFind( (ubi_btRootPtr)CachePtr, Key ) );
+    }
+  } /* ubi_cacheIndexFind */
+
+static ubi_cacheEntryPtr find_key( ubi_cacheRootPtr CachePtr,
+                                   ubi_trItemPtr    Key,
+                                   ubi_trBool       Splay )
+  /* ------------------------------------------------------------------------ **
+   * Find an entry by key alone.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          Key       - The key to look for.
+   *          Splay     - As for ubi_cacheIndexFind().
+   *
+   *  Output: A pointer to the entry, or NULL if it is not in the cache.
+   *
+   *  Notes:  The key is hashed only if the index needs it.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long hash = 0;
+
+  if( ubi_cacheINDEX_HASH == CachePtr->index )
+    hash = (*CachePtr->hash_func)( Key );
+  return( ubi_cacheIndexFind( CachePtr, Key, hash, Splay ) );
+  } /* find_key */
+
+static void index_remove( ubi_cacheRootPtr  CachePtr,
+                          ubi_cacheEntryPtr EntryPtr,
+                          ubi_trBool        Splay )
+  /* ------------------------------------------------------------------------ **
+   * Take an entry out of the cache's index.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          EntryPtr  - A pointer to the entry, which must be indexed.
+   *          Splay     - If TRUE, a splay tree is splayed around the entry
+   *                      before it is removed.  Otherwise, it is simply
+   *                      unlinked, which is O(1) for a leaf.
+   *
+   *  Output: none.
+   *
+   *  Notes:  The AVL tree is always rebalanced.  A hash chain is walked
+   *          to find the link that points at the entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_btNodePtr *pp;
+
+  switch( CachePtr->index )
+    {
+    case ubi_cacheINDEX_HASH:
+      pp = &CachePtr->buckets[EntryPtr->hash % CachePtr->bucket_count];
+      while( *pp != (ubi_btNodePtr)EntryPtr )
+        pp = &(*pp)->Link[ ubi_trLEFT ];
+      *pp = EntryPtr->node.Link[ ubi_trLEFT ];
+      CachePtr->root.count--;
+      break;
+    case ubi_cacheINDEX_AVL:
+      (void)ubi_avlRemove( (ubi_btRootPtr)CachePtr, &EntryPtr->node );
+      break;
+    default:
+      if( Splay )
+        (void)ubi_sptRemove( (ubi_btRootPtr)CachePtr, &EntryPtr->node );
+      else
+        (void)ubi_btRemove( (ubi_btRootPtr)CachePtr, &EntryPtr->node );
+      break;
+    }
+  } /* index_remove */
+
+static ubi_cacheEntryPtr index_insert( ubi_cacheRootPtr  CachePtr,
+                                       ubi_cacheEntryPtr EntryPtr,
+                                       ubi_trItemPtr     Key )
+  /* ------------------------------------------------------------------------ **
+   * Add an entry to the cache's index, replacing any entry with its key.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          EntryPtr  - A pointer to the new entry.  For the hash index,
+   *                      its hash field must be set.
+   *          Key       - A pointer to the entry's key.
+   *
+   *  Output: A pointer to the entry that was replaced, or NULL.
+   *
+   *  Notes:  New entries go at the head of their hash chain.  The other
+   *          links of the tree node are cleared, so that code which
+   *          follows parent links (see note_eviction()) finds none.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_btNodePtr  Old = NULL;
+  ubi_btNodePtr *pp;
+
+  switch( CachePtr->index )
+    {
+    case ubi_cacheINDEX_HASH:
+      Old = (ubi_btNodePtr)ubi_cacheIndexFind( CachePtr, Key, EntryPtr->hash,
+                                               ubi_trFALSE );
+      if( Old )
+        index_remove( CachePtr, (ubi_cacheEntryPtr)Old, ubi_trFALSE );
+      pp = &CachePtr->buckets[EntryPtr->hash % CachePtr->bucket_count];
+      EntryPtr->node.Link[ ubi_trLEFT ]   = *pp;
+      EntryPtr->node.Link[ ubi_trPARENT ] = NULL;
+      EntryPtr->node.Link[ ubi_trRIGHT ]  = NULL;
+      *pp = &EntryPtr->node;
+      CachePtr->root.count++;
+      break;
+    case ubi_cacheINDEX_AVL:
+      (void)ubi_avlInsert( (ubi_btRootPtr)CachePtr, &EntryPtr->node, Key,
+                           &Old );
+      break;
+    default:
+      (void)ubi_sptInsert( (ubi_btRootPtr)CachePtr, &EntryPtr->node, Key,
+                           &Old );
+      break;
+    }
+  return( (ubi_cacheEntryPtr)Old );
+  } /* index_insert */
+
+static unsigned long index_walk( ubi_cacheRootPtr CachePtr,
+                                 ubi_btActionRtn  Action,
+                                 void            *UserData )
+  /* ------------------------------------------------------------------------ **
+   * Call a function for each entry in the cache's index.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          Action    - The function to call.
+   *          UserData  - Passed to Action.
+   *
+   *  Output: The number of entries visited.
+   *
+   *  Notes:  As with ubi_btTraverse(), Action may remove the entry that
+   *          it is given.  Trees are walked in key order; hash tables in
+   *          no particular order.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_btNodePtr p, q;
+  unsigned long i, count = 0;
+
+  if( ubi_cacheINDEX_HASH != CachePtr->index )
+    return( ubi_btTraverse( (ubi_btRootPtr)CachePtr, Action, UserData ) );
+  for( i = 0; i < CachePtr->bucket_count; i++ )
+    {
+    for( p = CachePtr->buckets[i]; NULL != p; p = q )
+      {
+      q = p->Link[ ubi_trLEFT ];
+      (*Action)( p, UserData );
+      count++;
+      }
+    }
+  return( count );
+  } /* index_walk */
+
+void ubi_cacheFreeMemory( ubi_cacheRootPtr  CachePtr,
+                          ubi_cacheEntryPtr EntryPtr )
+  /* ------------------------------------------------------------------------ **
+   * Free the memory of an entry, now.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          EntryPtr  - A pointer to the entry, which is not in the cache.
+   *
+   *  Output: none.
+   *
+   *  Notes:  A cache that keeps its entries in a slab pool may have no
+   *          free function, in which case the chunk goes straight back
+   *          to the pool.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( CachePtr->free_func )
+    (*CachePtr->free_func)( (void *)EntryPtr );
+  else
+    ubi_slabFree( CachePtr->slab, (void *)EntryPtr );
+  } /* ubi_cacheFreeMemory */
+
+static void discard( ubi_cacheRootPtr CachePtr, ubi_cacheEntryPtr EntryPtr )
+  /* ------------------------------------------------------------------------ **
+   * Hand an entry that is no longer in the cache to the free function.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          EntryPtr  - A pointer to the entry.
+   *
+   *  Output: none.
+   *
+   *  Notes:  If the cache has a retire function, the entry is handed to
+   *          it rather than freed.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( CachePtr->retire )
+    (*CachePtr->retire)( CachePtr->retire_ctx, (void *)EntryPtr );
+  else
+    ubi_cacheFreeMemory( CachePtr, EntryPtr );
+  } /* discard */
+
 static void free_entry( ubi_cacheRootPtr CachePtr, ubi_cacheEntryPtr EntryPtr )
   /* ------------------------------------------------------------------------ **
    * Free a ubi_cacheEntry, and adjust the mem_used counter accordingly.
@@ -76,34 +566,849 @@ static void free_entry( ubi_cacheRootPtr CachePtr, ubi_cacheEntryPtr EntryPtr )
    *  Output: none.
    *
    *  Notes:  Remove the entry from the cache before calling this function.
+   *          See discard().  A pending expiry timer is cancelled.  A slab
+   *          chunk is taken off of its class's LRU list, so that it can't
+   *          be chosen as a victim again while it waits to be freed.
+   *          A pinned entry is only marked as gone.  It is freed when the
+   *          last reference to it is released.
    *
    * ------------------------------------------------------------------------ **
    */
   {
   CachePtr->mem_used -= EntryPtr->entry_size;
-  (*CachePtr->free_func)( (void *)EntryPtr );
+  if( CachePtr->pool )
+    ubi_cachePoolCharge( CachePtr, 0, EntryPtr->entry_size );
+  if( CachePtr->slab )
+    ubi_slabUnlink( CachePtr->slab, EntryPtr );
+  if( Expiring( CachePtr, EntryPtr ) )
+    (void)ubi_timerCancel( CachePtr->wheel, &ExtEntry( EntryPtr )->timer );
+  if( EntryPtr->refs )
+    {
+    CachePtr->pinned--;
+    EntryPtr->flags = GONE_BIT;
+    }
+  else
+    discard( CachePtr, EntryPtr );
   } /* free_entry */
 
+static void note_eviction( ubi_cacheRootPtr  CachePtr,
+                           ubi_cacheEntryPtr EntryPtr,
+                           int               Reason )
+  /* ------------------------------------------------------------------------ **
+   * Count an eviction.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          EntryPtr  - The entry that is about to be evicted.  It must
+   *                      still be in the tree.
+   *          Reason    - One of the ubi_cacheEVICT_* values.
+   *
+   *  Output: none.
+   *
+   *  Notes:  The depth is found by following parent links up to the root,
+   *          which costs no more than the removal that follows.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_btNodePtr p     = (ubi_btNodePtr)EntryPtr;
+  unsigned long depth = 0;
+
+  while( NULL != (p = p->Link[ ubi_trPARENT ]) )
+    depth++;
+  CachePtr->stats.evictions[Reason]++;
+  CachePtr->stats.evicted_bytes += EntryPtr->entry_size;
+  CachePtr->stats.evicted_depth += depth;
+  if( depth > CachePtr->stats.max_depth )
+    CachePtr->stats.max_depth = depth;
+  } /* note_eviction */
+
+static void evict_entry( ubi_cacheRootPtr  CachePtr,
+                         ubi_cacheEntryPtr EntryPtr,
+                         int               Reason )
+  /* ------------------------------------------------------------------------ **
+   * Evict an entry from the cache, for the given reason.
+   *
+   *  Notes:  The entry is removed without splaying.  It is about to be
+   *          freed, so there is no point in moving it to the root first.
+   *          For a leaf (the usual victim of the splay policy), removal
+   *          is then O(1), instead of two full-depth splays.
+   *          If the cache has a spill log, the entry is written to it
+   *          first, unless an entry is being read back from the log.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  note_eviction( CachePtr, EntryPtr, Reason );
+  index_remove( CachePtr, EntryPtr, ubi_trFALSE );
+  ubi_cachePolicyRemove( CachePtr, EntryPtr );
+  ubi_cachePolicyEvicted( CachePtr, EntryPtr );
+  if( CachePtr->spill && !CachePtr->spill->busy )
+    ubi_cacheSpillAdd( CachePtr, EntryPtr );
+  free_entry( CachePtr, EntryPtr );
+  } /* evict_entry */
+
+static void slab_evict( void *UserData, void *Ptr )
+  /* ------------------------------------------------------------------------ **
+   * Evict the entry in a slab chunk.
+   *
+   *  Input:  UserData  - A pointer to the cache.
+   *          Ptr       - A live chunk, which holds an entry.
+   *
+   *  Output: none.
+   *
+   *  Notes:  This is the ubi_slabRebalance() callback.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  evict_entry( (ubi_cacheRootPtr)UserData, (ubi_cacheEntryPtr)Ptr,
+               ubi_cacheEVICT_SIZE );
+  } /* slab_evict */
+
+static void slab_unlink( ubi_trNodePtr NodePtr, void *UserData )
+  /* ------------------------------------------------------------------------ **
+   * Take an entry's slab chunk off of the LRU list.
+   *
+   *  Input:  NodePtr   - A pointer to the entry.
+   *          UserData  - A pointer to the slab pool.
+   *
+   *  Output: none.
+   *
+   *  Notes:  This is an index_walk() callback, used when the cache is
+   *          cleared.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_slabUnlink( (ubi_slabPoolPtr)UserData, NodePtr );
+  } /* slab_unlink */
+
+static void clear_entry( ubi_trNodePtr NodePtr, void *UserData )
+  /* ------------------------------------------------------------------------ **
+   * Remove an entry from the tree, and free it unless it is pinned.
+   *
+   *  Input:  NodePtr   - A pointer to the entry.
+   *          UserData  - A pointer to the cache.
+   *
+   *  Output: none.
+   *
+   *  Notes:  This is an index_walk() callback, used when a cache with
+   *          pinned entries, a hash index, a retire function, or no free
+   *          function is cleared.
+   *          (The walk allows the current entry to be removed.)  The
+   *          pinned entries are left for ubi_cacheRelease() to free.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRootPtr  CachePtr = (ubi_cacheRootPtr)UserData;
+  ubi_cacheEntryPtr EntryPtr = (ubi_cacheEntryPtr)NodePtr;
+
+  index_remove( CachePtr, EntryPtr, ubi_trFALSE );
+  if( EntryPtr->refs )
+    EntryPtr->flags = GONE_BIT;
+  else
+    discard( CachePtr, EntryPtr );
+  } /* clear_entry */
+
+static void forget( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Reset everything that refers to the entries of a cache whose index is
+   * now empty.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *
+   *  Output: none.
+   *
+   *  Notes:  Used by ubi_cacheClear() and ubi_cacheAbandon().  The
+   *          settings and the stats are kept.  The memory that the
+   *          entries used is given back to the cache's pool, if any.
+   *          Spilled entries are forgotten, too.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long used = CachePtr->mem_used;
+
+  ubi_cachePolicyReset( CachePtr );
+  (void)ubi_dlInitList( &CachePtr->window );
+  ubi_cacheSpillReset( CachePtr );
+  sketch_clear( &CachePtr->sketch );
+  if( CachePtr->wheel )
+    (void)ubi_timerInitWheel( CachePtr->wheel, CachePtr->wheel->now );
+  CachePtr->trimming    = ubi_trFALSE;
+  CachePtr->mem_used    = 0;
+  CachePtr->cache_hits  = 0;
+  CachePtr->cache_trys  = 0;
+  CachePtr->pinned      = 0;
+  if( CachePtr->pool )
+    ubi_cachePoolCharge( CachePtr, 0, used );
+  } /* forget */
+
+static void admit( ubi_cacheRootPtr CachePtr, ubi_cacheEntryPtr EntryPtr )
+  /* ------------------------------------------------------------------------ **
+   * Move an entry out of the TinyLFU window, if it is worth keeping.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          EntryPtr  - The candidate, which is the oldest entry in the
+   *                      window.
+   *
+   *  Output: none.
+   *
+   *  Notes:  If the cache has room, the candidate is simply handed to the
+   *          eviction policy.  Otherwise, its estimated frequency is
+   *          compared with that of the policy's victim, and the loser is
+   *          evicted.  Ties go to the victim, which is already known to be
+   *          useful.  (With the splay policy, the victim may be the
+   *          candidate itself.)  If either one is pinned, the candidate
+   *          is let in, and cachetrim() makes room later.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheEntryPtr Victim;
+
+  (void)ubi_dlRemThis( &CachePtr->window, &EntryPtr->link );
+  EntryPtr->flags = 0;
+  if( over_limit( CachePtr ) && !EntryPtr->refs )
+    {
+    Victim = ubi_cachePolicyVictim( CachePtr );
+    if( (NULL != Victim) && Victim->refs )
+      Victim = NULL;
+    if( (Victim == EntryPtr)
+     || ( (NULL != Victim)
+       && (sketch_estimate( &CachePtr->sketch, EntryPtr->hash )
+           <= sketch_estimate( &CachePtr->sketch, Victim->hash )) ) )
+      {
+      note_eviction( CachePtr, EntryPtr, ubi_cacheEVICT_REJECTED );
+      index_remove( CachePtr, EntryPtr, ubi_trTRUE );
+      free_entry( CachePtr, EntryPtr );
+      return;
+      }
+    if( NULL != Victim )
+      evict_entry( CachePtr, Victim, ubi_cacheEVICT_SIZE );
+    }
+  ubi_cachePolicyInsert( CachePtr, EntryPtr );
+  } /* admit */
+
+static void expire_entry( ubi_timerNodePtr TimerPtr, void *UserData )
+  /* ------------------------------------------------------------------------ **
+   * Remove and free an entry whose time is up.
+   *
+   *  Input:  TimerPtr  - A pointer to the timer field of the entry.
+   *          UserData  - A pointer to the cache.
+   *
+   *  Output: none.
+   *
+   *  Notes:  This is the ubi_timerAdvance() callback, but it is also used
+   *          when ubi_cacheGet() finds an expired entry.  Expired entries
+   *          are not evictions, so the policy does not remember them.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRootPtr  CachePtr = (ubi_cacheRootPtr)UserData;
+  ubi_cacheEntryPtr EntryPtr = TimerEntry( TimerPtr );
+
+  note_eviction( CachePtr, EntryPtr, ubi_cacheEVICT_EXPIRED );
+  index_remove( CachePtr, EntryPtr, ubi_trTRUE );
+  ubi_cachePolicyRemove( CachePtr, EntryPtr );
+  free_entry( CachePtr, EntryPtr );
+  } /* expire_entry */
+
+ubi_trBool ubi_cacheEvict( ubi_cacheRootPtr CachePtr,
+                           unsigned long    count,
+                           int              Reason )
+  /* ------------------------------------------------------------------------ **
+   * Evict up to count entries, as chosen by the eviction policy.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          count     - The number of entries to remove.
+   *          Reason    - The reason, for the statistics.
+   *
+   *  Output: TRUE if count entries were removed, else FALSE.
+   *
+   *  Notes:  See ubi_cacheReduce().  Pinned victims are passed over (see
+   *          ubi_cachePolicyPassOver()).  If more victims are passed over
+   *          than there are entries, they must all be pinned, so FALSE is
+   *          returned.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheEntryPtr EntryPtr;
+  ubi_dlList        passed;
+  unsigned long     skipped = 0;
+
+  (void)ubi_dlInitList( &passed );
+  while( count )
+    {
+    EntryPtr = ubi_cachePolicyVictim( CachePtr );
+    if( (NULL == EntryPtr) && ubi_dlCount( &CachePtr->window ) )
+      EntryPtr = LinkEntry( ubi_dlLast( &CachePtr->window ) );
+    if( NULL == EntryPtr )
+      break;
+    if( EntryPtr->refs )
+      {
+      if( (CachePtr->pinned >= ubi_trCount( CachePtr ))
+       || (skipped++ >= ubi_trCount( CachePtr )) )
+        break;
+      ubi_cachePolicyPassOver( CachePtr, EntryPtr, &passed );
+      continue;
+      }
+    evict_entry( CachePtr, EntryPtr, Reason );
+    count--;
+    }
+  ubi_cachePolicyPassDone( CachePtr, &passed );
+  return( (0 == count) ? ubi_trTRUE : ubi_trFALSE );
+  } /* ubi_cacheEvict */
+
 static void cachetrim( ubi_cacheRootPtr crptr )
   /* ------------------------------------------------------------------------ **
-   * Remove entries from the cache until the number of entries and the amount
-   * of memory used are both at or below the maximum.
+   * If the cache has grown past its high watermark, remove entries until
+   * the number of entries and the amount of memory used are both at or
+   * below the low watermark.
    *
    *  Input:  crptr - pointer to the cache to be trimmed.
    *
    *  Output: None.
    *
+   *  Notes:  Expired entries, if any, are removed first.
+   *          If the cache has a trim budget, at most that many entries are
+   *          evicted per call.  The trimming flag stays set until the low
+   *          watermark is reached, so the next call picks up where this
+   *          one left off.
    * ------------------------------------------------------------------------ **
    */
   {
-  while( ( crptr->max_entries && (crptr->max_entries < crptr->root.count) )
-      || ( crptr->max_memory  && (crptr->max_memory  < crptr->mem_used)   ) )
+  unsigned long n = 0;
+
+  if( over_mark( crptr, crptr->high_water ) )
+    crptr->trimming = ubi_trTRUE;
+  if( !crptr->trimming )
+    return;
+  if( crptr->wheel && ubi_timerCount( crptr->wheel ) )
+    (void)ubi_timerAdvance( crptr->wheel, crptr->now, expire_entry, crptr );
+  while( over_mark( crptr, crptr->low_water ) )
     {
-    if( !ubi_cacheReduce( crptr, 1 ) )
+    if( crptr->trim_budget && (n >= crptr->trim_budget) )
       return;
+    if( !ubi_cacheEvict( crptr, 1, ubi_cacheEVICT_SIZE ) )
+      break;
+    n++;
     }
+  crptr->trimming = ubi_trFALSE;
   } /* cachetrim */
 
+void ubi_cachePutEntry( ubi_cacheRootPtr  CachePtr,
+                        unsigned long     EntrySize,
+                        ubi_cacheEntryPtr EntryPtr,
+                        ubi_trItemPtr     Key,
+                        ubi_trBool        Timed,
+                        unsigned long     Expires )
+  /* ------------------------------------------------------------------------ **
+   * Add an entry to the cache.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          EntrySize - The size of the entry.
+   *          EntryPtr  - A pointer to the new entry.
+   *          Key       - A pointer to the entry's key.
+   *          Timed     - TRUE if the entry should expire.
+   *          Expires   - If Timed, the tick at which the entry expires.
+   *
+   *  Output: none.
+   *
+   *  Notes:  See ubi_cachePut().  The timer is started before the entry
+   *          can be refused admission or trimmed, so that free_entry()
+   *          always finds it in a consistent state.  With a slab pool,
+   *          the entry is charged the size of its chunk, not EntrySize.
+   *          Loaded entries skip the TinyLFU window; they were admitted
+   *          before the dump was taken.  Once the cache is within its own
+   *          limits, its pool (if any) is brought within its budget.  A
+   *          spilled copy of the key's entry is out of date, and is
+   *          forgotten.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheEntryPtr OldPtr;
+
+  if( CachePtr->slab )
+    {
+    EntrySize = ubi_slabChunkSize( CachePtr->slab, EntryPtr );
+    ubi_slabLink( CachePtr->slab, EntryPtr );
+    }
+  EntryPtr->entry_size = EntrySize;
+  EntryPtr->flags      = 0;
+  EntryPtr->hash       = 0;
+  EntryPtr->refs       = 0;
+  if( CachePtr->wheel )
+    (void)ubi_timerInitNode( &ExtEntry( EntryPtr )->timer );
+  if( CachePtr->hash_func )
+    EntryPtr->hash = (*CachePtr->hash_func)( Key );
+  if( CachePtr->spill )
+    ubi_cacheSpillForget( CachePtr, EntryPtr->hash );
+  if( CachePtr->mrc )
+    ubi_mrcSetSize( CachePtr->mrc, ubi_mrcHash( EntryPtr->hash ), EntrySize );
+  CachePtr->mem_used  += EntrySize;
+  if( CachePtr->pool )
+    ubi_cachePoolCharge( CachePtr, EntrySize, 0 );
+  CachePtr->stats.inserts++;
+  OldPtr = index_insert( CachePtr, EntryPtr, Key );
+  if( OldPtr )
+    {
+    CachePtr->stats.overwrites++;
+    ubi_cachePolicyRemove( CachePtr, OldPtr );
+    free_entry( CachePtr, OldPtr );
+    }
+  if( Timed && CachePtr->wheel )
+    (void)ubi_timerAdd( CachePtr->wheel,
+                        &ExtEntry( EntryPtr )->timer, Expires );
+  if( CachePtr->sketch.counts && !CachePtr->loading )
+    {
+    EntryPtr->flags = WIN_BIT;
+    (void)ubi_dlAddHead( &CachePtr->window, &EntryPtr->link );
+    while( ubi_dlCount( &CachePtr->window ) > window_max( CachePtr ) )
+      admit( CachePtr, LinkEntry( ubi_dlLast( &CachePtr->window ) ) );
+    }
+  else
+    ubi_cachePolicyInsert( CachePtr, EntryPtr );
+
+  cachetrim( CachePtr );
+  if( CachePtr->pool )
+    ubi_cachePoolTrim( CachePtr );
+  } /* ubi_cachePutEntry */
+
+static ubi_trBool write_number( FILE *Stream, unsigned long Number )
+  /* ------------------------------------------------------------------------ **
+   * Write a number to a dump, seven bits at a time, low bits first.
+   *
+   *  Input:  Stream  - The dump file.
+   *          Number  - The number to write.
+   *
+   *  Output: TRUE on success, FALSE if the write failed.
+   *
+   *  Notes:  The high bit of each byte is set if more bytes follow, so
+   *          small numbers take a single byte.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  while( Number > 0x7F )
+    {
+    if( EOF == putc( (int)((Number & 0x7F) | 0x80), Stream ) )
+      return( ubi_trFALSE );
+    Number >>= 7;
+    }
+  return( (EOF == putc( (int)Number, Stream )) ? ubi_trFALSE : ubi_trTRUE );
+  } /* write_number */
+
+static ubi_trBool read_number( FILE *Stream, unsigned long *Number )
+  /* ------------------------------------------------------------------------ **
+   * Read a number written by write_number().
+   *
+   *  Input:  Stream  - The dump file.
+   *          Number  - Where to put the number.
+   *
+   *  Output: TRUE on success, FALSE at the end of the file, or if the
+   *          number is too big.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long n     = 0;
+  unsigned int  shift = 0;
+  int           c;
+
+  do
+    {
+    if( (EOF == (c = getc( Stream ))) || (shift >= (8 * sizeof( n ))) )
+      return( ubi_trFALSE );
+    n |= (unsigned long)(c & 0x7F) << shift;
+    shift += 7;
+    } while( c & 0x80 );
+  *Number = n;
+  return( ubi_trTRUE );
+  } /* read_number */
+
+static void dump_entry( ubi_cacheRootPtr  CachePtr,
+                        Dumper           *Dump,
+                        ubi_cacheEntryPtr EntryPtr )
+  /* ------------------------------------------------------------------------ **
+   * Write one entry to a dump.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          Dump      - The dump in progress.
+   *          EntryPtr  - The entry to write.
+   *
+   *  Output: none.  Dump->failed is set if the write failed.
+   *
+   *  Notes:  A record is the DUMP_ENTRY tag, the number of ticks the entry
+   *          has left to live (zero if it never expires), and whatever the
+   *          serialization function writes.  Entries that have already
+   *          expired are skipped.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long left = 0;
+
+  if( Dump->failed )
+    return;
+  if( Expiring( CachePtr, EntryPtr ) )
+    {
+    left = ExtEntry( EntryPtr )->timer.expires - CachePtr->now;
+    if( (0 == left) || (left > (~0UL >> 1)) )
+      return;
+    }
+  if( (EOF == putc( DUMP_ENTRY, Dump->stream ))
+   || !write_number( Dump->stream, left )
+   || !(*Dump->func)( Dump->stream, EntryPtr, Dump->context ) )
+    Dump->failed = ubi_trTRUE;
+  else
+    Dump->count++;
+  } /* dump_entry */
+
+static void dump_list( ubi_cacheRootPtr CachePtr,
+                       Dumper          *Dump,
+                       ubi_dlListPtr    List )
+  /* ------------------------------------------------------------------------ **
+   * Dump the entries on a list, from head to tail.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_dlNodePtr p;
+
+  for( p = ubi_dlFirst( List ); p && !Dump->failed; p = ubi_dlNext( p ) )
+    dump_entry( CachePtr, Dump, LinkEntry( p ) );
+  } /* dump_list */
+
+static void dump_ring( ubi_cacheRootPtr CachePtr,
+                       Dumper          *Dump,
+                       ubi_trBool       Used )
+  /* ------------------------------------------------------------------------ **
+   * Dump some of the entries on the clock ring.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          Dump      - The dump in progress.
+   *          Used      - If TRUE, dump the entries that are hot or have
+   *                      their reference bit set.  If FALSE, dump the rest.
+   *
+   *  Output: none.
+   *
+   *  Notes:  The ring is walked backward from the hand, which visits the
+   *          entries that the hand passed (or that were added) most
+   *          recently first.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheEntryPtr EntryPtr;
+  ubi_dlNodePtr     p;
+  unsigned long     n;
+
+  if( NULL == CachePtr->hand )
+    return;
+  p = CachePtr->hand;
+  for( n = ubi_dlCount( &CachePtr->lru ); n && !Dump->failed; n-- )
+    {
+    p = ubi_dlPrev( p ) ? ubi_dlPrev( p ) : ubi_dlLast( &CachePtr->lru );
+    EntryPtr = LinkEntry( p );
+    if( (0 != (EntryPtr->flags & (HOT_BIT | REF_BIT))) == (0 != Used) )
+      dump_entry( CachePtr, Dump, EntryPtr );
+    }
+  } /* dump_ring */
+
+static void dump_tree( ubi_cacheRootPtr CachePtr, Dumper *Dump )
+  /* ------------------------------------------------------------------------ **
+   * Dump the entries in the splay tree, roughly hottest first.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          Dump      - The dump in progress.
+   *
+   *  Output: none.
+   *
+   *  Notes:  Used by the splay policy, which keeps no list.  Recently used
+   *          entries are near the root, so the tree is walked once for
+   *          each band of depths: 0, then 1-2, then 3-6, and so on, and
+   *          the walk does not go below the current band.  Entries in the
+   *          TinyLFU window are skipped; the caller dumps them separately.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_btNodePtr     p, q;
+  ubi_cacheEntryPtr EntryPtr;
+  unsigned long     lo, hi, depth;
+  ubi_trBool        more;
+
+  lo = 0;
+  hi = 1;
+  do
+    {
+    more  = ubi_trFALSE;
+    depth = 0;
+    p     = (ubi_btNodePtr)CachePtr->root.root;
+    while( p && !Dump->failed )
+      {
+      EntryPtr = (ubi_cacheEntryPtr)p;
+      if( (depth >= lo) && !(EntryPtr->flags & WIN_BIT) )
+        dump_entry( CachePtr, Dump, EntryPtr );
+
+      /* Go down, if the children are in the band. */
+      q = NULL;
+      if( (depth + 1) < hi )
+        q = p->Link[ ubi_trLEFT ] ? p->Link[ ubi_trLEFT ]
+                                  : p->Link[ ubi_trRIGHT ];
+      else if( p->Link[ ubi_trLEFT ] || p->Link[ ubi_trRIGHT ] )
+        more = ubi_trTRUE;
+      if( q )
+        {
+        p = q;
+        depth++;
+        continue;
+        }
+
+      /* Go up to the nearest right subtree that has not been visited. */
+      for( q = p->Link[ ubi_trPARENT ]; q; q = q->Link[ ubi_trPARENT ] )
+        {
+        if( (p == q->Link[ ubi_trLEFT ]) && q->Link[ ubi_trRIGHT ] )
+          break;
+        p = q;
+        depth--;
+        }
+      p = q ? q->Link[ ubi_trRIGHT ] : NULL;
+      }
+    lo = hi;
+    hi = (2 * hi) + 1;
+    } while( more && !Dump->failed );
+  } /* dump_tree */
+
+static unsigned long heat( ubi_cacheRootPtr CachePtr,
+                           ubi_cacheEntryPtr EntryPtr )
+  /* ------------------------------------------------------------------------ **
+   * Return a rough measure of how much an entry is used, for the dump.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          EntryPtr  - A pointer to the entry.
+   *
+   *  Output: For GDSF, the log2 of half of the entry's use count.  For the
+   *          sampled policy, 32 minus the log2 of its age.  Either way,
+   *          the hotter the entry, the larger the result.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long f, n = 0;
+
+  if( ubi_cacheSAMPLED == CachePtr->policy )
+    {
+    for( f = (AccessClock( CachePtr ) - ExtEntry( EntryPtr )->pol.smp.atime)
+             & 0xFFFFFFFFUL;
+         f;
+         f >>= 1 )
+      n++;
+    return( 32 - n );
+    }
+  for( f = ExtEntry( EntryPtr )->pol.gdsf.freq >> 1; f; f >>= 1 )
+    n++;
+  return( n );
+  } /* heat */
+
+static void heat_top( ubi_btNodePtr NodePtr, void *UserData )
+  /* ------------------------------------------------------------------------ **
+   * Note the largest heat() of the entries that are not in the window.
+   *
+   *  Notes:  This is an index_walk() callback.  UserData is the Dumper.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Dumper           *Dump     = (Dumper *)UserData;
+  ubi_cacheEntryPtr EntryPtr = (ubi_cacheEntryPtr)NodePtr;
+
+  if( !(EntryPtr->flags & WIN_BIT)
+   && (heat( Dump->cache, EntryPtr ) > Dump->top) )
+    Dump->top = heat( Dump->cache, EntryPtr );
+  } /* heat_top */
+
+static void heat_band( ubi_btNodePtr NodePtr, void *UserData )
+  /* ------------------------------------------------------------------------ **
+   * Dump an entry, if its rank is in the current band.
+   *
+   *  Notes:  This is an index_walk() callback.  UserData is the Dumper.
+   *          The rank counts down from the hottest entries, so that
+   *          they are written first.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Dumper           *Dump     = (Dumper *)UserData;
+  ubi_cacheEntryPtr EntryPtr = (ubi_cacheEntryPtr)NodePtr;
+  unsigned long     f, rank;
+
+  if( (EntryPtr->flags & WIN_BIT) || Dump->failed )
+    return;
+  f    = heat( Dump->cache, EntryPtr );
+  rank = (f < Dump->top) ? (Dump->top - f) : 0;
+  if( rank >= Dump->hi )
+    Dump->more = ubi_trTRUE;
+  else if( rank >= Dump->lo )
+    dump_entry( Dump->cache, Dump, EntryPtr );
+  } /* heat_band */
+
+static void dump_heat( ubi_cacheRootPtr CachePtr, Dumper *Dump )
+  /* ------------------------------------------------------------------------ **
+   * Dump the entries in order of heat(), hottest first.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          Dump      - The dump in progress.
+   *
+   *  Output: none.
+   *
+   *  Notes:  Entries are ranked by GDSF frequency or by age, in powers of
+   *          two, and the index is walked once for each band of ranks: 0,
+   *          then 1-2, then 3-6, and so on.  Entries in the TinyLFU window are
+   *          skipped; the caller dumps them separately.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Dump->top = 0;
+  (void)index_walk( CachePtr, heat_top, Dump );
+  Dump->lo = 0;
+  Dump->hi = 1;
+  do
+    {
+    Dump->more = ubi_trFALSE;
+    (void)index_walk( CachePtr, heat_band, Dump );
+    Dump->lo = Dump->hi;
+    Dump->hi = (2 * Dump->hi) + 1;
+    } while( Dump->more && !Dump->failed );
+  } /* dump_heat */
+
+static ubi_trBool has_room( ubi_cacheRootPtr CachePtr, unsigned long Size )
+  /* ------------------------------------------------------------------------ **
+   * Return TRUE if an entry of the given size can be added without going
+   * over the high watermark.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( ( CachePtr->max_entries
+     && (mark( CachePtr->max_entries, CachePtr->high_water )
+         <= CachePtr->root.count) )
+   || ( CachePtr->max_memory
+     && (mark( CachePtr->max_memory, CachePtr->high_water )
+         < (CachePtr->mem_used + Size)) ) )
+    return( ubi_trFALSE );
+  return( ubi_trTRUE );
+  } /* has_room */
+
+static size_t append( char       *Buffer,
+                      size_t      Size,
+                      size_t      Len,
+                      const char *Text )
+  /* ------------------------------------------------------------------------ **
+   * Append a string to a buffer, in the manner of snprintf().
+   *
+   *  Input:  Buffer  - The output buffer.
+   *          Size    - The size of the buffer.
+   *          Len     - The length of the text produced so far, which may
+   *                    be more than will fit in the buffer.
+   *          Text    - The string to append.
+   *
+   *  Output: The new length.
+   *
+   *  Notes:  Text that does not fit is counted, but not written.  The
+   *          buffer is always nul terminated (if Size is not zero).
+   *          Numbers are formatted with sprintf() into a small scratch
+   *          buffer first; there is no vsnprintf() in C89.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  size_t n = strlen( Text );
+  size_t room;
+
+  if( Len < Size )
+    {
+    room = Size - Len - 1;
+    (void)memcpy( Buffer + Len, Text, (n < room) ? n : room );
+    Buffer[ Len + ((n < room) ? n : room) ] = '\0';
+    }
+  return( Len + n );
+  } /* append */
+
+static size_t put_value( char       *Buffer,
+                         size_t      Size,
+                         size_t      Len,
+                         const char *Metric,
+                         const char *Name,
+                         const char *Label,
+                         const char *LabelValue,
+                         const char *Value )
+  /* ------------------------------------------------------------------------ **
+   * Append one Prometheus sample line.
+   *
+   *  Input:  Buffer, Size, Len - As for append().
+   *          Metric      - Metric name, without the "ubi_cache_" prefix.
+   *          Name        - The cache name, or NULL.  If given, it becomes
+   *                        the value of a "cache" label.
+   *          Label       - The name of an additional label, or NULL.
+   *          LabelValue  - The value of the additional label.
+   *          Value       - The sample value, already formatted.
+   *
+   *  Output: The new length.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Len = append( Buffer, Size, Len, "ubi_cache_" );
+  Len = append( Buffer, Size, Len, Metric );
+  if( Name || Label )
+    {
+    Len = append( Buffer, Size, Len, "{" );
+    if( Name )
+      {
+      Len = append( Buffer, Size, Len, "cache=\"" );
+      Len = append( Buffer, Size, Len, Name );
+      Len = append( Buffer, Size, Len, Label ? "\"," : "\"" );
+      }
+    if( Label )
+      {
+      Len = append( Buffer, Size, Len, Label );
+      Len = append( Buffer, Size, Len, "=\"" );
+      Len = append( Buffer, Size, Len, LabelValue );
+      Len = append( Buffer, Size, Len, "\"" );
+      }
+    Len = append( Buffer, Size, Len, "}" );
+    }
+  Len = append( Buffer, Size, Len, " " );
+  Len = append( Buffer, Size, Len, Value );
+  return( append( Buffer, Size, Len, "\n" ) );
+  } /* put_value */
+
+static size_t put_header( char       *Buffer,
+                          size_t      Size,
+                          size_t      Len,
+                          const char *Metric,
+                          const char *Type,
+                          const char *Help )
+  /* ------------------------------------------------------------------------ **
+   * Append the HELP and TYPE lines for a Prometheus metric.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Len = append( Buffer, Size, Len, "# HELP ubi_cache_" );
+  Len = append( Buffer, Size, Len, Metric );
+  Len = append( Buffer, Size, Len, " " );
+  Len = append( Buffer, Size, Len, Help );
+  Len = append( Buffer, Size, Len, "\n# TYPE ubi_cache_" );
+  Len = append( Buffer, Size, Len, Metric );
+  Len = append( Buffer, Size, Len, " " );
+  Len = append( Buffer, Size, Len, Type );
+  return( append( Buffer, Size, Len, "\n" ) );
+  } /* put_header */
+
+static size_t put_single( char            *Buffer,
+                          size_t           Size,
+                          size_t           Len,
+                          const char      *Name,
+                          const char      *Metric,
+                          const char      *Type,
+                          const char      *Help,
+                          ubi_cacheCounter Value )
+  /* ------------------------------------------------------------------------ **
+   * Append a metric that has a single, integer, sample.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  char num[32];
+
+  (void)sprintf( num, ubi_cacheCOUNTER_FMT, Value );
+  Len = put_header( Buffer, Size, Len, Metric, Type, Help );
+  return( put_value( Buffer, Size, Len, Metric, Name, NULL, NULL, num ) );
+  } /* put_single */
+
 
 /* -------------------------------------------------------------------------- **
  * Exported functions...
@@ -126,7 +1431,9 @@ ubi_cacheRootPtr ubi_cacheInit( ubi_cacheRootPtr  CachePtr,
    *                      will likely be free().  If you are allocating
    *                      cache entries from a free list, then this will
    *                      likely be a function that returns memory to the
-   *                      free list, etc.
+   *                      free list, etc.  If the cache will keep its
+   *                      entries in a slab pool, this may be NULL.  See
+   *                      \c #ubi_cacheSetSlab().
    * @param   MaxEntries  The maximum number of entries that will be
    *                      allowed to exist in the cache.  If this limit
    *                      is exceeded, then existing entries will be
@@ -166,6 +1473,40 @@ ubi_cacheRootPtr ubi_cacheInit( ubi_cacheRootPtr  CachePtr,
     CachePtr->mem_used    = 0;
     CachePtr->cache_hits  = 0;
     CachePtr->cache_trys  = 0;
+    CachePtr->retire      = NULL;
+    CachePtr->retire_ctx  = NULL;
+    ubi_cachePolicyInit( CachePtr );
+    CachePtr->extended    = ubi_trFALSE;
+    CachePtr->hash_func   = NULL;
+    (void)ubi_dlInitList( &CachePtr->window );
+    CachePtr->sketch.counts   = NULL;
+    CachePtr->sketch.door     = NULL;
+    CachePtr->sketch.mask     = 0;
+    CachePtr->sketch.adds     = 0;
+    CachePtr->wheel           = NULL;
+    CachePtr->now             = 0;
+    CachePtr->high_water      = 100;
+    CachePtr->low_water       = 100;
+    CachePtr->trim_budget     = 0;
+    CachePtr->trimming        = ubi_trFALSE;
+    (void)ubi_btInitTree( &CachePtr->flights, flight_cmp, 0 );
+    CachePtr->lock            = NULL;
+    CachePtr->unlock          = NULL;
+    CachePtr->wait            = NULL;
+    CachePtr->wake            = NULL;
+    CachePtr->sync            = NULL;
+    CachePtr->load_check      = NULL;
+    CachePtr->check_ctx       = NULL;
+    CachePtr->slab            = NULL;
+    CachePtr->loading         = ubi_trFALSE;
+    CachePtr->mrc             = NULL;
+    CachePtr->pinned          = 0;
+    CachePtr->index           = ubi_cacheINDEX_SPLAY;
+    CachePtr->buckets         = NULL;
+    CachePtr->bucket_count    = 0;
+    CachePtr->pool            = NULL;
+    CachePtr->spill           = NULL;
+    (void)memset( &CachePtr->stats, 0, sizeof( ubi_cacheStats ) );
     }
   return( CachePtr );
   } /* ubi_cacheInit */
@@ -178,19 +1519,65 @@ ubi_cacheRootPtr ubi_cacheClear( ubi_cacheRootPtr CachePtr )
    * @returns A pointer to the cache header (i.e., the same as
    *          \p CachePtr).
    *
-   * \b Note: This function re-initializes the cache header.
+   * \b Note: This function re-initializes the cache header, except for
+   *          the \c stats, which keep counting.  Clearing the cache does
+   *          not count as evicting the entries.  Pinned entries are not
+   *          freed until they are released (see \c #ubi_cacheAcquire()).
+   *          A cache that is in a pool stays in it, with its memory
+   *          returned to the pool.  Entries in the spill log, if any, are
+   *          forgotten; the whole log becomes garbage.
    */
   {
   if( CachePtr )
     {
-    (void)ubi_trKillTree( CachePtr, CachePtr->free_func );
-    CachePtr->mem_used    = 0;
-    CachePtr->cache_hits  = 0;
-    CachePtr->cache_trys  = 0;
+    if( CachePtr->slab )
+      (void)index_walk( CachePtr, slab_unlink, CachePtr->slab );
+    if( CachePtr->pinned
+     || (ubi_cacheINDEX_HASH == CachePtr->index)
+     || (NULL != CachePtr->retire)
+     || (NULL == CachePtr->free_func) )
+      (void)index_walk( CachePtr, clear_entry, CachePtr );
+    else
+      (void)ubi_trKillTree( CachePtr, CachePtr->free_func );
+    forget( CachePtr );
     }
   return( CachePtr );
   } /* ubi_cacheClear */
 
+ubi_cacheRootPtr ubi_cacheAbandon( ubi_cacheRootPtr CachePtr )
+  /** Empty a cache without looking at, or freeing, any of its entries.
+   *
+   * @param   CachePtr  A pointer to the cache that is to be emptied.
+   *
+   * @returns A pointer to the cache header (i.e., the same as
+   *          \p CachePtr).
+   *
+   * \b Notes:
+   *  - This is for recovery, when the cache may have been left half way
+   *    through an update (e.g., by a process that died while holding the
+   *    lock of a cache in shared memory).  The index and the eviction
+   *    lists are reset, not walked, and the entries are leaked.  If they
+   *    are in a slab pool, re-initialize the pool with \c #ubi_slabInit()
+   *    to get their memory back.
+   *  - The settings of the cache are kept, as with \c #ubi_cacheClear().
+   *    The ARC ghost lists and the spill records are still walked to
+   *    reset them.
+   *  - References held on the abandoned entries must not be released.
+   */
+  {
+  if( CachePtr )
+    {
+    CachePtr->root.root  = NULL;
+    CachePtr->root.count = 0;
+    if( CachePtr->buckets )
+      (void)memset( CachePtr->buckets, 0,
+                    CachePtr->bucket_count * sizeof( ubi_btNodePtr ) );
+    (void)ubi_btInitTree( &CachePtr->flights, flight_cmp, 0 );
+    forget( CachePtr );
+    }
+  return( CachePtr );
+  } /* ubi_cacheAbandon */
+
 void ubi_cachePut( ubi_cacheRootPtr  CachePtr,
                    unsigned long     EntrySize,
                    ubi_cacheEntryPtr EntryPtr,
@@ -223,18 +1610,139 @@ void ubi_cachePut( ubi_cacheRootPtr  CachePtr,
    *  - The underlying splay tree is opened in OVERWRITE mode.  If the input
    *    key matches an existing key, the existing entry will be politely
    *    removed from the tree and freed.
+   *  - If the cache has an admission filter (see
+   *    \c #ubi_cacheSetAdmission()), the new entry goes into the filter's
+   *    window.  An entry pushed out of the window may be refused, in which
+   *    case it is freed right away.
    */
   {
-  ubi_trNodePtr OldNode;
+  ubi_cachePutEntry( CachePtr, EntrySize, EntryPtr, Key, ubi_trFALSE, 0 );
+  } /* ubi_cachePut */
 
-  EntryPtr->entry_size = EntrySize;
-  CachePtr->mem_used  += EntrySize;
-  (void)ubi_trInsert( CachePtr, EntryPtr, Key, &OldNode );
-  if( OldNode )
-    free_entry( CachePtr, (ubi_cacheEntryPtr)OldNode );
+void ubi_cachePutExpires( ubi_cacheRootPtr  CachePtr,
+                          unsigned long     EntrySize,
+                          ubi_cacheEntryPtr EntryPtr,
+                          ubi_trItemPtr     Key,
+                          unsigned long     Expires )
+  /** Add an entry to the cache, with an expiry time.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   EntrySize The size of the entry.  See \c #ubi_cachePut().
+   * @param   EntryPtr  A pointer to the entry.
+   * @param   Key       A pointer to the entry's key.
+   * @param   Expires   The time at which the entry expires, in ticks of
+   *                    the cache's timing wheel.
+   *
+   * \b Notes:
+   *  - This is the same as \c #ubi_cachePut(), except that the entry
+   *    will be removed by \c #ubi_cacheExpire() once \p Expires has
+   *    come.  From then on (or if \p Expires has already passed),
+   *    \c #ubi_cacheGet() will not return it.
+   *  - If the cache has no timing wheel (see \c #ubi_cacheSetWheel()),
+   *    the expiry time is ignored.
+   */
+  {
+  ubi_cachePutEntry( CachePtr, EntrySize, EntryPtr, Key, ubi_trTRUE, Expires );
+  } /* ubi_cachePutExpires */
 
-  cachetrim( CachePtr );
-  } /* ubi_cachePut */
+ubi_cacheEntryPtr ubi_cacheGetOrLoad( ubi_cacheRootPtr  CachePtr,
+                                      ubi_trItemPtr     Key,
+                                      ubi_cacheLoadFunc Loader,
+                                      void             *Context )
+  /** Look up an entry, loading it into the cache if it is missing.
+   *
+   * @param   CachePtr  A pointer to the cache, which must be locked (if
+   *                    it has a lock).
+   * @param   Key       The key to look up.
+   * @param   Loader    The function called to create the entry on a miss.
+   * @param   Context   A pointer passed to \p Loader.
+   *
+   * @returns A pointer to the entry, or NULL if \p Loader failed.  The
+   *          cache is locked again when this function returns, and the
+   *          entry may be used until it is unlocked.
+   *
+   * \b Notes:
+   *  - The loader is called without the lock held.  It must return an
+   *    entry with its \c entry_size filled in (or NULL), and the entry
+   *    is then put under \p Key.
+   *  - If the cache has a hash function (\c #ubi_cacheSetHashFunc())
+   *    and synchronization functions (\c #ubi_cacheSetSync()), only one
+   *    load per key is done at a time.  Other callers that miss on the
+   *    same key wait for that load to finish, and then look again.  If
+   *    the load failed, one of them tries next.
+   *  - Loads in progress are matched by hash, so two keys with the same
+   *    hash are loaded one after the other rather than at the same time.
+   *  - Without those, this is simply a get, followed by a load and a put
+   *    if the get missed.
+   *  - The loader must not call this function for the same key, or it
+   *    will wait for itself.
+   *  - If the cache has a load check (\c #ubi_cacheSetLoadCheck()), an
+   *    entry that fails it is not put, and NULL is returned.
+   */
+  {
+  ubi_cacheEntryPtr EntryPtr;
+  Flight           *Other;
+  Flight            flight;
+  ubi_trBool        flying;
+
+  flying = (CachePtr->hash_func && CachePtr->wait) ? ubi_trTRUE : ubi_trFALSE;
+  for(;;)
+    {
+    EntryPtr = ubi_cacheGet( CachePtr, Key );
+    if( EntryPtr || !flying )
+      break;
+    flight.hash = (*CachePtr->hash_func)( Key );
+    Other = (Flight *)ubi_btFind( &CachePtr->flights, &flight.hash );
+    if( NULL == Other )
+      break;
+
+    /* Someone else is loading the key.  Wait, then look again. */
+    Other->waiters++;
+    while( !Other->done )
+      (*CachePtr->wait)( CachePtr->sync );
+    if( 0 == --Other->waiters )
+      (*CachePtr->wake)( CachePtr->sync );
+    }
+  if( EntryPtr )
+    return( EntryPtr );
+
+  if( flying )
+    {
+    flight.waiters = 0;
+    flight.done    = ubi_trFALSE;
+    (void)ubi_btInsert( &CachePtr->flights, &flight.node, &flight.hash, NULL );
+    }
+  if( CachePtr->unlock )
+    (*CachePtr->unlock)( CachePtr->sync );
+  EntryPtr = (*Loader)( Key, Context );
+  if( CachePtr->lock )
+    (*CachePtr->lock)( CachePtr->sync );
+
+  if( EntryPtr && CachePtr->load_check
+   && !(*CachePtr->load_check)( CachePtr->check_ctx, EntryPtr ) )
+    EntryPtr = NULL;
+  if( EntryPtr )
+    {
+    ubi_cachePutEntry( CachePtr, EntryPtr->entry_size, EntryPtr, Key,
+                       ubi_trFALSE, 0 );
+    /* Make sure it wasn't refused admission or trimmed right away. */
+    EntryPtr = find_key( CachePtr, Key, ubi_trFALSE );
+    }
+
+  /* The flight is on our stack, so wait for the waiters to let go of it. */
+  if( flying )
+    {
+    (void)ubi_btRemove( &CachePtr->flights, &flight.node );
+    flight.done = ubi_trTRUE;
+    if( flight.waiters )
+      {
+      (*CachePtr->wake)( CachePtr->sync );
+      while( flight.waiters )
+        (*CachePtr->wait)( CachePtr->sync );
+      }
+    }
+  return( EntryPtr );
+  } /* ubi_cacheGetOrLoad */
 
 ubi_cacheEntryPtr ubi_cacheGet( ubi_cacheRootPtr CachePtr,
                                 ubi_trItemPtr    FindMe )
@@ -248,21 +1756,63 @@ ubi_cacheEntryPtr ubi_cacheGet( ubi_cacheRootPtr CachePtr,
    *          matching entry was found.
    *
    * \b Notes:
-   *  - This function also updates the hit ratio counters.
+   *  - This function also updates the hit ratio counters, the statistics,
+   *    and the admission filter's frequency sketch (if any).
+   *  - An entry that has expired (as of the last time given to
+   *    \c #ubi_cacheExpire() or \c #ubi_cacheSetTime()) is freed, and
+   *    NULL is returned.
    *    - The counters are unsigned short.  If the number of cache tries
    *      reaches 65534 (0xFFFE), then both the number of tries and the
    *      number of hits are divided by two.  This prevents the counters
    *      from overflowing.  See the comments in #ubi_cacheHitRatio() for
    *      additional notes.
+   *  - If the cache has a spill log (\c #ubi_cacheSetSpill()), a key that
+   *    is not in memory is looked for there.  If it is found, the entry
+   *    is read back and put into the cache, which may evict others.  The
+   *    hit is counted in \c stats.spill_hits, not as a cache hit.
    */
   {
   ubi_trNodePtr FoundPtr;
+  unsigned long hash = 0;
 
-  FoundPtr = ubi_trFind( CachePtr, FindMe );
+  if( (CachePtr->sketch.counts || CachePtr->mrc || CachePtr->spill
+    || (ubi_cacheINDEX_HASH == CachePtr->index)) && CachePtr->hash_func )
+    hash = (*CachePtr->hash_func)( FindMe );
+  if( CachePtr->sketch.counts )
+    sketch_add( &CachePtr->sketch, hash );
+
+  /* The CLOCK, GDSF and sampled policies don't need the tree splayed, so
+   * don't write to it.
+   */
+  FoundPtr = (ubi_trNodePtr)ubi_cacheIndexFind( CachePtr, FindMe, hash,
+                                  (ubi_cacheSPLAY == CachePtr->policy)
+                               || (ubi_cacheLRU == CachePtr->policy)
+                               || (ubi_cacheARC == CachePtr->policy) );
+
+  /* An entry that has expired is as good as gone. */
+  if( FoundPtr
+   && Expiring( CachePtr, FoundPtr )
+   && ((long)(ExtEntry( FoundPtr )->timer.expires
+              - CachePtr->now) <= 0) )
+    {
+    expire_entry( &ExtEntry( FoundPtr )->timer, CachePtr );
+    FoundPtr = NULL;
+    }
 
   if( FoundPtr )
+    {
     CachePtr->cache_hits++;
+    CachePtr->stats.hits++;
+    ubi_cachePolicyTouch( CachePtr, (ubi_cacheEntryPtr)FoundPtr );
+    if( CachePtr->slab )
+      ubi_slabTouch( CachePtr->slab, FoundPtr );
+    }
+  if( CachePtr->mrc )
+    ubi_mrcReference( CachePtr->mrc, ubi_mrcHash( hash ),
+                      FoundPtr ? ((ubi_cacheEntryPtr)FoundPtr)->entry_size
+                               : 0 );
   CachePtr->cache_trys++;
+  CachePtr->stats.lookups++;
 
   if( CachePtr->cache_trys >= 0xFFFE )
     {
@@ -270,9 +1820,68 @@ ubi_cacheEntryPtr ubi_cacheGet( ubi_cacheRootPtr CachePtr,
     CachePtr->cache_trys >>= 1;
     }
 
+  /* A miss in memory may still be found in the spill log. */
+  if( (NULL == FoundPtr) && CachePtr->spill )
+    FoundPtr = (ubi_trNodePtr)ubi_cacheSpillGet( CachePtr, FindMe, hash );
+
   return( (ubi_cacheEntryPtr)FoundPtr );
   } /* ubi_cacheGet */
 
+ubi_cacheEntryPtr ubi_cacheAcquire( ubi_cacheRootPtr CachePtr,
+                                    ubi_trItemPtr    FindMe )
+  /** Look up an entry, and pin it until it is released.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   FindMe    The key to look up.
+   *
+   * @returns A pointer to the entry, or NULL if it was not found.
+   *
+   * \b Notes:
+   *  - This is \c #ubi_cacheGet(), plus a reference to the entry.  Each
+   *    successful call must be matched by a call to
+   *    \c #ubi_cacheRelease().  Until then, the entry will not be evicted
+   *    or freed, so its data may be used without copying it, even after
+   *    the cache has been unlocked.
+   *  - Pinned entries can still be deleted, overwritten, or expired.  They
+   *    then leave the cache, and can no longer be found, but they are not
+   *    freed until the last reference is released.  The entry's data must
+   *    therefore not be changed while it is pinned.
+   *  - A cache whose entries are all pinned can't be trimmed, and stays
+   *    over its limits until some of them are released.  Keep pins short.
+   */
+  {
+  ubi_cacheEntryPtr EntryPtr = ubi_cacheGet( CachePtr, FindMe );
+
+  if( EntryPtr && (0 == EntryPtr->refs++) )
+    CachePtr->pinned++;
+  return( EntryPtr );
+  } /* ubi_cacheAcquire */
+
+void ubi_cacheRelease( ubi_cacheRootPtr  CachePtr,
+                       ubi_cacheEntryPtr EntryPtr )
+  /** Release a reference taken by \c #ubi_cacheAcquire().
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   EntryPtr  A pointer to the pinned entry.
+   *
+   * @returns None.
+   *
+   * \b Notes:
+   *  - The cache must be locked (if it has a lock), as for any other
+   *    change to the cache.
+   *  - If the entry left the cache while it was pinned, it is freed (or
+   *    retired, if the cache has a retire function) when the last reference
+   *    is released.
+   */
+  {
+  if( 0 != --EntryPtr->refs )
+    return;
+  if( EntryPtr->flags & GONE_BIT )
+    discard( CachePtr, EntryPtr );
+  else
+    CachePtr->pinned--;
+  } /* ubi_cacheRelease */
+
 ubi_trBool ubi_cacheDelete( ubi_cacheRootPtr CachePtr, ubi_trItemPtr DeleteMe )
   /** Find and delete the specified cache entry.
    *
@@ -280,15 +1889,22 @@ ubi_trBool ubi_cacheDelete( ubi_cacheRootPtr CachePtr, ubi_trItemPtr DeleteMe )
    * @param   DeleteMe  The key of the entry to be deleted.
    *
    * @returns TRUE if the entry was found & freed, else FALSE.
+   *
+   * \b Note: A copy of the entry in the spill log, if any, is forgotten
+   *          as well.  That does not count toward the return value.
    */
   {
-  ubi_trNodePtr FoundPtr;
+  ubi_cacheEntryPtr FoundPtr;
 
-  FoundPtr = ubi_trFind( CachePtr, DeleteMe );
+  if( CachePtr->spill )
+    ubi_cacheSpillForget( CachePtr, (*CachePtr->hash_func)( DeleteMe ) );
+  FoundPtr = find_key( CachePtr, DeleteMe, ubi_trTRUE );
   if( FoundPtr )
     {
-    (void)ubi_trRemove( CachePtr, FoundPtr );
-    free_entry( CachePtr, (ubi_cacheEntryPtr)FoundPtr );
+    CachePtr->stats.deletes++;
+    index_remove( CachePtr, FoundPtr, ubi_trTRUE );
+    ubi_cachePolicyRemove( CachePtr, FoundPtr );
+    free_entry( CachePtr, FoundPtr );
     return( ubi_trTRUE );
     }
   return( ubi_trFALSE );
@@ -309,28 +1925,38 @@ ubi_trBool ubi_cacheReduce( ubi_cacheRootPtr CachePtr, unsigned long count )
    *  - This function forces a reduction in the number of cache entries
    *    without requiring that the \c MaxMemory or \c MaxEntries values be
    *    changed.
-   *  - Cache entries are removed by looking at the "bottom" of the cache.
-   *    That is, an attempt is made to remove the least recently used (LRU)
-   *    nodes in the cache first.
+   *  - The entries to be removed are chosen by the cache's eviction
+   *    policy.  By default, entries are removed by looking at the "bottom"
+   *    of the cache.  That is, an attempt is made to remove the least
+   *    recently used (LRU) nodes in the cache first.  See
+   *    \c #ubi_cacheSetPolicy().
    */
   {
-  ubi_trNodePtr NodePtr;
-
-  while( count )
-    {
-    NodePtr = ubi_trLeafNode( CachePtr->root.root );
-    if( NULL == NodePtr )
-      return( ubi_trFALSE );
-    else
-      {
-      (void)ubi_trRemove( CachePtr, NodePtr );
-      free_entry( CachePtr, (ubi_cacheEntryPtr)NodePtr );
-      }
-    count--;
-    }
-  return( ubi_trTRUE );
+  return( ubi_cacheEvict( CachePtr, count, ubi_cacheEVICT_REDUCE ) );
   } /* ubi_cacheReduce */
 
+unsigned long ubi_cacheTraverse( ubi_cacheRootPtr CachePtr,
+                                 ubi_trActionRtn  Action,
+                                 void            *UserData )
+  /** Call a function for each entry in the cache.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Action    The function to call.  It is passed a pointer to
+   *                    the entry, and \p UserData.
+   * @param   UserData  A pointer passed to \p Action.
+   *
+   * @returns The number of entries visited.
+   *
+   * \b Notes:
+   *  - This works with any index (see \c #ubi_cacheSetIndex()).  A tree
+   *    index is walked in key order; a hash index in no particular order.
+   *  - \p Action must not change the cache.  Expired entries that have
+   *    not yet been removed are included.
+   */
+  {
+  return( index_walk( CachePtr, Action, UserData ) );
+  } /* ubi_cacheTraverse */
+
 unsigned long ubi_cacheSetMaxEntries( ubi_cacheRootPtr CachePtr,
                                       unsigned long    NewSize )
   /** Change the maximum number of entries allowed to exist in the cache.
@@ -343,7 +1969,9 @@ unsigned long ubi_cacheSetMaxEntries( ubi_cacheRootPtr CachePtr,
    *
    * \b Notes:
    *  - If the new size is less than the old size, this function will trim
-   *    the cache (remove excess entries, if any).
+   *    the cache (remove excess entries, if any).  If the cache has a trim
+   *    budget, only that many entries are removed now, and the rest by
+   *    later puts.  See \c #ubi_cacheSetTrimBudget().
    *  - A value of zero indicates an unlimited number of entries.
    */
   {
@@ -366,7 +1994,8 @@ unsigned long ubi_cacheSetMaxMemory( ubi_cacheRootPtr CachePtr,
    *
    * \b Notes:
    *  - If the new size is less than the old size, this function will trim
-   *    the cache (remove excess entries).
+   *    the cache (remove excess entries).  As with
+   *    \c #ubi_cacheSetMaxEntries(), a trim budget spreads the work out.
    *  - A value of zero (0) indicates that the cache has no memory limit.
    */
   {
@@ -378,6 +2007,67 @@ unsigned long ubi_cacheSetMaxMemory( ubi_cacheRootPtr CachePtr,
   return( oldsize );
   } /* ubi_cacheSetMaxMemory */
 
+ubi_trBool ubi_cacheSetWatermarks( ubi_cacheRootPtr CachePtr,
+                                   unsigned int     High,
+                                   unsigned int     Low )
+  /** Set the points at which trimming starts and stops.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   High      Trimming starts when the number of entries, or the
+   *                    memory used, goes above this percentage of its
+   *                    limit.
+   * @param   Low       Trimming stops when both are at or below this
+   *                    percentage of their limits.
+   *
+   * @returns TRUE if the watermarks were set, or FALSE if the condition
+   *          <tt>Low <= High <= 100</tt> does not hold.
+   *
+   * \b Notes:
+   *  - The default is 100 and 100, which keeps the cache at its limits by
+   *    evicting one entry for each entry put.  A lower \p Low makes each
+   *    trim evict a batch of entries, so that the next several puts need
+   *    not evict anything.
+   *  - If \p High is less than 100, the cache never fills up completely.
+   *    With a trim budget (see \c #ubi_cacheSetTrimBudget()), the space
+   *    above \p High gives the trimming room to catch up.
+   */
+  {
+  if( (Low > High) || (High > 100) )
+    return( ubi_trFALSE );
+  CachePtr->high_water = High;
+  CachePtr->low_water  = Low;
+  cachetrim( CachePtr );
+  return( ubi_trTRUE );
+  } /* ubi_cacheSetWatermarks */
+
+unsigned long ubi_cacheSetTrimBudget( ubi_cacheRootPtr CachePtr,
+                                      unsigned long    Budget )
+  /** Limit the number of entries evicted by any one call.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Budget    The most entries to evict per put (or other call
+   *                    that trims the cache), or zero for no limit.
+   *
+   * @returns The previous budget.
+   *
+   * \b Notes:
+   *  - With a budget, a large trim (after a big entry is put, or after
+   *    \c #ubi_cacheSetMaxMemory() lowers the limit) is spread across
+   *    the following puts instead of being done all at once.
+   *  - In exchange, the cache may go over its limits until the trimming
+   *    catches up.  A budget of two or more entries per put is enough to
+   *    catch up on an entry limit.  A memory limit needs more if entry
+   *    sizes vary widely.
+   *  - Call \c #ubi_cacheReduce() to do some of the outstanding work at
+   *    a convenient time.
+   */
+  {
+  unsigned long oldbudget = CachePtr->trim_budget;
+
+  CachePtr->trim_budget = Budget;
+  return( oldbudget );
+  } /* ubi_cacheSetTrimBudget */
+
 int ubi_cacheHitRatio( ubi_cacheRootPtr CachePtr )
   /** Return the cache hit ratio (times 10000).
    *
@@ -407,4 +2097,801 @@ int ubi_cacheHitRatio( ubi_cacheRootPtr CachePtr )
   return( 0 );
   } /* ubi_cacheHitRatio */
 
+void ubi_cacheStatsSample( ubi_cacheRootPtr CachePtr )
+  /** Update the moving averages of the hit ratio.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   *
+   * \b Notes:
+   *  - Call this every \c #ubi_cacheSAMPLE_SECS seconds.  The averages
+   *    decay exponentially, like the Unix load average, so that a sample
+   *    is worth about 1/e as much after one (or five) minutes.
+   *  - Hits and lookups are averaged separately, so busy intervals weigh
+   *    more than quiet ones.
+   */
+  {
+  ubi_cacheStatsPtr sp      = &CachePtr->stats;
+  ubi_cacheCounter  lookups = (sp->lookups - sp->last_lookups) << STATS_SHIFT;
+  ubi_cacheCounter  hits    = (sp->hits - sp->last_hits) << STATS_SHIFT;
+  int               i;
+
+  sp->last_lookups = sp->lookups;
+  sp->last_hits    = sp->hits;
+  for( i = 0; i < 2; i++ )
+    {
+    sp->avg_lookups[i] = ( (sp->avg_lookups[i] * StatsDecay[i])
+                         + (lookups * (STATS_ONE - StatsDecay[i])) )
+                       >> STATS_SHIFT;
+    sp->avg_hits[i]    = ( (sp->avg_hits[i] * StatsDecay[i])
+                         + (hits * (STATS_ONE - StatsDecay[i])) )
+                       >> STATS_SHIFT;
+    }
+  } /* ubi_cacheStatsSample */
+
+int ubi_cacheStatsHitRatio( ubi_cacheRootPtr CachePtr, int Window )
+  /** Return a moving average of the hit ratio (times 10000).
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Window    \c #ubi_cacheWINDOW_1MIN or
+   *                    \c #ubi_cacheWINDOW_5MIN.
+   *
+   * @returns The hit ratio over roughly the last one or five minutes, as
+   *          a value in the range [0..10000].  Zero is returned if there
+   *          have been no lookups, or if \p Window is not valid.
+   *
+   * \b Note:  The averages only change when \c #ubi_cacheStatsSample() is
+   *          called.
+   */
+  {
+  ubi_cacheStatsPtr sp = &CachePtr->stats;
+
+  if( (Window < 0) || (Window > 1) || (0 == sp->avg_lookups[Window]) )
+    return( 0 );
+  return( (int)((10000 * sp->avg_hits[Window]) / sp->avg_lookups[Window]) );
+  } /* ubi_cacheStatsHitRatio */
+
+size_t ubi_cacheStatsFormat( ubi_cacheRootPtr CachePtr,
+                             const char      *Name,
+                             char            *Buffer,
+                             size_t           Size )
+  /** Write the cache statistics in the Prometheus text format.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Name      A name for the cache, or NULL.  If given, each
+   *                    sample is labelled with <tt>cache="Name"</tt>.
+   *                    The name must not contain quotes or backslashes.
+   * @param   Buffer    The output buffer.
+   * @param   Size      The size of \p Buffer, in bytes.
+   *
+   * @returns The length of the text, not counting the terminating nul.
+   *          As with snprintf(), if this is not less than \p Size, the
+   *          text was truncated.  4K is plenty, unless \p Name is long.
+   *
+   * \b Notes:
+   *  - Every metric name starts with \c ubi_cache_.  Evictions are
+   *    labelled with a \c reason, and the hit ratio with a \c window of
+   *    \c 1m or \c 5m.
+   *  - To export several caches on one page, give each a different
+   *    \p Name.  The HELP and TYPE lines will be repeated, which some
+   *    scrapers dislike; strip them from all but the first if need be.
+   */
+  {
+  static const char *const windows[2] = { "1m", "5m" };
+  ubi_cacheStatsPtr sp    = &CachePtr->stats;
+  ubi_cacheCounter  total = 0;
+  size_t            len   = 0;
+  char              num[32];
+  int               i;
+
+  if( Size > 0 )
+    Buffer[0] = '\0';
+  len = put_single( Buffer, Size, len, Name, "lookups_total", "counter",
+                    "Cache lookups.", sp->lookups );
+  len = put_single( Buffer, Size, len, Name, "hits_total", "counter",
+                    "Lookups that found an entry.", sp->hits );
+  len = put_single( Buffer, Size, len, Name, "misses_total", "counter",
+                    "Lookups that found nothing.", sp->lookups - sp->hits );
+  len = put_single( Buffer, Size, len, Name, "inserts_total", "counter",
+                    "Entries put.", sp->inserts );
+  len = put_single( Buffer, Size, len, Name, "overwrites_total", "counter",
+                    "Puts that replaced an existing entry.", sp->overwrites );
+  len = put_single( Buffer, Size, len, Name, "deletes_total", "counter",
+                    "Entries deleted.", sp->deletes );
+
+  len = put_header( Buffer, Size, len, "evictions_total", "counter",
+                    "Entries evicted, by reason." );
+  for( i = 0; i < ubi_cacheEVICT_REASONS; i++ )
+    {
+    (void)sprintf( num, ubi_cacheCOUNTER_FMT, sp->evictions[i] );
+    len = put_value( Buffer, Size, len, "evictions_total", Name,
+                     "reason", EvictReasons[i], num );
+    total += sp->evictions[i];
+    }
+  len = put_single( Buffer, Size, len, Name, "evicted_bytes_total", "counter",
+                    "Total size of evicted entries.", sp->evicted_bytes );
+
+  len = put_header( Buffer, Size, len, "eviction_depth", "summary",
+                    "Tree depth of evicted entries." );
+  (void)sprintf( num, ubi_cacheCOUNTER_FMT, sp->evicted_depth );
+  len = put_value( Buffer, Size, len, "eviction_depth_sum", Name,
+                   NULL, NULL, num );
+  (void)sprintf( num, ubi_cacheCOUNTER_FMT, total );
+  len = put_value( Buffer, Size, len, "eviction_depth_count", Name,
+                   NULL, NULL, num );
+  len = put_single( Buffer, Size, len, Name, "eviction_depth_max", "gauge",
+                    "Deepest evicted entry.", sp->max_depth );
+
+  len = put_single( Buffer, Size, len, Name, "spill_writes_total", "counter",
+                    "Evicted entries written to the spill log.",
+                    sp->spill_writes );
+  len = put_single( Buffer, Size, len, Name, "spill_hits_total", "counter",
+                    "Misses that were read back from the spill log.",
+                    sp->spill_hits );
+
+  len = put_single( Buffer, Size, len, Name, "entries", "gauge",
+                    "Entries in the cache.",
+                    ubi_cacheGetEntryCount( CachePtr ) );
+  len = put_single( Buffer, Size, len, Name, "memory_bytes", "gauge",
+                    "Memory used by the entries.",
+                    ubi_cacheGetMemUsed( CachePtr ) );
+
+  len = put_header( Buffer, Size, len, "hit_ratio", "gauge",
+                    "Moving average of the hit ratio." );
+  for( i = 0; i < 2; i++ )
+    {
+    (void)sprintf( num, "%.4f", ubi_cacheStatsHitRatio( CachePtr, i ) / 1e4 );
+    len = put_value( Buffer, Size, len, "hit_ratio", Name,
+                     "window", windows[i], num );
+    }
+  return( len );
+  } /* ubi_cacheStatsFormat */
+
+ubi_trBool ubi_cacheSetExtended( ubi_cacheRootPtr CachePtr,
+                                 ubi_trBool       Extended )
+  /** Declare whether the cache's entries are extended entries.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Extended  TRUE if every entry put into the cache will be a
+   *                    \c #ubi_cacheEntryExt, FALSE if they may be plain
+   *                    \c #ubi_cacheEntry structures (the default).
+   *
+   * @returns TRUE if the setting was changed, or FALSE if the cache is not
+   *          empty, or if \p Extended is FALSE and the cache has a timing
+   *          wheel or uses the GDSF or sampled policy.
+   *
+   * \b Notes:
+   *  - Extended entries are about twice the size of plain ones.  They are
+   *    needed only by the features that keep more state per entry:
+   *    expiry (\c #ubi_cacheSetWheel()), and the GDSF and sampled
+   *    eviction policies.  Declare them first, then set those.
+   *  - The entries returned by a \c #ubi_cacheLoadFunc or a
+   *    \c #ubi_cacheDeserializeFunc must be extended too.
+   */
+  {
+  if( (0 != ubi_cacheGetEntryCount( CachePtr ))
+   || (!Extended && (CachePtr->wheel
+                  || (ubi_cacheGDSF == CachePtr->policy)
+                  || (ubi_cacheSAMPLED == CachePtr->policy))) )
+    return( ubi_trFALSE );
+  CachePtr->extended = Extended ? ubi_trTRUE : ubi_trFALSE;
+  return( ubi_trTRUE );
+  } /* ubi_cacheSetExtended */
+
+ubi_trBool ubi_cacheSetIndex( ubi_cacheRootPtr CachePtr,
+                              int              Index,
+                              ubi_btNodePtr   *Buckets,
+                              unsigned long    Count )
+  /** Select the structure used to look up the cache's entries.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Index     One of:
+   *                    - \c #ubi_cacheINDEX_SPLAY - A splay tree.  This is
+   *                      the default, and the only index that supports
+   *                      the \c #ubi_cacheSPLAY eviction policy.
+   *                    - \c #ubi_cacheINDEX_AVL - An AVL tree.  Lookups
+   *                      are O(log n), and don't change the tree.
+   *                    - \c #ubi_cacheINDEX_HASH - A hash table.  Lookups
+   *                      are O(1), given enough buckets.  Requires a hash
+   *                      function; see \c #ubi_cacheSetHashFunc().
+   * @param   Buckets   For the hash index, an array of \p Count bucket
+   *                    pointers, which the cache will use until the index
+   *                    is changed.  Otherwise, NULL.
+   * @param   Count     The number of buckets, or zero.
+   *
+   * @returns TRUE if the index was set, or FALSE if the cache is not empty,
+   *          \p Index is not recognized, or a hash index was asked for
+   *          without buckets or a hash function.
+   *
+   * \b Notes:
+   *  - The index may only be changed while the cache is empty.  Choosing
+   *    a tree index after \c #ubi_cacheInit() leaves the comparison
+   *    function in place; the hash index uses it, too, to tell apart keys
+   *    with the same hash.
+   *  - If the eviction policy is \c #ubi_cacheSPLAY and the new index is
+   *    not a splay tree, the policy is changed to \c #ubi_cacheLRU.
+   *  - The hash table does not grow.  Give it about as many buckets as
+   *    the cache will hold entries.  A bucket is picked by taking the
+   *    hash modulo \p Count, so a prime \p Count makes up for a weak
+   *    hash function.
+   *  - With a hash index, the cache is not a tree, and the \c ubi_tr
+   *    functions must not be used on it.  Use \c #ubi_cacheTraverse().
+   */
+  {
+  if( (0 != ubi_cacheGetEntryCount( CachePtr ))
+   || (Index < ubi_cacheINDEX_SPLAY) || (Index > ubi_cacheINDEX_HASH)
+   || ((ubi_cacheINDEX_HASH == Index)
+    && ((NULL == Buckets) || (0 == Count) || (NULL == CachePtr->hash_func))) )
+    return( ubi_trFALSE );
+  CachePtr->index        = Index;
+  CachePtr->buckets      = NULL;
+  CachePtr->bucket_count = 0;
+  if( ubi_cacheINDEX_HASH == Index )
+    {
+    (void)memset( Buckets, 0, Count * sizeof( ubi_btNodePtr ) );
+    CachePtr->buckets      = Buckets;
+    CachePtr->bucket_count = Count;
+    }
+  if( (ubi_cacheINDEX_SPLAY != Index) && (ubi_cacheSPLAY == CachePtr->policy) )
+    (void)ubi_cacheSetPolicy( CachePtr, ubi_cacheLRU );
+  return( ubi_trTRUE );
+  } /* ubi_cacheSetIndex */
+
+void ubi_cacheSetRetire( ubi_cacheRootPtr    CachePtr,
+                         ubi_cacheRetireFunc RetireFunc,
+                         void               *Context )
+  /** Hand removed entries to a function, rather than freeing them.
+   *
+   * @param   CachePtr    A pointer to the cache.
+   * @param   RetireFunc  The function that takes charge of removed
+   *                      entries, or NULL to go back to freeing them
+   *                      immediately.
+   * @param   Context     Passed, along with the entry, to \p RetireFunc.
+   *
+   * @returns None.
+   *
+   * \b Notes:
+   *  - Once this is set, entries removed by \c #ubi_cachePut() (an
+   *    overwritten entry or a trimmed one), \c #ubi_cacheDelete(),
+   *    \c #ubi_cacheReduce(), and \c #ubi_cacheClear() are passed to
+   *    \p RetireFunc, and the cache's \c free_func is not called.
+   *  - The usual use is epoch-based reclamation: \p Context is a
+   *    \c #ubi_epochDomain, and \p RetireFunc passes the entry on to
+   *    \c #ubi_epochRetire() along with a free function that takes a
+   *    <tt>void *</tt>.  A thread that finds an entry with
+   *    \c #ubi_cacheGet() may then release the cache lock and keep using
+   *    the entry until it calls \c #ubi_epochExit().  (\c #ubi_cacheGet()
+   *    splays the tree, so the lookup itself still needs the lock.)
+   *  - This module does not depend on \c ubi_Epoch, which needs C11
+   *    atomics; only the code that glues the two together does.
+   *  - If the cache has a slab pool (\c #ubi_cacheSetSlab()), whatever
+   *    eventually frees the entries must return them to the pool with
+   *    \c #ubi_slabFree().
+   */
+  {
+  CachePtr->retire     = RetireFunc;
+  CachePtr->retire_ctx = Context;
+  } /* ubi_cacheSetRetire */
+
+ubi_trBool ubi_cacheSetHashFunc( ubi_cacheRootPtr  CachePtr,
+                                 ubi_cacheHashFunc HashFunc )
+  /** Give the cache a way to hash its keys.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   HashFunc  The hash function, or NULL.
+   *
+   * @returns TRUE if the hash function was set, or FALSE if the cache is
+   *          not empty (or see below).
+   *
+   * \b Notes:
+   *  - The hash of each key is stored in the \c hash field of its entry
+   *    by \c #ubi_cachePut().  Some eviction policies use the hash to
+   *    remember keys after their entries are gone.
+   *  - Changing the hash function of an ARC cache forgets its ghosts, and
+   *    any spilled entries are forgotten as well.
+   *  - A cache with a hash index (\c #ubi_cacheSetIndex()) or a spill log
+   *    (\c #ubi_cacheSetSpill()) can't be left without a hash function.
+   */
+  {
+  if( (0 != ubi_cacheGetEntryCount( CachePtr ))
+   || ((NULL == HashFunc) && ((ubi_cacheINDEX_HASH == CachePtr->index)
+                           || CachePtr->spill)) )
+    return( ubi_trFALSE );
+  CachePtr->hash_func = HashFunc;
+  ubi_cachePolicyReset( CachePtr );
+  ubi_cacheSpillReset( CachePtr );
+  return( ubi_trTRUE );
+  } /* ubi_cacheSetHashFunc */
+
+ubi_trBool ubi_cacheSetSlab( ubi_cacheRootPtr CachePtr,
+                             ubi_slabPoolPtr  PoolPtr )
+  /** Keep the cache entries in a slab pool.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   PoolPtr   A pointer to an initialized \c #ubi_slabPool, or
+   *                    NULL to go back to letting the caller allocate
+   *                    entries.
+   *
+   * @returns TRUE if the pool was set, or FALSE if the cache is not empty.
+   *
+   * \b Notes:
+   *  - Every entry must then be allocated with \c #ubi_cacheAlloc(), and
+   *    the ubi_cacheEntry must be at the start of the allocation.  The
+   *    cache's \c free_func should return the entry to the pool with
+   *    \c #ubi_slabFree().  If the cache has no \c free_func (it was
+   *    given NULL by \c #ubi_cacheInit()), the cache does that itself,
+   *    unless it has a retire function (\c #ubi_cacheSetRetire()), which
+   *    must then do it.
+   *  - Each entry is charged the chunk size of its slab class (see
+   *    \c #ubi_slabChunkSize()), whatever \c EntrySize is given to
+   *    \c #ubi_cachePut().  The \c mem_used count and \c max_memory
+   *    limit are then honest.  Since the pool can't grow past its arena,
+   *    \c max_memory may also be left at zero.
+   *  - Within each slab class, a successful \c #ubi_cacheGet() moves the
+   *    entry to the front of the class's LRU list.  When a class runs out
+   *    of chunks, its least recently used entry is evicted, whatever the
+   *    eviction policy.  The policy still decides what to evict when the
+   *    cache is over \c max_entries or \c max_memory.
+   *  - Don't share a pool between caches.  Victims are evicted from the
+   *    cache that needs the room, so every live chunk in the pool must
+   *    belong to that cache.
+   */
+  {
+  if( 0 != ubi_cacheGetEntryCount( CachePtr ) )
+    return( ubi_trFALSE );
+  CachePtr->slab = PoolPtr;
+  return( ubi_trTRUE );
+  } /* ubi_cacheSetSlab */
+
+void *ubi_cacheAlloc( ubi_cacheRootPtr CachePtr, unsigned long Size )
+  /** Allocate a new cache entry from the cache's slab pool.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Size      The size of the entry, including the
+   *                    \c #ubi_cacheEntry at its start.
+   *
+   * @returns A pointer to the new entry, or NULL if \p Size is too large
+   *          for the pool, or no room could be made.
+   *
+   * \b Notes:
+   *  - If the slab class for \p Size has no free chunks, and the pool has
+   *    no more pages to give it, the least recently used entry in the
+   *    class is evicted, and the allocation is tried again.  Pinned
+   *    entries are passed over.
+   *  - If the cache has a retire function, evicted entries don't return
+   *    to the pool until they are freed, so at most one entry is evicted
+   *    and NULL may be returned.  Try again once retired entries have
+   *    been freed (e.g., after \c #ubi_epochReclaim()).
+   *  - The cache may only be used by one thread at a time, as with
+   *    \c #ubi_cachePut().  A loader called by \c #ubi_cacheGetOrLoad()
+   *    runs with the cache unlocked, and should take the lock around
+   *    this call.
+   */
+  {
+  void         *Ptr;
+  void         *Victim;
+  unsigned long skipped = 0;
+
+  if( NULL == CachePtr->slab )
+    return( NULL );
+  Ptr = ubi_slabAlloc( CachePtr->slab, Size );
+  while( (NULL == Ptr)
+      && (NULL != (Victim = ubi_slabVictim( CachePtr->slab, Size ))) )
+    {
+    if( ((ubi_cacheEntryPtr)Victim)->refs )
+      {
+      if( skipped++ >= CachePtr->pinned )
+        break;
+      ubi_slabTouch( CachePtr->slab, Victim );
+      continue;
+      }
+    evict_entry( CachePtr, (ubi_cacheEntryPtr)Victim, ubi_cacheEVICT_SIZE );
+    if( CachePtr->retire )
+      break;
+    Ptr = ubi_slabAlloc( CachePtr->slab, Size );
+    }
+  return( Ptr );
+  } /* ubi_cacheAlloc */
+
+ubi_trBool ubi_cacheRebalance( ubi_cacheRootPtr CachePtr )
+  /** Move a slab page to the size class that needs it most.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   *
+   * @returns TRUE if a page was moved, else FALSE.
+   *
+   * \b Notes:
+   *  - The entries in the page are evicted.  See \c #ubi_slabRebalance().
+   *  - Call this every so often, so that the pool follows changes in the
+   *    sizes of the entries being put.  Between calls, each class can
+   *    only reuse its own chunks.
+   */
+  {
+  if( (NULL == CachePtr->slab)
+   || !ubi_slabRebalance( CachePtr->slab, slab_evict, CachePtr ) )
+    return( ubi_trFALSE );
+  return( ubi_trTRUE );
+  } /* ubi_cacheRebalance */
+
+ubi_trBool ubi_cacheSetMissRatio( ubi_cacheRootPtr CachePtr,
+                                  ubi_mrcRootPtr   MrcPtr )
+  /** Attach (or detach) a miss ratio curve.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   MrcPtr    A pointer to an initialized \c #ubi_mrcRoot, or
+   *                    NULL to detach the curve.
+   *
+   * @returns TRUE on success, or FALSE if the cache has no hash function.
+   *
+   * \b Notes:
+   *  - Every \c #ubi_cacheGet() is then recorded as a reference, with the
+   *    size of the entry if it was found.  Puts record the size of new
+   *    entries.
+   *  - The curve predicts the hit ratio of other cache sizes, whatever
+   *    the current size is.  See \c #ubi_mrcHitRatio() and
+   *    \c #ubi_cacheTuneMemory().
+   *  - The curve may be shared by several caches (e.g., the shards of a
+   *    \c ubi_ShardCache) only if they share a lock.
+   */
+  {
+  if( MrcPtr && (NULL == CachePtr->hash_func) )
+    return( ubi_trFALSE );
+  CachePtr->mrc = MrcPtr;
+  return( ubi_trTRUE );
+  } /* ubi_cacheSetMissRatio */
+
+unsigned long ubi_cacheTuneMemory( ubi_cacheRootPtr CachePtr,
+                                   unsigned long    Min,
+                                   unsigned long    Max,
+                                   int              Slack )
+  /** Set the memory limit from the miss ratio curve.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Min       The smallest memory limit to consider.
+   * @param   Max       The largest memory limit to consider.
+   * @param   Slack     How much lower (times 10000, as for
+   *                    \c #ubi_cacheHitRatio()) the predicted hit ratio
+   *                    may be than it would be with \p Max.
+   *
+   * @returns The new memory limit.  If there is no curve, or it has no
+   *          data yet, the limit is not changed, and the old one is
+   *          returned.
+   *
+   * \b Notes:
+   *  - This picks the smallest limit in [\p Min, \p Max] whose predicted
+   *    hit ratio is within \p Slack of the best, and passes it to
+   *    \c #ubi_cacheSetMaxMemory().  A slack of 50 (half a percent) trims
+   *    the flat end of the curve, where more memory buys very little.
+   *  - Call it now and then, not on every request.  It costs a few tens
+   *    of passes over the histogram.
+   *  - The entry limit, if any, is taken into account but not changed.
+   */
+  {
+  unsigned long lo, hi, mid;
+  int           target;
+
+  if( (NULL == CachePtr->mrc) || (CachePtr->mrc->refs <= 0.0) || (Min > Max) )
+    return( CachePtr->max_memory );
+
+  target = ubi_mrcHitRatio( CachePtr->mrc, CachePtr->max_entries, Max )
+         - Slack;
+  lo = Min;
+  hi = Max;
+  while( lo < hi )
+    {
+    mid = lo + ((hi - lo) / 2);
+    if( ubi_mrcHitRatio( CachePtr->mrc, CachePtr->max_entries, mid )
+        >= target )
+      hi = mid;
+    else
+      lo = mid + 1;
+    }
+  (void)ubi_cacheSetMaxMemory( CachePtr, lo );
+  return( lo );
+  } /* ubi_cacheTuneMemory */
+
+ubi_trBool ubi_cacheSetAdmission( ubi_cacheRootPtr CachePtr,
+                                  void            *Buffer,
+                                  unsigned long    Size )
+  /** Add (or remove) a TinyLFU admission filter.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Buffer    Memory for the filter's frequency sketch, or NULL
+   *                    to remove the filter.
+   * @param   Size      The size of \p Buffer, in bytes.  Use
+   *                    \c #ubi_cacheSketchSize() to pick a size.
+   *
+   * @returns TRUE if the filter was set, or FALSE if the cache is not
+   *          empty, there is no hash function (see
+   *          \c #ubi_cacheSetHashFunc()), or \p Size is too small.
+   *
+   * \b Notes:
+   *  - Every \c #ubi_cacheGet() counts an access to the key (hit or
+   *    miss), so the filter works best when puts follow failed gets.  A
+   *    key that is put without ever having been looked up has little
+   *    chance of being admitted once the cache is full.
+   *  - The sketch is about four bytes per entry.  It is rounded down to a
+   *    power of two columns, so it may not use all of \p Buffer.
+   *  - Puts that were refused are counted as evictions, with the reason
+   *    \c #ubi_cacheEVICT_REJECTED.
+   */
+  {
+  unsigned long width = 8;
+
+  if( 0 != ubi_cacheGetEntryCount( CachePtr ) )
+    return( ubi_trFALSE );
+  if( NULL == Buffer )
+    {
+    CachePtr->sketch.counts = NULL;
+    CachePtr->sketch.door   = NULL;
+    CachePtr->sketch.mask   = 0;
+    return( ubi_trTRUE );
+    }
+  if( (NULL == CachePtr->hash_func) || (Size < ((4 * width) + (width / 8))) )
+    return( ubi_trFALSE );
+
+  while( ((8 * width) + (width / 4)) <= Size )
+    width *= 2;
+  CachePtr->sketch.counts   = (unsigned char *)Buffer;
+  CachePtr->sketch.door     = CachePtr->sketch.counts + (4 * width);
+  CachePtr->sketch.mask     = width - 1;
+  sketch_clear( &CachePtr->sketch );
+  (void)ubi_dlInitList( &CachePtr->window );
+  return( ubi_trTRUE );
+  } /* ubi_cacheSetAdmission */
+
+ubi_trBool ubi_cacheSetWheel( ubi_cacheRootPtr  CachePtr,
+                              ubi_timerWheelPtr WheelPtr )
+  /** Give the cache a timing wheel, so that entries can expire.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   WheelPtr  A pointer to an initialized \c #ubi_timerWheel, or
+   *                    NULL.
+   *
+   * @returns TRUE if the wheel was set, or FALSE if the cache is not
+   *          empty, or if \p WheelPtr is not NULL and the cache's entries
+   *          are not extended (see \c #ubi_cacheSetExtended()).
+   *
+   * \b Notes:
+   *  - The wheel defines the unit of time (seconds, milliseconds, ...),
+   *    and the cache's current time is set from it.
+   *  - The wheel should not be shared with anything else, since
+   *    \c #ubi_cacheClear() re-initializes it.
+   */
+  {
+  if( (0 != ubi_cacheGetEntryCount( CachePtr ))
+   || (WheelPtr && !CachePtr->extended) )
+    return( ubi_trFALSE );
+  CachePtr->wheel = WheelPtr;
+  if( WheelPtr )
+    CachePtr->now = WheelPtr->now;
+  return( ubi_trTRUE );
+  } /* ubi_cacheSetWheel */
+
+void ubi_cacheSetSync( ubi_cacheRootPtr  CachePtr,
+                       ubi_cacheSyncFunc LockFunc,
+                       ubi_cacheSyncFunc UnlockFunc,
+                       ubi_cacheSyncFunc WaitFunc,
+                       ubi_cacheSyncFunc WakeFunc,
+                       void             *Sync )
+  /** Tell the cache how it is locked, so that loads can be shared.
+   *
+   * @param   CachePtr    A pointer to the cache.
+   * @param   LockFunc    Lock the cache.
+   * @param   UnlockFunc  Unlock the cache.
+   * @param   WaitFunc    Unlock the cache, wait to be woken, and lock it
+   *                      again.
+   * @param   WakeFunc    Wake all threads that are waiting.
+   * @param   Sync        The lock object, passed to each of the above.
+   *
+   * \b Notes:
+   *  - These are used only by \c #ubi_cacheGetOrLoad().  The cache does
+   *    not lock itself; the caller still does that.
+   *  - With POSIX threads, \p Sync would point to a structure holding a
+   *    mutex and a condition variable.  \p WaitFunc would call
+   *    \c pthread_cond_wait(), and \p WakeFunc would call
+   *    \c pthread_cond_broadcast().
+   *  - Pass NULL for \p WaitFunc to turn off load sharing.
+   */
+  {
+  CachePtr->lock   = LockFunc;
+  CachePtr->unlock = UnlockFunc;
+  CachePtr->wait   = WaitFunc;
+  CachePtr->wake   = WakeFunc;
+  CachePtr->sync   = Sync;
+  } /* ubi_cacheSetSync */
+
+void ubi_cacheSetLoadCheck( ubi_cacheRootPtr   CachePtr,
+                            ubi_cacheCheckFunc CheckFunc,
+                            void              *Context )
+  /** Check each loaded entry before \c #ubi_cacheGetOrLoad() puts it.
+   *
+   * @param   CachePtr    A pointer to the cache.
+   * @param   CheckFunc   The check, or NULL for none.
+   * @param   Context     Passed, along with the entry, to \p CheckFunc.
+   *
+   * \b Notes:
+   *  - The loader runs with the cache unlocked, so the cache may have
+   *    changed by the time it returns.  The check is made once the cache
+   *    is locked again, just before the put.
+   *  - An entry that fails the check is neither put nor freed.  The check
+   *    function must dispose of it, if need be.
+   *  - The shard cache uses this to refuse entries allocated from a slab
+   *    pool that was started over while they were being loaded (see
+   *    \c #ubi_shardRecover()).
+   */
+  {
+  CachePtr->load_check = CheckFunc;
+  CachePtr->check_ctx  = Context;
+  } /* ubi_cacheSetLoadCheck */
+
+unsigned long ubi_cacheExpire( ubi_cacheRootPtr CachePtr, unsigned long Now )
+  /** Free all entries that have expired.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Now       The current time, in ticks.  Entries that expire at
+   *                    or before this time are removed.
+   *
+   * @returns The number of entries removed.
+   *
+   * \b Notes:
+   *  - Only the expired entries are visited.  There is no need to walk
+   *    the whole cache looking for them.
+   *  - This also sets the cache's current time.  See
+   *    \c #ubi_cacheSetTime().
+   */
+  {
+  CachePtr->now = Now;
+  if( NULL == CachePtr->wheel )
+    return( 0 );
+  return( ubi_timerAdvance( CachePtr->wheel, Now, expire_entry, CachePtr ) );
+  } /* ubi_cacheExpire */
+
+long ubi_cacheDump( ubi_cacheRootPtr       CachePtr,
+                    FILE                  *Stream,
+                    ubi_cacheSerializeFunc Serialize,
+                    void                  *Context )
+  /** Write the contents of the cache to a file, hottest entries first.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Stream    The file to write to.
+   * @param   Serialize The function that writes each entry's key and data.
+   * @param   Context   A pointer passed to \p Serialize.
+   *
+   * @returns The number of entries written, or -1 if a write failed.
+   *
+   * \b Notes:
+   *  - Each entry is written as a one byte tag, the number of ticks it
+   *    has left to live (in one to ten bytes; zero means it does not
+   *    expire), and whatever \p Serialize writes.  A second tag marks the
+   *    end of the dump.  There is no file header, so the dump may follow
+   *    other data in the same file.
+   *  - The order follows the eviction policy.  LRU writes the list from
+   *    most to least recently used.  ARC writes T2 and then T1.  The
+   *    CLOCK policies write the hot and referenced entries before the
+   *    others.  The splay policy writes the entries in order of depth,
+   *    GDSF in order of frequency, and the sampled policy in order of
+   *    last use (roughly).  Entries in the TinyLFU window come last.
+   *  - Expired entries are not written.
+   *  - The cache is not changed, but the caller should hold its lock for
+   *    the duration.  \p Serialize must not call back into the cache.
+   *  - The stream is not flushed.
+   */
+  {
+  Dumper dump;
+
+  dump.cache   = CachePtr;
+  dump.stream  = Stream;
+  dump.func    = Serialize;
+  dump.context = Context;
+  dump.count   = 0;
+  dump.failed  = ubi_trFALSE;
+
+  switch( CachePtr->policy )
+    {
+    case ubi_cacheLRU:
+      dump_list( CachePtr, &dump, &CachePtr->lru );
+      break;
+    case ubi_cacheARC:
+      dump_list( CachePtr, &dump, &CachePtr->t2 );
+      dump_list( CachePtr, &dump, &CachePtr->lru );
+      break;
+    case ubi_cacheCLOCK:
+    case ubi_cacheCLOCKPRO:
+      dump_ring( CachePtr, &dump, ubi_trTRUE );
+      dump_ring( CachePtr, &dump, ubi_trFALSE );
+      break;
+    case ubi_cacheGDSF:
+    case ubi_cacheSAMPLED:
+      dump_heat( CachePtr, &dump );
+      break;
+    default:
+      dump_tree( CachePtr, &dump );
+      break;
+    }
+  dump_list( CachePtr, &dump, &CachePtr->window );
+
+  if( dump.failed || (EOF == putc( DUMP_END, Stream )) || ferror( Stream ) )
+    return( -1 );
+  return( (long)dump.count );
+  } /* ubi_cacheDump */
+
+unsigned long ubi_cacheLoad( ubi_cacheRootPtr         CachePtr,
+                             FILE                    *Stream,
+                             ubi_cacheDeserializeFunc Deserialize,
+                             void                    *Context,
+                             unsigned long            Budget )
+  /** Reload entries written by \c #ubi_cacheDump().
+   *
+   * @param   CachePtr    A pointer to the cache.
+   * @param   Stream      The file to read from.
+   * @param   Deserialize The function that reads each entry.
+   * @param   Context     A pointer passed to \p Deserialize.
+   * @param   Budget      The most entries to load in this call, or zero
+   *                      for no limit.
+   *
+   * @returns The number of entries loaded.  If that is less than
+   *          \p Budget (or \p Budget is zero), the load is finished: the
+   *          end of the dump was reached, the cache is full, or there was
+   *          an error.  Use \c ferror() to tell which.
+   *
+   * \b Notes:
+   *  - Since the dump is hottest first, a small budget brings back the
+   *    most useful part of the working set quickly.  Call this again,
+   *    between requests, to load the rest.
+   *  - Loading stops, rather than evict anything, once the cache reaches
+   *    its high watermark.  The entry that did not fit is freed.
+   *  - Entries that are already in the cache (put since the load began)
+   *    are newer than the dump, so the loaded copy is freed instead.
+   *  - Each loaded entry is placed behind the entries already in the
+   *    cache, in the eviction order.  The LRU, ARC and CLOCK policies thus
+   *    keep the order of the dump.  (The history kept by the policies,
+   *    such as ARC's T2 list or the GDSF frequency, is not saved; loaded
+   *    entries start out as if they had been used once.)
+   *  - Loaded entries bypass the TinyLFU window.
+   *  - An entry's time to live is counted from the cache's current time
+   *    (see \c #ubi_cacheSetTime()).  If the cache has no timer wheel,
+   *    the entries do not expire.
+   *  - \p Deserialize is called with the cache locked (if it is locked at
+   *    all).  With a slab pool, it should allocate the entry with
+   *    \c #ubi_cacheAlloc().
+   */
+  {
+  ubi_cacheEntryPtr EntryPtr;
+  ubi_trItemPtr     Key;
+  unsigned long     n = 0;
+  unsigned long     left;
+  unsigned long     size;
+
+  while( (0 == Budget) || (n < Budget) )
+    {
+    if( (DUMP_ENTRY != getc( Stream )) || !read_number( Stream, &left ) )
+      break;
+    Key      = NULL;
+    EntryPtr = (*Deserialize)( Stream, &Key, Context );
+    if( NULL == EntryPtr )
+      break;
+
+    size = CachePtr->slab ? ubi_slabChunkSize( CachePtr->slab, EntryPtr )
+                          : EntryPtr->entry_size;
+    if( find_key( CachePtr, Key, ubi_trFALSE ) )
+      {
+      ubi_cacheFreeMemory( CachePtr, EntryPtr );
+      continue;
+      }
+    if( !has_room( CachePtr, size ) )
+      {
+      ubi_cacheFreeMemory( CachePtr, EntryPtr );
+      break;
+      }
+
+    CachePtr->loading = ubi_trTRUE;
+    ubi_cachePutEntry( CachePtr, EntryPtr->entry_size, EntryPtr, Key,
+                       (left && CachePtr->wheel) ? ubi_trTRUE : ubi_trFALSE,
+                       CachePtr->now + left );
+    CachePtr->loading = ubi_trFALSE;
+    n++;
+    }
+  return( n );
+  } /* ubi_cacheLoad */
+
 /* -------------------------------------------------------------------------- */
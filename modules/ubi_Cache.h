@@ -67,7 +67,8 @@
  *    amount of memory used.  When either limit is exceeded, cache entries
  *    are removed until the cache is again within the given limits.
  *  - Some rough statistical information is kept so that an approximate
- *    "hit ratio" can be calculated.
+ *    "hit ratio" can be calculated.  More detailed counters are kept in
+ *    a \c #ubi_cacheStats structure; see below.
  *  - There are several functions available that provide access to, and
  *    management of cache size limits, hit ratio, and cache trimming.
  *
@@ -76,6 +77,152 @@
  *  This makes it easy to purge less recently used items should the cache
  *  exceed its limits.
  *
+ *  That's only an approximation of LRU, though, and finding a leaf to
+ *  purge takes O(log n) time.  The eviction policy can be changed using
+ *  \c #ubi_cacheSetPolicy():
+ *  - \c #ubi_cacheSPLAY (the default) purges leaves from the bottom of the
+ *    splay tree, as described above.
+ *  - \c #ubi_cacheLRU threads every entry onto a list, in order of use.
+ *    A successful \c #ubi_cacheGet() moves the entry to the front of the
+ *    list, and the entry at the back is purged.  Eviction is O(1) and
+ *    exactly LRU.
+ *  - \c #ubi_cacheCLOCK keeps the entries on a circular list.  A
+ *    successful \c #ubi_cacheGet() only sets a reference bit in the entry.
+ *    To purge, a "hand" sweeps around the circle, clearing reference bits
+ *    until it finds an entry whose bit was already clear.
+ *  - \c #ubi_cacheCLOCKPRO is a simplified CLOCK-Pro.  New entries start
+ *    out "cold", and are promoted to "hot" only if they are used again
+ *    before the hand comes around.  Only cold entries are purged, so a
+ *    scan through many keys that are used just once cannot flush the hot
+ *    entries out of the cache.
+ *
+ *  - \c #ubi_cacheARC is the Adaptive Replacement Cache.  Entries that
+ *    have been used once are kept on one LRU list (T1), and entries that
+ *    have been used more than once on another (T2).  The keys of evicted
+ *    entries are remembered, as "ghosts", on two more lists (B1 and B2).
+ *    Putting a key that has a ghost in B1 means T1 was too short, and
+ *    vice versa, so ARC moves its target length for T1 accordingly.  ARC
+ *    needs a hash function (\c #ubi_cacheSetHashFunc()) and some memory
+ *    for the ghosts (\c #ubi_cacheSetGhosts()).
+ *  - \c #ubi_cacheGDSF is GreedyDual-Size-Frequency.  Each entry has a
+ *    priority of L + (frequency * cost / size), where L is the priority of
+ *    the last entry evicted, and the entries are kept in a heap so that
+ *    the one with the lowest priority is evicted.  Small entries, and
+ *    entries that are used often or are expensive to load, stay longer.
+ *    L "ages" the entries that are no longer used.  The cost of an entry
+ *    is 1, unless a cost function is given (\c #ubi_cacheSetCostFunc()).
+ *    A cost of 1 favors the hit ratio by count; a cost equal to the entry
+ *    size favors the byte hit ratio.  GDSF needs extended entries (see
+ *    below).
+ *  - \c #ubi_cacheSAMPLED is sampled LRU, as in Redis.  Each entry is
+ *    stamped with the cache's clock when it is used, and nothing else is
+ *    written on a hit.  To evict, K entries are picked at random and the
+ *    one that was used longest ago goes.  K (\c #ubi_cacheSetSampleSize())
+ *    trades accuracy for speed, and can be changed at any time: 5 is
+ *    close to LRU, 10 closer still.  The entries are kept in an array of
+ *    slots, so that they can be picked in O(1) time, and the caller must
+ *    provide it (\c #ubi_cacheSetSlots()).  Like GDSF, it needs extended
+ *    entries.
+ *
+ *  The policies are implemented in ubi_CachePolicy.c.  They keep their
+ *  state in the cache header, so their settings are declared here.
+ *
+ *  The entries are indexed by a splay tree by default, but the index can
+ *  be changed with \c #ubi_cacheSetIndex().  The other eviction policies
+ *  do not depend upon the splay tree, and the cache never needs its keys
+ *  in order, so a cache that only does exact-match lookups can use an AVL
+ *  tree (lookups don't write to it) or a hash table, which is chained
+ *  through the tree nodes of the entries and makes lookups O(1).  With a
+ *  hash table, the cache is no longer a tree, and must be walked with
+ *  \c #ubi_cacheTraverse() rather than the \c ubi_tr functions.
+ *
+ *  Independently of the eviction policy, the cache can be given a TinyLFU
+ *  admission filter (\c #ubi_cacheSetAdmission()).  New entries go into a
+ *  small LRU "window" (1% of the cache).  When an entry falls out of the
+ *  window, it is admitted to the rest of the cache only if its key has
+ *  been looked up more often, recently, than the key of the entry that
+ *  would be evicted to make room.  Otherwise, it is freed.  This keeps
+ *  keys that are seen only once from pushing useful entries out.
+ *
+ *  Entries may be given an expiry time (see \c #ubi_cachePutExpires()).
+ *  Time is measured in ticks of a caller-supplied \c #ubi_timerWheel,
+ *  which serves as the expiry index.  \c #ubi_cacheExpire() frees the
+ *  entries that have expired, at a cost proportional to the number of
+ *  expired entries (not the size of the cache).  \c #ubi_cacheGet() will
+ *  not return an entry that has expired, and expired entries are removed
+ *  before anything else when the cache is trimmed.
+ *
+ *  A plain \c #ubi_cacheEntry has room only for the state that every
+ *  cache needs.  Expiry and the GDSF and sampled policies keep more, in a
+ *  \c #ubi_cacheEntryExt, and a cache that uses any of them must be told
+ *  that its entries are extended (\c #ubi_cacheSetExtended()) before they
+ *  are set.  Other caches don't pay for the larger entry.
+ *
+ *  \c #ubi_cacheGetOrLoad() calls a loader function on a miss, and puts
+ *  the result.  If the cache is shared by several threads, it can make
+ *  sure that only one of them loads any given key at a time, while the
+ *  others wait for the result (see \c #ubi_cacheSetSync()).
+ *
+ *  By default, the cache evicts one entry for each entry put once it is
+ *  full.  With \c #ubi_cacheSetWatermarks(), trimming starts above a high
+ *  watermark and evicts a batch of entries, down to a low watermark.  A
+ *  trim budget (\c #ubi_cacheSetTrimBudget()) limits the number of
+ *  entries evicted by any one put.  A large trim is then spread over the
+ *  following puts, and the cache may briefly exceed its limits.
+ *
+ *  An entry returned by \c #ubi_cacheGet() may be freed by the next put,
+ *  so its data must be copied out before the cache is touched again (or
+ *  unlocked).  \c #ubi_cacheAcquire() also takes a reference to the
+ *  entry, which pins it until \c #ubi_cacheRelease() is called.  Pinned
+ *  entries are passed over by eviction.  A pinned entry that is deleted,
+ *  overwritten, or expires leaves the cache at once, but is not freed
+ *  until its last reference is released.  Large entries can then be
+ *  handed to writev(), say, without copying them.
+ *
+ *  For a warm restart, \c #ubi_cacheDump() writes the entries to a file,
+ *  hottest first, and \c #ubi_cacheLoad() reads them back into a new
+ *  cache.  The load can be done a few entries at a time, so that the
+ *  hottest part of the working set is back before the rest has been read.
+ *
+ *  The same functions can give the cache a second tier on disk.  With
+ *  \c #ubi_cacheSetSpill(), each entry that is evicted is first appended
+ *  to a log file, and a small record of where it went is kept in memory.
+ *  A lookup that misses in memory looks for a record, reads the entry back
+ *  from the log, and puts it into the cache again.  Records are far
+ *  smaller than most entries, so the second tier can be many times larger
+ *  than the cache.  Space in the log is reclaimed by copying the live
+ *  entries to a new file.  The spill log is in a module of its own;
+ *  see ubi_CacheSpill.h.
+ *
+ *  To help choose the cache's limits, \c #ubi_cacheSetMissRatio() attaches
+ *  a \c ubi_MissRatio curve, which samples the keys looked up and
+ *  predicts the hit ratio that other sizes would have.
+ *  \c #ubi_cacheTuneMemory() uses it to pick the smallest memory limit
+ *  that would lose next to nothing.
+ *
+ *  Many caches (one per tenant, say) can share one memory budget by
+ *  joining a \c #ubi_cachePool.  Each member has a minimum and maximum
+ *  share.  When the members together go over the budget, the pool evicts
+ *  from the member whose memory is earning the fewest hits per byte at
+ *  the margin, so that busy caches grow at the expense of idle ones.
+ *  \c #ubi_cachePoolUpdate() re-estimates that value, from each member's
+ *  miss ratio curve if it has one, or else from its recent hits.  Pools
+ *  are in a module of their own; see ubi_CachePool.h.
+ *
+ *  The \c stats field of the cache header counts lookups, hits, puts,
+ *  and evictions (by reason), using 64-bit counters that are never reset
+ *  except by \c #ubi_cacheInit().  Call \c #ubi_cacheStatsSample() every
+ *  \c #ubi_cacheSAMPLE_SECS seconds to keep 1 and 5 minute moving averages
+ *  of the hit ratio, and use \c #ubi_cacheStatsFormat() to export it all
+ *  as Prometheus text.
+ *
+ *  With either CLOCK policy, \c #ubi_cacheGet() does not splay the tree,
+ *  so a hit writes nothing but the reference bit and the hit counters.
+ *  (GDSF doesn't splay either, but a hit updates the heap.  Nor does the
+ *  sampled policy, where a hit writes only the entry's access stamp.)
+ *  The tree is still splayed by insertions, which keeps it reasonably
+ *  shallow as long as keys do not arrive in sorted order.
+ *
  *  To use this module, you will need to supply a comparison function of
  *  type \c #ubi_trCompFunc and a node-freeing function of type
  *  \c #ubi_trKillNodeRtn.  See ubi_BinTree.h for more information on
@@ -94,21 +241,282 @@
  *    cache header keeps the total.  This information is provided via
  *    the \c EntrySize parameter in \c #ubi_cachePut(), so it is up to
  *    the caller to make sure that the numbers are accurate.  (The numbers
- *    don't even have to represent bytes used.)
+ *    don't even have to represent bytes used.)  The entry structure
+ *    itself is not counted unless the caller includes it; see
+ *    \c #ubi_cacheEntry.
  *
  *    As you consider this, note that the strdup() function--as an
  *    example--will call malloc().  The latter generally allocates a
  *    multiple of the system word size, which may be more than the
  *    number of bytes needed to store the string.
  *
+ *    To have the cache account for the memory that is really used, give
+ *    it a \c ubi_Slab pool (\c #ubi_cacheSetSlab()) and allocate the
+ *    entries with \c #ubi_cacheAlloc().  Each entry is then charged the
+ *    size of its slab chunk, and the pool never grows past its arena.
+ *
+ *  - Entries that are removed from the cache are freed immediately.  If
+ *    other threads may still be using entries that they found (i.e.,
+ *    they use an entry after releasing the lock that protects the
+ *    cache), call \c #ubi_cacheSetRetire() so that removed entries are
+ *    handed to a function that retires them, for instance via the
+ *    \c ubi_Epoch module, instead.
+ *
  */
 
+#include <stddef.h>           /* size_t */
+#include <stdio.h>            /* FILE   */
 #include "ubi_SplayTree.h"
+#include "ubi_dLinkList.h"
+#include "ubi_Heap.h"
+#include "ubi_MissRatio.h"
+#include "ubi_Slab.h"
+#include "ubi_TimerWheel.h"
+
+/* -------------------------------------------------------------------------- **
+ * Constants...
+ */
+
+/**
+ * @def     ubi_cacheSPLAY
+ * @brief   Eviction policy: purge leaves of the splay tree.  (Default.)
+ * @def     ubi_cacheLRU
+ * @brief   Eviction policy: purge the least recently used entry.
+ * @def     ubi_cacheCLOCK
+ * @brief   Eviction policy: CLOCK (second chance).
+ * @def     ubi_cacheCLOCKPRO
+ * @brief   Eviction policy: scan-resistant CLOCK, with hot and cold entries.
+ * @def     ubi_cacheARC
+ * @brief   Eviction policy: Adaptive Replacement Cache.
+ * @def     ubi_cacheGDSF
+ * @brief   Eviction policy: GreedyDual-Size-Frequency.
+ * @def     ubi_cacheSAMPLED
+ * @brief   Eviction policy: the least recently used of a random sample.
+ * @see     #ubi_cacheSetPolicy()
+ */
+#define ubi_cacheSPLAY    0
+#define ubi_cacheLRU      1
+#define ubi_cacheCLOCK    2
+#define ubi_cacheCLOCKPRO 3
+#define ubi_cacheARC      4
+#define ubi_cacheGDSF     5
+#define ubi_cacheSAMPLED  6
+
+/**
+ * @def     ubi_cacheINDEX_SPLAY
+ * @brief   Index: a splay tree.  (Default.)
+ * @def     ubi_cacheINDEX_AVL
+ * @brief   Index: an AVL tree, which lookups do not restructure.
+ * @def     ubi_cacheINDEX_HASH
+ * @brief   Index: a hash table, chained through the entries.
+ * @see     #ubi_cacheSetIndex()
+ */
+#define ubi_cacheINDEX_SPLAY 0
+#define ubi_cacheINDEX_AVL   1
+#define ubi_cacheINDEX_HASH  2
+
+/**
+ * @def     ubi_cacheEVICT_SIZE
+ * @brief   Eviction reason: the cache was over its entry or memory limit.
+ * @def     ubi_cacheEVICT_REDUCE
+ * @brief   Eviction reason: \c #ubi_cacheReduce() was called.
+ * @def     ubi_cacheEVICT_EXPIRED
+ * @brief   Eviction reason: the entry expired.
+ * @def     ubi_cacheEVICT_REJECTED
+ * @brief   Eviction reason: the admission filter refused the entry.
+ * @def     ubi_cacheEVICT_POOL
+ * @brief   Eviction reason: the cache's \c #ubi_cachePool was over budget.
+ * @def     ubi_cacheEVICT_REASONS
+ * @brief   The number of eviction reasons.
+ * @see     #ubi_cacheStats
+ */
+#define ubi_cacheEVICT_SIZE     0
+#define ubi_cacheEVICT_REDUCE   1
+#define ubi_cacheEVICT_EXPIRED  2
+#define ubi_cacheEVICT_REJECTED 3
+#define ubi_cacheEVICT_POOL     4
+#define ubi_cacheEVICT_REASONS  5
+
+/**
+ * @def     ubi_cacheWINDOW_1MIN
+ * @brief   Hit ratio window: one minute moving average.
+ * @def     ubi_cacheWINDOW_5MIN
+ * @brief   Hit ratio window: five minute moving average.
+ * @def     ubi_cacheSAMPLE_SECS
+ * @brief   Interval, in seconds, at which to call
+ *          \c #ubi_cacheStatsSample().
+ * @see     #ubi_cacheStatsHitRatio()
+ */
+#define ubi_cacheWINDOW_1MIN 0
+#define ubi_cacheWINDOW_5MIN 1
+#define ubi_cacheSAMPLE_SECS 5
 
 /* -------------------------------------------------------------------------- **
  * Typedefs...
  */
 
+/* Forward reference.  See ubi_cacheEntry, below. */
+struct ubi_cacheEntryStruct;
+
+/**
+ * @typedef ubi_cacheRetireFunc
+ * @brief   Function that takes charge of an entry removed from the cache,
+ *          for \c #ubi_cacheSetRetire().
+ * @details Called with the context given to \c #ubi_cacheSetRetire() and
+ *          the entry, which is no longer in the cache.  The function must
+ *          see to it that the entry is freed, now or later.
+ */
+typedef void (*ubi_cacheRetireFunc)( void *Context, void *EntryPtr );
+
+/**
+ * @typedef ubi_cacheHashFunc
+ * @brief   Key hashing function.
+ * @details Given a key (as passed to \c #ubi_cachePut() or
+ *          \c #ubi_cacheGet()), return a hash of the key.  Keys that
+ *          compare as equal must have the same hash.
+ */
+typedef unsigned long (*ubi_cacheHashFunc)( ubi_trItemPtr Key );
+
+/**
+ * @typedef ubi_cacheCostFunc
+ * @brief   Entry cost function, used by the GDSF eviction policy.
+ * @details Given a pointer to a new cache entry, return the cost of
+ *          loading it again if it is evicted (e.g., the time it took to
+ *          fetch, or its size).  A cost of zero is treated as one.
+ */
+typedef unsigned long (*ubi_cacheCostFunc)( ubi_trNodePtr EntryPtr );
+
+/**
+ * @typedef ubi_cacheSyncFunc
+ * @brief   Lock, unlock, wait or wake function.
+ * @details Called with the lock object given to \c #ubi_cacheSetSync().
+ */
+typedef void (*ubi_cacheSyncFunc)( void *Sync );
+
+/**
+ * @typedef ubi_cacheCheckFunc
+ * @brief   Loaded entry check, for \c #ubi_cacheSetLoadCheck().
+ * @details Called, with the cache locked again, with the context given to
+ *          \c #ubi_cacheSetLoadCheck() and the entry that the loader
+ *          returned.  Return FALSE if the entry must not be put.
+ */
+typedef ubi_trBool (*ubi_cacheCheckFunc)( void                        *Context,
+                                          struct ubi_cacheEntryStruct *Entry );
+
+/**
+ * @typedef ubi_cacheSerializeFunc
+ * @brief   Entry writing function, for \c #ubi_cacheDump() and
+ *          \c #ubi_cacheSetSpill().
+ * @details Write the key and data of the entry to the stream, in any
+ *          format that the matching \c #ubi_cacheDeserializeFunc can
+ *          read back.  Return TRUE on success, FALSE on failure.
+ */
+typedef ubi_trBool (*ubi_cacheSerializeFunc)(
+                          FILE                        *Stream,
+                          struct ubi_cacheEntryStruct *EntryPtr,
+                          void                        *Context );
+
+/**
+ * @typedef ubi_cacheDeserializeFunc
+ * @brief   Entry reading function, for \c #ubi_cacheLoad() and
+ *          \c #ubi_cacheSetSpill().
+ * @details Read one entry written by the \c #ubi_cacheSerializeFunc from
+ *          the stream, and return it as a new cache entry (with its
+ *          \c entry_size set).  \p KeyPtr is set to point to the entry's
+ *          key, which is usually within the entry.  Return NULL if the
+ *          entry could not be read or allocated.
+ */
+typedef struct ubi_cacheEntryStruct *(*ubi_cacheDeserializeFunc)(
+                          FILE          *Stream,
+                          ubi_trItemPtr *KeyPtr,
+                          void          *Context );
+
+/**
+ * @struct  ubi_cacheGhost
+ * @brief   A record of an evicted key, used by the ARC policy.
+ * @details Ghosts remember only the hash of the key, not the key itself,
+ *          so a hash collision may occasionally be mistaken for a ghost
+ *          hit.  That only affects the tuning of the policy, not the
+ *          correctness of the cache.
+ */
+typedef struct
+  {
+  ubi_btNode    node;           /**< Index node, keyed by hash.     */
+  ubi_dlNode    link;           /**< Ghost list link.               */
+  unsigned long hash;           /**< Hash of the evicted key.       */
+  ubi_dlListPtr list;           /**< The list this ghost is on.     */
+  } ubi_cacheGhost;
+
+/** Pointer to a \c #ubi_cacheGhost. */
+typedef ubi_cacheGhost *ubi_cacheGhostPtr;
+
+/**
+ * @struct  ubi_cacheSketch
+ * @brief   TinyLFU frequency sketch, used to decide which puts to admit.
+ * @details A count-min sketch of four rows of small (saturating at 15)
+ *          counters, plus a "doorkeeper" Bloom filter that absorbs the
+ *          first access to each key.  The memory is supplied by the
+ *          caller; see \c #ubi_cacheSetAdmission().
+ */
+typedef struct
+  {
+  unsigned char *counts;        /**< Counters: four rows of width.  */
+  unsigned char *door;          /**< Doorkeeper bits (width bits).  */
+  unsigned long  mask;          /**< Width - 1 (a power of two).    */
+  unsigned long  adds;          /**< Additions since last aging.    */
+  } ubi_cacheSketch;
+
+/**
+ * @typedef ubi_cacheCounter
+ * @brief   A statistics counter.
+ * @details This is <tt>unsigned long long</tt> if the compiler supports
+ *          C99, and <tt>unsigned long</tt> otherwise.  The latter is 64
+ *          bits wide on most 64-bit systems, but on a 32-bit system with
+ *          a C89 compiler the counters will wrap, and the moving averages
+ *          (which are kept in fixed point) lose accuracy once there are
+ *          more than about a thousand lookups per sample.
+ *          \c #ubi_cacheCOUNTER_FMT is the matching \c printf() format.
+ */
+#if defined( __STDC_VERSION__ ) && (__STDC_VERSION__ >= 199901L)
+typedef unsigned long long ubi_cacheCounter;
+#define ubi_cacheCOUNTER_FMT "%llu"
+#else
+typedef unsigned long ubi_cacheCounter;
+#define ubi_cacheCOUNTER_FMT "%lu"
+#endif
+
+/**
+ * @struct  ubi_cacheStats
+ * @brief   Cache statistics.
+ * @details All counters only ever go up.  Misses are \c lookups minus
+ *          \c hits.  Overwrites and deletions are not evictions.  The
+ *          depth of an evicted entry is its distance from the root of
+ *          the tree, just before it was removed.  The moving averages
+ *          are maintained by \c #ubi_cacheStatsSample(), in fixed point.
+ */
+typedef struct
+  {
+  ubi_cacheCounter lookups;       /**< Calls to ubi_cacheGet().           */
+  ubi_cacheCounter hits;          /**< Lookups that found an entry.       */
+  ubi_cacheCounter inserts;       /**< Entries put.                       */
+  ubi_cacheCounter overwrites;    /**< Puts that replaced an entry.       */
+  ubi_cacheCounter deletes;       /**< Entries removed by ubi_cacheDelete.*/
+  ubi_cacheCounter evictions[ ubi_cacheEVICT_REASONS ];
+                                  /**< Evictions, by reason.              */
+  ubi_cacheCounter evicted_bytes; /**< Sum of evicted entry sizes.        */
+  ubi_cacheCounter evicted_depth; /**< Sum of evicted entry depths.       */
+  unsigned long    max_depth;     /**< Deepest entry evicted.             */
+  ubi_cacheCounter spill_writes;  /**< Evicted entries written to disk.   */
+  ubi_cacheCounter spill_hits;    /**< Misses found on disk.              */
+  ubi_cacheCounter last_lookups;  /**< Lookups at the last sample.        */
+  ubi_cacheCounter last_hits;     /**< Hits at the last sample.           */
+  ubi_cacheCounter avg_lookups[ 2 ];  /**< Moving average of lookups.     */
+  ubi_cacheCounter avg_hits[ 2 ];     /**< Moving average of hits.        */
+  } ubi_cacheStats;
+
+/** Pointer to a \c #ubi_cacheStats. */
+typedef ubi_cacheStats *ubi_cacheStatsPtr;
+
 /**
  * @struct  ubi_cacheRoot
  * @brief   Cache header structure.
@@ -117,13 +525,62 @@
  */
 typedef struct
   {
-  ubi_trRoot        root;         /**< Splay tree control structure.      */
+  ubi_trRoot        root;         /**< Index tree control structure.      */
   ubi_trKillNodeRtn free_func;    /**< Function used to free entries.     */
   unsigned long     max_entries;  /**< Max cache entries.  0 == unlimited */
   unsigned long     max_memory;   /**< Max memory to use.  0 == unlimited */
   unsigned long     mem_used;     /**< Memory currently in use (bytes).   */
   unsigned short    cache_hits;   /**< Incremented on succesful find.     */
   unsigned short    cache_trys;   /**< Incremented on any cache lookup.   */
+  ubi_cacheRetireFunc retire;     /**< If set, retire; don't free.        */
+  void             *retire_ctx;   /**< Context for the retire function.   */
+  int               policy;       /**< Eviction policy.                   */
+  ubi_trBool        extended;     /**< Entries are ubi_cacheEntryExt.     */
+  ubi_dlList        lru;          /**< Recency list, or the clock ring.   */
+  ubi_dlNodePtr     hand;         /**< Clock hand (next entry to check).  */
+  ubi_dlNodePtr     hot_hand;     /**< CLOCK-Pro hand for hot entries.    */
+  unsigned long     hot;          /**< Number of hot CLOCK-Pro entries.   */
+  ubi_cacheHashFunc hash_func;    /**< Key hash function, or NULL.        */
+  ubi_dlList        t2;           /**< ARC: entries used more than once.  */
+  ubi_dlList        b1;           /**< ARC: ghosts of entries from lru.   */
+  ubi_dlList        b2;           /**< ARC: ghosts of entries from t2.    */
+  ubi_dlList        spare;        /**< ARC: unused ghosts.                */
+  ubi_btRoot        ghosts;       /**< ARC: ghosts, indexed by hash.      */
+  unsigned long     arc_p;        /**< ARC: target length of lru (T1).    */
+  ubi_cacheSketch   sketch;       /**< TinyLFU admission sketch.          */
+  ubi_dlList        window;       /**< TinyLFU window, most recent first. */
+  ubi_timerWheelPtr wheel;        /**< Expiry index, or NULL.             */
+  unsigned long     now;          /**< Current time, in wheel ticks.      */
+  ubi_cacheStats    stats;        /**< Statistics.                        */
+  unsigned int      high_water;   /**< Start trimming above this percent. */
+  unsigned int      low_water;    /**< Trim down to this percent.         */
+  unsigned long     trim_budget;  /**< Max evictions per call.  0 == all  */
+  ubi_trBool        trimming;     /**< Trimming is unfinished.            */
+  ubi_btRoot        flights;      /**< Loads in progress, by key hash.    */
+  ubi_cacheSyncFunc lock;         /**< Lock the cache, or NULL.           */
+  ubi_cacheSyncFunc unlock;       /**< Unlock the cache, or NULL.         */
+  ubi_cacheSyncFunc wait;         /**< Wait for a load, or NULL.          */
+  ubi_cacheSyncFunc wake;         /**< Wake the waiters.                  */
+  void             *sync;         /**< Lock object for the above.         */
+  ubi_cacheCheckFunc load_check;  /**< Check loaded entries, or NULL.     */
+  void             *check_ctx;    /**< Context for load_check.            */
+  ubi_hpRoot        gdsf;         /**< GDSF: entries, by priority.        */
+  double            gdsf_age;     /**< GDSF: L, the last evicted priority */
+  ubi_cacheCostFunc cost_func;    /**< GDSF: entry cost function, or NULL */
+  ubi_slabPoolPtr   slab;         /**< Entry storage, or NULL.            */
+  ubi_trBool        loading;      /**< ubi_cacheLoad() is putting entries.*/
+  ubi_mrcRootPtr    mrc;          /**< Miss ratio curve, or NULL.         */
+  unsigned long     pinned;       /**< Entries with references held.      */
+  int               index;        /**< Index: splay, AVL, or hash.        */
+  ubi_btNodePtr    *buckets;      /**< Hash index: chain heads, or NULL.  */
+  unsigned long     bucket_count; /**< Hash index: number of buckets.     */
+  struct ubi_cachePoolMemberStruct *pool; /**< Pool membership, or NULL. */
+  struct ubi_cacheEntryStruct **slots; /**< Sampled: entry slots.     */
+  unsigned long     slot_max;     /**< Sampled: size of the slots array.  */
+  unsigned long     slot_count;   /**< Sampled: slots in use.             */
+  unsigned long     sample_size;  /**< Sampled: K, entries per eviction.  */
+  unsigned long     sample_seed;  /**< Sampled: random number state.      */
+  struct ubi_cacheSpillLogStruct *spill; /**< Spill log, or NULL.   */
   } ubi_cacheRoot;
 
 /** A cache pointer; points to a \c #ubi_cacheRoot structure. */
@@ -135,16 +592,84 @@ typedef ubi_cacheRoot *ubi_cacheRootPtr;
  * @details   A cache entry consists of a tree node structure and the size
  *            (in bytes) of the entry data.  The entry size is supplied via
  *            the \p EntrySize parameter of the #ubi_cachePut() function.
+ *            The \c link and \c flags fields are used by eviction
+ *            policies that keep their own list of entries.  The \c hash
+ *            field is filled in by \c #ubi_cachePut() if the cache has a
+ *            hash function.  \c refs counts the references held by
+ *            \c #ubi_cacheAcquire().
+ *
+ *            The entry structure itself is not part of \c entry_size.  It
+ *            is 72 bytes on a 64-bit system (40 on a 32-bit one), which
+ *            matters in a cache of many small entries.  A caller that
+ *            wants the memory limit to cover it should add
+ *            \c sizeof(ubi_cacheEntry) to the \p EntrySize it passes to
+ *            \c #ubi_cachePut().
+ *
+ *            Expiry timers and the GDSF and sampled policies need more
+ *            room; see \c #ubi_cacheEntryExt.
  */
-typedef struct
+typedef struct ubi_cacheEntryStruct
   {
   ubi_trNode    node;           /**< Tree node structure.   */
   unsigned long entry_size;     /**< Entry size, in bytes.  */
+  ubi_dlNode    link;           /**< Eviction list link.    */
+  unsigned long hash;           /**< Key hash, if known.    */
+  unsigned int  flags;          /**< Eviction policy flags. */
+  unsigned int  refs;           /**< References held.       */
   } ubi_cacheEntry;
 
 /** Pointer to a ubi_cacheEntry. */
 typedef ubi_cacheEntry *ubi_cacheEntryPtr;
 
+/**
+ * @struct    ubi_cacheEntryExt
+ * @brief     Extended cache entry.
+ * @details   A cache entry followed by the fields that only some features
+ *            use.  The \c timer field is used if the entry was added with
+ *            \c #ubi_cachePutExpires().  The \c pol union holds the
+ *            fields that only one policy uses: \c gdsf for the GDSF
+ *            policy, and \c smp for the sampled policy.
+ *
+ *            A cache whose entries are all extended is told so with
+ *            \c #ubi_cacheSetExtended().  Only such a cache may be given a
+ *            timing wheel, or the GDSF or sampled policy.  The extended
+ *            entry is still passed to the cache functions as a
+ *            \c #ubi_cacheEntryPtr; that is, as a pointer to \c base.
+ *            It is 152 bytes on a 64-bit system.
+ */
+typedef struct
+  {
+  ubi_cacheEntry base;          /**< The entry.  Must be first. */
+  ubi_timerNode  timer;         /**< Expiry timer.          */
+  union
+    {
+    struct
+      {
+      ubi_hpNode    heap;       /**< Heap node.             */
+      double        priority;   /**< Priority.              */
+      unsigned long freq;       /**< Use count.             */
+      unsigned long cost;       /**< Miss cost.             */
+      } gdsf;                   /**< GDSF policy fields.    */
+    struct
+      {
+      unsigned long slot;       /**< Slot index.            */
+      unsigned int  atime;      /**< Last use.              */
+      } smp;                    /**< Sampled policy fields. */
+    } pol;                      /**< Policy-private fields. */
+  } ubi_cacheEntryExt;
+
+/** Pointer to a ubi_cacheEntryExt. */
+typedef ubi_cacheEntryExt *ubi_cacheEntryExtPtr;
+
+/**
+ * @typedef ubi_cacheLoadFunc
+ * @brief   Entry loading function, for \c #ubi_cacheGetOrLoad().
+ * @details Given a key and a context pointer, create and return a new
+ *          cache entry (with its \c entry_size set), or return NULL if
+ *          the data could not be loaded.
+ */
+typedef ubi_cacheEntryPtr (*ubi_cacheLoadFunc)( ubi_trItemPtr Key,
+                                                void         *Context );
 
 /* -------------------------------------------------------------------------- **
  * Macros...
@@ -184,6 +709,27 @@ typedef ubi_cacheEntry *ubi_cacheEntryPtr;
  */
 #define ubi_cacheGetMemUsed( Cptr ) (((ubi_cacheRootPtr)(Cptr))->mem_used)
 
+/**
+ * @def     ubi_cacheSketchSize( N )
+ * @param   N The maximum number of entries in the cache.
+ * @returns A reasonable size, in bytes, for the buffer passed to
+ *          \c #ubi_cacheSetAdmission().
+ */
+#define ubi_cacheSketchSize( N ) ((4 * (N)) + ((N) / 8) + 1)
+
+/**
+ * @def     ubi_cacheSetTime( Cptr, Now )
+ * @param   Cptr  Pointer to the cache root.
+ * @param   Now   The current time, in ticks.
+ * @brief   Tell the cache what time it is, without expiring anything.
+ * @details \c #ubi_cacheGet() compares expiry times against the cache's
+ *          idea of the current time.  That is normally updated by
+ *          \c #ubi_cacheExpire(), but this macro is cheaper if you want
+ *          to update it more often.
+ */
+#define ubi_cacheSetTime( Cptr, Now ) \
+        ((void)(((ubi_cacheRootPtr)(Cptr))->now = (Now)))
+
 /* -------------------------------------------------------------------------- **
  * Prototypes...
  */
@@ -196,25 +742,141 @@ ubi_cacheRootPtr ubi_cacheInit( ubi_cacheRootPtr  CachePtr,
 
 ubi_cacheRootPtr ubi_cacheClear( ubi_cacheRootPtr CachePtr );
 
+ubi_cacheRootPtr ubi_cacheAbandon( ubi_cacheRootPtr CachePtr );
+
 void ubi_cachePut( ubi_cacheRootPtr  CachePtr,
                    unsigned long     EntrySize,
                    ubi_cacheEntryPtr EntryPtr,
                    ubi_trItemPtr     Key );
 
+void ubi_cachePutExpires( ubi_cacheRootPtr  CachePtr,
+                          unsigned long     EntrySize,
+                          ubi_cacheEntryPtr EntryPtr,
+                          ubi_trItemPtr     Key,
+                          unsigned long     Expires );
+
+unsigned long ubi_cacheExpire( ubi_cacheRootPtr CachePtr, unsigned long Now );
+
+long ubi_cacheDump( ubi_cacheRootPtr       CachePtr,
+                    FILE                  *Stream,
+                    ubi_cacheSerializeFunc Serialize,
+                    void                  *Context );
+
+unsigned long ubi_cacheLoad( ubi_cacheRootPtr         CachePtr,
+                             FILE                    *Stream,
+                             ubi_cacheDeserializeFunc Deserialize,
+                             void                    *Context,
+                             unsigned long            Budget );
+
+ubi_cacheEntryPtr ubi_cacheGetOrLoad( ubi_cacheRootPtr  CachePtr,
+                                      ubi_trItemPtr     Key,
+                                      ubi_cacheLoadFunc Loader,
+                                      void             *Context );
+
 ubi_cacheEntryPtr ubi_cacheGet( ubi_cacheRootPtr CachePtr,
                                 ubi_trItemPtr    FindMe );
 
+ubi_cacheEntryPtr ubi_cacheAcquire( ubi_cacheRootPtr CachePtr,
+                                    ubi_trItemPtr    FindMe );
+
+void ubi_cacheRelease( ubi_cacheRootPtr  CachePtr,
+                       ubi_cacheEntryPtr EntryPtr );
+
 ubi_trBool ubi_cacheDelete( ubi_cacheRootPtr CachePtr, ubi_trItemPtr DeleteMe );
 
 ubi_trBool ubi_cacheReduce( ubi_cacheRootPtr CachePtr, unsigned long count );
 
+unsigned long ubi_cacheTraverse( ubi_cacheRootPtr CachePtr,
+                                 ubi_trActionRtn  Action,
+                                 void            *UserData );
+
 unsigned long ubi_cacheSetMaxEntries( ubi_cacheRootPtr CachePtr,
                                       unsigned long    NewSize );
 
 unsigned long ubi_cacheSetMaxMemory( ubi_cacheRootPtr CachePtr,
                                      unsigned long    NewSize );
 
+ubi_trBool ubi_cacheSetWatermarks( ubi_cacheRootPtr CachePtr,
+                                   unsigned int     High,
+                                   unsigned int     Low );
+
+unsigned long ubi_cacheSetTrimBudget( ubi_cacheRootPtr CachePtr,
+                                      unsigned long    Budget );
+
 int ubi_cacheHitRatio( ubi_cacheRootPtr CachePtr );
 
+void ubi_cacheStatsSample( ubi_cacheRootPtr CachePtr );
+
+int ubi_cacheStatsHitRatio( ubi_cacheRootPtr CachePtr, int Window );
+
+size_t ubi_cacheStatsFormat( ubi_cacheRootPtr CachePtr,
+                             const char      *Name,
+                             char            *Buffer,
+                             size_t           Size );
+
+ubi_trBool ubi_cacheSetPolicy( ubi_cacheRootPtr CachePtr, int Policy );
+
+ubi_trBool ubi_cacheSetExtended( ubi_cacheRootPtr CachePtr,
+                                 ubi_trBool       Extended );
+
+ubi_trBool ubi_cacheSetIndex( ubi_cacheRootPtr CachePtr,
+                              int              Index,
+                              ubi_btNodePtr   *Buckets,
+                              unsigned long    Count );
+
+void ubi_cacheSetRetire( ubi_cacheRootPtr    CachePtr,
+                         ubi_cacheRetireFunc RetireFunc,
+                         void               *Context );
+
+ubi_trBool ubi_cacheSetHashFunc( ubi_cacheRootPtr  CachePtr,
+                                 ubi_cacheHashFunc HashFunc );
+
+ubi_trBool ubi_cacheSetSlab( ubi_cacheRootPtr CachePtr,
+                             ubi_slabPoolPtr  PoolPtr );
+
+void *ubi_cacheAlloc( ubi_cacheRootPtr CachePtr, unsigned long Size );
+
+ubi_trBool ubi_cacheRebalance( ubi_cacheRootPtr CachePtr );
+
+void ubi_cacheSetCostFunc( ubi_cacheRootPtr  CachePtr,
+                           ubi_cacheCostFunc CostFunc );
+
+ubi_trBool ubi_cacheSetMissRatio( ubi_cacheRootPtr CachePtr,
+                                  ubi_mrcRootPtr   MrcPtr );
+
+unsigned long ubi_cacheTuneMemory( ubi_cacheRootPtr CachePtr,
+                                   unsigned long    Min,
+                                   unsigned long    Max,
+                                   int              Slack );
+
+ubi_trBool ubi_cacheSetGhosts( ubi_cacheRootPtr  CachePtr,
+                               ubi_cacheGhostPtr Ghosts,
+                               unsigned long     Count );
+
+ubi_trBool ubi_cacheSetSlots( ubi_cacheRootPtr   CachePtr,
+                              ubi_cacheEntryPtr *Slots,
+                              unsigned long      Count );
+
+unsigned long ubi_cacheSetSampleSize( ubi_cacheRootPtr CachePtr,
+                                      unsigned long    Size );
+
+ubi_trBool ubi_cacheSetAdmission( ubi_cacheRootPtr CachePtr,
+                                  void            *Buffer,
+                                  unsigned long    Size );
+
+ubi_trBool ubi_cacheSetWheel( ubi_cacheRootPtr  CachePtr,
+                              ubi_timerWheelPtr WheelPtr );
+
+void ubi_cacheSetSync( ubi_cacheRootPtr  CachePtr,
+                       ubi_cacheSyncFunc LockFunc,
+                       ubi_cacheSyncFunc UnlockFunc,
+                       ubi_cacheSyncFunc WaitFunc,
+                       ubi_cacheSyncFunc WakeFunc,
+                       void             *Sync );
+
+void ubi_cacheSetLoadCheck( ubi_cacheRootPtr   CachePtr,
+                            ubi_cacheCheckFunc CheckFunc,
+                            void              *Context );
+
 /* ========================================================================== */
 #endif /* ubi_CACHE_H */
@@ -0,0 +1,1067 @@
+/* ========================================================================== **
+ *                             ubi_CachePolicy.c
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module implements the eviction policies of ubi_Cache.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ *
+ *  The cache calls the ubi_cachePolicy*() functions below whenever an
+ *  entry is added, used, removed, or evicted, and when it needs a victim.
+ *  Each of them switches on the cache's policy.  The policies keep their
+ *  state in the cache header and the entries, so this module has no
+ *  header of its own; the functions that set the policies up are declared
+ *  in ubi_Cache.h, with the rest of the cache's settings.
+ *
+ * ========================================================================== **
+ */
+
+#include <stddef.h>           /* offsetof() */
+#include "ubi_Cache.h"        /* The cache. */
+#include "ubi_CachePriv.h"    /* Shared with the rest of the cache. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ *
+ *  LinkGhost - Given a pointer to the link field of a ghost, return a
+ *              pointer to the ghost.
+ *  HeapEntry - Given a pointer to the heap field of an extended entry,
+ *              return a pointer to the entry.
+ *  HotMax()  - The most hot entries that CLOCK-Pro will keep, given the
+ *              number of entries in the cache.  The rest are cold.
+ */
+
+#define LinkGhost( L ) \
+  ((ubi_cacheGhostPtr)((char *)(L) - offsetof( ubi_cacheGhost, link )))
+
+#define HeapEntry( H ) \
+  ((ubi_cacheEntryPtr)((char *)(H) \
+                       - offsetof( ubi_cacheEntryExt, pol.gdsf.heap )))
+
+#define HotMax( N ) (((N) / 4) * 3)
+
+
+/* -------------------------------------------------------------------------- **
+ * Constants...
+ *
+ *  NO_SLOT     - The slot of an entry that the sampled policy could not fit
+ *                into its slots array.
+ *  SAMPLE_SIZE - The default number of entries sampled per eviction.
+ *  SAMPLE_SEED - The initial state of the sampled policy's random numbers.
+ */
+
+#define NO_SLOT     (~0UL)
+#define SAMPLE_SIZE 5
+#define SAMPLE_SEED 2463534242UL
+
+
+/* -------------------------------------------------------------------------- **
+ * Internal functions...
+ */
+
+static ubi_dlNodePtr clock_next( ubi_dlListPtr Ring, ubi_dlNodePtr Node )
+  /* ------------------------------------------------------------------------ **
+   * Return the node following Node, treating the list as a circle.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( ubi_dlNext( Node ) ? ubi_dlNext( Node ) : ubi_dlFirst( Ring ) );
+  } /* clock_next */
+
+static void clock_cool( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Demote hot CLOCK-Pro entries until there are no more than HotMax().
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *
+   *  Output: none.
+   *
+   *  Notes:  The hot hand skips cold entries.  A hot entry that has been
+   *          used since the hot hand last passed it gets another chance;
+   *          otherwise, it is demoted to cold.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheEntryPtr EntryPtr;
+  ubi_dlNodePtr     p;
+
+  while( CachePtr->hot > HotMax( ubi_dlCount( &CachePtr->lru ) ) )
+    {
+    p = CachePtr->hot_hand ? CachePtr->hot_hand : CachePtr->hand;
+    CachePtr->hot_hand = clock_next( &CachePtr->lru, p );
+    EntryPtr = LinkEntry( p );
+    if( EntryPtr->flags & HOT_BIT )
+      {
+      if( EntryPtr->flags & REF_BIT )
+        EntryPtr->flags &= ~REF_BIT;
+      else
+        {
+        EntryPtr->flags &= ~HOT_BIT;
+        CachePtr->hot--;
+        }
+      }
+    }
+  } /* clock_cool */
+
+static int ghost_cmp( ubi_btItemPtr ItemPtr, ubi_btNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare a hash value against the hash stored in a ghost.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((ubi_cacheGhostPtr)NodePtr)->hash;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* ghost_cmp */
+
+static int gdsf_cmp( ubi_hpNodePtr A, ubi_hpNodePtr B )
+  /* ------------------------------------------------------------------------ **
+   * Compare the GDSF priorities of two entries.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  double PA = ExtEntry( HeapEntry( A ) )->pol.gdsf.priority;
+  double PB = ExtEntry( HeapEntry( B ) )->pol.gdsf.priority;
+
+  return( (PA < PB) ? -1 : ((PA > PB) ? 1 : 0) );
+  } /* gdsf_cmp */
+
+static unsigned long arc_size( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Return ARC's idea of the cache size (c, in the ARC paper).
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *
+   *  Output: The maximum number of entries, if there is one.  Otherwise,
+   *          the cache is limited by memory, and the number of entries it
+   *          currently holds is the best estimate available.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( CachePtr->max_entries )
+    return( CachePtr->max_entries );
+  return( ubi_cacheGetEntryCount( CachePtr ) + 1 );
+  } /* arc_size */
+
+static void ghost_drop( ubi_cacheRootPtr CachePtr, ubi_cacheGhostPtr Ghost )
+  /* ------------------------------------------------------------------------ **
+   * Forget a ghost, and return it to the spare list.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)ubi_btRemove( &CachePtr->ghosts, &Ghost->node );
+  (void)ubi_dlRemThis( Ghost->list, &Ghost->link );
+  Ghost->list = &CachePtr->spare;
+  (void)ubi_dlAddHead( &CachePtr->spare, &Ghost->link );
+  } /* ghost_drop */
+
+static void ghost_add( ubi_cacheRootPtr  CachePtr,
+                       ubi_cacheEntryPtr EntryPtr,
+                       ubi_dlListPtr     List )
+  /* ------------------------------------------------------------------------ **
+   * Remember the key of an evicted entry.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          EntryPtr  - The entry, which has already been taken off of its
+   *                      resident list.
+   *          List      - The ghost list (b1 or b2) to which the key should
+   *                      be added.
+   *
+   *  Output: none.
+   *
+   *  Notes:  ARC keeps |T1| + |B1| <= c, and the total of all four lists
+   *          <= 2c.  Old ghosts are dropped to keep within those bounds,
+   *          or if there are no spare ghosts left.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long     c  = arc_size( CachePtr );
+  ubi_dlListPtr     b1 = &CachePtr->b1;
+  ubi_dlListPtr     b2 = &CachePtr->b2;
+  ubi_cacheGhostPtr Ghost;
+  ubi_btNodePtr     Old;
+
+  /* A ghost with the same hash is out of date.  Drop it first. */
+  Old = ubi_btFind( &CachePtr->ghosts, &EntryPtr->hash );
+  if( NULL != Old )
+    ghost_drop( CachePtr, (ubi_cacheGhostPtr)Old );
+
+  if( List == b1 )
+    {
+    if( ubi_dlCount( &CachePtr->lru ) >= c )
+      return;
+    while( ubi_dlCount( b1 )
+        && ((ubi_dlCount( &CachePtr->lru ) + ubi_dlCount( b1 )) >= c) )
+      ghost_drop( CachePtr, LinkGhost( ubi_dlLast( b1 ) ) );
+    }
+  while( (ubi_dlCount( b1 ) || ubi_dlCount( b2 ))
+      && ((ubi_dlCount( &CachePtr->lru ) + ubi_dlCount( &CachePtr->t2 )
+         + ubi_dlCount( b1 ) + ubi_dlCount( b2 )) >= (2 * c)) )
+    ghost_drop( CachePtr,
+                LinkGhost( ubi_dlLast( ubi_dlCount( b2 ) ? b2 : b1 ) ) );
+  if( 0 == ubi_dlCount( &CachePtr->spare ) )
+    {
+    if( 0 == (ubi_dlCount( b1 ) + ubi_dlCount( b2 )) )
+      return;
+    ghost_drop( CachePtr, LinkGhost( ubi_dlLast( (ubi_dlCount( b1 )
+                                                  > ubi_dlCount( b2 ))
+                                                 ? b1 : b2 ) ) );
+    }
+
+  Ghost = LinkGhost( ubi_dlRemHead( &CachePtr->spare ) );
+  Ghost->hash = EntryPtr->hash;
+  Ghost->list = List;
+  (void)ubi_btInsert( &CachePtr->ghosts, &Ghost->node, &Ghost->hash, NULL );
+  (void)ubi_dlAddHead( List, &Ghost->link );
+  } /* ghost_add */
+
+static void ghost_reset( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Forget all ghosts, and reset the ARC target.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  while( ubi_dlCount( &CachePtr->b1 ) )
+    ghost_drop( CachePtr, LinkGhost( ubi_dlFirst( &CachePtr->b1 ) ) );
+  while( ubi_dlCount( &CachePtr->b2 ) )
+    ghost_drop( CachePtr, LinkGhost( ubi_dlFirst( &CachePtr->b2 ) ) );
+  CachePtr->arc_p = 0;
+  } /* ghost_reset */
+
+static void gdsf_priority( ubi_cacheRootPtr     CachePtr,
+                           ubi_cacheEntryExtPtr ExtPtr )
+  /* ------------------------------------------------------------------------ **
+   * Compute the GDSF priority of an entry.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          ExtPtr    - A pointer to the entry, with its freq and cost set.
+   *
+   *  Output: none.  ExtPtr->pol.gdsf.priority is set to
+   *          L + (freq * cost / size).
+   *
+   *  Notes:  An entry with a size of zero is treated as one byte long.
+   *          The entry's priority must be updated in the heap afterward.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long size = ExtPtr->base.entry_size ? ExtPtr->base.entry_size : 1;
+
+  ExtPtr->pol.gdsf.priority = CachePtr->gdsf_age
+                            + (((double)ExtPtr->pol.gdsf.freq
+                              * (double)ExtPtr->pol.gdsf.cost)
+                               / (double)size);
+  } /* gdsf_priority */
+
+static unsigned long sample_random( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Return a random number, for the sampled policy.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *
+   *  Output: 32 random bits (a 32-bit xorshift), never zero.
+   *
+   *  Notes:  Each cache has its own state, which ubi_cacheInit() seeds
+   *          with a constant, so that runs can be repeated.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long x = CachePtr->sample_seed;
+
+  x ^= (x << 13) & 0xFFFFFFFFUL;
+  x ^= x >> 17;
+  x ^= (x << 5) & 0xFFFFFFFFUL;
+  CachePtr->sample_seed = x;
+  return( x );
+  } /* sample_random */
+
+static ubi_cacheEntryPtr sample_victim( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Choose a victim for the sampled policy.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *
+   *  Output: The entry that was used longest ago, of sample_size entries
+   *          picked at random from the slots, or NULL if there are none.
+   *
+   *  Notes:  Entries that did not fit into the slots are evicted first,
+   *          oldest first, skipping any that are pinned.  If the sample is
+   *          as large as the number of entries, all of them are checked
+   *          instead, and the result is exactly LRU (up to ties).  Pinned
+   *          entries are passed over unless the whole sample is pinned.
+   *          Ages are taken modulo 2^32 ticks of the clock.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheEntryPtr EntryPtr, Best = NULL;
+  ubi_dlNodePtr     p;
+  unsigned int      now = AccessClock( CachePtr );
+  unsigned int      age, best = 0;
+  unsigned long     i, n;
+
+  for( p = ubi_dlLast( &CachePtr->lru ); NULL != p; p = ubi_dlPrev( p ) )
+    if( 0 == LinkEntry( p )->refs )
+      return( LinkEntry( p ) );
+  if( 0 == CachePtr->slot_count )
+    return( ubi_dlCount( &CachePtr->lru )
+            ? LinkEntry( ubi_dlLast( &CachePtr->lru ) ) : NULL );
+  n = CachePtr->sample_size;
+  if( n >= CachePtr->slot_count )
+    n = CachePtr->slot_count;
+  for( i = 0; i < n; i++ )
+    {
+    if( n == CachePtr->slot_count )
+      EntryPtr = CachePtr->slots[i];
+    else
+      EntryPtr = CachePtr->slots[ sample_random( CachePtr )
+                                  % CachePtr->slot_count ];
+    age = (unsigned int)((now - ExtEntry( EntryPtr )->pol.smp.atime)
+                         & 0xFFFFFFFFUL);
+    if( (NULL == Best)
+     || ((0 != Best->refs) && (0 == EntryPtr->refs))
+     || ((age > best) && ((0 != Best->refs) || (0 == EntryPtr->refs))) )
+      {
+      Best = EntryPtr;
+      best = age;
+      }
+    }
+  return( Best );
+  } /* sample_victim */
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions shared with ubi_Cache.c...
+ */
+
+void ubi_cachePolicyInit( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Initialize the policy fields of a new cache.
+   *
+   *  Input:  CachePtr  - A pointer to the cache, from ubi_cacheInit().
+   *
+   *  Output: none.
+   *
+   *  Notes:  The policy starts out as ubi_cacheSPLAY, with no ghosts, no
+   *          slots, and no cost function.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  CachePtr->policy      = ubi_cacheSPLAY;
+  CachePtr->hand        = NULL;
+  CachePtr->hot_hand    = NULL;
+  CachePtr->hot         = 0;
+  CachePtr->arc_p       = 0;
+  (void)ubi_dlInitList( &CachePtr->lru );
+  (void)ubi_dlInitList( &CachePtr->t2 );
+  (void)ubi_dlInitList( &CachePtr->b1 );
+  (void)ubi_dlInitList( &CachePtr->b2 );
+  (void)ubi_dlInitList( &CachePtr->spare );
+  (void)ubi_btInitTree( &CachePtr->ghosts, ghost_cmp, 0 );
+  (void)ubi_hpInitHeap( &CachePtr->gdsf, gdsf_cmp );
+  CachePtr->gdsf_age    = 0.0;
+  CachePtr->cost_func   = NULL;
+  CachePtr->slots       = NULL;
+  CachePtr->slot_max    = 0;
+  CachePtr->slot_count  = 0;
+  CachePtr->sample_size = SAMPLE_SIZE;
+  CachePtr->sample_seed = SAMPLE_SEED;
+  } /* ubi_cachePolicyInit */
+
+void ubi_cachePolicyReset( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Forget all of the entries that the policy knows about.
+   *
+   *  Input:  CachePtr  - A pointer to a cache whose index is now empty.
+   *
+   *  Output: none.
+   *
+   *  Notes:  The ghosts are forgotten, too.  The policy's settings (the
+   *          ghosts' memory, the slots, the cost function, and the sample
+   *          size) are kept.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)ubi_dlInitList( &CachePtr->lru );
+  (void)ubi_dlInitList( &CachePtr->t2 );
+  (void)ubi_hpInitHeap( &CachePtr->gdsf, gdsf_cmp );
+  CachePtr->gdsf_age   = 0.0;
+  ghost_reset( CachePtr );
+  CachePtr->hand       = NULL;
+  CachePtr->hot_hand   = NULL;
+  CachePtr->hot        = 0;
+  CachePtr->slot_count = 0;
+  } /* ubi_cachePolicyReset */
+
+void ubi_cachePolicyInsert( ubi_cacheRootPtr  CachePtr,
+                            ubi_cacheEntryPtr EntryPtr )
+  /* ------------------------------------------------------------------------ **
+   * Tell the eviction policy about a new entry.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          EntryPtr  - A pointer to the entry, which has just been added
+   *                      to the tree.
+   *
+   *  Output: none.
+   *
+   *  Notes:  For ARC, EntryPtr->hash must already be set.
+   *          While ubi_cacheLoad() is running, the list policies put new
+   *          entries at the cold end instead, so that each one is older
+   *          than the ones loaded before it.  (The dump is hottest first.)
+   *          The sampled policy back-dates them for the same reason.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheEntryExtPtr ExtPtr = ExtEntry( EntryPtr );
+  ubi_cacheGhostPtr    Ghost;
+  ubi_cacheEntryPtr    Prev;
+  unsigned long        b1, b2, c, delta;
+
+  switch( CachePtr->policy )
+    {
+    case ubi_cacheLRU:
+      if( CachePtr->loading )
+        (void)ubi_dlAddTail( &CachePtr->lru, &EntryPtr->link );
+      else
+        (void)ubi_dlAddHead( &CachePtr->lru, &EntryPtr->link );
+      break;
+    case ubi_cacheCLOCK:
+    case ubi_cacheCLOCKPRO:
+      /* New entries go just behind the hand, so they are checked last.
+       * Loaded entries go in front of it, so they are checked first.
+       */
+      EntryPtr->flags = 0;
+      if( NULL == CachePtr->hand )
+        {
+        (void)ubi_dlAddHead( &CachePtr->lru, &EntryPtr->link );
+        CachePtr->hand = &EntryPtr->link;
+        }
+      else
+        {
+        (void)ubi_dlAddNext( &CachePtr->lru,
+                             &EntryPtr->link,
+                             ubi_dlPrev( CachePtr->hand ) );
+        if( CachePtr->loading )
+          CachePtr->hand = &EntryPtr->link;
+        }
+      break;
+    case ubi_cacheARC:
+      Ghost = CachePtr->loading
+            ? NULL
+            : (ubi_cacheGhostPtr)ubi_btFind( &CachePtr->ghosts,
+                                             &EntryPtr->hash );
+      if( NULL == Ghost )
+        {
+        EntryPtr->flags = 0;
+        if( CachePtr->loading )
+          (void)ubi_dlAddTail( &CachePtr->lru, &EntryPtr->link );
+        else
+          (void)ubi_dlAddHead( &CachePtr->lru, &EntryPtr->link );
+        break;
+        }
+      /* A ghost hit.  Adapt the target, and treat the key as reused. */
+      b1 = ubi_dlCount( &CachePtr->b1 );
+      b2 = ubi_dlCount( &CachePtr->b2 );
+      if( Ghost->list == &CachePtr->b1 )
+        {
+        delta = (b2 > b1) ? (b2 / b1) : 1;
+        c     = arc_size( CachePtr );
+        CachePtr->arc_p = ((CachePtr->arc_p + delta) < c)
+                        ? (CachePtr->arc_p + delta) : c;
+        }
+      else
+        {
+        delta = (b1 > b2) ? (b1 / b2) : 1;
+        CachePtr->arc_p = (CachePtr->arc_p > delta)
+                        ? (CachePtr->arc_p - delta) : 0;
+        }
+      ghost_drop( CachePtr, Ghost );
+      EntryPtr->flags = T2_BIT;
+      (void)ubi_dlAddHead( &CachePtr->t2, &EntryPtr->link );
+      break;
+    case ubi_cacheGDSF:
+      EntryPtr->flags = 0;
+      ExtPtr->pol.gdsf.freq = 1;
+      ExtPtr->pol.gdsf.cost = CachePtr->cost_func
+                      ? (*CachePtr->cost_func)( (ubi_trNodePtr)EntryPtr ) : 1;
+      if( 0 == ExtPtr->pol.gdsf.cost )
+        ExtPtr->pol.gdsf.cost = 1;
+      gdsf_priority( CachePtr, ExtPtr );
+      (void)ubi_hpInsert( &CachePtr->gdsf,
+                          ubi_hpInitNode( &ExtPtr->pol.gdsf.heap ) );
+      break;
+    case ubi_cacheSAMPLED:
+      /* A loaded entry is made a tick older than the one before it. */
+      EntryPtr->flags = 0;
+      ExtPtr->pol.smp.atime = AccessClock( CachePtr );
+      if( CachePtr->loading && CachePtr->slot_count )
+        {
+        Prev = CachePtr->slots[ CachePtr->slot_count - 1 ];
+        ExtPtr->pol.smp.atime = (unsigned int)
+                    ((ExtEntry( Prev )->pol.smp.atime - 1) & 0xFFFFFFFFUL);
+        }
+      if( CachePtr->slot_count < CachePtr->slot_max )
+        {
+        ExtPtr->pol.smp.slot = CachePtr->slot_count;
+        CachePtr->slots[ CachePtr->slot_count++ ] = EntryPtr;
+        }
+      else
+        {
+        ExtPtr->pol.smp.slot = NO_SLOT;
+        (void)ubi_dlAddHead( &CachePtr->lru, &EntryPtr->link );
+        }
+      break;
+    default:
+      break;
+    }
+  } /* ubi_cachePolicyInsert */
+
+void ubi_cachePolicyTouch( ubi_cacheRootPtr  CachePtr,
+                           ubi_cacheEntryPtr EntryPtr )
+  /* ------------------------------------------------------------------------ **
+   * Tell the eviction policy that an entry has been used.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          EntryPtr  - A pointer to the entry that was found.
+   *
+   *  Output: none.
+   *
+   *  Notes:  The splay policy needs nothing here; the lookup has already
+   *          splayed the entry to the top of the tree.  The CLOCK policies
+   *          only set the reference bit, and the sampled policy only
+   *          stamps the entry (if the stamp has changed).  Entries in the
+   *          TinyLFU window are not yet known to the policy, and are
+   *          handled here.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheEntryExtPtr ExtPtr = ExtEntry( EntryPtr );
+
+  if( EntryPtr->flags & WIN_BIT )
+    {
+    if( ubi_dlFirst( &CachePtr->window ) != &EntryPtr->link )
+      {
+      (void)ubi_dlRemThis( &CachePtr->window, &EntryPtr->link );
+      (void)ubi_dlAddHead( &CachePtr->window, &EntryPtr->link );
+      }
+    return;
+    }
+
+  switch( CachePtr->policy )
+    {
+    case ubi_cacheLRU:
+      if( ubi_dlFirst( &CachePtr->lru ) != &EntryPtr->link )
+        {
+        (void)ubi_dlRemThis( &CachePtr->lru, &EntryPtr->link );
+        (void)ubi_dlAddHead( &CachePtr->lru, &EntryPtr->link );
+        }
+      break;
+    case ubi_cacheCLOCK:
+    case ubi_cacheCLOCKPRO:
+      if( !(EntryPtr->flags & REF_BIT) )
+        EntryPtr->flags |= REF_BIT;
+      break;
+    case ubi_cacheARC:
+      if( EntryPtr->flags & T2_BIT )
+        (void)ubi_dlRemThis( &CachePtr->t2, &EntryPtr->link );
+      else
+        {
+        (void)ubi_dlRemThis( &CachePtr->lru, &EntryPtr->link );
+        EntryPtr->flags = T2_BIT;
+        }
+      (void)ubi_dlAddHead( &CachePtr->t2, &EntryPtr->link );
+      break;
+    case ubi_cacheGDSF:
+      ExtPtr->pol.gdsf.freq++;
+      gdsf_priority( CachePtr, ExtPtr );
+      ubi_hpUpdate( &CachePtr->gdsf, &ExtPtr->pol.gdsf.heap );
+      break;
+    case ubi_cacheSAMPLED:
+      if( ExtPtr->pol.smp.atime != AccessClock( CachePtr ) )
+        ExtPtr->pol.smp.atime = AccessClock( CachePtr );
+      break;
+    default:
+      break;
+    }
+  } /* ubi_cachePolicyTouch */
+
+void ubi_cachePolicyRemove( ubi_cacheRootPtr  CachePtr,
+                            ubi_cacheEntryPtr EntryPtr )
+  /* ------------------------------------------------------------------------ **
+   * Tell the eviction policy that an entry is leaving the cache.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          EntryPtr  - A pointer to the entry, which has been (or is about
+   *                      to be) removed from the tree.
+   *
+   *  Output: none.
+   *
+   *  Notes:  The sampled policy fills the entry's slot with the entry in
+   *          the last slot, so that the slots in use stay contiguous.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheEntryExtPtr ExtPtr = ExtEntry( EntryPtr );
+  ubi_cacheEntryPtr    Last;
+  ubi_dlNodePtr        p;
+
+  if( EntryPtr->flags & WIN_BIT )
+    {
+    (void)ubi_dlRemThis( &CachePtr->window, &EntryPtr->link );
+    return;
+    }
+
+  switch( CachePtr->policy )
+    {
+    case ubi_cacheLRU:
+      (void)ubi_dlRemThis( &CachePtr->lru, &EntryPtr->link );
+      break;
+    case ubi_cacheCLOCK:
+    case ubi_cacheCLOCKPRO:
+      /* Move the hands off of the entry before unlinking it. */
+      p = (ubi_dlCount( &CachePtr->lru ) > 1)
+        ? clock_next( &CachePtr->lru, &EntryPtr->link ) : NULL;
+      if( CachePtr->hand == &EntryPtr->link )
+        CachePtr->hand = p;
+      if( CachePtr->hot_hand == &EntryPtr->link )
+        CachePtr->hot_hand = p;
+      if( EntryPtr->flags & HOT_BIT )
+        CachePtr->hot--;
+      (void)ubi_dlRemThis( &CachePtr->lru, &EntryPtr->link );
+      break;
+    case ubi_cacheARC:
+      (void)ubi_dlRemThis( (EntryPtr->flags & T2_BIT) ? &CachePtr->t2
+                                                      : &CachePtr->lru,
+                           &EntryPtr->link );
+      break;
+    case ubi_cacheGDSF:
+      (void)ubi_hpRemove( &CachePtr->gdsf, &ExtPtr->pol.gdsf.heap );
+      break;
+    case ubi_cacheSAMPLED:
+      if( NO_SLOT == ExtPtr->pol.smp.slot )
+        {
+        (void)ubi_dlRemThis( &CachePtr->lru, &EntryPtr->link );
+        break;
+        }
+      Last = CachePtr->slots[ --CachePtr->slot_count ];
+      ExtEntry( Last )->pol.smp.slot = ExtPtr->pol.smp.slot;
+      CachePtr->slots[ ExtPtr->pol.smp.slot ] = Last;
+      break;
+    default:
+      break;
+    }
+  } /* ubi_cachePolicyRemove */
+
+void ubi_cachePolicyEvicted( ubi_cacheRootPtr  CachePtr,
+                             ubi_cacheEntryPtr EntryPtr )
+  /* ------------------------------------------------------------------------ **
+   * Tell the eviction policy that an entry has been evicted.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          EntryPtr  - A pointer to the entry, which has already been
+   *                      passed to ubi_cachePolicyRemove() but not yet freed.
+   *
+   *  Output: none.
+   *
+   *  Notes:  Entries that are deleted or overwritten are not evicted, and
+   *          don't come through here.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( EntryPtr->flags & WIN_BIT )
+    return;
+
+  switch( CachePtr->policy )
+    {
+    case ubi_cacheARC:
+      ghost_add( CachePtr, EntryPtr, (EntryPtr->flags & T2_BIT)
+                                     ? &CachePtr->b2 : &CachePtr->b1 );
+      break;
+    case ubi_cacheGDSF:
+      /* Inflate L, so that entries added from now on outrank the ones
+       * that have not been used for a while.
+       */
+      CachePtr->gdsf_age = ExtEntry( EntryPtr )->pol.gdsf.priority;
+      break;
+    default:
+      break;
+    }
+  } /* ubi_cachePolicyEvicted */
+
+ubi_cacheEntryPtr ubi_cachePolicyVictim( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Choose an entry to be evicted.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *
+   *  Output: A pointer to the entry that should be evicted next, or NULL
+   *          if the cache is empty.  The entry is not removed.
+   *
+   *  Notes:  The CLOCK hand gives each referenced entry a second chance,
+   *          so it will go around the circle at most once (plus one step)
+   *          before finding a victim.  The CLOCK-Pro hand skips hot
+   *          entries, and promotes referenced cold entries to hot.  At
+   *          least one entry is always cold, so that loop ends, too.
+   *          ARC evicts from the end of T1 or T2, depending upon whether
+   *          T1 is longer than its target length.  See sample_victim()
+   *          for the sampled policy.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheEntryPtr EntryPtr;
+  ubi_dlNodePtr     p;
+
+  switch( CachePtr->policy )
+    {
+    case ubi_cacheLRU:
+      p = ubi_dlLast( &CachePtr->lru );
+      return( p ? LinkEntry( p ) : NULL );
+    case ubi_cacheCLOCK:
+      while( NULL != (p = CachePtr->hand) )
+        {
+        EntryPtr = LinkEntry( p );
+        if( !(EntryPtr->flags & REF_BIT) )
+          return( EntryPtr );
+        EntryPtr->flags &= ~REF_BIT;
+        CachePtr->hand = clock_next( &CachePtr->lru, p );
+        }
+      return( NULL );
+    case ubi_cacheCLOCKPRO:
+      clock_cool( CachePtr );
+      while( NULL != (p = CachePtr->hand) )
+        {
+        EntryPtr = LinkEntry( p );
+        if( !(EntryPtr->flags & (HOT_BIT | REF_BIT)) )
+          return( EntryPtr );
+        CachePtr->hand = clock_next( &CachePtr->lru, p );
+        if( !(EntryPtr->flags & HOT_BIT) )
+          {
+          /* Used again while cold: promote it. */
+          EntryPtr->flags = HOT_BIT;
+          CachePtr->hot++;
+          clock_cool( CachePtr );
+          }
+        }
+      return( NULL );
+    case ubi_cacheARC:
+      /* Evict from T1 if it is longer than its target, else from T2. */
+      if( ubi_dlCount( &CachePtr->lru )
+       && ((ubi_dlCount( &CachePtr->lru ) > CachePtr->arc_p)
+        || (0 == ubi_dlCount( &CachePtr->t2 ))) )
+        p = ubi_dlLast( &CachePtr->lru );
+      else
+        p = ubi_dlLast( &CachePtr->t2 );
+      return( p ? LinkEntry( p ) : NULL );
+    case ubi_cacheGDSF:
+      return( ubi_hpFirst( &CachePtr->gdsf )
+              ? HeapEntry( ubi_hpFirst( &CachePtr->gdsf ) ) : NULL );
+    case ubi_cacheSAMPLED:
+      return( sample_victim( CachePtr ) );
+    default:
+      return( (ubi_cacheEntryPtr)ubi_trLeafNode( CachePtr->root.root ) );
+    }
+  } /* ubi_cachePolicyVictim */
+
+void ubi_cachePolicyPassOver( ubi_cacheRootPtr  CachePtr,
+                              ubi_cacheEntryPtr EntryPtr,
+                              ubi_dlListPtr     Passed )
+  /* ------------------------------------------------------------------------ **
+   * Move a pinned entry out of the way of the eviction policy.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          EntryPtr  - A pinned entry, chosen as a victim.
+   *          Passed    - A list for GDSF entries that are passed over.
+   *
+   *  Output: none.
+   *
+   *  Notes:  Being passed over is not a use of the entry, so the policy's
+   *          statistics are left alone.  The entry is only moved to where
+   *          it won't be chosen next:
+   *          - The LRU lists (including ARC's T1 and T2, and the TinyLFU
+   *            window) move it to their most recent end.  An ARC entry
+   *            stays on the list that it was on.
+   *          - The CLOCK hands step past it, without setting its reference
+   *            bit.  (CLOCK-Pro would promote a referenced cold entry.)
+   *          - GDSF takes it out of the heap and adds it to Passed.  The
+   *            caller must put it back with ubi_cachePolicyPassDone() once
+   *            the evictions are over, since its priority may well still be
+   *            the lowest.
+   *          - The splay policy splays it, so that it is not the leaf
+   *            found next time.
+   *          - The sampled policy needs nothing; sample_victim() only
+   *            returns a pinned entry if it found no other.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( ubi_cacheSPLAY == CachePtr->policy )
+    {
+    ubi_trSplay( CachePtr, EntryPtr );
+    return;
+    }
+  if( EntryPtr->flags & WIN_BIT )
+    {
+    (void)ubi_dlRemThis( &CachePtr->window, &EntryPtr->link );
+    (void)ubi_dlAddHead( &CachePtr->window, &EntryPtr->link );
+    return;
+    }
+
+  switch( CachePtr->policy )
+    {
+    case ubi_cacheLRU:
+      (void)ubi_dlRemThis( &CachePtr->lru, &EntryPtr->link );
+      (void)ubi_dlAddHead( &CachePtr->lru, &EntryPtr->link );
+      break;
+    case ubi_cacheCLOCK:
+    case ubi_cacheCLOCKPRO:
+      CachePtr->hand = clock_next( &CachePtr->lru, &EntryPtr->link );
+      break;
+    case ubi_cacheARC:
+      if( EntryPtr->flags & T2_BIT )
+        {
+        (void)ubi_dlRemThis( &CachePtr->t2, &EntryPtr->link );
+        (void)ubi_dlAddHead( &CachePtr->t2, &EntryPtr->link );
+        }
+      else
+        {
+        (void)ubi_dlRemThis( &CachePtr->lru, &EntryPtr->link );
+        (void)ubi_dlAddHead( &CachePtr->lru, &EntryPtr->link );
+        }
+      break;
+    case ubi_cacheGDSF:
+      (void)ubi_hpRemove( &CachePtr->gdsf,
+                          &ExtEntry( EntryPtr )->pol.gdsf.heap );
+      (void)ubi_dlAddTail( Passed, &EntryPtr->link );
+      break;
+    default:
+      break;
+    }
+  } /* ubi_cachePolicyPassOver */
+
+void ubi_cachePolicyPassDone( ubi_cacheRootPtr CachePtr,
+                              ubi_dlListPtr    Passed )
+  /* ------------------------------------------------------------------------ **
+   * Put the GDSF entries that were passed over back into the heap.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *          Passed    - The list filled in by ubi_cachePolicyPassOver().
+   *
+   *  Output: none.
+   *
+   *  Notes:  Each entry's priority is recomputed from the current value of
+   *          L (gdsf_age), which the evictions have raised, and its own
+   *          use count, which is not changed.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheEntryExtPtr ExtPtr;
+
+  while( ubi_dlCount( Passed ) )
+    {
+    ExtPtr = ExtEntry( LinkEntry( ubi_dlRemHead( Passed ) ) );
+    gdsf_priority( CachePtr, ExtPtr );
+    (void)ubi_hpInsert( &CachePtr->gdsf, &ExtPtr->pol.gdsf.heap );
+    }
+  } /* ubi_cachePolicyPassDone */
+
+
+/* -------------------------------------------------------------------------- **
+ * Exported functions...
+ */
+
+ubi_trBool ubi_cacheSetPolicy( ubi_cacheRootPtr CachePtr, int Policy )
+  /** Select the eviction policy used to trim the cache.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Policy    One of:
+   *                    - \c #ubi_cacheSPLAY - Remove leaves from the bottom
+   *                      of the splay tree.  This is the default.
+   *                    - \c #ubi_cacheLRU - Remove the least recently used
+   *                      entry, using a list that is kept in order of use.
+   *                    - \c #ubi_cacheCLOCK - Sweep a clock hand around the
+   *                      entries, removing the first one that has not been
+   *                      used since the hand last passed it.
+   *                    - \c #ubi_cacheCLOCKPRO - As CLOCK, but entries that
+   *                      are used again soon after they are added become
+   *                      hot, and only cold entries are removed.
+   *                    - \c #ubi_cacheARC - Adaptive Replacement Cache.
+   *                      Requires a hash function; see
+   *                      \c #ubi_cacheSetHashFunc().  Without ghosts (see
+   *                      \c #ubi_cacheSetGhosts()), ARC cannot adapt.
+   *                    - \c #ubi_cacheGDSF - Remove the entry with the
+   *                      lowest GreedyDual-Size-Frequency priority.  See
+   *                      \c #ubi_cacheSetCostFunc().  Requires extended
+   *                      entries; see \c #ubi_cacheSetExtended().
+   *                    - \c #ubi_cacheSAMPLED - Remove the least recently
+   *                      used of a few entries picked at random.  Requires
+   *                      slots (see \c #ubi_cacheSetSlots()) and extended
+   *                      entries.
+   *
+   * @returns TRUE if the policy was set, or FALSE if the cache is not empty,
+   *          \p Policy is not recognized, \p Policy is ARC and there
+   *          is no hash function, \p Policy is SPLAY and the index is
+   *          not a splay tree, \p Policy is SAMPLED and there are no
+   *          slots, or \p Policy is GDSF or SAMPLED and the entries are
+   *          not extended.
+   *
+   * \b Note: The policy may only be changed while the cache is empty.
+   */
+  {
+  if( (0 != ubi_cacheGetEntryCount( CachePtr )) || (Policy < ubi_cacheSPLAY)
+   || (Policy > ubi_cacheSAMPLED)
+   || ((ubi_cacheARC == Policy) && (NULL == CachePtr->hash_func))
+   || ((ubi_cacheSAMPLED == Policy) && (0 == CachePtr->slot_max))
+   || (((ubi_cacheGDSF == Policy) || (ubi_cacheSAMPLED == Policy))
+    && !CachePtr->extended)
+   || ((ubi_cacheSPLAY == Policy)
+    && (ubi_cacheINDEX_SPLAY != CachePtr->index)) )
+    return( ubi_trFALSE );
+  CachePtr->policy = Policy;
+  ubi_cachePolicyReset( CachePtr );
+  return( ubi_trTRUE );
+  } /* ubi_cacheSetPolicy */
+
+void ubi_cacheSetCostFunc( ubi_cacheRootPtr  CachePtr,
+                           ubi_cacheCostFunc CostFunc )
+  /** Give the GDSF eviction policy a way to find the cost of an entry.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   CostFunc  The cost function, or NULL to give every entry a
+   *                    cost of 1.
+   *
+   * \b Notes:
+   *  - The cost function is called once for each entry, when it is added
+   *    to the policy, and the result is kept in the entry's \c cost field.
+   *    Changing the cost function does not change the cost of entries
+   *    that are already in the cache.
+   *  - With a cost of 1, GDSF tries to maximize the number of hits.  To
+   *    maximize the number of bytes served from the cache instead, return
+   *    the entry's \c entry_size.  To save on load time (or on requests
+   *    to a backend that charges for them), return that.
+   *  - Only the GDSF policy uses the cost.
+   */
+  {
+  CachePtr->cost_func = CostFunc;
+  } /* ubi_cacheSetCostFunc */
+
+ubi_trBool ubi_cacheSetGhosts( ubi_cacheRootPtr  CachePtr,
+                               ubi_cacheGhostPtr Ghosts,
+                               unsigned long     Count )
+  /** Provide memory for the ARC policy's ghost lists.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Ghosts    An array of \p Count ghost structures.
+   * @param   Count     The number of ghosts.  Zero removes the ghosts.
+   *
+   * @returns TRUE if the ghosts were set, or FALSE if the cache is not
+   *          empty.
+   *
+   * \b Notes:
+   *  - ARC remembers as many as c evicted keys, where c is the maximum
+   *    number of entries.  A \p Count equal to the maximum number of
+   *    entries is ideal.  With fewer ghosts, the oldest are forgotten
+   *    early and ARC adapts more slowly.
+   *  - The ghosts are only used by the ARC policy.
+   */
+  {
+  unsigned long i;
+
+  if( 0 != ubi_cacheGetEntryCount( CachePtr ) )
+    return( ubi_trFALSE );
+  (void)ubi_dlInitList( &CachePtr->b1 );
+  (void)ubi_dlInitList( &CachePtr->b2 );
+  (void)ubi_dlInitList( &CachePtr->spare );
+  (void)ubi_btInitTree( &CachePtr->ghosts, ghost_cmp, 0 );
+  for( i = 0; i < Count; i++ )
+    {
+    Ghosts[i].list = &CachePtr->spare;
+    (void)ubi_dlAddTail( &CachePtr->spare, &Ghosts[i].link );
+    }
+  CachePtr->arc_p = 0;
+  return( ubi_trTRUE );
+  } /* ubi_cacheSetGhosts */
+
+ubi_trBool ubi_cacheSetSlots( ubi_cacheRootPtr   CachePtr,
+                              ubi_cacheEntryPtr *Slots,
+                              unsigned long      Count )
+  /** Provide memory for the sampled policy's array of entries.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Slots     An array of \p Count entry pointers.
+   * @param   Count     The number of slots.  Zero removes the slots.
+   *
+   * @returns TRUE if the slots were set, or FALSE if the cache is not
+   *          empty, or if \p Count is zero and the policy is
+   *          \c #ubi_cacheSAMPLED.
+   *
+   * \b Notes:
+   *  - The sampled policy picks its samples from this array, so every
+   *    entry needs a slot.  Give the cache as many slots as it can have
+   *    entries.  If it runs out, the entries that did not get a slot are
+   *    evicted before any others, oldest first.
+   *  - A cache that is limited only by memory can hold as many entries as
+   *    fit; allow for the smallest entries.
+   *  - The slots are only used by the sampled policy.
+   */
+  {
+  if( (0 != ubi_cacheGetEntryCount( CachePtr ))
+   || ((0 == Count) && (ubi_cacheSAMPLED == CachePtr->policy)) )
+    return( ubi_trFALSE );
+  CachePtr->slots      = Count ? Slots : NULL;
+  CachePtr->slot_max   = Count;
+  CachePtr->slot_count = 0;
+  (void)ubi_dlInitList( &CachePtr->lru );
+  return( ubi_trTRUE );
+  } /* ubi_cacheSetSlots */
+
+unsigned long ubi_cacheSetSampleSize( ubi_cacheRootPtr CachePtr,
+                                      unsigned long    Size )
+  /** Set the number of entries that the sampled policy compares.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   Size      The number of entries picked at random for each
+   *                    eviction.  Zero restores the default of 5.
+   *
+   * @returns The previous sample size.
+   *
+   * \b Notes:
+   *  - The least recently used entry of the sample is evicted.  A larger
+   *    sample comes closer to true LRU, and costs more per eviction.  A
+   *    sample of 1 is random eviction.  With a sample at least as large as
+   *    the cache, every entry is checked, and the policy is exact LRU at
+   *    O(n) per eviction.
+   *  - Unlike most settings, the sample size may be changed at any time.
+   *  - The samples are taken with replacement, so an entry may be picked
+   *    twice for the same eviction.
+   */
+  {
+  unsigned long oldsize = CachePtr->sample_size;
+
+  CachePtr->sample_size = Size ? Size : SAMPLE_SIZE;
+  return( oldsize );
+  } /* ubi_cacheSetSampleSize */
+
+/* ================================ The End ================================= */
@@ -0,0 +1,384 @@
+/* ========================================================================== **
+ *                              ubi_CachePool.c
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module lets several ubi_Caches share one memory budget.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ */
+
+#include <stddef.h>           /* offsetof() */
+#include "ubi_CachePool.h"    /* Header for *this* module. */
+#include "ubi_CachePriv.h"    /* Shared with the rest of the cache. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ *
+ *  NodeMember  - Given a pointer to the heap node of a pool member, return
+ *                a pointer to the member.
+ *  LinkMember  - The same, for the member list link.
+ */
+
+#define NodeMember( H ) \
+  ((ubi_cachePoolMemberPtr)((char *)(H) \
+                            - offsetof( ubi_cachePoolMember, node )))
+
+#define LinkMember( L ) \
+  ((ubi_cachePoolMemberPtr)((char *)(L) \
+                            - offsetof( ubi_cachePoolMember, link )))
+
+
+/* -------------------------------------------------------------------------- **
+ * Internal functions...
+ */
+
+static int pool_cmp( ubi_hpNodePtr A, ubi_hpNodePtr B )
+  /* ------------------------------------------------------------------------ **
+   * Compare the value of the memory held by two pool members.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  double VA = NodeMember( A )->value;
+  double VB = NodeMember( B )->value;
+
+  return( (VA < VB) ? -1 : ((VA > VB) ? 1 : 0) );
+  } /* pool_cmp */
+
+static void pool_fix( ubi_cachePoolMemberPtr MemberPtr )
+  /* ------------------------------------------------------------------------ **
+   * Update a member's place in its pool's heap.
+   *
+   *  Input:  MemberPtr - A pointer to a pool member whose memory use or
+   *                      weight may have changed.
+   *
+   *  Output: none.
+   *
+   *  Notes:  The value of the member's memory is its weight divided by
+   *          the memory it uses.  A member at or below its minimum share
+   *          is taken out of the heap, so that the pool never evicts
+   *          from it.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cachePoolPtr PoolPtr = MemberPtr->pool;
+  unsigned long    used    = MemberPtr->cache->mem_used;
+  double           old     = MemberPtr->value;
+
+  if( used <= MemberPtr->min )
+    {
+    if( MemberPtr->listed )
+      {
+      (void)ubi_hpRemove( &PoolPtr->heap, &MemberPtr->node );
+      MemberPtr->listed = ubi_trFALSE;
+      }
+    return;
+    }
+  MemberPtr->value = MemberPtr->weight / (double)used;
+  if( !MemberPtr->listed )
+    {
+    (void)ubi_hpInsert( &PoolPtr->heap, &MemberPtr->node );
+    MemberPtr->listed = ubi_trTRUE;
+    }
+  else if( MemberPtr->value < old )
+    ubi_hpDecrease( &PoolPtr->heap, &MemberPtr->node );
+  else if( MemberPtr->value > old )
+    ubi_hpUpdate( &PoolPtr->heap, &MemberPtr->node );
+  } /* pool_fix */
+
+static void pool_trim( ubi_cachePoolPtr PoolPtr )
+  /* ------------------------------------------------------------------------ **
+   * Evict from the members of a pool until it is within its budget.
+   *
+   *  Input:  PoolPtr - A pointer to the pool.
+   *
+   *  Output: None.
+   *
+   *  Notes:  Each entry is taken from the member whose memory is worth the
+   *          least, as chosen by that member's own eviction policy.  The
+   *          victim's value goes up as it shrinks, so the evictions are
+   *          spread out once it is no longer the cheapest.  Members at or
+   *          below their minimum share are not in the heap, so the pool
+   *          may stay over budget if only they (or pinned entries) are
+   *          left.  A member whose entries are all pinned is dropped from
+   *          the heap until its memory use next changes.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cachePoolMemberPtr MemberPtr;
+
+  while( (PoolPtr->used > PoolPtr->budget)
+      && (NULL != ubi_hpFirst( &PoolPtr->heap )) )
+    {
+    MemberPtr = NodeMember( ubi_hpFirst( &PoolPtr->heap ) );
+    if( !ubi_cacheEvict( MemberPtr->cache, 1, ubi_cacheEVICT_POOL )
+     && MemberPtr->listed )
+      {
+      (void)ubi_hpRemove( &PoolPtr->heap, &MemberPtr->node );
+      MemberPtr->listed = ubi_trFALSE;
+      }
+    }
+  } /* pool_trim */
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions shared with ubi_Cache.c...
+ */
+
+void ubi_cachePoolCharge( ubi_cacheRootPtr CachePtr,
+                          unsigned long    Added,
+                          unsigned long    Removed )
+  /* ------------------------------------------------------------------------ **
+   * Charge a change in a member's memory use to its pool.
+   *
+   *  Input:  CachePtr  - A pointer to a cache that is in a pool.  Its
+   *                      mem_used field has already been updated.
+   *          Added     - The memory that the cache has taken.
+   *          Removed   - The memory that it has given back.
+   *
+   *  Output: none.
+   *
+   *  Notes:  The pool is not trimmed here; see ubi_cachePoolTrim().
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cachePoolMemberPtr MemberPtr = CachePtr->pool;
+
+  MemberPtr->pool->used += Added;
+  MemberPtr->pool->used -= Removed;
+  pool_fix( MemberPtr );
+  } /* ubi_cachePoolCharge */
+
+void ubi_cachePoolTrim( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Bring the pool that a cache is in within its budget.
+   *
+   *  Input:  CachePtr  - A pointer to a cache that is in a pool.
+   *
+   *  Output: none.
+   *
+   *  Notes:  The entries may be evicted from any member, not just this
+   *          one.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  pool_trim( CachePtr->pool->pool );
+  } /* ubi_cachePoolTrim */
+
+
+/* -------------------------------------------------------------------------- **
+ * Exported functions...
+ */
+
+ubi_cachePoolPtr ubi_cachePoolInit( ubi_cachePoolPtr PoolPtr,
+                                   unsigned long    Budget )
+  /** Initialize a pool, which shares one memory budget among several caches.
+   *
+   * @param   PoolPtr   A pointer to the \c #ubi_cachePool to initialize.
+   * @param   Budget    The memory that the member caches may use between
+   *                    them, in the same units as their \c entry_size.
+   *
+   * @returns A pointer to the pool (i.e., the same as \p PoolPtr).
+   *
+   * \b Notes:
+   *  - With a fixed \c max_memory per cache, idle caches hold on to memory
+   *    that busy ones could use.  A pool lets each member grow as long as
+   *    the total fits the budget.  When a put takes the pool over budget,
+   *    entries are evicted from the member whose memory is worth the
+   *    least: the one expected to lose the fewest hits per byte freed.
+   *    Each member's own eviction policy picks the entries.
+   *  - The value of a member's memory is re-estimated by
+   *    \c #ubi_cachePoolUpdate(), which should be called now and then.
+   *  - The pool and all of its members must be protected by one lock (or
+   *    used by one thread), since a put to one member may evict from
+   *    another.
+   */
+  {
+  (void)ubi_dlInitList( &PoolPtr->members );
+  (void)ubi_hpInitHeap( &PoolPtr->heap, pool_cmp );
+  PoolPtr->budget   = Budget;
+  PoolPtr->used     = 0;
+  PoolPtr->reserved = 0;
+  return( PoolPtr );
+  } /* ubi_cachePoolInit */
+
+ubi_trBool ubi_cachePoolAdd( ubi_cachePoolPtr       PoolPtr,
+                             ubi_cachePoolMemberPtr MemberPtr,
+                             ubi_cacheRootPtr       CachePtr,
+                             unsigned long          MinShare,
+                             unsigned long          MaxShare )
+  /** Add a cache to a pool.
+   *
+   * @param   PoolPtr   A pointer to the pool.
+   * @param   MemberPtr A pointer to the \c #ubi_cachePoolMember that will
+   *                    hold the cache's membership.  It must not be moved
+   *                    or reused until the cache leaves the pool.
+   * @param   CachePtr  A pointer to the cache, which need not be empty.
+   * @param   MinShare  The pool will not evict from the cache while it uses
+   *                    this much memory or less.
+   * @param   MaxShare  If nonzero, the cache's own memory limit (see
+   *                    \c #ubi_cacheSetMaxMemory()).  If zero, the limit is
+   *                    left as it is.
+   *
+   * @returns TRUE on success, or FALSE if the cache is already in a pool,
+   *          if \p MaxShare is below \p MinShare, or if the minimum shares
+   *          of the members would add up to more than the budget.
+   *
+   * \b Notes:
+   *  - The memory that the cache already uses is charged to the pool, and
+   *    the pool is trimmed if that takes it over budget.
+   *  - Until the first \c #ubi_cachePoolUpdate(), the cache's memory has
+   *    no value, and it is the first to be evicted from.
+   */
+  {
+  if( CachePtr->pool
+   || (MaxShare && (MaxShare < MinShare))
+   || (MinShare > (PoolPtr->budget - PoolPtr->reserved))
+   || (PoolPtr->reserved > PoolPtr->budget) )
+    return( ubi_trFALSE );
+
+  (void)ubi_dlAddTail( &PoolPtr->members, &MemberPtr->link );
+  PoolPtr->used      += CachePtr->mem_used;
+  PoolPtr->reserved  += MinShare;
+  MemberPtr->cache    = CachePtr;
+  MemberPtr->pool     = PoolPtr;
+  MemberPtr->listed   = ubi_trFALSE;
+  MemberPtr->min      = MinShare;
+  MemberPtr->weight   = 0.0;
+  MemberPtr->value    = 0.0;
+  MemberPtr->lookups  = CachePtr->stats.lookups;
+  MemberPtr->hits     = CachePtr->stats.hits;
+  CachePtr->pool      = MemberPtr;
+  pool_fix( MemberPtr );
+  if( MaxShare )
+    (void)ubi_cacheSetMaxMemory( CachePtr, MaxShare );
+  pool_trim( PoolPtr );
+  return( ubi_trTRUE );
+  } /* ubi_cachePoolAdd */
+
+void ubi_cachePoolRemove( ubi_cacheRootPtr CachePtr )
+  /** Take a cache out of its pool.
+   *
+   * @param   CachePtr  A pointer to the cache.  If it is not in a pool,
+   *                    nothing happens.
+   *
+   * \b Note: The cache keeps its entries, and its memory limit.  Its
+   *          \c #ubi_cachePoolMember is no longer needed.
+   */
+  {
+  ubi_cachePoolMemberPtr MemberPtr = CachePtr->pool;
+  ubi_cachePoolPtr       PoolPtr;
+
+  if( NULL == MemberPtr )
+    return;
+  PoolPtr = MemberPtr->pool;
+  if( MemberPtr->listed )
+    (void)ubi_hpRemove( &PoolPtr->heap, &MemberPtr->node );
+  (void)ubi_dlRemThis( &PoolPtr->members, &MemberPtr->link );
+  PoolPtr->used     -= CachePtr->mem_used;
+  PoolPtr->reserved -= MemberPtr->min;
+  MemberPtr->listed  = ubi_trFALSE;
+  CachePtr->pool     = NULL;
+  } /* ubi_cachePoolRemove */
+
+unsigned long ubi_cachePoolSetBudget( ubi_cachePoolPtr PoolPtr,
+                                      unsigned long    Budget )
+  /** Change the memory budget of a pool.
+   *
+   * @param   PoolPtr   A pointer to the pool.
+   * @param   Budget    The new budget.
+   *
+   * @returns The previous budget.
+   *
+   * \b Note: If the pool is over the new budget, it is trimmed.  The
+   *          members are not trimmed below their minimum shares, so the
+   *          pool stays over a budget that is less than their sum.
+   */
+  {
+  unsigned long old = PoolPtr->budget;
+
+  PoolPtr->budget = Budget;
+  pool_trim( PoolPtr );
+  return( old );
+  } /* ubi_cachePoolSetBudget */
+
+void ubi_cachePoolUpdate( ubi_cachePoolPtr PoolPtr )
+  /** Re-estimate the value of the memory held by each member of a pool.
+   *
+   * @param   PoolPtr   A pointer to the pool.
+   *
+   * \b Notes:
+   *  - The value of a member's memory is the number of hits that it would
+   *    lose per byte, if it were made smaller.  For a member with a miss
+   *    ratio curve (see \c #ubi_cacheSetMissRatio()), that is read from
+   *    the slope of the curve over the last eighth of the memory it uses,
+   *    times the number of lookups since the last update.  That is the
+   *    true marginal value: a cache whose hits all come from a few hot
+   *    entries has little to lose.  Without a curve, the member's hits
+   *    since the last update are spread over all of its memory, which
+   *    overrates such a cache, but still favors busy caches over idle
+   *    ones.
+   *  - Each estimate is averaged with the previous one, so that a single
+   *    quiet interval does not give a member's memory away.  Between
+   *    updates, a member's value moves with its memory use.
+   *  - Call this at a regular interval, such as every
+   *    \c #ubi_cacheSAMPLE_SECS seconds.  It costs two passes over the
+   *    curve of each member that has one.
+   */
+  {
+  ubi_dlNodePtr          Link;
+  ubi_cachePoolMemberPtr MemberPtr;
+  ubi_cacheRootPtr       CachePtr;
+  unsigned long          step;
+  double                 gain;
+  int                    slope;
+
+  for( Link = ubi_dlFirst( &PoolPtr->members );
+       NULL != Link;
+       Link = ubi_dlNext( Link ) )
+    {
+    MemberPtr = LinkMember( Link );
+    CachePtr  = MemberPtr->cache;
+    gain = (double)(CachePtr->stats.hits - MemberPtr->hits);
+    step = CachePtr->mem_used / 8;
+    if( CachePtr->mrc && (CachePtr->mrc->refs > 0.0) && step )
+      {
+      slope = ubi_mrcHitRatio( CachePtr->mrc, CachePtr->max_entries,
+                               CachePtr->mem_used )
+            - ubi_mrcHitRatio( CachePtr->mrc, CachePtr->max_entries,
+                               CachePtr->mem_used - step );
+      gain  = (slope > 0) ? ((double)slope * 8.0 / 10000.0) : 0.0;
+      gain *= (double)(CachePtr->stats.lookups - MemberPtr->lookups);
+      }
+    MemberPtr->lookups = CachePtr->stats.lookups;
+    MemberPtr->hits    = CachePtr->stats.hits;
+    MemberPtr->weight  = (MemberPtr->weight + gain) / 2.0;
+    pool_fix( MemberPtr );
+    }
+  } /* ubi_cachePoolUpdate */
+
+/* ================================ The End ================================= */
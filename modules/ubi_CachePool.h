@@ -0,0 +1,127 @@
+#ifndef UBI_CACHEPOOL_H
+#define UBI_CACHEPOOL_H
+/* ========================================================================== **
+ *                              ubi_CachePool.h
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module lets several ubi_Caches share one memory budget.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ *//**
+ * @file      ubi_CachePool.h
+ * @author    Christopher R. Hertel
+ * @brief     A memory budget shared by several \c ubi_Cache caches.
+ * @date      Oct 2026
+ * @version   \$Id$
+ * @copyright Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * @details
+ *  Many caches (one per tenant, say) can share one memory budget by
+ *  joining a \c #ubi_cachePool.  Each member has a minimum and maximum
+ *  share.  When the members together go over the budget, the pool evicts
+ *  from the member whose memory is earning the fewest hits per byte at
+ *  the margin, so that busy caches grow at the expense of idle ones.
+ *  \c #ubi_cachePoolUpdate() re-estimates that value, from each member's
+ *  miss ratio curve if it has one, or else from its recent hits.
+ *
+ *  As usual, nothing is allocated here.  The caller supplies the pool,
+ *  and a \c #ubi_cachePoolMember for each cache that joins it.  Caches
+ *  that are not in a pool pay only for a pointer.
+ */
+
+#include "ubi_Cache.h"        /* The member caches. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ */
+
+/**
+ * @struct  ubi_cachePool
+ * @brief   A memory budget shared by several caches.
+ * @details The members that hold more than their minimum share are kept
+ *          in a heap, the one whose memory is worth the least on top.
+ *          See \c #ubi_cachePoolInit().
+ */
+typedef struct
+  {
+  ubi_dlList    members;        /**< The members of the pool.       */
+  ubi_hpRoot    heap;           /**< Members above their minimum.   */
+  unsigned long budget;         /**< Memory shared by the members.  */
+  unsigned long used;           /**< Memory used by the members.    */
+  unsigned long reserved;       /**< Sum of the minimum shares.     */
+  } ubi_cachePool;
+
+/** Pointer to a \c #ubi_cachePool. */
+typedef ubi_cachePool *ubi_cachePoolPtr;
+
+/**
+ * @struct  ubi_cachePoolMember
+ * @brief   A cache's membership in a pool.
+ * @details Supplied by the caller when the cache joins the pool (see
+ *          \c #ubi_cachePoolAdd()), and not needed once it has left.
+ */
+typedef struct ubi_cachePoolMemberStruct
+  {
+  ubi_dlNode       link;        /**< Member list link.              */
+  ubi_hpNode       node;        /**< Heap node.                     */
+  ubi_cacheRootPtr cache;       /**< The member cache.              */
+  ubi_cachePoolPtr pool;        /**< The pool.                      */
+  ubi_trBool       listed;      /**< In the heap.                   */
+  unsigned long    min;         /**< Minimum share.                 */
+  double           weight;      /**< Hits at stake, on average.     */
+  double           value;       /**< weight / the cache's mem_used. */
+  ubi_cacheCounter lookups;     /**< Lookups at the last update.    */
+  ubi_cacheCounter hits;        /**< Hits at the last update.       */
+  } ubi_cachePoolMember;
+
+/** Pointer to a \c #ubi_cachePoolMember. */
+typedef ubi_cachePoolMember *ubi_cachePoolMemberPtr;
+
+
+/* -------------------------------------------------------------------------- **
+ * Prototypes...
+ */
+
+ubi_cachePoolPtr ubi_cachePoolInit( ubi_cachePoolPtr PoolPtr,
+                                   unsigned long    Budget );
+
+ubi_trBool ubi_cachePoolAdd( ubi_cachePoolPtr       PoolPtr,
+                             ubi_cachePoolMemberPtr MemberPtr,
+                             ubi_cacheRootPtr       CachePtr,
+                             unsigned long          MinShare,
+                             unsigned long          MaxShare );
+
+void ubi_cachePoolRemove( ubi_cacheRootPtr CachePtr );
+
+unsigned long ubi_cachePoolSetBudget( ubi_cachePoolPtr PoolPtr,
+                                      unsigned long    Budget );
+
+void ubi_cachePoolUpdate( ubi_cachePoolPtr PoolPtr );
+
+/* ================================ The End ================================= */
+#endif /* UBI_CACHEPOOL_H */
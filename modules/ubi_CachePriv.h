@@ -0,0 +1,193 @@
+#ifndef UBI_CACHEPRIV_H
+#define UBI_CACHEPRIV_H
+/* ========================================================================== **
+ *                              ubi_CachePriv.h
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  Declarations shared by the modules that make up ubi_Cache.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ *
+ *  The cache is implemented by ubi_Cache.c and its eviction policies by
+ *  ubi_CachePolicy.c, with optional features in modules of their own
+ *  (ubi_CachePool.c, ubi_CacheSpill.c, ...).  This file declares the
+ *  functions and macros that they share.  None of it is part of the
+ *  interface; applications should not include this file.
+ *
+ * ========================================================================== **
+ */
+
+#include <stddef.h>           /* offsetof() */
+#include "ubi_Cache.h"
+#include "ubi_CachePool.h"
+#include "ubi_CacheSpill.h"
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ *
+ *  ExtEntry    - Given a pointer to a cache entry, return a pointer to it
+ *                as an extended entry.  Only valid if the cache's
+ *                \c extended field is set.
+ *  LinkEntry   - Given a pointer to the link field of a cache entry,
+ *                return a pointer to the entry.
+ *  Expiring    - TRUE if the entry has an expiry timer running.  Caches
+ *                with a wheel have extended entries.
+ *  AccessClock - The sampled policy's clock: it ticks once per lookup and
+ *                once per put, and wraps at 32 bits.
+ */
+
+#define ExtEntry( E ) ((ubi_cacheEntryExtPtr)(E))
+
+#define LinkEntry( L ) \
+  ((ubi_cacheEntryPtr)((char *)(L) - offsetof( ubi_cacheEntry, link )))
+
+#define Expiring( C, E ) \
+  ((C)->wheel && ubi_timerPending( &ExtEntry( E )->timer ))
+
+#define AccessClock( C ) \
+  ((unsigned int)(((C)->stats.lookups + (C)->stats.inserts) & 0xFFFFFFFFUL))
+
+
+/* -------------------------------------------------------------------------- **
+ * Constants...
+ *
+ *  REF_BIT     - Entry flag: the entry has been used since the hand last
+ *                passed it.
+ *  HOT_BIT     - Entry flag: the entry is hot (CLOCK-Pro only).
+ *  T2_BIT      - Entry flag: the entry is on the t2 list (ARC only).
+ *  WIN_BIT     - Entry flag: the entry is in the TinyLFU window.
+ *  GONE_BIT    - Entry flag: the entry left the cache while it was pinned,
+ *                and is freed by the last ubi_cacheRelease().
+ *  DUMP_ENTRY  - Dump record tag: an entry follows.  Each entry in the
+ *                spill log starts with it, too.
+ */
+
+#define REF_BIT     0x01
+#define HOT_BIT     0x02
+#define T2_BIT      0x04
+#define WIN_BIT     0x08
+#define GONE_BIT    0x10
+
+#define DUMP_ENTRY  'E'
+
+
+/* -------------------------------------------------------------------------- **
+ * Prototypes...
+ *
+ *  ubi_Cache.c:
+ *    ubi_cachePutEntry()   - Add an entry, as ubi_cachePut() does.
+ *    ubi_cacheIndexFind()  - Look a key up in the index.
+ *    ubi_cacheFreeMemory() - Free an entry that was never in the cache.
+ *    ubi_cacheEvict()      - Evict entries, as chosen by the policy.
+ *
+ *  ubi_CachePolicy.c:
+ *    ubi_cachePolicyInit()     - Set up the policy fields of a new cache.
+ *    ubi_cachePolicyReset()    - Forget all entries and ghosts.
+ *    ubi_cachePolicyInsert()   - Hand a new entry to the policy.
+ *    ubi_cachePolicyTouch()    - Tell the policy an entry has been used.
+ *    ubi_cachePolicyRemove()   - Take an entry away from the policy.
+ *    ubi_cachePolicyEvicted()  - Tell the policy an entry was evicted.
+ *    ubi_cachePolicyVictim()   - Choose the next entry to evict.
+ *    ubi_cachePolicyPassOver() - Move a pinned victim out of the way.
+ *    ubi_cachePolicyPassDone() - Restore the entries passed over.
+ *
+ *  ubi_CachePool.c:
+ *    ubi_cachePoolCharge()   - Charge a change in memory use to the pool.
+ *    ubi_cachePoolTrim()     - Bring the pool within its budget.
+ *
+ *  ubi_CacheSpill.c:
+ *    ubi_cacheSpillAdd()     - Append an evicted entry to the log.
+ *    ubi_cacheSpillGet()     - Read a missing entry back from the log.
+ *    ubi_cacheSpillForget()  - Forget the spilled copy of a key.
+ *    ubi_cacheSpillReset()   - Forget all spilled entries.
+ *
+ *  See the functions themselves for details.
+ */
+
+void ubi_cachePutEntry( ubi_cacheRootPtr  CachePtr,
+                        unsigned long     EntrySize,
+                        ubi_cacheEntryPtr EntryPtr,
+                        ubi_trItemPtr     Key,
+                        ubi_trBool        Timed,
+                        unsigned long     Expires );
+
+ubi_cacheEntryPtr ubi_cacheIndexFind( ubi_cacheRootPtr CachePtr,
+                                      ubi_trItemPtr    Key,
+                                      unsigned long    Hash,
+                                      ubi_trBool       Splay );
+
+void ubi_cacheFreeMemory( ubi_cacheRootPtr  CachePtr,
+                          ubi_cacheEntryPtr EntryPtr );
+
+ubi_trBool ubi_cacheEvict( ubi_cacheRootPtr CachePtr,
+                           unsigned long    count,
+                           int              Reason );
+
+void ubi_cachePolicyInit( ubi_cacheRootPtr CachePtr );
+
+void ubi_cachePolicyReset( ubi_cacheRootPtr CachePtr );
+
+void ubi_cachePolicyInsert( ubi_cacheRootPtr  CachePtr,
+                            ubi_cacheEntryPtr EntryPtr );
+
+void ubi_cachePolicyTouch( ubi_cacheRootPtr  CachePtr,
+                           ubi_cacheEntryPtr EntryPtr );
+
+void ubi_cachePolicyRemove( ubi_cacheRootPtr  CachePtr,
+                            ubi_cacheEntryPtr EntryPtr );
+
+void ubi_cachePolicyEvicted( ubi_cacheRootPtr  CachePtr,
+                             ubi_cacheEntryPtr EntryPtr );
+
+ubi_cacheEntryPtr ubi_cachePolicyVictim( ubi_cacheRootPtr CachePtr );
+
+void ubi_cachePolicyPassOver( ubi_cacheRootPtr  CachePtr,
+                              ubi_cacheEntryPtr EntryPtr,
+                              ubi_dlListPtr     Passed );
+
+void ubi_cachePolicyPassDone( ubi_cacheRootPtr CachePtr,
+                              ubi_dlListPtr    Passed );
+
+void ubi_cachePoolCharge( ubi_cacheRootPtr CachePtr,
+                          unsigned long    Added,
+                          unsigned long    Removed );
+
+void ubi_cachePoolTrim( ubi_cacheRootPtr CachePtr );
+
+void ubi_cacheSpillAdd( ubi_cacheRootPtr CachePtr, ubi_cacheEntryPtr EntryPtr );
+
+ubi_cacheEntryPtr ubi_cacheSpillGet( ubi_cacheRootPtr CachePtr,
+                                     ubi_trItemPtr    FindMe,
+                                     unsigned long    Hash );
+
+void ubi_cacheSpillForget( ubi_cacheRootPtr CachePtr, unsigned long Hash );
+
+void ubi_cacheSpillReset( ubi_cacheRootPtr CachePtr );
+
+/* ================================ The End ================================= */
+#endif /* UBI_CACHEPRIV_H */
@@ -0,0 +1,448 @@
+/* ========================================================================== **
+ *                              ubi_CacheSpill.c
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module gives a ubi_Cache a second tier, in a file.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ */
+
+#include <stddef.h>           /* offsetof() */
+#include <stdio.h>            /* fseek(), fread(), fwrite(), ... */
+#include "ubi_CacheSpill.h"   /* Header for *this* module. */
+#include "ubi_CachePriv.h"    /* Shared with the rest of the cache. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ *
+ *  LinkSpill - Given a pointer to the link field of a spill record, return
+ *              a pointer to the record.
+ */
+
+#define LinkSpill( L ) \
+  ((ubi_cacheSpillPtr)((char *)(L) - offsetof( ubi_cacheSpill, link )))
+
+
+/* -------------------------------------------------------------------------- **
+ * Constants...
+ *
+ *  COPY_SIZE - Buffer size used to copy the spill log when compacting.
+ */
+
+#define COPY_SIZE 512
+
+
+/* -------------------------------------------------------------------------- **
+ * Internal functions...
+ */
+
+static int spill_cmp( ubi_btItemPtr ItemPtr, ubi_btNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare a hash value against the hash stored in a spill record.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((ubi_cacheSpillPtr)NodePtr)->hash;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* spill_cmp */
+
+static void spill_drop( ubi_cacheSpillLogPtr LogPtr, ubi_cacheSpillPtr Rec )
+  /* ------------------------------------------------------------------------ **
+   * Forget a spilled entry, and return its record to the spare list.
+   *
+   *  Input:  LogPtr    - A pointer to the spill log.
+   *          Rec       - The record, which is in use.
+   *
+   *  Output: none.
+   *
+   *  Notes:  The entry's bytes in the log become garbage, to be reclaimed
+   *          by ubi_cacheSpillCompact().
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)ubi_btRemove( &LogPtr->records, &Rec->node );
+  (void)ubi_dlRemThis( &LogPtr->age, &Rec->link );
+  (void)ubi_dlAddHead( &LogPtr->spare, &Rec->link );
+  LogPtr->live -= Rec->length;
+  LogPtr->dead += Rec->length;
+  } /* spill_drop */
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions shared with ubi_Cache.c...
+ */
+
+void ubi_cacheSpillForget( ubi_cacheRootPtr CachePtr, unsigned long Hash )
+  /* ------------------------------------------------------------------------ **
+   * Forget the spilled entry with the given hash, if there is one.
+   *
+   *  Input:  CachePtr  - A pointer to the cache, which has a spill log.
+   *          Hash      - The hash of a key that has been put or deleted.
+   *
+   *  Output: none.
+   *
+   *  Notes:  The spilled copy is out of date.  If it belongs to another
+   *          key with the same hash, it is dropped anyway; that only costs
+   *          a miss later.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_btNodePtr Rec;
+
+  if( NULL != (Rec = ubi_btFind( &CachePtr->spill->records, &Hash )) )
+    spill_drop( CachePtr->spill, (ubi_cacheSpillPtr)Rec );
+  } /* ubi_cacheSpillForget */
+
+void ubi_cacheSpillReset( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Forget all spilled entries.
+   *
+   *  Input:  CachePtr  - A pointer to the cache.
+   *
+   *  Output: none.
+   *
+   *  Notes:  Does nothing if the cache has no spill log.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheSpillLogPtr LogPtr = CachePtr->spill;
+
+  if( NULL == LogPtr )
+    return;
+  while( ubi_dlCount( &LogPtr->age ) )
+    spill_drop( LogPtr, LinkSpill( ubi_dlFirst( &LogPtr->age ) ) );
+  } /* ubi_cacheSpillReset */
+
+void ubi_cacheSpillAdd( ubi_cacheRootPtr CachePtr, ubi_cacheEntryPtr EntryPtr )
+  /* ------------------------------------------------------------------------ **
+   * Append an evicted entry to the spill log.
+   *
+   *  Input:  CachePtr  - A pointer to the cache, which has a spill log.
+   *          EntryPtr  - The entry, which has been taken out of the index
+   *                      but not yet freed.
+   *
+   *  Output: none.
+   *
+   *  Notes:  If there are no spare records, the oldest spilled entry is
+   *          forgotten.  An entry that has already expired is not worth
+   *          writing.  If the write fails, whatever part of the entry
+   *          made it into the log is counted as garbage, and the entry is
+   *          simply lost, as it would have been without a log.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheSpillLogPtr LogPtr = CachePtr->spill;
+  FILE                *Log    = LogPtr->file;
+  ubi_cacheSpillPtr    Rec;
+  long                 start, end;
+
+  if( Expiring( CachePtr, EntryPtr )
+   && ((long)(ExtEntry( EntryPtr )->timer.expires - CachePtr->now) <= 0) )
+    return;
+  ubi_cacheSpillForget( CachePtr, EntryPtr->hash );
+  if( 0 == ubi_dlCount( &LogPtr->spare ) )
+    {
+    if( 0 == ubi_dlCount( &LogPtr->age ) )
+      return;
+    spill_drop( LogPtr, LinkSpill( ubi_dlLast( &LogPtr->age ) ) );
+    }
+
+  if( (0 != fseek( Log, 0L, SEEK_END )) || ((start = ftell( Log )) < 0) )
+    {
+    clearerr( Log );
+    return;
+    }
+  if( (EOF == putc( DUMP_ENTRY, Log ))
+   || !(*LogPtr->write)( Log, EntryPtr, LogPtr->context )
+   || ((end = ftell( Log )) < 0) )
+    {
+    clearerr( Log );
+    if( (0 == fseek( Log, 0L, SEEK_END )) && ((end = ftell( Log )) > start) )
+      LogPtr->dead += (unsigned long)(end - start);
+    return;
+    }
+
+  Rec = LinkSpill( ubi_dlRemHead( &LogPtr->spare ) );
+  Rec->hash    = EntryPtr->hash;
+  Rec->offset  = start;
+  Rec->length  = (unsigned long)(end - start);
+  Rec->timed   = Expiring( CachePtr, EntryPtr ) ? ubi_trTRUE : ubi_trFALSE;
+  Rec->expires = Rec->timed ? ExtEntry( EntryPtr )->timer.expires : 0;
+  (void)ubi_btInsert( &LogPtr->records, &Rec->node, &Rec->hash, NULL );
+  (void)ubi_dlAddHead( &LogPtr->age, &Rec->link );
+  LogPtr->live += Rec->length;
+  CachePtr->stats.spill_writes++;
+  } /* ubi_cacheSpillAdd */
+
+ubi_cacheEntryPtr ubi_cacheSpillGet( ubi_cacheRootPtr CachePtr,
+                                     ubi_trItemPtr    FindMe,
+                                     unsigned long    Hash )
+  /* ------------------------------------------------------------------------ **
+   * Read an entry back from the spill log, and put it into the cache.
+   *
+   *  Input:  CachePtr  - A pointer to the cache, which has a spill log.
+   *          FindMe    - The key that was not found in memory.
+   *          Hash      - The hash of the key.
+   *
+   *  Output: A pointer to the entry, now back in the cache, or NULL if
+   *          there was no spilled entry for the key.
+   *
+   *  Notes:  A record with the same hash may belong to another key, so
+   *          the key that is read back is compared with FindMe.  If they
+   *          differ, the entry is freed, and the record is kept for the
+   *          other key.  Otherwise, the record is forgotten, since the
+   *          entry is in memory again.  Evictions made while the entry is
+   *          read (by ubi_cacheAlloc(), say) are not spilled, so that the
+   *          log is left alone until the read is done.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheSpillLogPtr LogPtr   = CachePtr->spill;
+  FILE                *Log      = LogPtr->file;
+  ubi_cacheEntryPtr    EntryPtr = NULL;
+  ubi_trItemPtr        Key      = NULL;
+  ubi_cacheSpillPtr    Rec;
+  ubi_trBool           timed;
+  unsigned long        expires;
+
+  Rec = (ubi_cacheSpillPtr)ubi_btFind( &LogPtr->records, &Hash );
+  if( NULL == Rec )
+    return( NULL );
+  if( Rec->timed && ((long)(Rec->expires - CachePtr->now) <= 0) )
+    {
+    spill_drop( LogPtr, Rec );
+    return( NULL );
+    }
+
+  LogPtr->busy = ubi_trTRUE;
+  if( (0 == fseek( Log, Rec->offset, SEEK_SET ))
+   && (DUMP_ENTRY == getc( Log )) )
+    EntryPtr = (*LogPtr->read)( Log, &Key, LogPtr->context );
+  LogPtr->busy = ubi_trFALSE;
+  if( NULL == EntryPtr )
+    {
+    clearerr( Log );
+    spill_drop( LogPtr, Rec );
+    return( NULL );
+    }
+  if( 0 != (*CachePtr->root.cmp)( FindMe, (ubi_btNodePtr)EntryPtr ) )
+    {
+    ubi_cacheFreeMemory( CachePtr, EntryPtr );
+    return( NULL );
+    }
+
+  timed   = (Rec->timed && CachePtr->wheel) ? ubi_trTRUE : ubi_trFALSE;
+  expires = Rec->expires;
+  spill_drop( LogPtr, Rec );
+  CachePtr->stats.spill_hits++;
+  ubi_cachePutEntry( CachePtr, EntryPtr->entry_size, EntryPtr, Key,
+                     timed, expires );
+  /* Make sure it wasn't refused admission or trimmed right away. */
+  return( ubi_cacheIndexFind( CachePtr, FindMe, Hash, ubi_trFALSE ) );
+  } /* ubi_cacheSpillGet */
+
+
+/* -------------------------------------------------------------------------- **
+ * Exported functions...
+ */
+
+ubi_cacheSpillLogPtr ubi_cacheSpillInit( ubi_cacheSpillLogPtr     LogPtr,
+                                         FILE                    *Log,
+                                         ubi_cacheSerializeFunc   Serialize,
+                                         ubi_cacheDeserializeFunc Deserialize,
+                                         void                    *Context,
+                                         ubi_cacheSpillPtr        Records,
+                                         unsigned long            Count )
+  /** Initialize a spill log.
+   *
+   * @param   LogPtr      A pointer to the \c #ubi_cacheSpillLog.
+   * @param   Log         The log file: a file opened for reading and
+   *                      writing (e.g., with \c tmpfile(), or mode
+   *                      \c "w+b").
+   * @param   Serialize   Writes an entry's key and data, as for
+   *                      \c #ubi_cacheDump().
+   * @param   Deserialize Reads them back, as for \c #ubi_cacheLoad().
+   * @param   Context     A pointer passed to \p Serialize and
+   *                      \p Deserialize.
+   * @param   Records     An array of \p Count records, one for each
+   *                      entry that may be held in the log.
+   * @param   Count       The number of records.
+   *
+   * @returns A pointer to the initialized log (i.e., the same as
+   *          \p LogPtr), or NULL if the file, a function or the records
+   *          are missing.
+   *
+   * \b Notes:
+   *  - The log is only ever appended to, and the space taken by entries
+   *    that have been read back or forgotten is not reused.  See
+   *    \c #ubi_cacheSpillCompact().  The log is read and written with
+   *    \c fseek(), \c fread() and \c fwrite(), so that the library stays
+   *    portable.  Give the stream a buffer (\c setvbuf()) about the size
+   *    of a typical entry.
+   *  - \p Serialize and \p Deserialize are called with the cache locked
+   *    (if it is locked at all), and must not call back into the cache,
+   *    except that \p Deserialize may use \c #ubi_cacheAlloc().  Their
+   *    records need not be self-delimiting; each is read from its start.
+   *    If the cache has extended entries, \p Deserialize must return an
+   *    extended entry.
+   *  - The file is appended to, so it need not be empty.  It is never
+   *    closed by this module.
+   *  - A record is about 64 bytes, so a log can hold many more entries
+   *    than the cache itself.
+   */
+  {
+  unsigned long i;
+
+  if( (NULL == LogPtr) || (NULL == Log) || (NULL == Serialize)
+   || (NULL == Deserialize) || (NULL == Records) || (0 == Count) )
+    return( NULL );
+
+  LogPtr->file    = Log;
+  LogPtr->write   = Serialize;
+  LogPtr->read    = Deserialize;
+  LogPtr->context = Context;
+  (void)ubi_btInitTree( &LogPtr->records, spill_cmp, 0 );
+  (void)ubi_dlInitList( &LogPtr->age );
+  (void)ubi_dlInitList( &LogPtr->spare );
+  for( i = 0; i < Count; i++ )
+    (void)ubi_dlAddTail( &LogPtr->spare, &Records[i].link );
+  LogPtr->live    = 0;
+  LogPtr->dead    = 0;
+  LogPtr->busy    = ubi_trFALSE;
+  return( LogPtr );
+  } /* ubi_cacheSpillInit */
+
+ubi_trBool ubi_cacheSetSpill( ubi_cacheRootPtr     CachePtr,
+                              ubi_cacheSpillLogPtr LogPtr )
+  /** Give the cache a second tier, in a file: evicted entries are spilled
+   *  to the file, and read back when they are looked up again.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   LogPtr    A spill log, initialized by
+   *                    \c #ubi_cacheSpillInit(), or NULL to stop spilling.
+   *
+   * @returns TRUE if the log was set (or removed), or FALSE if there is no
+   *          hash function (see \c #ubi_cacheSetHashFunc()).
+   *
+   * \b Notes:
+   *  - Entries that are evicted (for any reason but expiry or refusal by
+   *    the admission filter) are appended to the log before they are
+   *    freed.  Once all of the records are in use, the oldest spilled
+   *    entry is forgotten to make room.
+   *  - \c #ubi_cacheGet() looks in the log when a key is not in memory,
+   *    and puts the entry back into the cache if it is there, at the
+   *    price of a read on each spilled hit.
+   *  - Records are found by the hash of the key.  The key that is read
+   *    back is compared with the one that was looked up, so a collision
+   *    costs a read, but never returns the wrong entry.
+   *  - A put or delete of a key forgets its spilled copy, which is then
+   *    out of date.  So does clearing the cache.  Expiry times are kept,
+   *    and an expired entry is never read back.
+   *  - The entries spilled to the previous log, if any, are forgotten.
+   *  - A log in a file can't be shared between processes, so a cache in
+   *    shared memory should not spill.
+   */
+  {
+  if( (NULL != LogPtr) && (NULL == CachePtr->hash_func) )
+    return( ubi_trFALSE );
+  ubi_cacheSpillReset( CachePtr );
+  CachePtr->spill = LogPtr;
+  return( ubi_trTRUE );
+  } /* ubi_cacheSetSpill */
+
+long ubi_cacheSpillCompact( ubi_cacheRootPtr CachePtr, FILE *NewLog )
+  /** Copy the live entries of the spill log to a new log.
+   *
+   * @param   CachePtr  A pointer to the cache.
+   * @param   NewLog    The new log, opened for reading and writing.  The
+   *                    entries are appended to it.
+   *
+   * @returns The number of bytes copied, or -1 if the cache has no log or
+   *          the copy failed.
+   *
+   * \b Notes:
+   *  - On success, the cache uses \p NewLog from then on.  The old log is
+   *    no longer needed, and the caller should close it (and remove it,
+   *    if it has a name).
+   *  - If a read or write fails, every spilled entry is forgotten, and
+   *    the cache goes on with the old log.
+   *  - The bytes are copied as they are, oldest entry first, without
+   *    calling the serialization functions.  The cost is proportional to
+   *    the live part of the log, so a good time to compact is when
+   *    \c #ubi_cacheGetSpillDead() is larger than that; the copying then
+   *    costs no more than the writes that made the garbage.
+   *  - The cache must stay locked for the duration.  To keep that short,
+   *    compact often, or give the cache a new, empty log instead (with
+   *    \c #ubi_cacheSetSpill()), which simply forgets the old entries.
+   */
+  {
+  ubi_cacheSpillLogPtr LogPtr = CachePtr->spill;
+  FILE                *Old;
+  ubi_dlNodePtr        p;
+  ubi_cacheSpillPtr    Rec;
+  char                 buf[COPY_SIZE];
+  unsigned long        left;
+  size_t               n;
+  long                 base, start;
+  ubi_trBool           failed = ubi_trFALSE;
+
+  if( (NULL == LogPtr) || (NULL == NewLog) || ((Old = LogPtr->file) == NewLog)
+   || (0 != fseek( NewLog, 0L, SEEK_END )) || ((base = ftell( NewLog )) < 0) )
+    return( -1 );
+
+  p = ubi_dlLast( &LogPtr->age );
+  for( ; (NULL != p) && !failed; p = ubi_dlPrev( p ) )
+    {
+    Rec   = LinkSpill( p );
+    start = ftell( NewLog );
+    if( (start < 0) || (0 != fseek( Old, Rec->offset, SEEK_SET )) )
+      failed = ubi_trTRUE;
+    for( left = Rec->length; (left > 0) && !failed; left -= n )
+      {
+      n = (left < COPY_SIZE) ? (size_t)left : COPY_SIZE;
+      if( (n != fread( buf, 1, n, Old )) || (n != fwrite( buf, 1, n, NewLog )) )
+        failed = ubi_trTRUE;
+      }
+    Rec->offset = start;
+    }
+  if( failed || (0 != fflush( NewLog )) )
+    {
+    clearerr( Old );
+    clearerr( NewLog );
+    ubi_cacheSpillReset( CachePtr );
+    return( -1 );
+    }
+
+  LogPtr->file = NewLog;
+  LogPtr->dead = (unsigned long)base;
+  return( (long)LogPtr->live );
+  } /* ubi_cacheSpillCompact */
+
+/* ================================ The End ================================= */
@@ -0,0 +1,152 @@
+#ifndef UBI_CACHESPILL_H
+#define UBI_CACHESPILL_H
+/* ========================================================================== **
+ *                              ubi_CacheSpill.h
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module gives a ubi_Cache a second tier, in a file.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ *//**
+ * @file      ubi_CacheSpill.h
+ * @author    Christopher R. Hertel
+ * @brief     A spill log: a second tier, on disk, for a \c ubi_Cache.
+ * @date      Oct 2026
+ * @version   \$Id$
+ * @copyright Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * @details
+ *  With a spill log (\c #ubi_cacheSetSpill()), each entry that is evicted
+ *  from the cache is first appended to a log file, and a small record of
+ *  where it went is kept in memory.  A lookup that misses in memory looks
+ *  for a record, reads the entry back from the log, and puts it into the
+ *  cache again.  Records are far smaller than most entries, so the second
+ *  tier can be many times larger than the cache.  Space in the log is
+ *  reclaimed by copying the live entries to a new file
+ *  (\c #ubi_cacheSpillCompact()).
+ *
+ *  The entries are written and read by the same kind of functions as
+ *  \c #ubi_cacheDump() and \c #ubi_cacheLoad() use.  As usual, nothing is
+ *  allocated here: the caller supplies the \c #ubi_cacheSpillLog and the
+ *  array of records.
+ */
+
+#include <stdio.h>            /* FILE */
+#include "ubi_Cache.h"        /* The cache that spills. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ */
+
+/**
+ * @struct  ubi_cacheSpill
+ * @brief   The in-memory record of an entry that was spilled to disk.
+ * @details Records are indexed by the hash of the key, like ghosts.  The
+ *          memory is supplied by the caller; see \c #ubi_cacheSpillInit().
+ */
+typedef struct
+  {
+  ubi_btNode    node;           /**< Index node, keyed by hash.     */
+  ubi_dlNode    link;           /**< Age list (or spare list) link. */
+  unsigned long hash;           /**< Hash of the entry's key.       */
+  long          offset;         /**< Where the entry is in the log. */
+  unsigned long length;         /**< Bytes written to the log.      */
+  unsigned long expires;        /**< Expiry tick, if timed.         */
+  ubi_trBool    timed;          /**< The entry will expire.         */
+  } ubi_cacheSpill;
+
+/** Pointer to a \c #ubi_cacheSpill. */
+typedef ubi_cacheSpill *ubi_cacheSpillPtr;
+
+/**
+ * @struct  ubi_cacheSpillLog
+ * @brief   A spill log, and the records of the entries in it.
+ * @details See \c #ubi_cacheSpillInit().  A log may be given to only one
+ *          cache at a time.
+ */
+typedef struct ubi_cacheSpillLogStruct
+  {
+  FILE                    *file;    /**< The log.                         */
+  ubi_cacheSerializeFunc   write;   /**< Writes an entry.                 */
+  ubi_cacheDeserializeFunc read;    /**< Reads it back.                   */
+  void                    *context; /**< Passed to the above.             */
+  ubi_btRoot               records; /**< Records in use, indexed by hash. */
+  ubi_dlList               age;     /**< Records in use, newest first.    */
+  ubi_dlList               spare;   /**< Unused records.                  */
+  unsigned long            live;    /**< Log bytes still in use.          */
+  unsigned long            dead;    /**< Log bytes no longer needed.      */
+  ubi_trBool               busy;    /**< Reading; don't write.            */
+  } ubi_cacheSpillLog;
+
+/** Pointer to a \c #ubi_cacheSpillLog. */
+typedef ubi_cacheSpillLog *ubi_cacheSpillLogPtr;
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ */
+
+/**
+ * @def     ubi_cacheGetSpillCount( Cptr )
+ * @param   Cptr  Pointer to the cache root.
+ * @returns The number of entries that can be read back from the spill log.
+ */
+#define ubi_cacheGetSpillCount( Cptr ) \
+        (((ubi_cacheRootPtr)(Cptr))->spill \
+          ? ubi_dlCount( &((ubi_cacheRootPtr)(Cptr))->spill->age ) : 0)
+
+/**
+ * @def     ubi_cacheGetSpillDead( Cptr )
+ * @param   Cptr  Pointer to the cache root.
+ * @returns The number of bytes in the spill log that no longer hold a live
+ *          entry, and would be reclaimed by \c #ubi_cacheSpillCompact().
+ */
+#define ubi_cacheGetSpillDead( Cptr ) \
+        (((ubi_cacheRootPtr)(Cptr))->spill \
+          ? ((ubi_cacheRootPtr)(Cptr))->spill->dead : 0)
+
+
+/* -------------------------------------------------------------------------- **
+ * Prototypes...
+ */
+
+ubi_cacheSpillLogPtr ubi_cacheSpillInit( ubi_cacheSpillLogPtr     LogPtr,
+                                         FILE                    *Log,
+                                         ubi_cacheSerializeFunc   Serialize,
+                                         ubi_cacheDeserializeFunc Deserialize,
+                                         void                    *Context,
+                                         ubi_cacheSpillPtr        Records,
+                                         unsigned long            Count );
+
+ubi_trBool ubi_cacheSetSpill( ubi_cacheRootPtr     CachePtr,
+                              ubi_cacheSpillLogPtr LogPtr );
+
+long ubi_cacheSpillCompact( ubi_cacheRootPtr CachePtr, FILE *NewLog );
+
+/* ================================ The End ================================= */
+#endif /* UBI_CACHESPILL_H */
@@ -0,0 +1,304 @@
+/* ========================================================================== **
+ *                                 ubi_Epoch.c
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module implements epoch-based memory reclamation.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ */
+
+#include "ubi_Epoch.h"    /* Header for *this* module. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Internal functions...
+ */
+
+static ubi_btNodePtr PostFirst( ubi_btNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Find the first node, in post-order, of the given subtree.
+   *
+   *  Input:  NodePtr - The root of the subtree.  May be NULL.
+   *
+   *  Output: The first node visited by a post-order walk of the subtree,
+   *          or NULL if the subtree is empty.
+   *
+   *  Notes:  That's the leaf found by going left whenever possible and
+   *          right otherwise.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( NULL != NodePtr )
+    {
+    for(;;)
+      {
+      if( NULL != NodePtr->Link[ubi_trLEFT] )
+        NodePtr = NodePtr->Link[ubi_trLEFT];
+      else if( NULL != NodePtr->Link[ubi_trRIGHT] )
+        NodePtr = NodePtr->Link[ubi_trRIGHT];
+      else
+        break;
+      }
+    }
+  return( NodePtr );
+  } /* PostFirst */
+
+
+/* -------------------------------------------------------------------------- **
+ * Exported functions...
+ */
+
+ubi_epochDomainPtr ubi_epochInit( ubi_epochDomainPtr DomainPtr,
+                                  ubi_epochReaderPtr Readers,
+                                  unsigned int       NumReaders,
+                                  ubi_epochLimbo    *Limbo,
+                                  unsigned long      LimboSize )
+  /** Initialize an epoch domain.
+   *
+   * @param   DomainPtr   A pointer to the \c #ubi_epochDomain to be
+   *                      initialized.
+   * @param   Readers     An array of \p NumReaders reader slots.  Each
+   *                      reader thread must be given one of these.
+   * @param   NumReaders  The number of reader slots.
+   * @param   Limbo       An array of \p LimboSize limbo list entries, used
+   *                      to keep track of retired objects.
+   * @param   LimboSize   The number of limbo list entries.  Must be at
+   *                      least one.
+   *
+   * @returns A pointer to the initialized domain (i.e., the same as
+   *          \p DomainPtr).
+   *
+   * \b Note: The size of the limbo list determines how often reclamation
+   *          is attempted, and how long the writer may have to wait if
+   *          readers are slow to leave their read-side sections.  A few
+   *          hundred entries is a reasonable start.
+   */
+  {
+  unsigned int i;
+
+  if( DomainPtr )
+    {
+    atomic_init( &DomainPtr->global, 1 );
+    DomainPtr->readers  = Readers;
+    DomainPtr->nreaders = NumReaders;
+    DomainPtr->limbo    = Limbo;
+    DomainPtr->size     = LimboSize;
+    DomainPtr->head     = 0;
+    DomainPtr->count    = 0;
+    DomainPtr->retired  = 0;
+    DomainPtr->freed    = 0;
+    for( i = 0; i < NumReaders; i++ )
+      atomic_init( &Readers[i].epoch, 0 );
+    }
+  return( DomainPtr );
+  } /* ubi_epochInit */
+
+void ubi_epochEnter( ubi_epochDomainPtr DomainPtr, ubi_epochReaderPtr Reader )
+  /** Begin a read-side section.
+   *
+   * @param   DomainPtr A pointer to the epoch domain.
+   * @param   Reader    A pointer to the calling thread's reader slot.
+   *
+   * \b Note: Objects that the reader finds after this call will not be
+   *          freed until after the matching call to \c #ubi_epochExit().
+   */
+  {
+  unsigned long e;
+
+  e = atomic_load_explicit( &DomainPtr->global, memory_order_relaxed );
+  atomic_store_explicit( &Reader->epoch, e, memory_order_relaxed );
+  /* The slot must be visible before we look at any shared data. */
+  atomic_thread_fence( memory_order_seq_cst );
+  } /* ubi_epochEnter */
+
+void ubi_epochExit( ubi_epochReaderPtr Reader )
+  /** End a read-side section.
+   *
+   * @param   Reader  A pointer to the calling thread's reader slot.
+   */
+  {
+  atomic_store_explicit( &Reader->epoch, 0, memory_order_release );
+  } /* ubi_epochExit */
+
+void ubi_epochRetire( ubi_epochDomainPtr DomainPtr,
+                      void              *Ptr,
+                      ubi_epochFreeFunc  FreeFunc )
+  /** Free an object once no reader can be looking at it.
+   *
+   * @param   DomainPtr A pointer to the epoch domain.
+   * @param   Ptr       A pointer to the object, which must already have
+   *                    been removed from the shared data structure.
+   * @param   FreeFunc  The function that will be called to free the
+   *                    object.
+   *
+   * \b Notes
+   *  - If the limbo list is half full (or more) after the object has been
+   *    added, a reclamation pass is made.
+   *  - If the limbo list is full, this function will spin until readers
+   *    leave their read-side sections and space becomes available.  A
+   *    reader must never call this function from within a read-side
+   *    section.
+   */
+  {
+  ubi_epochLimbo *lp;
+
+  while( DomainPtr->count >= DomainPtr->size )
+    (void)ubi_epochReclaim( DomainPtr );
+
+  lp = &DomainPtr->limbo[(DomainPtr->head + DomainPtr->count)
+                         % DomainPtr->size];
+  lp->ptr       = Ptr;
+  lp->free_func = FreeFunc;
+  lp->epoch     = atomic_load_explicit( &DomainPtr->global,
+                                        memory_order_relaxed );
+  DomainPtr->count++;
+  DomainPtr->retired++;
+
+  if( DomainPtr->count >= ((DomainPtr->size + 1) / 2) )
+    (void)ubi_epochReclaim( DomainPtr );
+  } /* ubi_epochRetire */
+
+unsigned long ubi_epochReclaim( ubi_epochDomainPtr DomainPtr )
+  /** Advance the epoch and free any retired objects that are now safe.
+   *
+   * @param   DomainPtr A pointer to the epoch domain.
+   *
+   * @returns The number of objects freed.
+   *
+   * \b Notes
+   *  - This is called automatically by \c #ubi_epochRetire().  It may
+   *    also be called from a background thread (while holding the
+   *    writer's lock) to keep the limbo list short.
+   *  - An object can be freed once every reader that is inside a
+   *    read-side section entered it at a later epoch than the one in
+   *    which the object was retired.
+   */
+  {
+  ubi_epochLimbo *lp;
+  unsigned long   e, min, v;
+  unsigned long   n = 0;
+  unsigned int    i;
+
+  if( 0 == DomainPtr->count )
+    return( 0 );
+
+  /* Removals from the shared structure must be visible before the epoch
+   * moves and before the reader slots are examined.
+   */
+  atomic_thread_fence( memory_order_seq_cst );
+  e = atomic_load_explicit( &DomainPtr->global, memory_order_relaxed ) + 1;
+  if( 0 == e )
+    e = 1;
+  atomic_store_explicit( &DomainPtr->global, e, memory_order_relaxed );
+  atomic_thread_fence( memory_order_seq_cst );
+
+  min = e;
+  for( i = 0; i < DomainPtr->nreaders; i++ )
+    {
+    v = atomic_load_explicit( &DomainPtr->readers[i].epoch,
+                              memory_order_acquire );
+    if( v && ((long)(v - min) < 0) )
+      min = v;
+    }
+
+  while( DomainPtr->count )
+    {
+    lp = &DomainPtr->limbo[DomainPtr->head];
+    if( (long)(lp->epoch - min) >= 0 )
+      break;
+    (*lp->free_func)( lp->ptr );
+    DomainPtr->head = (DomainPtr->head + 1) % DomainPtr->size;
+    DomainPtr->count--;
+    n++;
+    }
+  DomainPtr->freed += n;
+  return( n );
+  } /* ubi_epochReclaim */
+
+void ubi_epochSynchronize( ubi_epochDomainPtr DomainPtr )
+  /** Wait until all retired objects have been freed.
+   *
+   * @param   DomainPtr A pointer to the epoch domain.
+   *
+   * \b Note: This spins until the readers have left the read-side
+   *          sections that they were in.  It is typically used when
+   *          shutting down.
+   */
+  {
+  while( DomainPtr->count )
+    (void)ubi_epochReclaim( DomainPtr );
+  } /* ubi_epochSynchronize */
+
+unsigned long ubi_epochKillTree( ubi_epochDomainPtr DomainPtr,
+                                 ubi_btRootPtr      RootPtr,
+                                 ubi_epochFreeFunc  FreeNode )
+  /** Empty a tree, retiring (rather than freeing) all of its nodes.
+   *
+   * @param   DomainPtr A pointer to the epoch domain.
+   * @param   RootPtr   A pointer to the tree.
+   * @param   FreeNode  The function that will be called to free each
+   *                    node, once it is safe to do so.
+   *
+   * @returns The number of nodes retired.
+   *
+   * \b Notes
+   *  - The tree header is re-initialized first, so that readers arriving
+   *    later will find an empty tree.  Readers that are already in the
+   *    tree will find it unchanged.  The nodes are never written to.
+   *  - The nodes are retired in post-order, so that a node is always
+   *    retired after its descendants.  That way, the walk never has to
+   *    look at a node that has already been retired (and might have been
+   *    freed).
+   */
+  {
+  ubi_btNodePtr p, q, parent;
+  unsigned long count = 0;
+
+  if( (NULL == RootPtr) || (NULL == FreeNode) )
+    return( 0 );
+
+  p = PostFirst( RootPtr->root );
+  (void)ubi_btInitTree( RootPtr, RootPtr->cmp, RootPtr->flags );
+  while( NULL != p )
+    {
+    parent = p->Link[ubi_trPARENT];
+    if( (NULL != parent) && (parent->Link[ubi_trLEFT] == p) )
+      {
+      q = PostFirst( parent->Link[ubi_trRIGHT] );
+      if( NULL == q )
+        q = parent;
+      }
+    else
+      q = parent;
+    ubi_epochRetire( DomainPtr, (void *)p, FreeNode );
+    count++;
+    p = q;
+    }
+  return( count );
+  } /* ubi_epochKillTree */
+
+/* ================================ The End ================================= */
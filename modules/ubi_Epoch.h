@@ -0,0 +1,203 @@
+#ifndef UBI_EPOCH_H
+#define UBI_EPOCH_H
+/* ========================================================================== **
+ *                                 ubi_Epoch.h
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module implements epoch-based memory reclamation.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ *//**
+ * @file      ubi_Epoch.h
+ * @author    Christopher R. Hertel
+ * @brief     Epoch-based reclamation of memory shared with readers.
+ * @date      Oct 2026
+ * @version   \$Id$
+ * @copyright Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * @details
+ *  When a node is removed from a tree, list, or cache, it is normally
+ *  freed right away.  That's fine as long as nobody else can be looking at
+ *  it.  If other threads read the structure, or hang on to pointers to
+ *  entries they found, then freeing the node immediately leaves them
+ *  holding a pointer to freed memory.
+ *
+ *  This module provides a way to put off freeing the node until it is
+ *  safe to do so:
+ *  - Readers bracket each read-side section with \c #ubi_epochEnter() and
+ *    \c #ubi_epochExit().  Each reader thread owns one
+ *    \c #ubi_epochReader slot.
+ *  - The writer removes the node as usual, but then passes it to
+ *    \c #ubi_epochRetire() instead of freeing it.  The node is recorded,
+ *    along with the current epoch, in the limbo list.
+ *  - Every so often, the epoch is advanced and the reader slots are
+ *    checked.  Once every reader that was active when a node was retired
+ *    has left its read-side section, nobody can still be holding that
+ *    node, and it is freed.
+ *
+ *  Reclamation is amortized.  \c #ubi_epochRetire() makes a reclamation
+ *  pass each time the limbo list is half full, and a background thread may
+ *  call \c #ubi_epochReclaim() whenever it likes.
+ *
+ *  \c #ubi_epochKillTree() is an epoch-aware version of \c #ubi_btKillTree().
+ *  The cache module can also be told to retire entries rather than free
+ *  them, by giving it a retire function (see \c #ubi_cacheSetRetire())
+ *  that calls \c #ubi_epochRetire().  The free function passed along must
+ *  take a <tt>void *</tt>; don't cast a \c ubi_trKillNodeRtn to fit.
+ *
+ * \b Notes
+ *  - This module makes no use of \c malloc().  The reader slots and the
+ *    limbo list are arrays supplied by the caller.  The retired objects
+ *    themselves are never written to, so readers that are still looking
+ *    at a retired node will find its links intact.
+ *  - Only \c #ubi_epochEnter() and \c #ubi_epochExit() may be called
+ *    concurrently.  All other calls (and the writes to the shared data
+ *    structure) must be serialized by the caller.  That is normally done
+ *    by holding the writer's lock.
+ *  - Read-side sections do not nest, and must be kept short.  A reader
+ *    that stays inside a section holds up all reclamation.
+ *  - This module protects memory, not consistency.  A reader that
+ *    searches a tree while the writer is rebalancing it may miss an entry
+ *    that is present.  Lock-free lookups should use \c #ubi_btFind() (not
+ *    a splay tree search, which modifies the tree) and must tolerate the
+ *    occasional false miss.  Readers that take a lock to search (e.g.,
+ *    to call \c #ubi_cacheGet()) and then release it can use an entry
+ *    safely until they exit the read-side section.
+ *  - This module requires C11 atomics (<tt>stdatomic.h</tt>).
+ *
+ * @see Fraser (2004), "Practical lock-freedom", University of Cambridge
+ *      Computer Laboratory Technical Report 579.
+ */
+
+#include <stdatomic.h>      /* C11 atomic operations. */
+#include "ubi_BinTree.h"    /* For ubi_epochKillTree(). */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ */
+
+/**
+ * @typedef ubi_epochFreeFunc
+ * @brief   Function used to free a retired object.
+ */
+typedef void (*ubi_epochFreeFunc)( void * );
+
+/**
+ * @struct  ubi_epochReader
+ * @brief   A reader slot.
+ * @details Each reader thread needs a slot of its own.  The slot holds
+ *          the epoch that was current when the reader entered its
+ *          read-side section, or zero if the reader is not in one.
+ */
+typedef struct
+  {
+  _Atomic unsigned long epoch;  /**< Epoch at entry, or 0 if idle.  */
+  } ubi_epochReader;
+
+/** Pointer to a \c #ubi_epochReader. */
+typedef ubi_epochReader *ubi_epochReaderPtr;
+
+/**
+ * @struct  ubi_epochLimbo
+ * @brief   A limbo list entry, describing one retired object.
+ */
+typedef struct
+  {
+  void             *ptr;        /**< The retired object.            */
+  ubi_epochFreeFunc free_func;  /**< Function that will free it.    */
+  unsigned long     epoch;      /**< Epoch at which it was retired. */
+  } ubi_epochLimbo;
+
+/**
+ * @struct  ubi_epochDomainStruct
+ * @brief   Epoch domain header structure.
+ * @details A domain covers one or more shared data structures, the reader
+ *          threads that read them, and the objects retired from them.
+ * @note    `%ubi_epochDomain` is a typedef for
+ *          `struct %ubi_epochDomainStruct`.
+ */
+struct ubi_epochDomainStruct
+  {
+  _Atomic unsigned long global;   /**< The current epoch.  Never zero.    */
+  ubi_epochReaderPtr    readers;  /**< Array of reader slots.             */
+  unsigned int          nreaders; /**< Number of reader slots.            */
+  ubi_epochLimbo       *limbo;    /**< The limbo list (a ring buffer).    */
+  unsigned long         size;     /**< Number of entries in the ring.     */
+  unsigned long         head;     /**< Index of the oldest entry.         */
+  unsigned long         count;    /**< Number of entries in the ring.     */
+  unsigned long         retired;  /**< Total objects retired.             */
+  unsigned long         freed;    /**< Total objects freed.               */
+  };
+
+/**
+ * @typedef ubi_epochDomain
+ * @brief   This is the short (typedef'd) name for a
+ *          `struct ubi_epochDomainStruct`.
+ */
+typedef struct ubi_epochDomainStruct ubi_epochDomain;
+
+/** Pointer to a \c #ubi_epochDomain. */
+typedef ubi_epochDomain *ubi_epochDomainPtr;
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ */
+
+/** Return the number of retired objects not yet freed. */
+#define ubi_epochPending( D ) (((ubi_epochDomainPtr)(D))->count)
+
+
+/* -------------------------------------------------------------------------- **
+ * Prototypes...
+ */
+
+ubi_epochDomainPtr ubi_epochInit( ubi_epochDomainPtr DomainPtr,
+                                  ubi_epochReaderPtr Readers,
+                                  unsigned int       NumReaders,
+                                  ubi_epochLimbo    *Limbo,
+                                  unsigned long      LimboSize );
+
+void ubi_epochEnter( ubi_epochDomainPtr DomainPtr, ubi_epochReaderPtr Reader );
+
+void ubi_epochExit( ubi_epochReaderPtr Reader );
+
+void ubi_epochRetire( ubi_epochDomainPtr DomainPtr,
+                      void              *Ptr,
+                      ubi_epochFreeFunc  FreeFunc );
+
+unsigned long ubi_epochReclaim( ubi_epochDomainPtr DomainPtr );
+
+void ubi_epochSynchronize( ubi_epochDomainPtr DomainPtr );
+
+unsigned long ubi_epochKillTree( ubi_epochDomainPtr DomainPtr,
+                                 ubi_btRootPtr      RootPtr,
+                                 ubi_epochFreeFunc  FreeNode );
+
+/* ================================ The End ================================= */
+#endif /* UBI_EPOCH_H */
@@ -0,0 +1,694 @@
+/* ========================================================================== **
+ *                                ubi_ExtSort.c
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module implements an external (file based) sort of text lines.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ */
+
+#include <stdlib.h>         /* malloc(3), realloc(3), free(3).  */
+#include <string.h>         /* strcmp(3), memchr(3), memcpy(3). */
+
+#include "ubi_ExtSort.h"    /* Header for *this* module. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Defined Constants...
+ *
+ *  xsRUN_BUFFER  - The stdio buffer given to each run file.  Up to fan-in
+ *                  run files are open at once, so this is kept small.
+ *  xsMIN_BUFFER  - Smallest read buffer used by a merge.  Merges made
+ *                  during run generation use this size, since the lines
+ *                  in the selection tree already take most of the budget.
+ *  xsDEF_BUFFER  - Buffer size used to pick a default merge fan-in.
+ *  xsMAX_FANIN   - Upper limit on the automatically chosen fan-in.  Each
+ *                  run being merged needs an open file.
+ *  xsLINE_START  - Initial size of a line input buffer.
+ */
+
+#define xsRUN_BUFFER  4096
+#define xsMIN_BUFFER  4096
+#define xsDEF_BUFFER  65536
+#define xsMAX_FANIN   128
+#define xsLINE_START  256
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  xsRec     - A line held in the run generation tree.  The <run> number
+ *              is the primary sort key, followed by the line itself and
+ *              then the input sequence number (which keeps the sort
+ *              stable and the keys unique).
+ *  xsCursor  - The current line of a run that is being merged, and a read
+ *              buffer of the merge's own.  The run index is used to break
+ *              ties.
+ *  xsKey     - Search key for either tree.  The tree comparison function
+ *              is only given the key and a node, so the key carries the
+ *              caller's line comparison function along with it.
+ *  xsRunList - The open run files, oldest first, each with its level: 0
+ *              for a run made by replacement selection, or one more than
+ *              the highest level of the runs merged to make it.
+ */
+
+typedef struct
+  {
+  ubi_trNode    node;
+  unsigned long run;
+  unsigned long seq;
+  size_t        len;
+  char          line[1];
+  } xsRec;
+
+typedef xsRec *xsRecPtr;
+
+typedef struct
+  {
+  ubi_trNode    node;
+  FILE         *fp;
+  char         *buf;
+  size_t        bufsize;
+  long          len;
+  unsigned long idx;
+  char         *in;
+  size_t        in_size;
+  size_t        in_pos;
+  size_t        in_len;
+  } xsCursor;
+
+typedef xsCursor *xsCursorPtr;
+
+typedef struct
+  {
+  ubi_xsCompFunc cmp;
+  void          *rec;
+  } xsKey;
+
+typedef struct
+  {
+  FILE         **fp;
+  unsigned long *level;
+  unsigned long  count;
+  } xsRunList;
+
+
+/* -------------------------------------------------------------------------- **
+ * Internal functions...
+ */
+
+static int RecCompare( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare two run generation records.
+   *
+   *  Input:  ItemPtr - Pointer to an xsKey that indicates the new record.
+   *          NodePtr - Pointer to a record in the tree.
+   *
+   *  Output: Negative, zero, or positive, as per strcmp(3).
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  xsRecPtr A = (xsRecPtr)((xsKey *)ItemPtr)->rec;
+  xsRecPtr B = (xsRecPtr)NodePtr;
+  int      tmp;
+
+  if( A->run != B->run )
+    return( (A->run < B->run) ? -1 : 1 );
+  tmp = (*((xsKey *)ItemPtr)->cmp)( A->line, B->line );
+  if( tmp )
+    return( tmp );
+  return( (A->seq < B->seq) ? -1 : ((A->seq > B->seq) ? 1 : 0) );
+  } /* RecCompare */
+
+static int CursorCompare( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare the current lines of two merge cursors.
+   *
+   *  Input:  ItemPtr - Pointer to an xsKey that indicates a cursor.
+   *          NodePtr - Pointer to a cursor in the tree.
+   *
+   *  Output: Negative, zero, or positive, as per strcmp(3).
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  xsCursorPtr A = (xsCursorPtr)((xsKey *)ItemPtr)->rec;
+  xsCursorPtr B = (xsCursorPtr)NodePtr;
+  int         tmp;
+
+  tmp = (*((xsKey *)ItemPtr)->cmp)( A->buf, B->buf );
+  if( tmp )
+    return( tmp );
+  return( (A->idx < B->idx) ? -1 : ((A->idx > B->idx) ? 1 : 0) );
+  } /* CursorCompare */
+
+static long ReadLine( FILE *fp, char **bufp, size_t *sizep )
+  /* ------------------------------------------------------------------------ **
+   * Read one line of any length, growing the buffer as needed.
+   *
+   *  Input:  fp    - Stream from which to read.
+   *          bufp  - Pointer to the buffer pointer.  The buffer is
+   *                  allocated if *bufp is NULL, and may be reallocated.
+   *          sizep - Pointer to the current size of the buffer.
+   *
+   *  Output: The length of the line, with the newline removed, or
+   *          -1 at end of file, or
+   *          -2 if memory could not be allocated.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  size_t len = 0;
+  char  *tmp;
+
+  if( NULL == *bufp )
+    {
+    if( NULL == (*bufp = (char *)malloc( xsLINE_START )) )
+      return( -2 );
+    *sizep = xsLINE_START;
+    }
+
+  for(;;)
+    {
+    if( NULL == fgets( *bufp + len, (int)(*sizep - len), fp ) )
+      return( (len > 0) ? (long)len : -1 );
+    len += strlen( *bufp + len );
+    if( (len > 0) && ('\n' == (*bufp)[len - 1]) )
+      {
+      (*bufp)[--len] = '\0';
+      return( (long)len );
+      }
+    if( len + 1 < *sizep )      /* Final line, without a newline. */
+      return( (long)len );
+    if( NULL == (tmp = (char *)realloc( *bufp, 2 * *sizep )) )
+      return( -2 );
+    *bufp   = tmp;
+    *sizep *= 2;
+    }
+  } /* ReadLine */
+
+static long CursorRead( xsCursorPtr c )
+  /* ------------------------------------------------------------------------ **
+   * Read the next line of a run into a merge cursor.
+   *
+   *  Input:  c - The cursor.  Its run file is read in blocks of in_size
+   *              bytes, into its own buffer.
+   *
+   *  Output: The length of the line, with the newline removed, or
+   *          -1 at end of file (or on a read error; check ferror()), or
+   *          -2 if memory could not be allocated.
+   *
+   *  Notes:  The run files have only a small stdio buffer.  fread() of a
+   *          larger block normally goes straight to the file, so this is
+   *          how a merge gets the benefit of a large buffer.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  size_t len = 0;
+  size_t n;
+  size_t size;
+  char  *nl;
+  char  *tmp;
+
+  for(;;)
+    {
+    if( c->in_pos >= c->in_len )
+      {
+      c->in_pos = 0;
+      c->in_len = fread( c->in, 1, c->in_size, c->fp );
+      if( 0 == c->in_len )
+        {
+        if( 0 == len )
+          return( -1 );
+        c->buf[len] = '\0';    /* Final line, without a newline. */
+        return( (long)len );
+        }
+      }
+    nl = (char *)memchr( c->in + c->in_pos, '\n', c->in_len - c->in_pos );
+    n  = nl ? (size_t)(nl - (c->in + c->in_pos)) : (c->in_len - c->in_pos);
+    if( (NULL == c->buf) || (len + n + 1 > c->bufsize) )
+      {
+      size = c->bufsize ? c->bufsize : xsLINE_START;
+      while( size < len + n + 1 )
+        size *= 2;
+      if( NULL == (tmp = (char *)realloc( c->buf, size )) )
+        return( -2 );
+      c->buf     = tmp;
+      c->bufsize = size;
+      }
+    (void)memcpy( c->buf + len, c->in + c->in_pos, n );
+    len       += n;
+    c->in_pos += n;
+    if( nl )
+      {
+      c->in_pos++;
+      c->buf[len] = '\0';
+      return( (long)len );
+      }
+    }
+  } /* CursorRead */
+
+static ubi_trBool WriteLine( FILE *fp, const char *line, size_t len )
+  /* ------------------------------------------------------------------------ **
+   * Write a line, followed by a newline.
+   *
+   *  Output: TRUE on success, FALSE on a write error.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( (fwrite( line, 1, len, fp ) != len) || (EOF == putc( '\n', fp )) )
+    return( ubi_trFALSE );
+  return( ubi_trTRUE );
+  } /* WriteLine */
+
+static FILE *TempRun( void )
+  /* ------------------------------------------------------------------------ **
+   * Create a (temporary) run file, with a small stdio buffer.
+   *
+   *  Output: The new run file, or NULL on error.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  FILE *fp;
+
+  if( NULL != (fp = tmpfile()) )
+    (void)setvbuf( fp, NULL, _IOFBF, xsRUN_BUFFER );
+  return( fp );
+  } /* TempRun */
+
+static void CloseRuns( xsRunList *Runs, unsigned long first )
+  /* ------------------------------------------------------------------------ **
+   * Close runs, starting with run number <first>.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long i;
+
+  for( i = first; i < Runs->count; i++ )
+    (void)fclose( Runs->fp[i] );
+  Runs->count = first;
+  } /* CloseRuns */
+
+static void KillRec( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Tree node freeing function; used to clean up after an error.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  free( NodePtr );
+  } /* KillRec */
+
+static ubi_trBool MergeRuns( ubi_xsSortPtr SortPtr,
+                             FILE        **Runs,
+                             unsigned long count,
+                             FILE         *Out,
+                             size_t        bufsize )
+  /* ------------------------------------------------------------------------ **
+   * Merge a set of runs into a single sorted output stream.
+   *
+   *  Input:  SortPtr - Sort parameters.
+   *          Runs    - Array of run files to be merged.
+   *          count   - Number of runs in <Runs>.
+   *          Out     - Output stream.
+   *          bufsize - Size of the read buffer for each run.
+   *
+   *  Output: TRUE on success, else FALSE.
+   *
+   *  Notes:  The read buffers exist only for the duration of the merge.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_trRoot    Root[1];
+  xsKey         Key;
+  xsCursorPtr   Cur;
+  xsCursorPtr   c;
+  unsigned long i;
+  ubi_trBool    ok = ubi_trTRUE;
+
+  Cur = (xsCursorPtr)calloc( count, sizeof( xsCursor ) );
+  if( NULL == Cur )
+    return( ubi_trFALSE );
+
+  (void)ubi_trInitTree( Root, CursorCompare, 0 );
+  Key.cmp = SortPtr->cmp;
+
+  /* Load the first line of each run into the selection tree. */
+  for( i = 0; ok && (i < count); i++ )
+    {
+    c          = &Cur[i];
+    c->fp      = Runs[i];
+    c->idx     = i;
+    c->in_size = bufsize;
+    if( (NULL == (c->in = (char *)malloc( bufsize )))
+     || (EOF == fflush( c->fp )) || (0 != fseek( c->fp, 0L, SEEK_SET )) )
+      ok = ubi_trFALSE;
+    else
+      {
+      c->len = CursorRead( c );
+      if( c->len >= 0 )
+        {
+        Key.rec = c;
+        (void)ubi_trInsert( Root, c, &Key, NULL );
+        }
+      else if( (-2 == c->len) || ferror( c->fp ) )
+        ok = ubi_trFALSE;
+      }
+    }
+
+  /* Write the smallest line and replace it with the next from that run. */
+  while( ok && (NULL != (c = (xsCursorPtr)ubi_trFirst( Root->root ))) )
+    {
+    (void)ubi_trRemove( Root, c );
+    if( !WriteLine( Out, c->buf, (size_t)c->len ) )
+      ok = ubi_trFALSE;
+    c->len = CursorRead( c );
+    if( c->len >= 0 )
+      {
+      Key.rec = c;
+      (void)ubi_trInsert( Root, c, &Key, NULL );
+      }
+    else if( (-2 == c->len) || ferror( c->fp ) )
+      ok = ubi_trFALSE;
+    }
+
+  for( i = 0; i < count; i++ )
+    {
+    free( Cur[i].in );
+    free( Cur[i].buf );
+    }
+  free( Cur );
+  return( ok );
+  } /* MergeRuns */
+
+static ubi_trBool Compact( ubi_xsSortPtr SortPtr, xsRunList *Runs )
+  /* ------------------------------------------------------------------------ **
+   * Merge the newest runs into one, to make room for more.
+   *
+   *  Input:  SortPtr - Sort parameters.
+   *          Runs    - The run list, which is full (it holds fan-in runs).
+   *
+   *  Output: TRUE on success, else FALSE.
+   *
+   *  Notes:  The runs merged are those of the lowest levels, starting
+   *          with the newest, until at least half of the runs are taken.
+   *          Runs of a level are only merged again once there are enough
+   *          of them, so each line is copied about log(runs) / log(fan-in
+   *          / 2) times in all, and no more than fan-in run files (plus
+   *          the one being written) are ever open.  The levels never
+   *          increase from the oldest run to the newest, so the runs
+   *          merged are always at the end of the list.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long first = Runs->count;
+  unsigned long level = Runs->level[Runs->count - 1];
+  unsigned long want  = (Runs->count < 4) ? 2 : (Runs->count / 2);
+  FILE         *fp;
+  ubi_trBool    ok;
+
+  for(;;)
+    {
+    while( (first > 0) && (Runs->level[first - 1] <= level) )
+      first--;
+    if( (0 == first) || ((Runs->count - first) >= want) )
+      break;
+    level = Runs->level[first - 1];
+    }
+
+  if( NULL == (fp = TempRun()) )
+    return( ubi_trFALSE );
+  ok = MergeRuns( SortPtr, &Runs->fp[first], Runs->count - first,
+                  fp, xsMIN_BUFFER );
+  CloseRuns( Runs, first );
+  Runs->fp[first]    = fp;
+  Runs->level[first] = level + 1;
+  Runs->count        = first + 1;
+  SortPtr->passes++;
+  return( ok );
+  } /* Compact */
+
+static ubi_trBool MakeRuns( ubi_xsSortPtr SortPtr,
+                            FILE         *In,
+                            xsRunList    *Runs,
+                            unsigned long fanin,
+                            unsigned long lines )
+  /* ------------------------------------------------------------------------ **
+   * Read the input and write it out as a set of sorted runs, using
+   * replacement selection.
+   *
+   *  Input:  SortPtr - Sort parameters.
+   *          In      - Input stream.
+   *          Runs    - Run list to which the new runs will be added.
+   *          fanin   - The most runs that may be open at once.
+   *          lines   - Memory budget for the lines in the tree.
+   *
+   *  Output: TRUE on success, else FALSE.
+   *
+   *  Notes:  The tree is keyed on {run, line, seq}, so the first node in
+   *          the tree is always the next line to be written.  A line read
+   *          from the input is compared against the line that was just
+   *          written.  If it is smaller, it missed its chance and is
+   *          tagged for the next run.
+   *          When the run list is full, some of the runs are merged (see
+   *          Compact()) before the next one is started.  Each run is
+   *          flushed when it is finished, so that write errors show up
+   *          early.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_trRoot    Root[1];
+  xsKey         Key;
+  xsRecPtr      Rec;
+  xsRecPtr      Last   = NULL;
+  FILE         *Run    = NULL;
+  unsigned long cur    = 0;
+  unsigned long seq    = 0;
+  unsigned long mem    = 0;
+  char         *buf    = NULL;
+  size_t        bsize  = 0;
+  long          len    = 0;
+  ubi_trBool    eof    = ubi_trFALSE;
+  ubi_trBool    ok     = ubi_trTRUE;
+
+  (void)ubi_trInitTree( Root, RecCompare, 0 );
+  Key.cmp = SortPtr->cmp;
+
+  do
+    {
+    /* Top up the tree until the memory budget is reached. */
+    while( !eof && ((NULL == Root->root) || (mem < lines)) )
+      {
+      len = ReadLine( In, &buf, &bsize );
+      if( len < 0 )
+        {
+        eof = ubi_trTRUE;
+        ok  = (-1 == len) && !ferror( In );
+        break;
+        }
+      Rec = (xsRecPtr)malloc( sizeof( xsRec ) + (size_t)len );
+      if( NULL == Rec )
+        {
+        eof = ubi_trTRUE;
+        ok  = ubi_trFALSE;
+        break;
+        }
+      (void)memcpy( Rec->line, buf, (size_t)len + 1 );
+      Rec->len = (size_t)len;
+      Rec->seq = seq++;
+      Rec->run = cur;
+      if( Last && ((*SortPtr->cmp)( Rec->line, Last->line ) < 0) )
+        Rec->run = cur + 1;
+      Key.rec = Rec;
+      (void)ubi_trInsert( Root, Rec, &Key, NULL );
+      mem += sizeof( xsRec ) + (unsigned long)len;
+      SortPtr->records++;
+      }
+
+    /* Move the smallest line from the tree to the current run. */
+    Rec = (xsRecPtr)ubi_trFirst( Root->root );
+    if( ok && (NULL != Rec) )
+      {
+      (void)ubi_trRemove( Root, Rec );
+      if( (NULL == Run) || (Rec->run != cur) )
+        {
+        if( Run && (EOF == fflush( Run )) )
+          ok = ubi_trFALSE;
+        if( ok && (Runs->count >= fanin) )
+          ok = Compact( SortPtr, Runs );
+        if( ok && (NULL == (Run = TempRun())) )
+          ok = ubi_trFALSE;
+        if( ok )
+          {
+          Runs->fp[Runs->count]    = Run;
+          Runs->level[Runs->count] = 0;
+          Runs->count++;
+          SortPtr->runs++;
+          }
+        cur = Rec->run;
+        }
+      if( ok && !WriteLine( Run, Rec->line, Rec->len ) )
+        ok = ubi_trFALSE;
+      if( Last )
+        {
+        mem -= sizeof( xsRec ) + (unsigned long)Last->len;
+        free( Last );
+        }
+      Last = Rec;
+      }
+    } while( ok && (NULL != Rec) );
+
+  free( Last );
+  free( buf );
+  (void)ubi_trKillTree( Root, KillRec );
+  return( ok );
+  } /* MakeRuns */
+
+
+
+/* -------------------------------------------------------------------------- **
+ * Exported functions...
+ */
+
+ubi_xsSortPtr ubi_xsInit( ubi_xsSortPtr  SortPtr,
+                          ubi_xsCompFunc CompFunc,
+                          unsigned long  MaxMemory,
+                          unsigned int   MaxFanIn )
+  /** Initialize an external sort control structure.
+   *
+   * @param   SortPtr   A pointer to the \c #ubi_xsSort structure that is
+   *                    to be initialized.
+   * @param   CompFunc  The line comparison function.  If NULL, \c strcmp()
+   *                    is used.
+   * @param   MaxMemory The memory budget, in bytes.  This is shared
+   *                    between the lines held in memory and the I/O
+   *                    buffers.  Values below 64K are rounded up to 64K.
+   * @param   MaxFanIn  The maximum number of runs to merge at once, which
+   *                    is also the most run files that are kept open.
+   *                    Zero means "pick one based on the memory budget".
+   *                    The minimum is two, and the fan-in is cut back if
+   *                    the run files' buffers would take more than half
+   *                    of the budget.
+   *
+   * @returns A pointer to the initialized structure (i.e., the same as
+   *          \p SortPtr).
+   */
+  {
+  if( SortPtr )
+    {
+    SortPtr->cmp        = CompFunc ? CompFunc : strcmp;
+    SortPtr->max_memory = (MaxMemory < 65536) ? 65536 : MaxMemory;
+    SortPtr->max_fanin  = MaxFanIn;
+    SortPtr->records    = 0;
+    SortPtr->runs       = 0;
+    SortPtr->passes     = 0;
+    }
+  return( SortPtr );
+  } /* ubi_xsInit */
+
+ubi_trBool ubi_xsSortFile( ubi_xsSortPtr SortPtr, FILE *In, FILE *Out )
+  /** Sort the lines read from one stream, writing them to another.
+   *
+   * @param   SortPtr   A pointer to an initialized \c #ubi_xsSort.
+   * @param   In        The input stream, which is read to end of file.
+   * @param   Out       The output stream.  The sorted lines are written
+   *                    to this stream, which is flushed but not closed.
+   *
+   * @returns TRUE on success, FALSE if a read, write, or memory
+   *          allocation error occurred (check \c errno).
+   *
+   * \b Notes
+   *  - The statistics fields of \p SortPtr are reset and then filled in.
+   *  - Temporary files are created with \c tmpfile(), so the \c TMPDIR
+   *    (or equivalent) must have room for a copy of the input, plus the
+   *    largest group of runs that is merged while runs are still being
+   *    made (about half of the input).
+   *  - No more than fan-in run files are open at once, plus one for the
+   *    merge output.  Each has a small (4K) stdio buffer, and that, along
+   *    with the read buffers used by merges made during run generation,
+   *    is taken out of the budget before the rest is given to the lines
+   *    in memory.  The large read buffers, of about
+   *    <tt>max_memory / fan-in</tt> bytes each, are only used by the final
+   *    merge, after the lines have been released.
+   */
+  {
+  xsRunList     Runs = { NULL, NULL, 0 };
+  unsigned long fanin;
+  unsigned long limit;
+  unsigned long lines;
+  size_t        bufsize;
+  ubi_trBool    ok = ubi_trFALSE;
+
+  SortPtr->records = 0;
+  SortPtr->runs    = 0;
+  SortPtr->passes  = 0;
+
+  /* Work out the merge fan-in.  The open run files and the merge buffers
+   * used during run generation may take up to half of the budget.
+   */
+  fanin = SortPtr->max_fanin;
+  if( 0 == fanin )
+    {
+    fanin = SortPtr->max_memory / xsDEF_BUFFER;
+    if( fanin > xsMAX_FANIN )
+      fanin = xsMAX_FANIN;
+    }
+  limit = ((SortPtr->max_memory / 2) / xsRUN_BUFFER - 1) / 2;
+  if( fanin > limit )
+    fanin = limit;
+  if( fanin < 2 )
+    fanin = 2;
+  lines   = SortPtr->max_memory
+          - (fanin * (xsRUN_BUFFER + xsMIN_BUFFER) + xsRUN_BUFFER);
+  bufsize = (size_t)((SortPtr->max_memory - (fanin * xsRUN_BUFFER)) / fanin);
+  if( bufsize < xsMIN_BUFFER )
+    bufsize = xsMIN_BUFFER;
+
+  Runs.fp    = (FILE **)malloc( fanin * sizeof( FILE * ) );
+  Runs.level = (unsigned long *)malloc( fanin * sizeof( unsigned long ) );
+
+  if( (NULL != Runs.fp) && (NULL != Runs.level) )
+    {
+    /* Phase one: generate the runs, merging as needed to keep no more than
+     * fanin of them.
+     */
+    ok = MakeRuns( SortPtr, In, &Runs, fanin, lines );
+
+    /* Phase two: merge what is left, directly to the output. */
+    if( ok && Runs.count )
+      {
+      ok = MergeRuns( SortPtr, Runs.fp, Runs.count, Out, bufsize );
+      SortPtr->passes++;
+      }
+    }
+  if( EOF == fflush( Out ) )
+    ok = ubi_trFALSE;
+
+  CloseRuns( &Runs, 0 );
+  free( Runs.level );
+  free( Runs.fp );
+  return( ok );
+  } /* ubi_xsSortFile */
+
+/* ================================ The End ================================= */
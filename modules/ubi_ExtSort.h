@@ -0,0 +1,128 @@
+#ifndef UBI_EXTSORT_H
+#define UBI_EXTSORT_H
+/* ========================================================================== **
+ *                                ubi_ExtSort.h
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module implements an external (file based) sort of text lines.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ *//**
+ * @file      ubi_ExtSort.h
+ * @author    Christopher R. Hertel
+ * @brief     External sort of text lines, based on \c ubi_AVLtree.
+ * @date      Oct 2026
+ * @version   \$Id$
+ * @copyright Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * @details
+ *  This module sorts a stream of text lines that may be much larger than
+ *  the available memory.  It works in the classic two phases:
+ *
+ *  - <b>Run generation.</b>  Input lines are read into an AVL tree that
+ *    acts as the selection heap.  The smallest line is repeatedly taken
+ *    from the tree (\c #ubi_btFirst() plus \c #ubi_avlRemove()) and
+ *    written to the current run, and its place is taken by the next input
+ *    line.  A new line that sorts before the line just written cannot go
+ *    into the current run, so it is tagged for the next one.  This is
+ *    "replacement selection".  On randomly ordered input, it produces runs
+ *    that average about twice the size of the memory budget; on input
+ *    that is already mostly sorted, the runs are much longer.
+ *
+ *  - <b>Merging.</b>  The runs are merged using a second AVL tree that
+ *    holds the current line from each run.  No more than fan-in runs are
+ *    kept; when that many exist and another is about to be started, the
+ *    newest runs are merged into one (taking runs of the same size class
+ *    together), so run generation and merging overlap.  What is left at
+ *    the end of the input is merged directly to the output.
+ *
+ *  Runs are kept in temporary files created with \c tmpfile(), each with
+ *  a small stdio buffer.  The memory budget covers the lines held in the
+ *  selection tree plus those buffers and the read buffers used by the
+ *  merges.  Only the final merge, which runs once the lines in the tree
+ *  have been released, uses large read buffers.
+ *
+ * \b Notes
+ *  - Unlike the data structure modules, this module allocates its own
+ *    memory (using \c malloc()) and performs its own I/O.  It is an
+ *    application of the tree modules rather than a building block.
+ *  - Records are newline-terminated lines.  A final line with no newline
+ *    is handled, but a newline will be added in the output.  Lines may
+ *    be of any length, but must not contain NUL bytes.
+ *  - The sort is stable; lines that compare equal are written in the
+ *    order in which they were read.
+ */
+
+#include <stdio.h>          /* FILE, for the sort input and output. */
+#include "ubi_AVLtree.h"    /* AVL trees are used as selection heaps. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ */
+
+/**
+ * @typedef ubi_xsCompFunc
+ * @brief   Line comparison function.
+ * @details A function with the same semantics as \c strcmp(3).  The two
+ *          parameters are NUL-terminated lines (without the newline).
+ */
+typedef int (*ubi_xsCompFunc)( const char *, const char * );
+
+/**
+ * @struct  ubi_xsSort
+ * @brief   External sort control structure.
+ * @details Holds the sort parameters and, once a sort has completed, some
+ *          statistics describing the work that was done.
+ */
+typedef struct
+  {
+  ubi_xsCompFunc cmp;         /**< Line comparison function.              */
+  unsigned long  max_memory;  /**< Memory budget, in bytes.               */
+  unsigned int   max_fanin;   /**< Max runs merged at once.  0 == auto.   */
+  unsigned long  records;     /**< Number of lines sorted.                */
+  unsigned long  runs;        /**< Number of initial runs generated.      */
+  unsigned long  passes;      /**< Number of merges made, incl. the last. */
+  } ubi_xsSort;
+
+/** Pointer to a \c #ubi_xsSort structure. */
+typedef ubi_xsSort *ubi_xsSortPtr;
+
+
+/* -------------------------------------------------------------------------- **
+ * Prototypes...
+ */
+
+ubi_xsSortPtr ubi_xsInit( ubi_xsSortPtr  SortPtr,
+                          ubi_xsCompFunc CompFunc,
+                          unsigned long  MaxMemory,
+                          unsigned int   MaxFanIn );
+
+ubi_trBool ubi_xsSortFile( ubi_xsSortPtr SortPtr, FILE *In, FILE *Out );
+
+/* ================================ The End ================================= */
+#endif /* UBI_EXTSORT_H */
@@ -0,0 +1,334 @@
+/* ========================================================================== **
+ *                                 ubi_Heap.c
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module implements a pairing heap (a priority queue).
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ */
+
+#include "ubi_Heap.h"   /* Header for *this* module. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Internal functions...
+ */
+
+static ubi_hpNodePtr Meld( ubi_hpCompFunc cmp,
+                           ubi_hpNodePtr  A,
+                           ubi_hpNodePtr  B )
+  /* ------------------------------------------------------------------------ **
+   * Combine two heap-ordered trees into one.
+   *
+   *  Input:  cmp - The heap comparison function.
+   *          A   - The root of the first tree.
+   *          B   - The root of the second tree.
+   *
+   *  Output: A pointer to the root of the combined tree.
+   *
+   *  Notes:  Neither A nor B may have siblings.  The larger of the two
+   *          becomes the leftmost child of the smaller.  If the two are
+   *          equal, A remains the root.  That keeps equal keys in first
+   *          come, first served order in most cases (but this is not a
+   *          promise; the heap is not stable).
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_hpNodePtr tmp;
+
+  if( (*cmp)( B, A ) < 0 )
+    {
+    tmp = A;
+    A   = B;
+    B   = tmp;
+    }
+  B->Prev = A;
+  B->Next = A->Child;
+  if( NULL != A->Child )
+    A->Child->Prev = B;
+  A->Child = B;
+  return( A );
+  } /* Meld */
+
+static ubi_hpNodePtr Combine( ubi_hpCompFunc cmp, ubi_hpNodePtr First )
+  /* ------------------------------------------------------------------------ **
+   * Combine a list of siblings into a single tree, using the standard
+   * two-pass method.
+   *
+   *  Input:  cmp   - The heap comparison function.
+   *          First - The leftmost of a list of siblings.
+   *
+   *  Output: A pointer to the root of the combined tree, or NULL if
+   *          <First> was NULL.
+   *
+   *  Notes:  The first pass melds the siblings in pairs, from left to
+   *          right.  The melded pairs are pushed onto a stack (linked
+   *          through the Next pointer), which reverses their order.  The
+   *          second pass pops the stack, melding each pair into the
+   *          result, so the pairs are combined from right to left.  No
+   *          recursion is needed.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_hpNodePtr Stack = NULL;
+  ubi_hpNodePtr A, B;
+
+  /* Pass one: left to right, in pairs. */
+  while( NULL != First )
+    {
+    A = First;
+    B = A->Next;
+    if( NULL == B )
+      First = NULL;
+    else
+      {
+      First   = B->Next;
+      B->Next = B->Prev = NULL;
+      }
+    A->Next = A->Prev = NULL;
+    if( NULL != B )
+      A = Meld( cmp, A, B );
+    A->Next = Stack;
+    Stack   = A;
+    }
+
+  if( NULL == Stack )
+    return( NULL );
+
+  /* Pass two: right to left, into a single tree. */
+  A       = Stack;
+  Stack   = A->Next;
+  A->Next = NULL;
+  while( NULL != Stack )
+    {
+    B       = Stack;
+    Stack   = B->Next;
+    B->Next = NULL;
+    A       = Meld( cmp, B, A );
+    }
+  return( A );
+  } /* Combine */
+
+static void Cut( ubi_hpNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Detach a node (and its subtree) from its parent and siblings.
+   *
+   *  Input:  NodePtr - The node to be detached.  This must not be the root
+   *                    of the heap.
+   *
+   *  Notes:  If the node is a leftmost child, then Prev points to the
+   *          parent and the parent's Child pointer must be updated.
+   *          Otherwise, Prev points to the left-hand sibling.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_hpNodePtr Prev = NodePtr->Prev;
+
+  if( Prev->Child == NodePtr )
+    Prev->Child = NodePtr->Next;
+  else
+    Prev->Next = NodePtr->Next;
+  if( NULL != NodePtr->Next )
+    NodePtr->Next->Prev = Prev;
+  NodePtr->Next = NodePtr->Prev = NULL;
+  } /* Cut */
+
+
+/* -------------------------------------------------------------------------- **
+ * Exported functions...
+ */
+
+ubi_hpRootPtr ubi_hpInitHeap( ubi_hpRootPtr HeapPtr, ubi_hpCompFunc CompFunc )
+  /** Initialize a heap header structure.
+   *
+   * @param   HeapPtr   A pointer to the \c #ubi_hpRoot to be initialized.
+   * @param   CompFunc  The function used to compare two nodes.
+   *
+   * @returns A pointer to the initialized heap header (i.e., the same as
+   *          \p HeapPtr).
+   */
+  {
+  if( HeapPtr )
+    {
+    HeapPtr->root  = NULL;
+    HeapPtr->cmp   = CompFunc;
+    HeapPtr->count = 0;
+    }
+  return( HeapPtr );
+  } /* ubi_hpInitHeap */
+
+ubi_hpNodePtr ubi_hpInitNode( ubi_hpNodePtr NodePtr )
+  /** Initialize a heap node.
+   *
+   * @param   NodePtr   Pointer to the \c #ubi_hpNode to be initialized.
+   *
+   * @returns A pointer to the initialized node (i.e., the same as
+   *          \p NodePtr).
+   *
+   * \b Note: \c #ubi_hpInsert() initializes the node, so there is no need
+   *          to call this function before inserting a node.
+   */
+  {
+  NodePtr->Child = NULL;
+  NodePtr->Next  = NULL;
+  NodePtr->Prev  = NULL;
+  return( NodePtr );
+  } /* ubi_hpInitNode */
+
+ubi_hpNodePtr ubi_hpInsert( ubi_hpRootPtr HeapPtr, ubi_hpNodePtr NewNode )
+  /** Add a node to the heap.
+   *
+   * @param   HeapPtr   A pointer to the heap.
+   * @param   NewNode   A pointer to the node to be added.  The node must
+   *                    not already be in a heap.
+   *
+   * @returns A pointer to the inserted node (i.e., the same as \p NewNode).
+   *
+   * \b Note: This is an O(1) operation.
+   */
+  {
+  (void)ubi_hpInitNode( NewNode );
+  if( NULL == HeapPtr->root )
+    HeapPtr->root = NewNode;
+  else
+    HeapPtr->root = Meld( HeapPtr->cmp, HeapPtr->root, NewNode );
+  HeapPtr->count++;
+  return( NewNode );
+  } /* ubi_hpInsert */
+
+ubi_hpNodePtr ubi_hpRemoveFirst( ubi_hpRootPtr HeapPtr )
+  /** Remove the smallest node from the heap.
+   *
+   * @param   HeapPtr   A pointer to the heap.
+   *
+   * @returns A pointer to the node that was removed, or NULL if the heap
+   *          was empty.
+   *
+   * \b Note: This is an O(log n) amortized operation.
+   */
+  {
+  ubi_hpNodePtr First = HeapPtr->root;
+
+  if( NULL != First )
+    {
+    HeapPtr->root = Combine( HeapPtr->cmp, First->Child );
+    HeapPtr->count--;
+    First->Child  = NULL;
+    }
+  return( First );
+  } /* ubi_hpRemoveFirst */
+
+ubi_hpNodePtr ubi_hpRemove( ubi_hpRootPtr HeapPtr, ubi_hpNodePtr DeadNode )
+  /** Remove the given node from the heap.
+   *
+   * @param   HeapPtr   A pointer to the heap.
+   * @param   DeadNode  A pointer to the node to be removed.  The node must
+   *                    be in the heap indicated by \p HeapPtr.
+   *
+   * @returns A pointer to the node that was removed (i.e., \p DeadNode).
+   *
+   * \b Note: This is an O(log n) amortized operation.
+   */
+  {
+  ubi_hpNodePtr Sub;
+
+  if( DeadNode == HeapPtr->root )
+    return( ubi_hpRemoveFirst( HeapPtr ) );
+
+  Cut( DeadNode );
+  Sub = Combine( HeapPtr->cmp, DeadNode->Child );
+  DeadNode->Child = NULL;
+  if( NULL != Sub )
+    HeapPtr->root = Meld( HeapPtr->cmp, HeapPtr->root, Sub );
+  HeapPtr->count--;
+  return( DeadNode );
+  } /* ubi_hpRemove */
+
+void ubi_hpDecrease( ubi_hpRootPtr HeapPtr, ubi_hpNodePtr NodePtr )
+  /** Restore heap order after the key of a node has been decreased.
+   *
+   * @param   HeapPtr   A pointer to the heap.
+   * @param   NodePtr   A pointer to a node in the heap.  The caller must
+   *                    already have reduced the node's key (or otherwise
+   *                    changed it so that the node compares as smaller or
+   *                    equal).
+   *
+   * \b Notes
+   *  - This is an O(1) operation, plus its share of the amortized cost of
+   *    the next \c #ubi_hpRemoveFirst().
+   *  - If the key was increased, use \c #ubi_hpUpdate() instead.
+   */
+  {
+  if( NodePtr == HeapPtr->root )
+    return;
+  Cut( NodePtr );
+  HeapPtr->root = Meld( HeapPtr->cmp, HeapPtr->root, NodePtr );
+  } /* ubi_hpDecrease */
+
+void ubi_hpUpdate( ubi_hpRootPtr HeapPtr, ubi_hpNodePtr NodePtr )
+  /** Restore heap order after the key of a node has been changed.
+   *
+   * @param   HeapPtr   A pointer to the heap.
+   * @param   NodePtr   A pointer to a node in the heap, the key of which
+   *                    has been increased, decreased, or otherwise fiddled.
+   *
+   * \b Note: This is equivalent to removing and then re-inserting the node,
+   *          and is an O(log n) amortized operation.  If the key is known
+   *          to have decreased, \c #ubi_hpDecrease() is cheaper.
+   */
+  {
+  (void)ubi_hpRemove( HeapPtr, NodePtr );
+  (void)ubi_hpInsert( HeapPtr, NodePtr );
+  } /* ubi_hpUpdate */
+
+ubi_hpRootPtr ubi_hpMerge( ubi_hpRootPtr HeapPtr, ubi_hpRootPtr OtherPtr )
+  /** Move all of the nodes from one heap into another.
+   *
+   * @param   HeapPtr   A pointer to the heap that will receive the nodes.
+   * @param   OtherPtr  A pointer to the heap that will be emptied.  It
+   *                    must use the same comparison function as
+   *                    \p HeapPtr.
+   *
+   * @returns A pointer to the merged heap (i.e., the same as \p HeapPtr).
+   *
+   * \b Note: This is an O(1) operation.
+   */
+  {
+  if( NULL != OtherPtr->root )
+    {
+    if( NULL == HeapPtr->root )
+      HeapPtr->root = OtherPtr->root;
+    else
+      HeapPtr->root = Meld( HeapPtr->cmp, HeapPtr->root, OtherPtr->root );
+    HeapPtr->count += OtherPtr->count;
+    OtherPtr->root  = NULL;
+    OtherPtr->count = 0;
+    }
+  return( HeapPtr );
+  } /* ubi_hpMerge */
+
+/* ================================ The End ================================= */
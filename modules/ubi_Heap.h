@@ -0,0 +1,198 @@
+#ifndef UBI_HEAP_H
+#define UBI_HEAP_H
+/* ========================================================================== **
+ *                                 ubi_Heap.h
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module implements a pairing heap (a priority queue).
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ *//**
+ * @file      ubi_Heap.h
+ * @author    Christopher R. Hertel
+ * @brief     Pairing heap implementation.
+ * @date      Oct 2026
+ * @version   \$Id$
+ * @copyright Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * @details
+ *  A binary tree makes a perfectly good priority queue: insert the
+ *  entries, then repeatedly take the \c #ubi_btFirst() node.  That gives
+ *  you a fully sorted structure, though, and a priority queue only ever
+ *  needs to know which entry is the smallest.  Keeping the rest of the
+ *  entries in order costs an O(log n) rebalance on every insert and every
+ *  removal.
+ *
+ *  A pairing heap is a multi-way tree in which every node is less than or
+ *  equal to all of its children.  Nothing else is kept in order, so:
+ *  - Insert is O(1).  The new node is simply compared with the root.
+ *  - Finding the minimum is O(1).  It's the root.
+ *  - Removing the minimum is O(log n) amortized.  The children of the old
+ *    root are paired up, left to right, and then the pairs are combined
+ *    right to left.
+ *  - Decreasing the key of a node is O(1) amortized (the best known bound
+ *    is o(log n); in practice it behaves as a constant).  The node is cut
+ *    from its parent and compared with the root.
+ *  - Removing an arbitrary node is O(log n) amortized.
+ *
+ *  Like the other ubiqx modules, the heap is intrusive.  Place a
+ *  \c #ubi_hpNode at the start of your own structure, and provide a
+ *  comparison function that knows how to compare two of your structures.
+ *  The heap never allocates or frees memory.
+ *
+ * @see https://en.wikipedia.org/wiki/Pairing_heap
+ * @see Fredman, Sedgewick, Sleator, and Tarjan (1986), "The pairing heap: a
+ *      new form of self-adjusting heap", Algorithmica 1: 111-129.
+ */
+
+#include "sys_include.h"    /* System-specific includes. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ */
+
+/**
+ * @struct  ubi_hpNodeStruct
+ * @brief   Pairing heap node structure.
+ * @details Each node keeps a pointer to its leftmost child and to its
+ *          right-hand sibling.  The \c Prev pointer indicates the left-hand
+ *          sibling or, for the leftmost child, the parent.  The \c Prev
+ *          pointer is what makes it possible to cut a node out of the heap
+ *          in constant time.
+ * @note    The `%ubi_hpNodeStruct` name is used only as a forward reference.
+ *          `%ubi_hpNode` is a typedef for `struct %ubi_hpNodeStruct`.
+ * @var     ubi_hpNodeStruct::Child
+ *          Pointer to the leftmost child of this node.
+ * @var     ubi_hpNodeStruct::Next
+ *          Pointer to the next (right-hand) sibling of this node.
+ * @var     ubi_hpNodeStruct::Prev
+ *          Pointer to the previous sibling, or to the parent if this node
+ *          is the leftmost child.  NULL at the root.
+ */
+struct ubi_hpNodeStruct
+  {
+  struct ubi_hpNodeStruct *Child;
+  struct ubi_hpNodeStruct *Next;
+  struct ubi_hpNodeStruct *Prev;
+  };
+
+/**
+ * @typedef ubi_hpNode
+ * @brief   This is the short (typedef'd) name for a `struct ubi_hpNodeStruct`.
+ */
+typedef struct ubi_hpNodeStruct ubi_hpNode;
+
+/**
+ * @typedef ubi_hpNodePtr
+ * @brief   Pointer to a `ubi_hpNode`.
+ */
+typedef ubi_hpNode *ubi_hpNodePtr;
+
+/**
+ * @typedef ubi_hpCompFunc
+ * @brief   Heap comparison function.
+ * @details The comparison function is given two nodes, and must return a
+ *          value that is less than, equal to, or greater than zero (0) to
+ *          indicate that the first node is (respectively) less than, equal
+ *          to, or greater than the second.  The smallest node is at the
+ *          top of the heap.
+ */
+typedef int (*ubi_hpCompFunc)( ubi_hpNodePtr, ubi_hpNodePtr );
+
+/**
+ * @struct  ubi_hpRoot
+ * @brief   Heap header structure.
+ * @var     ubi_hpRoot::root
+ *          Pointer to the root (smallest) node of the heap.
+ * @var     ubi_hpRoot::cmp
+ *          Pointer to the comparison function.
+ * @var     ubi_hpRoot::count
+ *          The number of nodes in the heap.
+ */
+typedef struct
+  {
+  ubi_hpNodePtr  root;
+  ubi_hpCompFunc cmp;
+  unsigned long  count;
+  } ubi_hpRoot;
+
+/**
+ * @typedef ubi_hpRootPtr
+ * @brief   Pointer to a \c #ubi_hpRoot structure.
+ */
+typedef ubi_hpRoot *ubi_hpRootPtr;
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ */
+
+/** Macro used to declare and initialize a new heap in one line.
+ *
+ *  For example:
+ * @code
+ *    static ubi_hpNewHeap( TimerQueue, CompareDeadlines );
+ * @endcode
+ *  would translate to
+ * @code
+ *    static ubi_hpRoot TimerQueue[1] = {{ NULL, CompareDeadlines, 0 }};
+ * @endcode
+ */
+#define ubi_hpNewHeap( H, C ) ubi_hpRoot (H)[1] = {{ NULL, (C), 0 }}
+
+/** Return the number of nodes currently in the heap. */
+#define ubi_hpCount( H ) (((ubi_hpRootPtr)(H))->count)
+
+/** Return a pointer to the smallest node in the heap (without removing it),
+ *  or NULL if the heap is empty.
+ */
+#define ubi_hpFirst( H ) (((ubi_hpRootPtr)(H))->root)
+
+
+/* -------------------------------------------------------------------------- **
+ * Prototypes...
+ */
+
+ubi_hpRootPtr ubi_hpInitHeap( ubi_hpRootPtr HeapPtr, ubi_hpCompFunc CompFunc );
+
+ubi_hpNodePtr ubi_hpInitNode( ubi_hpNodePtr NodePtr );
+
+ubi_hpNodePtr ubi_hpInsert( ubi_hpRootPtr HeapPtr, ubi_hpNodePtr NewNode );
+
+ubi_hpNodePtr ubi_hpRemoveFirst( ubi_hpRootPtr HeapPtr );
+
+ubi_hpNodePtr ubi_hpRemove( ubi_hpRootPtr HeapPtr, ubi_hpNodePtr DeadNode );
+
+void ubi_hpDecrease( ubi_hpRootPtr HeapPtr, ubi_hpNodePtr NodePtr );
+
+void ubi_hpUpdate( ubi_hpRootPtr HeapPtr, ubi_hpNodePtr NodePtr );
+
+ubi_hpRootPtr ubi_hpMerge( ubi_hpRootPtr HeapPtr, ubi_hpRootPtr OtherPtr );
+
+/* ================================ The End ================================= */
+#endif /* UBI_HEAP_H */
@@ -0,0 +1,400 @@
+/* ========================================================================== **
+ *                              ubi_MissRatio.c
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module estimates the miss ratio curve of a stream of references.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ */
+
+#include <stddef.h>           /* offsetof()                   */
+#include "ubi_MissRatio.h"    /* Header for *this* module.    */
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ *
+ *  LinkSample()  - Given a pointer to the link field of a sample, return
+ *                  a pointer to the sample.
+ *  HeapSample()  - The same, for the heap field.
+ */
+
+#define LinkSample( L ) \
+  ((ubi_mrcSamplePtr)((char *)(L) - offsetof( ubi_mrcSample, link )))
+
+#define HeapSample( H ) \
+  ((ubi_mrcSamplePtr)((char *)(H) - offsetof( ubi_mrcSample, heap )))
+
+
+/* -------------------------------------------------------------------------- **
+ * Internal functions...
+ */
+
+static int hash_cmp( ubi_btItemPtr ItemPtr, ubi_btNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare a hash against the hash of a sample.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((ubi_mrcSamplePtr)NodePtr)->hash;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* hash_cmp */
+
+static int heap_cmp( ubi_hpNodePtr A, ubi_hpNodePtr B )
+  /* ------------------------------------------------------------------------ **
+   * Heap comparison: the sample with the larger hash comes first.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long HA = HeapSample( A )->hash;
+  unsigned long HB = HeapSample( B )->hash;
+
+  return( (HA > HB) ? -1 : ((HA < HB) ? 1 : 0) );
+  } /* heap_cmp */
+
+static int bucket( double Distance )
+  /* ------------------------------------------------------------------------ **
+   * Find the histogram bucket for a distance.
+   *
+   *  Input:  Distance  - The (scaled) distance.
+   *
+   *  Output: The bucket number, in [0..ubi_mrcBUCKETS-1].
+   *
+   *  Notes:  Distances below 8 go in buckets 0 to 7.  For larger ones,
+   *          the bucket is picked by the position of the top bit and the
+   *          three bits below it.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long d;
+  int           e;
+
+  if( Distance < 8.0 )
+    return( (Distance > 0.0) ? (int)Distance : 0 );
+  if( Distance >= 9.2e18 )
+    return( ubi_mrcBUCKETS - 1 );
+  d = (unsigned long)Distance;
+  for( e = 3; (d >> e) > 1; e++ )
+    ;
+  e = ((e - 2) * 8) + (int)((d >> (e - 3)) & 7);
+  return( (e < ubi_mrcBUCKETS) ? e : (ubi_mrcBUCKETS - 1) );
+  } /* bucket */
+
+static double bucket_low( int Bucket )
+  /* ------------------------------------------------------------------------ **
+   * Return the smallest distance that falls in a bucket.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  double low;
+  int    e;
+
+  if( Bucket < 8 )
+    return( (double)Bucket );
+  low = (double)(8 + (Bucket % 8));
+  for( e = (Bucket / 8) + 2; e > 3; e-- )
+    low *= 2.0;
+  return( low );
+  } /* bucket_low */
+
+static double below( double *Histogram, double Limit )
+  /* ------------------------------------------------------------------------ **
+   * Count the references with a distance below a limit.
+   *
+   *  Input:  Histogram - The histogram to read.
+   *          Limit     - The cache size.
+   *
+   *  Output: The (scaled) number of references that would have hit in an
+   *          LRU cache of the given size.
+   *
+   *  Notes:  The references in the bucket that holds the limit are assumed
+   *          to be spread evenly across it.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  double sum = 0.0;
+  double low, high;
+  int    i;
+
+  for( i = 0; i < ubi_mrcBUCKETS; i++ )
+    {
+    low  = bucket_low( i );
+    if( low >= Limit )
+      break;
+    high = (i < (ubi_mrcBUCKETS - 1)) ? bucket_low( i + 1 ) : (2.0 * low);
+    if( high <= Limit )
+      sum += Histogram[i];
+    else
+      sum += Histogram[i] * ((Limit - low) / (high - low));
+    }
+  return( sum );
+  } /* below */
+
+
+/* -------------------------------------------------------------------------- **
+ * Exported functions...
+ */
+
+ubi_mrcRootPtr ubi_mrcInit( ubi_mrcRootPtr   MrcPtr,
+                            ubi_mrcSamplePtr Samples,
+                            unsigned long    Count,
+                            unsigned long    Rate )
+  /** Initialize a miss ratio curve.
+   *
+   * @param   MrcPtr  A pointer to the \c #ubi_mrcRoot to be initialized.
+   * @param   Samples An array of samples.
+   * @param   Count   The number of samples in the array.
+   * @param   Rate    The initial sampling rate, in parts per million.
+   *
+   * @returns A pointer to the initialized curve (i.e., the same as
+   *          \p MrcPtr), or NULL if \p Count or \p Rate is zero.
+   *
+   * \b Notes:
+   *  - A few thousand samples are enough for a good estimate.  The cost
+   *    of a sampled reference is proportional to the number of samples,
+   *    since the LRU list is walked to find the distance.
+   *  - With a rate of 1000 (0.1%) and 8192 samples, the rate will start
+   *    to drop once there are more than about eight million keys.  The
+   *    average cost of a reference is then a few list steps.
+   */
+  {
+  unsigned long i;
+
+  if( (NULL == MrcPtr) || (NULL == Samples) || (0 == Count) || (0 == Rate) )
+    return( NULL );
+
+  (void)ubi_btInitTree( &MrcPtr->index, hash_cmp, 0 );
+  (void)ubi_dlInitList( &MrcPtr->stack );
+  (void)ubi_hpInitHeap( &MrcPtr->heap, heap_cmp );
+  (void)ubi_dlInitList( &MrcPtr->spare );
+  for( i = 0; i < Count; i++ )
+    (void)ubi_dlAddTail( &MrcPtr->spare, &Samples[i].link );
+
+  MrcPtr->threshold = (Rate >= 1000000)
+                    ? 0xFFFFFFFFUL
+                    : (unsigned long)((double)Rate * 4294.967296);
+  MrcPtr->total = 0.0;
+  MrcPtr->refs  = 0.0;
+  MrcPtr->cold  = 0.0;
+  for( i = 0; i < ubi_mrcBUCKETS; i++ )
+    {
+    MrcPtr->keys[i]  = 0.0;
+    MrcPtr->bytes[i] = 0.0;
+    }
+  return( MrcPtr );
+  } /* ubi_mrcInit */
+
+unsigned long ubi_mrcHash( unsigned long Hash )
+  /** Turn a key hash into a sampling hash.
+   *
+   * @param   Hash  A hash of the key.
+   *
+   * @returns A 32-bit hash, well mixed, to compare with the threshold.
+   *
+   * \b Notes:
+   *  - The mixing makes sure that keys are sampled evenly, even if the
+   *    caller's hash function is weak in its low bits.  It is done
+   *    32 bits at a time, so that it is the same whatever the size of an
+   *    unsigned long.
+   */
+  {
+  unsigned long h;
+
+  h  = (Hash ^ ((Hash >> 16) >> 16)) & 0xFFFFFFFFUL;
+  h ^= h >> 16;
+  h  = (h * 0x45D9F3BUL) & 0xFFFFFFFFUL;
+  h ^= h >> 16;
+  h  = (h * 0x45D9F3BUL) & 0xFFFFFFFFUL;
+  h ^= h >> 16;
+  return( h );
+  } /* ubi_mrcHash */
+
+void ubi_mrcReference( ubi_mrcRootPtr MrcPtr,
+                       unsigned long  Hash,
+                       unsigned long  Size )
+  /** Record a reference to a key.
+   *
+   * @param   MrcPtr  A pointer to the curve.
+   * @param   Hash    The sampling hash of the key (see \c #ubi_mrcHash()).
+   * @param   Size    The size of the key's data, or zero if it is not
+   *                  known.  (The last known size is then used.)
+   *
+   * \b Notes:
+   *  - If the key is not sampled, this is a counter and a comparison.
+   *  - Each sampled reference counts for 1/R references, where R is the
+   *    sampling rate at the time.
+   */
+  {
+  ubi_mrcSamplePtr Sample;
+  ubi_dlNodePtr    p;
+  double           scale, keys, bytes;
+
+  MrcPtr->total += 1.0;
+  if( !ubi_mrcSampled( MrcPtr, Hash ) )
+    return;
+
+  scale = 1.0 / ubi_mrcRate( MrcPtr );
+  MrcPtr->refs += scale;
+  Sample = (ubi_mrcSamplePtr)ubi_btFind( &MrcPtr->index, &Hash );
+  if( Sample )
+    {
+    /* Seen before.  The distance is what is in front of it. */
+    keys  = 0.0;
+    bytes = 0.0;
+    for( p = ubi_dlFirst( &MrcPtr->stack );
+         p != &Sample->link;
+         p = ubi_dlNext( p ) )
+      {
+      keys  += 1.0;
+      bytes += (double)LinkSample( p )->size;
+      }
+    if( Size )
+      Sample->size = Size;
+    MrcPtr->keys[ bucket( keys * scale ) ] += scale;
+    MrcPtr->bytes[ bucket( (bytes * scale) + (double)Sample->size ) ] += scale;
+    (void)ubi_dlRemThis( &MrcPtr->stack, &Sample->link );
+    (void)ubi_dlAddHead( &MrcPtr->stack, &Sample->link );
+    return;
+    }
+
+  /* A new key.  If there is no room for it, lower the threshold. */
+  MrcPtr->cold += scale;
+  Sample = ubi_dlCount( &MrcPtr->spare )
+         ? LinkSample( ubi_dlRemHead( &MrcPtr->spare ) ) : NULL;
+  if( NULL == Sample )
+    {
+    Sample = HeapSample( ubi_hpFirst( &MrcPtr->heap ) );
+    if( Hash >= Sample->hash )
+      {
+      MrcPtr->threshold = Hash;
+      return;
+      }
+    MrcPtr->threshold = Sample->hash;
+    (void)ubi_hpRemove( &MrcPtr->heap, &Sample->heap );
+    (void)ubi_btRemove( &MrcPtr->index, &Sample->node );
+    (void)ubi_dlRemThis( &MrcPtr->stack, &Sample->link );
+    }
+  Sample->hash = Hash;
+  Sample->size = Size;
+  (void)ubi_btInsert( &MrcPtr->index, &Sample->node, &Sample->hash, NULL );
+  (void)ubi_dlAddHead( &MrcPtr->stack, &Sample->link );
+  (void)ubi_hpInsert( &MrcPtr->heap, ubi_hpInitNode( &Sample->heap ) );
+  } /* ubi_mrcReference */
+
+void ubi_mrcSetSize( ubi_mrcRootPtr MrcPtr,
+                     unsigned long  Hash,
+                     unsigned long  Size )
+  /** Record the size of a key's data, without a reference.
+   *
+   * @param   MrcPtr  A pointer to the curve.
+   * @param   Hash    The sampling hash of the key.
+   * @param   Size    The size of the key's data.
+   *
+   * \b Notes:
+   *  - A cache usually learns the size of an entry only when it is put,
+   *    after the reference that missed.
+   */
+  {
+  ubi_mrcSamplePtr Sample;
+
+  if( !ubi_mrcSampled( MrcPtr, Hash ) )
+    return;
+  Sample = (ubi_mrcSamplePtr)ubi_btFind( &MrcPtr->index, &Hash );
+  if( Sample )
+    Sample->size = Size;
+  } /* ubi_mrcSetSize */
+
+int ubi_mrcHitRatio( ubi_mrcRootPtr MrcPtr,
+                     unsigned long  Entries,
+                     unsigned long  Memory )
+  /** Predict the hit ratio of an LRU cache.
+   *
+   * @param   MrcPtr  A pointer to the curve.
+   * @param   Entries The cache's entry limit, or zero for no limit.
+   * @param   Memory  The cache's memory limit, or zero for no limit.
+   *
+   * @returns The predicted hit ratio, times 10000 (as for
+   *          \c #ubi_cacheHitRatio()), or zero if nothing has been
+   *          recorded yet.
+   *
+   * \b Notes:
+   *  - With both limits, the lower of the two predictions is returned.
+   *  - References to keys never seen before always miss, so even a cache
+   *    with no limits will not predict a hit ratio of 10000.
+   *  - The difference between the real and the estimated number of
+   *    references is added to the hits at the smallest distance (the
+   *    SHARDS "adj" correction).
+   */
+  {
+  double adj, all, hits, m;
+
+  if( (MrcPtr->refs <= 0.0) || (MrcPtr->total <= 0.0) )
+    return( 0 );
+  adj  = MrcPtr->total - MrcPtr->refs;
+  all  = MrcPtr->refs - MrcPtr->cold;
+  hits = Entries ? below( MrcPtr->keys, (double)Entries ) : all;
+  if( Memory )
+    {
+    m = below( MrcPtr->bytes, (double)Memory );
+    if( m < hits )
+      hits = m;
+    }
+  if( hits > all )
+    hits = all;
+  hits += adj;
+  if( hits < 0.0 )
+    return( 0 );
+  if( hits > MrcPtr->total )
+    return( 10000 );
+  return( (int)((10000.0 * hits) / MrcPtr->total) );
+  } /* ubi_mrcHitRatio */
+
+void ubi_mrcAge( ubi_mrcRootPtr MrcPtr )
+  /** Halve the weight of the references recorded so far.
+   *
+   * @param   MrcPtr  A pointer to the curve.
+   *
+   * \b Notes:
+   *  - Calling this at regular intervals gives an exponentially weighted
+   *    curve, which forgets old behavior.  The sampled keys are kept.
+   */
+  {
+  int i;
+
+  MrcPtr->total /= 2.0;
+  MrcPtr->refs  /= 2.0;
+  MrcPtr->cold  /= 2.0;
+  for( i = 0; i < ubi_mrcBUCKETS; i++ )
+    {
+    MrcPtr->keys[i]  /= 2.0;
+    MrcPtr->bytes[i] /= 2.0;
+    }
+  } /* ubi_mrcAge */
+
+/* ================================ The End ================================= */
@@ -0,0 +1,212 @@
+#ifndef UBI_MISSRATIO_H
+#define UBI_MISSRATIO_H
+/* ========================================================================== **
+ *                              ubi_MissRatio.h
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module estimates the miss ratio curve of a stream of references.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ *//**
+ * @file      ubi_MissRatio.h
+ * @author    Christopher R. Hertel
+ * @brief     Miss ratio curve estimation by spatial sampling (SHARDS).
+ * @date      Oct 2026
+ * @version   \$Id$
+ * @copyright Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * @details
+ *  How big should a cache be?  An LRU cache of size C hits on a reference
+ *  if, and only if, fewer than C other keys have been used since the last
+ *  reference to the same key.  That number is the "reuse distance".  Keep
+ *  a histogram of reuse distances, and the hit ratio of every possible
+ *  cache size can be read from it: the miss ratio curve.
+ *
+ *  Measuring every reuse distance is expensive.  SHARDS (Waldspurger et
+ *  al., FAST '15) measures only a sample of the keys, chosen by hashing:
+ *  a key is sampled if its hash is below a threshold, so the same keys
+ *  are always sampled, and every reference to them is seen.  With a
+ *  sampling rate of R, the reuse distance among the sampled keys is about
+ *  R times the real one, so each measured distance is scaled by 1/R.
+ *
+ *  This module keeps the sampled keys on an LRU list, and finds a reuse
+ *  distance by counting the keys in front of the one being referenced.
+ *  The number of sampled keys is limited by the array that you provide.
+ *  When it is full, the key with the largest hash is dropped, and the
+ *  threshold is lowered to match (the "fixed size" variant of SHARDS).
+ *  The sampling rate thus starts at the rate you choose, and drops as
+ *  the number of distinct keys grows.  The cost of a reference that is
+ *  not sampled is a hash and a comparison.
+ *
+ *  Two histograms are kept: one of the distance in keys, and one in
+ *  bytes, for caches that are limited by memory.  \c #ubi_mrcHitRatio()
+ *  predicts the hit ratio of an LRU cache with any given limits.  It
+ *  applies the SHARDS "adj" correction: a few very popular keys can make
+ *  up much of the traffic, and whether or not they happen to be sampled
+ *  skews the count of sampled references.  The difference between that
+ *  count (scaled) and the real number of references is credited to, or
+ *  taken from, the smallest distances, which is where those keys are.
+ *
+ * \b Notes
+ *  - The prediction is for LRU.  Other eviction policies usually do a bit
+ *    better, but the shape of the curve is what matters for sizing.
+ *  - The histograms are never reset, except by \c #ubi_mrcInit().  Call
+ *    \c #ubi_mrcAge() now and then to let old references fade, so that
+ *    the curve follows changes in the workload.
+ *  - The \c ubi_Cache module can feed a miss ratio curve from
+ *    \c #ubi_cacheGet().  See \c #ubi_cacheSetMissRatio().
+ */
+
+#include "ubi_BinTree.h"    /* Sampled key index.   */
+#include "ubi_dLinkList.h"  /* LRU stack.           */
+#include "ubi_Heap.h"       /* Largest sampled hash.*/
+
+
+/* -------------------------------------------------------------------------- **
+ * Constants...
+ */
+
+/**
+ * @def     ubi_mrcBUCKETS
+ * @brief   The number of buckets in each histogram.
+ * @details Distances below 8 have a bucket each.  Above that, each power
+ *          of two is split into eight buckets, so a bucket is never more
+ *          than 1/8th as wide as the distances in it.
+ */
+#define ubi_mrcBUCKETS 496
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ */
+
+/**
+ * @struct  ubi_mrcSample
+ * @brief   A sampled key.
+ */
+typedef struct
+  {
+  ubi_btNode    node;           /**< Index node, keyed by hash.     */
+  ubi_dlNode    link;           /**< LRU stack link.                */
+  ubi_hpNode    heap;           /**< Heap node, largest hash first. */
+  unsigned long hash;           /**< The sampling hash of the key.  */
+  unsigned long size;           /**< The size of the key's data.    */
+  } ubi_mrcSample;
+
+/** Pointer to a \c #ubi_mrcSample. */
+typedef ubi_mrcSample *ubi_mrcSamplePtr;
+
+/**
+ * @struct  ubi_mrcRoot
+ * @brief   Miss ratio curve header structure.
+ * @var     ubi_mrcRoot::index
+ *          The sampled keys, by hash.
+ * @var     ubi_mrcRoot::stack
+ *          The sampled keys, most recently used first.
+ * @var     ubi_mrcRoot::heap
+ *          The sampled keys, largest hash first.
+ * @var     ubi_mrcRoot::spare
+ *          Unused samples.
+ * @var     ubi_mrcRoot::threshold
+ *          Keys whose sampling hash is below this are sampled.
+ * @var     ubi_mrcRoot::total
+ *          The number of references, sampled or not.
+ * @var     ubi_mrcRoot::refs
+ *          The (scaled) number of sampled references.
+ * @var     ubi_mrcRoot::cold
+ *          The (scaled) number of references to keys not seen before.
+ * @var     ubi_mrcRoot::keys
+ *          The (scaled) number of references, by reuse distance in keys.
+ * @var     ubi_mrcRoot::bytes
+ *          The (scaled) number of references, by reuse distance in bytes.
+ */
+typedef struct
+  {
+  ubi_btRoot    index;
+  ubi_dlList    stack;
+  ubi_hpRoot    heap;
+  ubi_dlList    spare;
+  unsigned long threshold;
+  double        total;
+  double        refs;
+  double        cold;
+  double        keys[ubi_mrcBUCKETS];
+  double        bytes[ubi_mrcBUCKETS];
+  } ubi_mrcRoot;
+
+/** Pointer to a \c #ubi_mrcRoot. */
+typedef ubi_mrcRoot *ubi_mrcRootPtr;
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ */
+
+/**
+ * @def     ubi_mrcRate( M )
+ * @param   M   Pointer to the \c #ubi_mrcRoot.
+ * @returns The current sampling rate, as a fraction.
+ */
+#define ubi_mrcRate( M ) \
+  ((double)((ubi_mrcRootPtr)(M))->threshold / 4294967296.0)
+
+/**
+ * @def     ubi_mrcSampled( M, H )
+ * @param   M   Pointer to the \c #ubi_mrcRoot.
+ * @param   H   The sampling hash of a key (see \c #ubi_mrcHash()).
+ * @returns True if the key is sampled.
+ */
+#define ubi_mrcSampled( M, H ) ((H) < ((ubi_mrcRootPtr)(M))->threshold)
+
+
+/* -------------------------------------------------------------------------- **
+ * Prototypes...
+ */
+
+ubi_mrcRootPtr ubi_mrcInit( ubi_mrcRootPtr   MrcPtr,
+                            ubi_mrcSamplePtr Samples,
+                            unsigned long    Count,
+                            unsigned long    Rate );
+
+unsigned long ubi_mrcHash( unsigned long Hash );
+
+void ubi_mrcReference( ubi_mrcRootPtr MrcPtr,
+                       unsigned long  Hash,
+                       unsigned long  Size );
+
+void ubi_mrcSetSize( ubi_mrcRootPtr MrcPtr,
+                     unsigned long  Hash,
+                     unsigned long  Size );
+
+int ubi_mrcHitRatio( ubi_mrcRootPtr MrcPtr,
+                     unsigned long  Entries,
+                     unsigned long  Memory );
+
+void ubi_mrcAge( ubi_mrcRootPtr MrcPtr );
+
+/* ================================ The End ================================= */
+#endif /* UBI_MISSRATIO_H */
@@ -0,0 +1,475 @@
+/* ========================================================================== **
+ *                               ubi_Pressure.c
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module shrinks a memory limit while the system is short of memory,
+ *  and lets it grow back afterward.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>            /* snprintf(), fopen(), etc.   */
+#include <string.h>           /* strncmp()                    */
+#include "ubi_Pressure.h"     /* Header for *this* module.    */
+
+
+/* -------------------------------------------------------------------------- **
+ * Constants...
+ *
+ *  SHRINK      - Default percentage cut from the limit at full pressure.
+ *  GROW        - Default percentage of the base limit regained per update.
+ *  CALM        - Default number of quiet updates before the limit grows.
+ *  PATH_LEN    - Longest cgroup file name that will be built.
+ */
+
+#define SHRINK    50
+#define GROW      5
+#define CALM      5
+#define PATH_LEN  512
+
+
+/* -------------------------------------------------------------------------- **
+ * Internal functions...
+ */
+
+static unsigned long apply( ubi_pressMonitorPtr MonPtr )
+  /* ------------------------------------------------------------------------ **
+   * Hand the current limit to the apply function.
+   *
+   *  Input:  MonPtr  - Pointer to the monitor.
+   *
+   *  Output: The memory in use, which is also kept in the monitor.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  MonPtr->used = MonPtr->apply( MonPtr->target, MonPtr->limit );
+  return( MonPtr->used );
+  } /* apply */
+
+static int scale( unsigned long Value,
+                  unsigned long Low,
+                  unsigned long High )
+  /* ------------------------------------------------------------------------ **
+   * Map a value onto a pressure.
+   *
+   *  Input:  Value - The reading.
+   *          Low   - Readings at or below this are no pressure.
+   *          High  - Readings at or above this are full pressure.
+   *
+   *  Output: A pressure in [0..100].  Anything above Low is at least 1.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  double p;
+
+  if( Value <= Low )
+    return( 0 );
+  if( Value >= High )
+    return( 100 );
+  p = (100.0 * (double)(Value - Low)) / (double)(High - Low);
+  return( (p < 1.0) ? 1 : (int)p );
+  } /* scale */
+
+static int read_value( const char    *Dir,
+                       const char    *Name,
+                       unsigned long *Value )
+  /* ------------------------------------------------------------------------ **
+   * Read a number from a cgroup control file.
+   *
+   *  Input:  Dir   - The cgroup directory.
+   *          Name  - The name of the file within it.
+   *          Value - Where to put the number.
+   *
+   *  Output: 1 if a number was read, 0 if the file says "max", or -1 if
+   *          the file could not be read.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  char  path[PATH_LEN];
+  char  line[64];
+  FILE *fp;
+  int   n;
+  int   result = -1;
+
+  n = snprintf( path, sizeof( path ), "%s/%s", Dir, Name );
+  if( (n < 0) || ((size_t)n >= sizeof( path )) )
+    return( -1 );
+  if( NULL == (fp = fopen( path, "r" )) )
+    return( -1 );
+  if( NULL != fgets( line, sizeof( line ), fp ) )
+    {
+    if( 0 == strncmp( line, "max", 3 ) )
+      result = 0;
+    else if( 1 == sscanf( line, "%lu", Value ) )
+      result = 1;
+    }
+  (void)fclose( fp );
+  return( result );
+  } /* read_value */
+
+
+/* -------------------------------------------------------------------------- **
+ * Exported functions...
+ */
+
+ubi_pressMonitorPtr ubi_pressInit( ubi_pressMonitorPtr MonPtr,
+                                   unsigned long       Base,
+                                   ubi_pressSourceFunc Source,
+                                   void               *Context,
+                                   ubi_pressApplyFunc  Apply,
+                                   void               *Target )
+  /** Initialize a pressure monitor.
+   *
+   * @param   MonPtr  A pointer to the \c #ubi_pressMonitor to be
+   *                  initialized.
+   * @param   Base    The memory limit to use when there is no pressure.
+   * @param   Source  The function that reads the pressure, such as
+   *                  \c #ubi_pressLinux().
+   * @param   Context Passed to \p Source.
+   * @param   Apply   The function that sets the limit.
+   * @param   Target  Passed to \p Apply; usually a cache.
+   *
+   * @returns A pointer to the initialized monitor (i.e., the same as
+   *          \p MonPtr), or NULL if \p Base is zero or a function is
+   *          missing.
+   *
+   * \b Notes:
+   *  - The target's limit is assumed to be \p Base already.  Nothing is
+   *    applied until pressure is seen.
+   *  - The limit will not be cut below a tenth of \p Base.  See
+   *    \c #ubi_pressSetFloor().
+   *  - The limit is cut by up to 50% per update, and regains 5% of
+   *    \p Base per update after five quiet updates in a row.  See
+   *    \c #ubi_pressSetRates().
+   */
+  {
+  if( (NULL == MonPtr) || (0 == Base) || (NULL == Source) || (NULL == Apply) )
+    return( NULL );
+
+  MonPtr->source   = Source;
+  MonPtr->context  = Context;
+  MonPtr->apply    = Apply;
+  MonPtr->target   = Target;
+  MonPtr->base     = Base;
+  MonPtr->limit    = Base;
+  MonPtr->floor    = Base / 10;
+  MonPtr->used     = 0;
+  MonPtr->shrink   = SHRINK;
+  MonPtr->grow     = GROW;
+  MonPtr->calm     = CALM;
+  MonPtr->quiet    = 0;
+  MonPtr->pressure = 0;
+  MonPtr->shrinks  = 0;
+  MonPtr->grows    = 0;
+  return( MonPtr );
+  } /* ubi_pressInit */
+
+int ubi_pressSetRates( ubi_pressMonitorPtr MonPtr,
+                       unsigned int        Shrink,
+                       unsigned int        Grow,
+                       unsigned int        Calm )
+  /** Set how quickly the limit shrinks and grows.
+   *
+   * @param   MonPtr  A pointer to the \c #ubi_pressMonitor.
+   * @param   Shrink  The percentage cut from the limit by an update at full
+   *                  pressure, in [1..100].  Lower pressure cuts less.
+   * @param   Grow    The percentage of the base limit regained by a quiet
+   *                  update, in [1..100].
+   * @param   Calm    The number of quiet updates in a row that must be seen
+   *                  before the limit starts to grow.
+   *
+   * @returns Nonzero on success, zero if \p Shrink or \p Grow is out of
+   *          range.
+   */
+  {
+  if( (Shrink < 1) || (Shrink > 100) || (Grow < 1) || (Grow > 100) )
+    return( 0 );
+  MonPtr->shrink = Shrink;
+  MonPtr->grow   = Grow;
+  MonPtr->calm   = Calm;
+  return( 1 );
+  } /* ubi_pressSetRates */
+
+unsigned long ubi_pressSetFloor( ubi_pressMonitorPtr MonPtr,
+                                 unsigned long       Floor )
+  /** Set the lowest limit that pressure can bring about.
+   *
+   * @param   MonPtr  A pointer to the \c #ubi_pressMonitor.
+   * @param   Floor   The new floor.  It is capped at the base limit.
+   *
+   * @returns The old floor.
+   *
+   * \b Notes:
+   *  - If the limit is below the new floor, it is raised at once.
+   */
+  {
+  unsigned long old = MonPtr->floor;
+
+  MonPtr->floor = (Floor > MonPtr->base) ? MonPtr->base : Floor;
+  if( MonPtr->limit < MonPtr->floor )
+    {
+    MonPtr->limit = MonPtr->floor;
+    (void)apply( MonPtr );
+    }
+  return( old );
+  } /* ubi_pressSetFloor */
+
+unsigned long ubi_pressSetBase( ubi_pressMonitorPtr MonPtr,
+                                unsigned long       Base )
+  /** Change the limit to use when there is no pressure.
+   *
+   * @param   MonPtr  A pointer to the \c #ubi_pressMonitor.
+   * @param   Base    The new base limit.  Zero is ignored.
+   *
+   * @returns The old base limit.
+   *
+   * \b Notes:
+   *  - If the limit is above the new base, it is lowered at once.  If it
+   *    is below, it grows toward the new base as usual.
+   *  - The floor is lowered, if need be, to the new base.
+   */
+  {
+  unsigned long old = MonPtr->base;
+
+  if( 0 == Base )
+    return( old );
+  MonPtr->base = Base;
+  if( MonPtr->floor > Base )
+    MonPtr->floor = Base;
+  if( MonPtr->limit > Base )
+    {
+    MonPtr->limit = Base;
+    (void)apply( MonPtr );
+    }
+  return( old );
+  } /* ubi_pressSetBase */
+
+int ubi_pressUpdate( ubi_pressMonitorPtr MonPtr )
+  /** Read the pressure, and shrink or grow the limit to suit.
+   *
+   * @param   MonPtr  A pointer to the \c #ubi_pressMonitor.
+   *
+   * @returns The pressure that was read, in [0..100], or -1 if the source
+   *          could not tell.
+   *
+   * \b Notes:
+   *  - Under pressure, the limit is cut by (pressure * shrink rate)
+   *    percent.  The cut is taken from the memory in use, if that is less
+   *    than the limit, so that memory is actually freed.
+   *  - Without pressure, the limit grows by the grow rate once there have
+   *    been enough quiet updates in a row, and keeps growing on each quiet
+   *    update after that, until it reaches the base limit.
+   *  - An unknown reading changes nothing, and doesn't count as quiet.
+   *  - Call this every second or so, and whenever a PSI trigger fires.
+   */
+  {
+  unsigned long from, next;
+  double        step;
+  int           p;
+
+  p = MonPtr->source( MonPtr->context );
+  if( p < 0 )
+    return( MonPtr->pressure = -1 );
+  if( p > 100 )
+    p = 100;
+  MonPtr->pressure = p;
+
+  if( p > 0 )
+    {
+    MonPtr->quiet = 0;
+    from = apply( MonPtr );
+    if( from > MonPtr->limit )
+      from = MonPtr->limit;
+    step = ((double)from * (double)p * (double)MonPtr->shrink) / 10000.0;
+    next = from - (unsigned long)step;
+    if( next < MonPtr->floor )
+      next = MonPtr->floor;
+    if( next < MonPtr->limit )
+      {
+      MonPtr->limit = next;
+      MonPtr->shrinks++;
+      (void)apply( MonPtr );
+      }
+    return( p );
+    }
+
+  if( MonPtr->quiet < MonPtr->calm )
+    MonPtr->quiet++;
+  if( (MonPtr->quiet >= MonPtr->calm) && (MonPtr->limit < MonPtr->base) )
+    {
+    step = ((double)MonPtr->base * (double)MonPtr->grow) / 100.0;
+    next = (step < 1.0) ? 1 : (unsigned long)step;
+    if( next > (MonPtr->base - MonPtr->limit) )
+      MonPtr->limit = MonPtr->base;
+    else
+      MonPtr->limit += next;
+    MonPtr->grows++;
+    (void)apply( MonPtr );
+    }
+  return( 0 );
+  } /* ubi_pressUpdate */
+
+ubi_pressFilesPtr ubi_pressInitFiles( ubi_pressFilesPtr FilesPtr,
+                                      const char       *Psi,
+                                      const char       *Cgroup )
+  /** Initialize the context of the \c #ubi_pressLinux() pressure source.
+   *
+   * @param   FilesPtr  A pointer to the \c #ubi_pressFiles to be
+   *                    initialized.
+   * @param   Psi       The PSI memory file, normally
+   *                    \c #ubi_pressPSI_MEMORY, or NULL to ignore PSI.
+   * @param   Cgroup    The cgroup v2 directory, normally
+   *                    \c #ubi_pressCGROUP_ROOT, or NULL to ignore the
+   *                    cgroup limit.
+   *
+   * @returns A pointer to the initialized structure (i.e., the same as
+   *          \p FilesPtr), or NULL if both names are NULL.
+   *
+   * \b Notes:
+   *  - PSI stall times are in hundredths of a percent.  By default, up to
+   *    0.10% (of the last ten seconds) is no pressure, and 10% is full
+   *    pressure.
+   *  - By default, cgroup usage up to 90% of \c memory.high is no
+   *    pressure, and usage at the limit is full pressure.
+   *  - The fields may be changed directly after this call.  The names are
+   *    not copied, so the strings must outlive the structure.
+   */
+  {
+  if( (NULL == FilesPtr) || ((NULL == Psi) && (NULL == Cgroup)) )
+    return( NULL );
+
+  FilesPtr->psi        = Psi;
+  FilesPtr->cgroup     = Cgroup;
+  FilesPtr->psi_low    = 10;
+  FilesPtr->psi_full   = 1000;
+  FilesPtr->cgroup_low = 90;
+  return( FilesPtr );
+  } /* ubi_pressInitFiles */
+
+long ubi_pressReadPSI( const char *Path )
+  /** Read the recent memory stall time from a PSI file.
+   *
+   * @param   Path  The PSI file, usually \c #ubi_pressPSI_MEMORY.
+   *
+   * @returns The "some avg10" figure, in hundredths of a percent, or -1
+   *          if it could not be read.
+   *
+   * \b Notes:
+   *  - "some" is the share of time during which at least one task was
+   *    stalled waiting for memory.  The file looks like this:
+   *    <pre>
+   *    some avg10=0.12 avg60=0.05 avg300=0.01 total=123456
+   *    full avg10=0.00 avg60=0.00 avg300=0.00 total=23456
+   *    </pre>
+   */
+  {
+  char          line[256];
+  unsigned long whole, frac;
+  long          result = -1;
+  FILE         *fp;
+
+  if( NULL == (fp = fopen( Path, "r" )) )
+    return( -1 );
+  while( (result < 0) && (NULL != fgets( line, sizeof( line ), fp )) )
+    {
+    if( 2 == sscanf( line, "some avg10=%lu.%2lu", &whole, &frac ) )
+      result = (long)((whole * 100) + frac);
+    }
+  (void)fclose( fp );
+  return( result );
+  } /* ubi_pressReadPSI */
+
+int ubi_pressReadCgroup( const char    *Dir,
+                         unsigned long *Current,
+                         unsigned long *Limit )
+  /** Read the memory use and limit of a cgroup.
+   *
+   * @param   Dir     The cgroup v2 directory.
+   * @param   Current Where to put the contents of \c memory.current.
+   * @param   Limit   Where to put the limit: \c memory.high, or
+   *                  \c memory.max if there is no high mark, or zero if
+   *                  there is no limit at all.
+   *
+   * @returns Nonzero on success, zero if the files could not be read.
+   *
+   * \b Notes:
+   *  - The kernel starts reclaiming, and throttling, at \c memory.high.
+   *    The OOM killer acts at \c memory.max.
+   */
+  {
+  int r;
+
+  if( 1 != read_value( Dir, "memory.current", Current ) )
+    return( 0 );
+  r = read_value( Dir, "memory.high", Limit );
+  if( 0 == r )
+    r = read_value( Dir, "memory.max", Limit );
+  if( 0 == r )
+    *Limit = 0;
+  return( r >= 0 );
+  } /* ubi_pressReadCgroup */
+
+int ubi_pressLinux( void *Context )
+  /** Pressure source: Linux PSI and cgroup v2 memory files.
+   *
+   * @param   Context A pointer to a \c #ubi_pressFiles.
+   *
+   * @returns The memory pressure, in [0..100], or -1 if neither the PSI
+   *          file nor the cgroup files could be read.
+   *
+   * \b Notes:
+   *  - Pass this to \c #ubi_pressInit(), along with a \c #ubi_pressFiles
+   *    set up by \c #ubi_pressInitFiles().
+   *  - The result is the larger of the PSI and cgroup pressures.  A
+   *    cgroup without a limit has no pressure.
+   */
+  {
+  ubi_pressFilesPtr files = (ubi_pressFilesPtr)Context;
+  unsigned long     current, limit;
+  long              stall;
+  int               p = -1, q;
+
+  if( NULL != files->psi )
+    {
+    stall = ubi_pressReadPSI( files->psi );
+    if( stall >= 0 )
+      p = scale( (unsigned long)stall, files->psi_low, files->psi_full );
+    }
+  if( (NULL != files->cgroup)
+   && ubi_pressReadCgroup( files->cgroup, &current, &limit ) )
+    {
+    q = (0 == limit) ? 0
+      : scale( current,
+               (unsigned long)(((double)limit * files->cgroup_low) / 100.0),
+               limit );
+    if( q > p )
+      p = q;
+    }
+  return( p );
+  } /* ubi_pressLinux */
+
+/* ================================ The End ================================= */
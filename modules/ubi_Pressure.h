@@ -0,0 +1,233 @@
+#ifndef UBI_PRESSURE_H
+#define UBI_PRESSURE_H
+/* ========================================================================== **
+ *                               ubi_Pressure.h
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module shrinks a memory limit while the system is short of memory,
+ *  and lets it grow back afterward.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ *//**
+ * @file      ubi_Pressure.h
+ * @author    Christopher R. Hertel
+ * @brief     Memory pressure monitor, for shrinking caches on demand.
+ * @date      Oct 2026
+ * @version   \$Id$
+ * @copyright Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * @details
+ *  A cache with a fixed memory limit doesn't know when the rest of the
+ *  program, or the rest of the machine, needs the memory back.  In a
+ *  container, the OOM killer may strike while the cache is still full.
+ *
+ *  A pressure monitor sits between a source of "memory pressure" and a
+ *  memory limit.  Each call to \c #ubi_pressUpdate() reads the pressure,
+ *  as a percentage, and:
+ *  - If there is pressure, cuts the limit by that percentage of the
+ *    shrink rate.  At a pressure of 100 and the default rate of 50%, the
+ *    limit is halved.  The cut is taken from the memory actually in use,
+ *    if that is less than the limit, so that it frees something at once.
+ *  - If there has been no pressure for a few updates in a row, raises the
+ *    limit by the grow rate (a percentage of the base limit), until it is
+ *    back to the base.  Shrinking is quick and growing is slow, so that
+ *    the limit doesn't bounce.
+ *  - Hands the new limit to an apply function, which would normally be a
+ *    one-liner that calls \c ubi_cacheSetMaxMemory(),
+ *    \c ubi_cachePoolSetBudget(), or \c ubi_shardSetMaxMemory(), and
+ *    returns the memory in use.  Lowering a cache's limit trims it.
+ *
+ *  The pressure comes from a source function.  \c #ubi_pressLinux() is
+ *  one that reads the Linux pressure stall information (PSI) for memory,
+ *  usually \c /proc/pressure/memory, and the \c memory.current and
+ *  \c memory.high (or \c memory.max) files of a cgroup v2 directory.  It
+ *  reports the larger of:
+ *  - The share of the last ten seconds during which some task was stalled
+ *    waiting for memory, scaled so that \c psi_full is 100.
+ *  - How far the cgroup's usage is into the top part of its limit: 0 at
+ *    \c cgroup_low percent of the limit or below, 100 at the limit.
+ *
+ *  The file names are part of the source's context, so the source can be
+ *  tested against files that simulate pressure.  Or, use a source of your
+ *  own; it only has to return a number from 0 to 100.
+ *
+ *  \c #ubi_pressUpdate() doesn't read the clock; call it every second or
+ *  so.  To react faster, set up a PSI trigger: open
+ *  \c /proc/pressure/memory for writing, write (say)
+ *  <tt>"some 150000 1000000"</tt> to it (150ms of stall in any 1s window),
+ *  and \c poll() the descriptor for \c POLLPRI.  Call
+ *  \c #ubi_pressUpdate() when it fires, as well as on the timer, which
+ *  is still needed for the limit to grow back.
+ *
+ * \b Notes
+ *  - The monitor does no locking.  Hold the cache's lock while calling
+ *    \c #ubi_pressUpdate(), or have the apply function take it.
+ *  - The module doesn't depend upon the cache modules.  Anything with a
+ *    memory limit can be given one.
+ */
+
+#include "sys_include.h"    /* System-specific includes. */
+
+/* -------------------------------------------------------------------------- **
+ * Constants...
+ */
+
+/**
+ * @def     ubi_pressPSI_MEMORY
+ * @brief   The system-wide PSI memory file.
+ */
+#define ubi_pressPSI_MEMORY "/proc/pressure/memory"
+
+/**
+ * @def     ubi_pressCGROUP_ROOT
+ * @brief   Where the cgroup v2 hierarchy is usually mounted.
+ * @details Inside a container, this is normally the container's own
+ *          cgroup.  Elsewhere, append the path from \c /proc/self/cgroup.
+ */
+#define ubi_pressCGROUP_ROOT "/sys/fs/cgroup"
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ */
+
+/**
+ * @typedef ubi_pressSourceFunc
+ * @brief   Pressure source.
+ * @details Given the context pointer passed to \c #ubi_pressInit(),
+ *          return the current memory pressure, from 0 (none) to 100, or
+ *          -1 if it is not known.
+ */
+typedef int (*ubi_pressSourceFunc)( void *Context );
+
+/**
+ * @typedef ubi_pressApplyFunc
+ * @brief   Limit setting function.
+ * @details Given the target pointer passed to \c #ubi_pressInit() and a
+ *          memory limit, apply the limit (trimming as needed), and return
+ *          the amount of memory in use afterward.  The limit may be the
+ *          same as last time; the monitor does that to learn how much
+ *          memory is in use.
+ */
+typedef unsigned long (*ubi_pressApplyFunc)( void         *Target,
+                                             unsigned long Limit );
+
+/**
+ * @struct  ubi_pressFiles
+ * @brief   The context of the \c #ubi_pressLinux() pressure source.
+ * @details See \c #ubi_pressInitFiles() for the defaults.
+ */
+typedef struct
+  {
+  const char   *psi;            /**< PSI memory file, or NULL.          */
+  const char   *cgroup;         /**< cgroup v2 directory, or NULL.      */
+  unsigned long psi_low;        /**< Stall (1/100 %) below which, 0.    */
+  unsigned long psi_full;       /**< Stall (1/100 %) that counts as 100.*/
+  unsigned int  cgroup_low;     /**< Percent of the limit where, 0.     */
+  } ubi_pressFiles;
+
+/** Pointer to a \c #ubi_pressFiles. */
+typedef ubi_pressFiles *ubi_pressFilesPtr;
+
+/**
+ * @struct  ubi_pressMonitor
+ * @brief   Memory pressure monitor.
+ * @details See \c #ubi_pressInit().
+ */
+typedef struct
+  {
+  ubi_pressSourceFunc source;   /**< Reads the pressure.                */
+  void               *context;  /**< Passed to source.                  */
+  ubi_pressApplyFunc  apply;    /**< Sets the limit.                    */
+  void               *target;   /**< Passed to apply.                   */
+  unsigned long       base;     /**< The limit, without pressure.       */
+  unsigned long       limit;    /**< The limit now.                     */
+  unsigned long       floor;    /**< The limit is never cut below this. */
+  unsigned long       used;     /**< Memory in use, as of last apply.   */
+  unsigned int        shrink;   /**< Percent cut at full pressure.      */
+  unsigned int        grow;     /**< Percent of base regained per step. */
+  unsigned int        calm;     /**< Quiet updates needed before growth.*/
+  unsigned int        quiet;    /**< Quiet updates so far.              */
+  int                 pressure; /**< The last reading.                  */
+  unsigned long       shrinks;  /**< Updates that cut the limit.        */
+  unsigned long       grows;    /**< Updates that raised it.            */
+  } ubi_pressMonitor;
+
+/** Pointer to a \c #ubi_pressMonitor. */
+typedef ubi_pressMonitor *ubi_pressMonitorPtr;
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ */
+
+/**
+ * @def     ubi_pressGetLimit( M )
+ * @param   M   Pointer to the \c #ubi_pressMonitor.
+ * @returns The memory limit, as last applied.
+ */
+#define ubi_pressGetLimit( M ) (((ubi_pressMonitorPtr)(M))->limit)
+
+
+/* -------------------------------------------------------------------------- **
+ * Prototypes...
+ */
+
+ubi_pressMonitorPtr ubi_pressInit( ubi_pressMonitorPtr MonPtr,
+                                   unsigned long       Base,
+                                   ubi_pressSourceFunc Source,
+                                   void               *Context,
+                                   ubi_pressApplyFunc  Apply,
+                                   void               *Target );
+
+int ubi_pressSetRates( ubi_pressMonitorPtr MonPtr,
+                       unsigned int        Shrink,
+                       unsigned int        Grow,
+                       unsigned int        Calm );
+
+unsigned long ubi_pressSetFloor( ubi_pressMonitorPtr MonPtr,
+                                 unsigned long       Floor );
+
+unsigned long ubi_pressSetBase( ubi_pressMonitorPtr MonPtr,
+                                unsigned long       Base );
+
+int ubi_pressUpdate( ubi_pressMonitorPtr MonPtr );
+
+ubi_pressFilesPtr ubi_pressInitFiles( ubi_pressFilesPtr FilesPtr,
+                                      const char       *Psi,
+                                      const char       *Cgroup );
+
+long ubi_pressReadPSI( const char *Path );
+
+int ubi_pressReadCgroup( const char    *Dir,
+                         unsigned long *Current,
+                         unsigned long *Limit );
+
+int ubi_pressLinux( void *Context );
+
+/* ================================ The End ================================= */
+#endif /* UBI_PRESSURE_H */
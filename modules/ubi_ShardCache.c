@@ -0,0 +1,630 @@
+/* ========================================================================== **
+ *                              ubi_ShardCache.c
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module implements a sharded, lockable cache.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ */
+
+#include "ubi_ShardCache.h"   /* Header for *this* module. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ *
+ *  Stamp() - The slab tag given to entries allocated from a shard: the
+ *            low bits of its generation.
+ */
+
+#define Stamp( S ) ((unsigned int)((S)->generation & 0xFFFF))
+
+
+/* -------------------------------------------------------------------------- **
+ * Internal functions...
+ */
+
+static unsigned long share( unsigned long total, unsigned int count )
+  /* ------------------------------------------------------------------------ **
+   * Divide a cache limit among the shards.
+   *
+   *  Input:  total - The limit for the whole cache.  Zero means no limit.
+   *          count - The number of shards.
+   *
+   *  Output: The limit for each shard, rounded up so that a small, non-zero
+   *          limit does not become zero (i.e., unlimited).
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( 0 == total )
+    return( 0 );
+  return( (total + count - 1) / count );
+  } /* share */
+
+static void lock_shard( ubi_shardCachePtr ScPtr, ubi_shardPtr ShardPtr )
+  /* ------------------------------------------------------------------------ **
+   * Lock a shard, if locking has been configured.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( ScPtr->lock )
+    (*ScPtr->lock)( ShardPtr->lock );
+  } /* lock_shard */
+
+static void unlock_shard( ubi_shardCachePtr ScPtr, ubi_shardPtr ShardPtr )
+  /* ------------------------------------------------------------------------ **
+   * Unlock a shard, if locking has been configured.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( ScPtr->unlock )
+    (*ScPtr->unlock)( ShardPtr->lock );
+  } /* unlock_shard */
+
+static ubi_trBool fresh( void *Context, ubi_cacheEntryPtr EntryPtr )
+  /* ------------------------------------------------------------------------ **
+   * Check that an entry was allocated from the shard's current slab pool.
+   *
+   *  Input:  Context   - A pointer to the shard.
+   *          EntryPtr  - The entry, allocated by ubi_shardAlloc().
+   *
+   *  Output: TRUE if the entry's stamp matches the shard's generation,
+   *          FALSE if the shard has been recovered since the entry was
+   *          allocated.
+   *
+   *  Notes:  This is also the load check of each shard's cache, so that
+   *          ubi_shardGetOrLoad() does not put a stale entry either.  The
+   *          shard must be locked.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_shardPtr sp = (ubi_shardPtr)Context;
+
+  return( (ubi_slabTag( &sp->slab, EntryPtr ) == Stamp( sp ))
+          ? ubi_trTRUE : ubi_trFALSE );
+  } /* fresh */
+
+
+/* -------------------------------------------------------------------------- **
+ * Exported functions...
+ */
+
+ubi_shardCachePtr ubi_shardInit( ubi_shardCachePtr ShardCachePtr,
+                                 ubi_shardPtr      Shards,
+                                 unsigned int      ShardCount,
+                                 ubi_cacheHashFunc HashFunc,
+                                 ubi_trCompFunc    CompFunc,
+                                 ubi_trKillNodeRtn FreeFunc,
+                                 unsigned long     MaxEntries,
+                                 unsigned long     MaxMemory )
+  /** Initialize a shard cache.
+   *
+   * @param   ShardCachePtr A pointer to the \c #ubi_shardCache to be
+   *                        initialized.
+   * @param   Shards        An array of \p ShardCount shards.
+   * @param   ShardCount    The number of shards.  Must be at least one.
+   *                        A small multiple of the number of threads that
+   *                        will use the cache is a good choice.
+   * @param   HashFunc      A function that returns a hash of a key.  The
+   *                        hash is used to select a shard.
+   * @param   CompFunc      The key comparison function, as for
+   *                        \c #ubi_cacheInit().
+   * @param   FreeFunc      The entry freeing function, as for
+   *                        \c #ubi_cacheInit().
+   * @param   MaxEntries    The maximum number of entries in the whole
+   *                        cache, or zero for no limit.
+   * @param   MaxMemory     The maximum memory used by the whole cache, or
+   *                        zero for no limit.
+   *
+   * @returns A pointer to the initialized shard cache (i.e., the same as
+   *          \p ShardCachePtr).
+   *
+   * \b Notes
+   *  - Each shard is given an equal share (rounded up) of \p MaxEntries
+   *    and \p MaxMemory.  The limits are enforced per shard, so a shard
+   *    that gets more than its share of the keys will evict earlier than
+   *    a single cache would have.  With a reasonable hash, this makes
+   *    little difference.
+   *  - The shard cache has no locks until \c #ubi_shardSetLocks() is
+   *    called.
+   *  - Each shard is given \p HashFunc as its hash function, so eviction
+   *    policies and features that need one can be used on the shards.
+   */
+  {
+  unsigned int i;
+
+  if( ShardCachePtr )
+    {
+    ShardCachePtr->shards = Shards;
+    ShardCachePtr->count  = ShardCount;
+    ShardCachePtr->hash   = HashFunc;
+    ShardCachePtr->lock   = NULL;
+    ShardCachePtr->unlock = NULL;
+    ShardCachePtr->growth = 0;
+    for( i = 0; i < ShardCount; i++ )
+      {
+      (void)ubi_cacheInit( &Shards[i].cache, CompFunc, FreeFunc,
+                           share( MaxEntries, ShardCount ),
+                           share( MaxMemory, ShardCount ) );
+      (void)ubi_cacheSetHashFunc( &Shards[i].cache, HashFunc );
+      Shards[i].lock       = NULL;
+      Shards[i].lookups    = 0;
+      Shards[i].hits       = 0;
+      Shards[i].generation = 0;
+      }
+    }
+  return( ShardCachePtr );
+  } /* ubi_shardInit */
+
+void ubi_shardSetLocks( ubi_shardCachePtr ShardCachePtr,
+                        ubi_shardLockFunc LockFunc,
+                        ubi_shardLockFunc UnlockFunc,
+                        void             *Locks,
+                        size_t            LockSize )
+  /** Provide the locks used to protect the shards.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache.
+   * @param   LockFunc      The function used to lock a shard.
+   * @param   UnlockFunc    The function used to unlock a shard.
+   * @param   Locks         An array of (already initialized) lock
+   *                        objects, one per shard.
+   * @param   LockSize      The size of each lock object, in bytes.
+   *
+   * \b Notes
+   *  - For example, with POSIX threads, \p Locks would be an array of
+   *    \c pthread_mutex_t and \p LockSize would be
+   *    <tt>sizeof( pthread_mutex_t )</tt>.  The lock and unlock functions
+   *    would simply call \c pthread_mutex_lock() and
+   *    \c pthread_mutex_unlock().
+   *  - Call this before the cache is shared between threads.
+   *  - The shards' caches are told about the locks, so that
+   *    \c #ubi_shardGetOrLoad() can unlock a shard while it loads.
+   */
+  {
+  ubi_shardPtr sp;
+  unsigned int i;
+
+  ShardCachePtr->lock   = LockFunc;
+  ShardCachePtr->unlock = UnlockFunc;
+  for( i = 0; i < ShardCachePtr->count; i++ )
+    {
+    sp       = &ShardCachePtr->shards[i];
+    sp->lock = (void *)((char *)Locks + (i * LockSize));
+    ubi_cacheSetSync( &sp->cache, LockFunc, UnlockFunc, NULL, NULL, sp->lock );
+    }
+  } /* ubi_shardSetLocks */
+
+void ubi_shardSetWait( ubi_shardCachePtr ShardCachePtr,
+                       ubi_shardLockFunc WaitFunc,
+                       ubi_shardLockFunc WakeFunc )
+  /** Provide the functions used to wait for loads in progress.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache.
+   * @param   WaitFunc      Given a shard's lock object (which is locked),
+   *                        unlock it, wait to be woken, and lock it again.
+   * @param   WakeFunc      Wake all threads waiting on a lock object.
+   *
+   * \b Notes
+   *  - Call this after \c #ubi_shardSetLocks().  With POSIX threads, each
+   *    lock object would hold a mutex and a condition variable.
+   *  - This turns on load sharing in \c #ubi_shardGetOrLoad().  See
+   *    \c #ubi_cacheGetOrLoad().
+   */
+  {
+  ubi_shardPtr sp;
+  unsigned int i;
+
+  for( i = 0; i < ShardCachePtr->count; i++ )
+    {
+    sp = &ShardCachePtr->shards[i];
+    ubi_cacheSetSync( &sp->cache, ShardCachePtr->lock, ShardCachePtr->unlock,
+                      WaitFunc, WakeFunc, sp->lock );
+    }
+  } /* ubi_shardSetWait */
+
+ubi_trBool ubi_shardSetSlabs( ubi_shardCachePtr ShardCachePtr,
+                              void             *Arena,
+                              unsigned long     ArenaSize,
+                              unsigned long     PageSize,
+                              unsigned int      Growth )
+  /** Keep the entries of every shard in a slab pool.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache, which must be
+   *                        empty.
+   * @param   Arena         The memory for the entries, aligned as for
+   *                        \c #ubi_slabInit().
+   * @param   ArenaSize     The size of the arena, in bytes.  It is divided
+   *                        evenly among the shards.
+   * @param   PageSize      The slab page size.  See \c #ubi_slabInit().
+   * @param   Growth        The slab class growth.  See \c #ubi_slabInit().
+   *
+   * @returns TRUE on success, or FALSE if the parameters don't make sense
+   *          to \c #ubi_slabInit(), or a shard already has entries.
+   *
+   * \b Notes
+   *  - Allocate the entries with \c #ubi_shardAlloc().  If the shards were
+   *    given no free function, the entries go back to their pools when
+   *    they are removed.  See \c #ubi_cacheSetSlab().
+   *  - Each shard's share of the arena should hold at least a page for
+   *    each slab class that will be used.
+   *  - The arena is all the memory the entries can use, so the memory
+   *    limit given to \c #ubi_shardInit() may be zero.
+   */
+  {
+  ubi_shardPtr  sp;
+  unsigned long slice;
+  unsigned int  i;
+
+  slice = (ArenaSize / ShardCachePtr->count)
+        & ~(unsigned long)(ubi_slabALIGN - 1);
+  for( i = 0; i < ShardCachePtr->count; i++ )
+    {
+    sp = &ShardCachePtr->shards[i];
+    if( (NULL == ubi_slabInit( &sp->slab, (char *)Arena + (i * slice), slice,
+                               PageSize, Growth ))
+     || !ubi_cacheSetSlab( &sp->cache, &sp->slab ) )
+      return( ubi_trFALSE );
+    ubi_cacheSetLoadCheck( &sp->cache, fresh, sp );
+    }
+  ShardCachePtr->growth = Growth;
+  return( ubi_trTRUE );
+  } /* ubi_shardSetSlabs */
+
+void *ubi_shardAlloc( ubi_shardCachePtr ShardCachePtr,
+                      ubi_trItemPtr     Key,
+                      unsigned long     Size )
+  /** Allocate an entry from the slab pool of the shard that its key
+   *  belongs to.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache.
+   * @param   Key           The key that the entry will be put with.
+   * @param   Size          The size of the entry.
+   *
+   * @returns A pointer to the new entry, or NULL if no room could be made.
+   *          See \c #ubi_cacheAlloc().
+   *
+   * \b Note: The shard is locked only for the allocation.  Fill in the
+   *          entry, and then put it with \c #ubi_shardPut() and the same
+   *          key.  Until then, the entry belongs to the caller.  The
+   *          entry's slab chunk is tagged with the shard's generation (see
+   *          \c #ubi_slabSetTag()), which \c #ubi_shardPut() and
+   *          \c #ubi_shardGetOrLoad() check.
+   */
+  {
+  ubi_shardPtr sp = ubi_shardOf( ShardCachePtr, Key );
+  void        *Ptr;
+
+  lock_shard( ShardCachePtr, sp );
+  Ptr = ubi_cacheAlloc( &sp->cache, Size );
+  if( Ptr )
+    ubi_slabSetTag( &sp->slab, Ptr, Stamp( sp ) );
+  unlock_shard( ShardCachePtr, sp );
+  return( Ptr );
+  } /* ubi_shardAlloc */
+
+void ubi_shardRecover( ubi_shardCachePtr ShardCachePtr, unsigned int Index )
+  /** Reset a shard that may have been left inconsistent.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache.
+   * @param   Index         The index of the shard (see
+   *                        \c #ubi_shardIndex()).
+   *
+   * \b Notes
+   *  - Call this with the shard's lock held, when the lock reports that
+   *    its last holder died while holding it.  With a robust POSIX mutex,
+   *    the lock function would do so when \c pthread_mutex_lock() returns
+   *    \c EOWNERDEAD, after calling \c pthread_mutex_consistent().
+   *  - The shard's entries are dropped without being looked at (see
+   *    \c #ubi_cacheAbandon()), and its slab pool, if any, is started over,
+   *    which gets their memory back.  The shard's generation is bumped,
+   *    so that an entry allocated from the old pool by another process,
+   *    and not yet put, is refused by \c #ubi_shardPut(), or by
+   *    \c #ubi_shardGetOrLoad() if it was allocated by a loader.  (If
+   *    that process writes to the entry after the recovery, though, it
+   *    may overwrite a newer one.  The generation is kept in 16 bits of
+   *    the chunk header, so it would also take 65536 recoveries during
+   *    one allocation for a stale entry to get through.)
+   *  - The shard's settings and statistics are kept.
+   */
+  {
+  ubi_shardPtr    sp = &ShardCachePtr->shards[Index];
+  ubi_slabPoolPtr pp = &sp->slab;
+
+  (void)ubi_cacheAbandon( &sp->cache );
+  sp->generation++;
+  if( ShardCachePtr->growth )
+    (void)ubi_slabInit( pp, pp->base, pp->page_count * pp->page_size,
+                        pp->page_size, ShardCachePtr->growth );
+  } /* ubi_shardRecover */
+
+unsigned int ubi_shardIndex( ubi_shardCachePtr ShardCachePtr,
+                             ubi_trItemPtr     Key )
+  /** Return the index of the shard that holds (or would hold) a key.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache.
+   * @param   Key           The key.
+   *
+   * @returns The index, in the range [0..count-1].
+   *
+   * \b Note: The hash is mixed before use, so that hash functions with
+   *          poor low-order bits still spread keys evenly.
+   */
+  {
+  unsigned long h = (*ShardCachePtr->hash)( Key );
+
+  h ^= h >> 16;
+  h *= 0x45D9F3BUL;
+  h ^= h >> 16;
+  return( (unsigned int)(h % ShardCachePtr->count) );
+  } /* ubi_shardIndex */
+
+void ubi_shardPut( ubi_shardCachePtr ShardCachePtr,
+                   unsigned long     EntrySize,
+                   ubi_cacheEntryPtr EntryPtr,
+                   ubi_trItemPtr     Key )
+  /** Add an entry to the shard cache.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache.
+   * @param   EntrySize     The size of the entry.  See \c #ubi_cachePut().
+   * @param   EntryPtr      A pointer to the entry.
+   * @param   Key           The entry's key.
+   *
+   * \b Notes
+   *  - The shard is locked while \c #ubi_cachePut() runs, so the free
+   *    function may be called with the shard's lock held.
+   *  - If the shards keep their entries in slab pools, an entry that was
+   *    allocated before its shard was recovered is not put, since its
+   *    memory now belongs to the pool again.  See \c #ubi_shardRecover().
+   */
+  {
+  ubi_shardPtr sp = ubi_shardOf( ShardCachePtr, Key );
+
+  lock_shard( ShardCachePtr, sp );
+  if( (0 == ShardCachePtr->growth) || fresh( sp, EntryPtr ) )
+    ubi_cachePut( &sp->cache, EntrySize, EntryPtr, Key );
+  unlock_shard( ShardCachePtr, sp );
+  } /* ubi_shardPut */
+
+ubi_trBool ubi_shardGet( ubi_shardCachePtr ShardCachePtr,
+                         ubi_trItemPtr     FindMe,
+                         ubi_trActionRtn   Action,
+                         void             *UserData )
+  /** Look up an entry, and act on it while its shard is locked.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache.
+   * @param   FindMe        The key to look up.
+   * @param   Action        A function that is called with the entry, if
+   *                        found, while the shard is locked.  Typically,
+   *                        it copies the cached data out.  May be NULL.
+   * @param   UserData      A pointer passed to \p Action.
+   *
+   * @returns TRUE if the entry was found, else FALSE.
+   */
+  {
+  ubi_shardPtr      sp = ubi_shardOf( ShardCachePtr, FindMe );
+  ubi_cacheEntryPtr ep;
+
+  lock_shard( ShardCachePtr, sp );
+  ep = ubi_cacheGet( &sp->cache, FindMe );
+  sp->lookups++;
+  if( ep )
+    {
+    sp->hits++;
+    if( Action )
+      (*Action)( (ubi_trNodePtr)ep, UserData );
+    }
+  unlock_shard( ShardCachePtr, sp );
+  return( ep ? ubi_trTRUE : ubi_trFALSE );
+  } /* ubi_shardGet */
+
+ubi_trBool ubi_shardGetOrLoad( ubi_shardCachePtr ShardCachePtr,
+                               ubi_trItemPtr     Key,
+                               ubi_cacheLoadFunc Loader,
+                               void             *Context,
+                               ubi_trActionRtn   Action,
+                               void             *UserData )
+  /** Look up an entry, loading it if it is missing, and act on it.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache.
+   * @param   Key           The key to look up.
+   * @param   Loader        Called (without the shard locked) to create
+   *                        the entry on a miss.
+   * @param   Context       A pointer passed to \p Loader.
+   * @param   Action        As for \c #ubi_shardGet().
+   * @param   UserData      A pointer passed to \p Action.
+   *
+   * @returns TRUE if the entry was found or loaded, else FALSE.
+   *
+   * \b Notes
+   *  - If \c #ubi_shardSetWait() has been called, threads that miss on the
+   *    same key share a single load.
+   *  - If the shards keep their entries in slab pools, the loader should
+   *    allocate the entry with \c #ubi_shardAlloc().  As with
+   *    \c #ubi_shardPut(), an entry allocated before the shard was
+   *    recovered is not put, and FALSE is returned.
+   */
+  {
+  ubi_shardPtr      sp = ubi_shardOf( ShardCachePtr, Key );
+  ubi_cacheEntryPtr ep;
+  ubi_cacheCounter  hits;
+
+  lock_shard( ShardCachePtr, sp );
+  hits = sp->cache.stats.hits;
+  ep   = ubi_cacheGetOrLoad( &sp->cache, Key, Loader, Context );
+  sp->lookups++;
+  if( sp->cache.stats.hits != hits )
+    sp->hits++;
+  if( ep && Action )
+    (*Action)( (ubi_trNodePtr)ep, UserData );
+  unlock_shard( ShardCachePtr, sp );
+  return( ep ? ubi_trTRUE : ubi_trFALSE );
+  } /* ubi_shardGetOrLoad */
+
+ubi_trBool ubi_shardDelete( ubi_shardCachePtr ShardCachePtr,
+                            ubi_trItemPtr     DeleteMe )
+  /** Find and delete an entry.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache.
+   * @param   DeleteMe      The key of the entry to be deleted.
+   *
+   * @returns TRUE if the entry was found and freed, else FALSE.
+   */
+  {
+  ubi_shardPtr sp = ubi_shardOf( ShardCachePtr, DeleteMe );
+  ubi_trBool   found;
+
+  lock_shard( ShardCachePtr, sp );
+  found = ubi_cacheDelete( &sp->cache, DeleteMe );
+  unlock_shard( ShardCachePtr, sp );
+  return( found );
+  } /* ubi_shardDelete */
+
+void ubi_shardClear( ubi_shardCachePtr ShardCachePtr )
+  /** Remove and free all entries, and reset the statistics.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache.
+   *
+   * \b Note: The shards are cleared one at a time, so other threads may
+   *          add entries to shards that have already been cleared.
+   */
+  {
+  ubi_shardPtr sp;
+  unsigned int i;
+
+  for( i = 0; i < ShardCachePtr->count; i++ )
+    {
+    sp = &ShardCachePtr->shards[i];
+    lock_shard( ShardCachePtr, sp );
+    (void)ubi_cacheClear( &sp->cache );
+    sp->lookups = 0;
+    sp->hits    = 0;
+    unlock_shard( ShardCachePtr, sp );
+    }
+  } /* ubi_shardClear */
+
+ubi_trBool ubi_shardSetPolicy( ubi_shardCachePtr ShardCachePtr, int Policy )
+  /** Set the eviction policy of every shard.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache.
+   * @param   Policy        The policy.  See \c #ubi_cacheSetPolicy().
+   *
+   * @returns TRUE if the policy was set on all shards, else FALSE.
+   *
+   * \b Note: As with \c #ubi_cacheSetPolicy(), this should be done while
+   *          the cache is empty.
+   */
+  {
+  ubi_shardPtr sp;
+  ubi_trBool   ok = ubi_trTRUE;
+  unsigned int i;
+
+  for( i = 0; i < ShardCachePtr->count; i++ )
+    {
+    sp = &ShardCachePtr->shards[i];
+    lock_shard( ShardCachePtr, sp );
+    if( !ubi_cacheSetPolicy( &sp->cache, Policy ) )
+      ok = ubi_trFALSE;
+    unlock_shard( ShardCachePtr, sp );
+    }
+  return( ok );
+  } /* ubi_shardSetPolicy */
+
+void ubi_shardSetMaxEntries( ubi_shardCachePtr ShardCachePtr,
+                             unsigned long     NewSize )
+  /** Change the maximum number of entries in the whole cache.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache.
+   * @param   NewSize       The new limit, which is divided among the
+   *                        shards.  Zero means no limit.
+   */
+  {
+  ubi_shardPtr sp;
+  unsigned int i;
+
+  for( i = 0; i < ShardCachePtr->count; i++ )
+    {
+    sp = &ShardCachePtr->shards[i];
+    lock_shard( ShardCachePtr, sp );
+    (void)ubi_cacheSetMaxEntries( &sp->cache,
+                                  share( NewSize, ShardCachePtr->count ) );
+    unlock_shard( ShardCachePtr, sp );
+    }
+  } /* ubi_shardSetMaxEntries */
+
+void ubi_shardSetMaxMemory( ubi_shardCachePtr ShardCachePtr,
+                            unsigned long     NewSize )
+  /** Change the maximum memory used by the whole cache.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache.
+   * @param   NewSize       The new limit, which is divided among the
+   *                        shards.  Zero means no limit.
+   */
+  {
+  ubi_shardPtr sp;
+  unsigned int i;
+
+  for( i = 0; i < ShardCachePtr->count; i++ )
+    {
+    sp = &ShardCachePtr->shards[i];
+    lock_shard( ShardCachePtr, sp );
+    (void)ubi_cacheSetMaxMemory( &sp->cache,
+                                 share( NewSize, ShardCachePtr->count ) );
+    unlock_shard( ShardCachePtr, sp );
+    }
+  } /* ubi_shardSetMaxMemory */
+
+void ubi_shardGetStats( ubi_shardCachePtr ShardCachePtr,
+                        ubi_shardStats   *StatsPtr )
+  /** Total up the statistics of all shards.
+   *
+   * @param   ShardCachePtr A pointer to the shard cache.
+   * @param   StatsPtr      A pointer to the structure to be filled in.
+   *
+   * \b Note: Each shard is locked in turn while it is read, so the totals
+   *          are not a snapshot of a single moment.
+   */
+  {
+  ubi_shardPtr sp;
+  unsigned int i;
+
+  StatsPtr->entries  = 0;
+  StatsPtr->mem_used = 0;
+  StatsPtr->lookups  = 0;
+  StatsPtr->hits     = 0;
+  for( i = 0; i < ShardCachePtr->count; i++ )
+    {
+    sp = &ShardCachePtr->shards[i];
+    lock_shard( ShardCachePtr, sp );
+    StatsPtr->entries  += ubi_cacheGetEntryCount( &sp->cache );
+    StatsPtr->mem_used += ubi_cacheGetMemUsed( &sp->cache );
+    StatsPtr->lookups  += sp->lookups;
+    StatsPtr->hits     += sp->hits;
+    unlock_shard( ShardCachePtr, sp );
+    }
+  } /* ubi_shardGetStats */
+
+/* ================================ The End ================================= */
@@ -0,0 +1,248 @@
+#ifndef UBI_SHARDCACHE_H
+#define UBI_SHARDCACHE_H
+/* ========================================================================== **
+ *                              ubi_ShardCache.h
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module implements a sharded, lockable cache.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ *//**
+ * @file      ubi_ShardCache.h
+ * @author    Christopher R. Hertel
+ * @brief     A cache split into independently locked shards.
+ * @date      Oct 2026
+ * @version   \$Id$
+ * @copyright Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * @details
+ *  A \c #ubi_cacheRoot may only be used by one thread at a time.  Even
+ *  \c #ubi_cacheGet() modifies the cache (it splays the tree and updates
+ *  the eviction policy), so readers need an exclusive lock, and a cache
+ *  shared by many threads quickly becomes a bottleneck.
+ *
+ *  A shard cache spreads the entries over several ordinary caches (the
+ *  shards).  Each key is hashed to pick its shard, and each shard has a
+ *  lock of its own.  Threads that are working on different shards don't
+ *  get in each other's way.
+ *
+ *  - The entry and memory limits are divided evenly among the shards.
+ *  - Hit and lookup counts are kept per shard, and can be totalled with
+ *    \c #ubi_shardGetStats().
+ *  - The shards themselves are plain \c #ubi_cacheRoot structures, so
+ *    anything that can be done to a cache (e.g., setting the eviction
+ *    policy) can be done to each shard.
+ *
+ *  As usual, this module allocates no memory.  The caller supplies the
+ *  array of shards and, optionally, an array of locks.  The locks are
+ *  operated through caller-supplied functions, so any kind of lock (a
+ *  pthread mutex, a spinlock, ...) may be used.  With no lock functions,
+ *  the shard cache is not thread-safe, but still works.
+ *
+ *  \c #ubi_shardGetOrLoad() fills in misses by calling a loader function.
+ *  Given wait and wake functions (\c #ubi_shardSetWait()), threads that
+ *  miss on the same key at the same time share one load, instead of all
+ *  doing the same work.
+ *
+ * \b Note: Because another thread may evict an entry as soon as the shard
+ *          is unlocked, \c #ubi_shardGet() does not return a pointer to
+ *          the entry.  Instead, it calls a function with the entry while
+ *          the shard is still locked.  (Alternatively, have each shard
+ *          retire its entries via an epoch domain; see
+ *          \c #ubi_cacheSetRetire().)
+ *
+ *  A shard cache can also be shared by several processes, such as the
+ *  workers of a pre-forking server, so that they keep one warm cache
+ *  between them instead of one each.  Everything has to be in memory that
+ *  all of the processes map at the same address, which is the case for a
+ *  \c MAP_SHARED mapping made before the workers are forked:
+ *  - Put the \c #ubi_shardCache, the shards, the locks, and any other
+ *    memory given to the shards (hash buckets, ghosts, ...) in the shared
+ *    mapping.  The locks must work across processes (e.g., a mutex with
+ *    \c PTHREAD_PROCESS_SHARED).
+ *  - Give the rest of the mapping to \c #ubi_shardSetSlabs(), and
+ *    allocate entries with \c #ubi_shardAlloc().  Keys and data must be
+ *    stored in the entries, not pointed to.
+ *  - The comparison and hash functions are then found at the same address
+ *    in every worker, as long as the workers do not exec().
+ *  - If a worker dies while it holds a shard's lock, that shard may have
+ *    been left half-way through an update.  With a robust mutex, the next
+ *    process to lock it is told so (\c EOWNERDEAD), and should call
+ *    \c #ubi_shardRecover() before using the shard.
+ *  - Use \c #ubi_shardGet(), which copies the data out while the shard is
+ *    locked.  Loads in progress (\c #ubi_shardGetOrLoad() with
+ *    \c #ubi_shardSetWait()) and epoch domains live in the memory of a
+ *    single process, and can't be shared.
+ */
+
+#include <stddef.h>         /* size_t */
+#include "ubi_Cache.h"      /* The shards are ordinary caches. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ */
+
+/**
+ * @typedef ubi_shardLockFunc
+ * @brief   Lock or unlock function.
+ * @details Called with a pointer to the lock object belonging to a shard.
+ */
+typedef void (*ubi_shardLockFunc)( void *Lock );
+
+/**
+ * @struct  ubi_shard
+ * @brief   One shard of a shard cache.
+ */
+typedef struct
+  {
+  ubi_cacheRoot cache;    /**< The cache holding this shard's entries.  */
+  void         *lock;     /**< This shard's lock object, if any.        */
+  unsigned long lookups;  /**< Number of lookups in this shard.         */
+  unsigned long hits;     /**< Number of successful lookups.            */
+  ubi_slabPool  slab;     /**< Entry storage (see ubi_shardSetSlabs()). */
+  unsigned long generation; /**< Times ubi_shardRecover() was called.   */
+  } ubi_shard;
+
+/** Pointer to a \c #ubi_shard. */
+typedef ubi_shard *ubi_shardPtr;
+
+/**
+ * @struct  ubi_shardCache
+ * @brief   Shard cache header structure.
+ */
+typedef struct
+  {
+  ubi_shardPtr      shards;   /**< Array of shards.                      */
+  unsigned int      count;    /**< Number of shards.                     */
+  ubi_cacheHashFunc hash;     /**< Key hash, used to choose the shard.   */
+  ubi_shardLockFunc lock;     /**< Lock function, or NULL.               */
+  ubi_shardLockFunc unlock;   /**< Unlock function, or NULL.             */
+  unsigned int      growth;   /**< Slab class growth, or 0 if no slabs.  */
+  } ubi_shardCache;
+
+/** Pointer to a \c #ubi_shardCache. */
+typedef ubi_shardCache *ubi_shardCachePtr;
+
+/**
+ * @struct  ubi_shardStats
+ * @brief   Totals for all shards, as filled in by \c #ubi_shardGetStats().
+ */
+typedef struct
+  {
+  unsigned long entries;  /**< Number of entries in the cache.          */
+  unsigned long mem_used; /**< Memory used by the entries.              */
+  unsigned long lookups;  /**< Number of lookups.                       */
+  unsigned long hits;     /**< Number of successful lookups.            */
+  } ubi_shardStats;
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ */
+
+/** Return a pointer to the shard that holds (or would hold) the given key.
+ * @param   S A pointer to the shard cache.
+ * @param   K The key.
+ */
+#define ubi_shardOf( S, K ) \
+        (&((ubi_shardCachePtr)(S))->shards[ ubi_shardIndex( (S), (K) ) ])
+
+
+/* -------------------------------------------------------------------------- **
+ * Prototypes...
+ */
+
+ubi_shardCachePtr ubi_shardInit( ubi_shardCachePtr ShardCachePtr,
+                                 ubi_shardPtr      Shards,
+                                 unsigned int      ShardCount,
+                                 ubi_cacheHashFunc HashFunc,
+                                 ubi_trCompFunc    CompFunc,
+                                 ubi_trKillNodeRtn FreeFunc,
+                                 unsigned long     MaxEntries,
+                                 unsigned long     MaxMemory );
+
+void ubi_shardSetLocks( ubi_shardCachePtr ShardCachePtr,
+                        ubi_shardLockFunc LockFunc,
+                        ubi_shardLockFunc UnlockFunc,
+                        void             *Locks,
+                        size_t            LockSize );
+
+void ubi_shardSetWait( ubi_shardCachePtr ShardCachePtr,
+                       ubi_shardLockFunc WaitFunc,
+                       ubi_shardLockFunc WakeFunc );
+
+ubi_trBool ubi_shardSetSlabs( ubi_shardCachePtr ShardCachePtr,
+                              void             *Arena,
+                              unsigned long     ArenaSize,
+                              unsigned long     PageSize,
+                              unsigned int      Growth );
+
+void *ubi_shardAlloc( ubi_shardCachePtr ShardCachePtr,
+                      ubi_trItemPtr     Key,
+                      unsigned long     Size );
+
+void ubi_shardRecover( ubi_shardCachePtr ShardCachePtr, unsigned int Index );
+
+unsigned int ubi_shardIndex( ubi_shardCachePtr ShardCachePtr,
+                             ubi_trItemPtr     Key );
+
+void ubi_shardPut( ubi_shardCachePtr ShardCachePtr,
+                   unsigned long     EntrySize,
+                   ubi_cacheEntryPtr EntryPtr,
+                   ubi_trItemPtr     Key );
+
+ubi_trBool ubi_shardGet( ubi_shardCachePtr ShardCachePtr,
+                         ubi_trItemPtr     FindMe,
+                         ubi_trActionRtn   Action,
+                         void             *UserData );
+
+ubi_trBool ubi_shardGetOrLoad( ubi_shardCachePtr ShardCachePtr,
+                               ubi_trItemPtr     Key,
+                               ubi_cacheLoadFunc Loader,
+                               void             *Context,
+                               ubi_trActionRtn   Action,
+                               void             *UserData );
+
+ubi_trBool ubi_shardDelete( ubi_shardCachePtr ShardCachePtr,
+                            ubi_trItemPtr     DeleteMe );
+
+void ubi_shardClear( ubi_shardCachePtr ShardCachePtr );
+
+ubi_trBool ubi_shardSetPolicy( ubi_shardCachePtr ShardCachePtr, int Policy );
+
+void ubi_shardSetMaxEntries( ubi_shardCachePtr ShardCachePtr,
+                             unsigned long     NewSize );
+
+void ubi_shardSetMaxMemory( ubi_shardCachePtr ShardCachePtr,
+                            unsigned long     NewSize );
+
+void ubi_shardGetStats( ubi_shardCachePtr ShardCachePtr,
+                        ubi_shardStats   *StatsPtr );
+
+/* ================================ The End ================================= */
+#endif /* UBI_SHARDCACHE_H */
@@ -0,0 +1,553 @@
+/* ========================================================================== **
+ *                                ubi_Slab.c
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module implements a slab allocator with size classes.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ */
+
+#include "ubi_Slab.h"   /* Header for *this* module. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Chunk - The header at the start of every chunk.  The caller's memory
+ *          follows it.
+ *  Page  - The header at the start of every page.  The chunks follow it.
+ */
+
+typedef struct
+  {
+  ubi_dlNode     link;          /* Free list or LRU list link.  */
+  unsigned int   size;          /* Bytes requested, if in use.  */
+  unsigned short state;         /* FREE, HELD, or LIVE.         */
+  unsigned short tag;           /* See ubi_slabSetTag().        */
+  } Chunk;
+
+typedef struct
+  {
+  unsigned long used;           /* Chunks in use.               */
+  int           class;          /* The class that owns the page. */
+  } Page;
+
+
+/* -------------------------------------------------------------------------- **
+ * Static Constants...
+ *
+ *  FREE      - Chunk state: on its class's free list.
+ *  HELD      - Chunk state: allocated, but not on the LRU list.
+ *  LIVE      - Chunk state: allocated, and on the LRU list.
+ *  Round()   - Round a size up to a multiple of ubi_slabALIGN.
+ *  CHUNK_HDR - The size of a chunk header, rounded.
+ *  PAGE_HDR  - The size of a page header, rounded.
+ */
+
+#define FREE 0
+#define HELD 1
+#define LIVE 2
+
+#define Round( N ) \
+  (((N) + (ubi_slabALIGN - 1)) & ~(unsigned long)(ubi_slabALIGN - 1))
+
+#define CHUNK_HDR Round( sizeof( Chunk ) )
+#define PAGE_HDR  Round( sizeof( Page ) )
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ *
+ *  ChunkOf() - Given a pointer returned by ubi_slabAlloc(), return a
+ *              pointer to the chunk header.
+ *  DataOf()  - The reverse.
+ *  PageOf()  - Given a chunk, return a pointer to the header of the page
+ *              that contains it.
+ *  PageAt()  - Return a pointer to the page with the given index.
+ *  ChunkAt() - Return a pointer to chunk <I> of page <G> in class <C>.
+ */
+
+#define ChunkOf( P ) ((Chunk *)((char *)(P) - CHUNK_HDR))
+#define DataOf( C )  ((void *)((char *)(C) + CHUNK_HDR))
+
+#define PageOf( Pool, C ) \
+  PageAt( (Pool), ((char *)(C) - (Pool)->base) / (Pool)->page_size )
+
+#define PageAt( Pool, I ) \
+  ((Page *)((Pool)->base + ((I) * (Pool)->page_size)))
+
+#define ChunkAt( G, C, I ) \
+  ((Chunk *)((char *)(G) + PAGE_HDR + ((I) * (C)->chunk_size)))
+
+
+/* -------------------------------------------------------------------------- **
+ * Internal functions...
+ */
+
+static void Assign( ubi_slabPoolPtr PoolPtr, Page *PagePtr, int Class )
+  /* ------------------------------------------------------------------------ **
+   * Give a page to a class, and cut it into free chunks.
+   *
+   *  Input:  PoolPtr - The slab pool.
+   *          PagePtr - The page, which must have no chunks in use.
+   *          Class   - The class that will own the page.
+   *
+   *  Output: <none>
+   *
+   *  Notes:  The chunks are added to the tail of the free list, so that
+   *          chunks that are already warm in the CPU cache are used first.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_slabClass *cls = &PoolPtr->classes[Class];
+  Chunk         *c;
+  unsigned long  i;
+
+  PagePtr->used  = 0;
+  PagePtr->class = Class;
+  cls->pages++;
+  for( i = 0; i < cls->per_page; i++ )
+    {
+    c        = ChunkAt( PagePtr, cls, i );
+    c->size  = 0;
+    c->state = FREE;
+    c->tag   = 0;
+    (void)ubi_dlAddTail( &cls->free, &c->link );
+    }
+  } /* Assign */
+
+
+/* -------------------------------------------------------------------------- **
+ * Exported functions...
+ */
+
+ubi_slabPoolPtr ubi_slabInit( ubi_slabPoolPtr PoolPtr,
+                              void           *Arena,
+                              unsigned long   ArenaSize,
+                              unsigned long   PageSize,
+                              unsigned int    Growth )
+  /** Initialize a slab pool.
+   *
+   * @param   PoolPtr   A pointer to the \c #ubi_slabPool to be initialized.
+   * @param   Arena     The memory to be managed.  It must be aligned on a
+   *                    multiple of \c #ubi_slabALIGN bytes.  (Memory from
+   *                    malloc() is.)
+   * @param   ArenaSize The size of the arena, in bytes.
+   * @param   PageSize  The size of a page, in bytes.  This is also the
+   *                    largest allocation possible, less a few bytes of
+   *                    overhead.  Something around 1MB is typical.
+   * @param   Growth    The ratio between the chunk sizes of neighboring
+   *                    classes, as a percentage.  It must be greater than
+   *                    100.  A smaller ratio wastes less memory in each
+   *                    chunk, but spreads the pages over more classes.
+   *                    125 is a reasonable choice.
+   *
+   * @returns A pointer to the initialized pool (i.e., the same as
+   *          \p PoolPtr), or NULL if the parameters make no sense.
+   *
+   * \b Notes:
+   *  - Any part of the arena that is left over after dividing it into
+   *    pages is not used.
+   *  - The largest class always has a chunk size of (nearly) a page.
+   *    If \p Growth is small enough that \c #ubi_slabMAX_CLASSES classes
+   *    won't reach it, there is a gap between the last two classes.
+   */
+  {
+  unsigned long size, next, max;
+  int           n;
+
+  PageSize = PageSize & ~(unsigned long)(ubi_slabALIGN - 1);
+  if( (NULL == PoolPtr) || (NULL == Arena) || (Growth <= 100)
+   || (PageSize < (PAGE_HDR + ubi_slabMIN_CHUNK)) )
+    return( NULL );
+
+  PoolPtr->base       = (char *)Arena;
+  PoolPtr->page_size  = PageSize;
+  PoolPtr->page_count = ArenaSize / PageSize;
+  PoolPtr->pages_used = 0;
+
+  /* Grow the chunk sizes geometrically, and finish with a whole page. */
+  max  = (PageSize - PAGE_HDR) & ~(unsigned long)(ubi_slabALIGN - 1);
+  size = ubi_slabMIN_CHUNK;
+  for( n = 0; (n < (ubi_slabMAX_CLASSES - 1)) && (size < max); n++ )
+    {
+    PoolPtr->classes[n].chunk_size = size;
+    next = Round( (size * Growth) / 100 );
+    size = (next > size) ? next : (size + ubi_slabALIGN);
+    }
+  PoolPtr->classes[n++].chunk_size = max;
+  PoolPtr->class_count = n;
+
+  for( n = 0; n < PoolPtr->class_count; n++ )
+    {
+    PoolPtr->classes[n].per_page  = (PageSize - PAGE_HDR)
+                                  / PoolPtr->classes[n].chunk_size;
+    PoolPtr->classes[n].pages     = 0;
+    PoolPtr->classes[n].used      = 0;
+    PoolPtr->classes[n].requested = 0;
+    PoolPtr->classes[n].victims   = 0;
+    (void)ubi_dlInitList( &PoolPtr->classes[n].free );
+    (void)ubi_dlInitList( &PoolPtr->classes[n].lru );
+    }
+  return( PoolPtr );
+  } /* ubi_slabInit */
+
+int ubi_slabClassOf( ubi_slabPoolPtr PoolPtr, unsigned long Size )
+  /** Find the size class that serves a given request size.
+   *
+   * @param   PoolPtr   A pointer to the slab pool.
+   * @param   Size      The number of bytes to be requested.
+   *
+   * @returns The index of the smallest class whose chunks can hold
+   *          \p Size bytes, or -1 if the request is too large.
+   */
+  {
+  unsigned long need = Size + CHUNK_HDR;
+  int           lo   = 0;
+  int           hi   = PoolPtr->class_count - 1;
+  int           mid;
+
+  if( (need < Size) || (need > PoolPtr->classes[hi].chunk_size) )
+    return( -1 );
+  while( lo < hi )
+    {
+    mid = (lo + hi) / 2;
+    if( PoolPtr->classes[mid].chunk_size < need )
+      lo = mid + 1;
+    else
+      hi = mid;
+    }
+  return( lo );
+  } /* ubi_slabClassOf */
+
+void *ubi_slabAlloc( ubi_slabPoolPtr PoolPtr, unsigned long Size )
+  /** Allocate memory from a slab pool.
+   *
+   * @param   PoolPtr   A pointer to the slab pool.
+   * @param   Size      The number of bytes needed.
+   *
+   * @returns A pointer to the memory, or NULL if \p Size is too large or
+   *          the class has no free chunk and there are no pages left.
+   *
+   * \b Notes:
+   *  - The chunk is allocated but not live (it is not on the LRU list).
+   *    See \c #ubi_slabLink().
+   *  - When the pool is out of pages, the caller may free the chunk
+   *    returned by \c #ubi_slabVictim() and try again.
+   */
+  {
+  ubi_slabClass *cls;
+  Chunk         *c;
+  int            n = ubi_slabClassOf( PoolPtr, Size );
+
+  if( n < 0 )
+    return( NULL );
+  cls = &PoolPtr->classes[n];
+  if( 0 == ubi_dlCount( &cls->free ) )
+    {
+    if( PoolPtr->pages_used >= PoolPtr->page_count )
+      return( NULL );
+    Assign( PoolPtr, PageAt( PoolPtr, PoolPtr->pages_used ), n );
+    PoolPtr->pages_used++;
+    }
+  c        = (Chunk *)ubi_dlRemHead( &cls->free );
+  c->size  = (unsigned int)Size;
+  c->state = HELD;
+  c->tag   = 0;
+  cls->used++;
+  cls->requested += Size;
+  PageOf( PoolPtr, c )->used++;
+  return( DataOf( c ) );
+  } /* ubi_slabAlloc */
+
+void ubi_slabFree( ubi_slabPoolPtr PoolPtr, void *Ptr )
+  /** Return memory to a slab pool.
+   *
+   * @param   PoolPtr   A pointer to the slab pool.
+   * @param   Ptr       A pointer returned by \c #ubi_slabAlloc(), or NULL.
+   *
+   * \b Note: A live chunk is removed from the LRU list first.
+   */
+  {
+  ubi_slabClass *cls;
+  Page          *g;
+  Chunk         *c;
+
+  if( NULL == Ptr )
+    return;
+  c   = ChunkOf( Ptr );
+  g   = PageOf( PoolPtr, c );
+  cls = &PoolPtr->classes[g->class];
+  if( LIVE == c->state )
+    (void)ubi_dlRemThis( &cls->lru, &c->link );
+  cls->used--;
+  cls->requested -= c->size;
+  g->used--;
+  c->size  = 0;
+  c->state = FREE;
+  (void)ubi_dlAddHead( &cls->free, &c->link );
+  } /* ubi_slabFree */
+
+unsigned long ubi_slabChunkSize( ubi_slabPoolPtr PoolPtr, void *Ptr )
+  /** Return the number of bytes that an allocation really takes up.
+   *
+   * @param   PoolPtr   A pointer to the slab pool.
+   * @param   Ptr       A pointer returned by \c #ubi_slabAlloc().
+   *
+   * @returns The chunk size of the allocation's class, which includes the
+   *          chunk header and the space wasted at the end of the chunk.
+   */
+  {
+  return( PoolPtr->classes[PageOf( PoolPtr, ChunkOf( Ptr ) )->class]
+                                                             .chunk_size );
+  } /* ubi_slabChunkSize */
+
+void ubi_slabSetTag( ubi_slabPoolPtr PoolPtr, void *Ptr, unsigned int Tag )
+  /** Store a small number in an allocated chunk's header.
+   *
+   * @param   PoolPtr   A pointer to the slab pool.
+   * @param   Ptr       A pointer returned by \c #ubi_slabAlloc().
+   * @param   Tag       The number.  Only the low 16 bits are kept.
+   *
+   * \b Note: The tag is zero when the chunk is allocated.  The pool does
+   *          not use it; it is there so that a caller can mark a chunk
+   *          without taking space from the chunk's data.
+   */
+  {
+  ChunkOf( Ptr )->tag = (unsigned short)(Tag & 0xFFFF);
+  } /* ubi_slabSetTag */
+
+unsigned int ubi_slabTag( ubi_slabPoolPtr PoolPtr, void *Ptr )
+  /** Return the tag stored in a chunk's header by \c #ubi_slabSetTag().
+   *
+   * @param   PoolPtr   A pointer to the slab pool.
+   * @param   Ptr       A pointer returned by \c #ubi_slabAlloc().
+   *
+   * @returns The tag, which is zero if none was set.
+   */
+  {
+  return( ChunkOf( Ptr )->tag );
+  } /* ubi_slabTag */
+
+void ubi_slabLink( ubi_slabPoolPtr PoolPtr, void *Ptr )
+  /** Make an allocated chunk live, by adding it to its class's LRU list.
+   *
+   * @param   PoolPtr   A pointer to the slab pool.
+   * @param   Ptr       A pointer returned by \c #ubi_slabAlloc().
+   *
+   * \b Note: Only live chunks can be returned by \c #ubi_slabVictim() or
+   *          evicted by \c #ubi_slabRebalance().  The chunk goes to the
+   *          front of the list.  Linking a live chunk does nothing.
+   */
+  {
+  Chunk *c = ChunkOf( Ptr );
+
+  if( HELD == c->state )
+    {
+    c->state = LIVE;
+    (void)ubi_dlAddHead( &PoolPtr->classes[PageOf( PoolPtr, c )->class].lru,
+                         &c->link );
+    }
+  } /* ubi_slabLink */
+
+void ubi_slabUnlink( ubi_slabPoolPtr PoolPtr, void *Ptr )
+  /** Take a live chunk off of its class's LRU list.
+   *
+   * @param   PoolPtr   A pointer to the slab pool.
+   * @param   Ptr       A pointer returned by \c #ubi_slabAlloc().
+   *
+   * \b Note: The chunk stays allocated.  Unlinking a chunk that is not
+   *          live does nothing.
+   */
+  {
+  Chunk *c = ChunkOf( Ptr );
+
+  if( LIVE == c->state )
+    {
+    c->state = HELD;
+    (void)ubi_dlRemThis( &PoolPtr->classes[PageOf( PoolPtr, c )->class].lru,
+                         &c->link );
+    }
+  } /* ubi_slabUnlink */
+
+void ubi_slabTouch( ubi_slabPoolPtr PoolPtr, void *Ptr )
+  /** Move a live chunk to the front of its class's LRU list.
+   *
+   * @param   PoolPtr   A pointer to the slab pool.
+   * @param   Ptr       A pointer returned by \c #ubi_slabAlloc().
+   *
+   * \b Note: Touching a chunk that is not live does nothing.
+   */
+  {
+  Chunk         *c = ChunkOf( Ptr );
+  ubi_slabClass *cls;
+
+  if( LIVE == c->state )
+    {
+    cls = &PoolPtr->classes[PageOf( PoolPtr, c )->class];
+    if( ubi_dlFirst( &cls->lru ) != &c->link )
+      {
+      (void)ubi_dlRemThis( &cls->lru, &c->link );
+      (void)ubi_dlAddHead( &cls->lru, &c->link );
+      }
+    }
+  } /* ubi_slabTouch */
+
+void *ubi_slabVictim( ubi_slabPoolPtr PoolPtr, unsigned long Size )
+  /** Choose a live chunk to be freed, to make room for a new one.
+   *
+   * @param   PoolPtr   A pointer to the slab pool.
+   * @param   Size      The size of the allocation that failed.
+   *
+   * @returns The least recently used live chunk in the class that serves
+   *          \p Size, or NULL if there is none.
+   *
+   * \b Note: The chunk is not freed.  That's up to the caller, who must
+   *          know what the chunk is being used for.  Each call counts
+   *          toward the class's need for more pages, even if there is no
+   *          victim to return (a class with no pages has none); see
+   *          \c #ubi_slabRebalance().
+   */
+  {
+  ubi_slabClass *cls;
+  int            n = ubi_slabClassOf( PoolPtr, Size );
+
+  if( n < 0 )
+    return( NULL );
+  cls = &PoolPtr->classes[n];
+  cls->victims++;
+  if( NULL == ubi_dlLast( &cls->lru ) )
+    return( NULL );
+  return( DataOf( ubi_dlLast( &cls->lru ) ) );
+  } /* ubi_slabVictim */
+
+int ubi_slabRebalance( ubi_slabPoolPtr   PoolPtr,
+                       ubi_slabEvictFunc Evict,
+                       void             *UserData )
+  /** Move a page from the class that needs it least to the one that
+   *  needs it most.
+   *
+   * @param   PoolPtr   A pointer to the slab pool.
+   * @param   Evict     A function that releases a live chunk.
+   * @param   UserData  A pointer that is passed to \p Evict.
+   *
+   * @returns Non-zero if a page was moved, else zero.
+   *
+   * \b Notes:
+   *  - The class that needs a page most is the one with the most victims
+   *    since the last rebalance.  The page is taken from the class, among
+   *    the others that have pages, with the fewest victims.  Of that
+   *    class's pages, the one with the fewest chunks in use is chosen,
+   *    and \p Evict is called for each of its live chunks.
+   *  - If the page has chunks that are allocated but not live, or if the
+   *    page is still in use after the live chunks have been evicted (for
+   *    example, because \p Evict defers freeing them), nothing is moved.
+   *    A later call may succeed.
+   *  - Once a page has been moved, all of the victim counts are reset.
+   *  - This scans the page headers, so it is O(p + k), where p is the
+   *    number of pages and k the number of chunks per page.
+   */
+  {
+  ubi_slabClass *cls;
+  Page          *g, *best = NULL;
+  Chunk         *c;
+  unsigned long  i;
+  int            n, dst = -1, src = -1;
+
+  for( n = 0; n < PoolPtr->class_count; n++ )
+    {
+    if( PoolPtr->classes[n].victims
+     && ((dst < 0) || (PoolPtr->classes[n].victims
+                       > PoolPtr->classes[dst].victims)) )
+      dst = n;
+    }
+  if( dst < 0 )
+    return( 0 );
+  for( n = 0; n < PoolPtr->class_count; n++ )
+    {
+    if( (n != dst) && PoolPtr->classes[n].pages
+     && ((src < 0) || (PoolPtr->classes[n].victims
+                       < PoolPtr->classes[src].victims)) )
+      src = n;
+    }
+  if( src < 0 )
+    return( 0 );
+
+  for( i = 0; i < PoolPtr->pages_used; i++ )
+    {
+    g = PageAt( PoolPtr, i );
+    if( (src == g->class) && ((NULL == best) || (g->used < best->used)) )
+      best = g;
+    }
+
+  cls = &PoolPtr->classes[src];
+  for( i = 0; i < cls->per_page; i++ )
+    {
+    if( HELD == ChunkAt( best, cls, i )->state )
+      return( 0 );
+    }
+  for( i = 0; (i < cls->per_page) && best->used; i++ )
+    {
+    c = ChunkAt( best, cls, i );
+    if( LIVE == c->state )
+      (*Evict)( UserData, DataOf( c ) );
+    }
+  if( best->used )
+    return( 0 );
+
+  for( i = 0; i < cls->per_page; i++ )
+    (void)ubi_dlRemThis( &cls->free, &ChunkAt( best, cls, i )->link );
+  cls->pages--;
+  Assign( PoolPtr, best, dst );
+  for( n = 0; n < PoolPtr->class_count; n++ )
+    PoolPtr->classes[n].victims = 0;
+  return( 1 );
+  } /* ubi_slabRebalance */
+
+int ubi_slabFragmentation( ubi_slabPoolPtr PoolPtr )
+  /** Report how much of the memory in use is wasted.
+   *
+   * @param   PoolPtr   A pointer to the slab pool.
+   *
+   * @returns The percentage of the bytes in assigned pages that are not
+   *          part of any request: free chunks, chunk headers, and the
+   *          unused ends of chunks and pages.  Zero if no pages are
+   *          assigned.
+   */
+  {
+  unsigned long bytes = ubi_slabBytesUsed( PoolPtr );
+  unsigned long requested = 0;
+  int           n;
+
+  if( 0 == bytes )
+    return( 0 );
+  for( n = 0; n < PoolPtr->class_count; n++ )
+    requested += PoolPtr->classes[n].requested;
+  return( (int)((100.0 * (double)(bytes - requested)) / (double)bytes) );
+  } /* ubi_slabFragmentation */
+
+/* ================================ The End ================================= */
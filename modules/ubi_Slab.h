@@ -0,0 +1,234 @@
+#ifndef UBI_SLAB_H
+#define UBI_SLAB_H
+/* ========================================================================== **
+ *                                ubi_Slab.h
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module implements a slab allocator with size classes.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ *//**
+ * @file      ubi_Slab.h
+ * @author    Christopher R. Hertel
+ * @brief     Slab allocator with size classes, built on \c ubi_dLinkList.
+ * @date      Oct 2026
+ * @version   \$Id$
+ * @copyright Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * @details
+ *  A cache that calls malloc() for every entry has two problems.  The
+ *  first is the cost of malloc() and free() themselves.  The second is
+ *  that nobody knows how much memory the cache is really using: the
+ *  allocator rounds every request up, adds its own bookkeeping, and
+ *  fragments the heap over time.  A memory limit that counts the sizes
+ *  that were asked for will always be too low.
+ *
+ *  A slab pool manages a single block of memory (the "arena") that you
+ *  provide.  The arena is divided into pages of equal size, and each page,
+ *  once it is used, belongs to one size class.  The chunk sizes of the
+ *  classes grow geometrically, by a factor that you choose, from 64 bytes
+ *  up to a whole page.  A page is cut into chunks of its class's size, and
+ *  the free chunks of each class are kept on a list.
+ *  - \c #ubi_slabAlloc() and \c #ubi_slabFree() are O(log c) and O(1),
+ *    where c is the number of classes.  They never call malloc().
+ *  - The pool never uses more memory than the arena.  The difference
+ *    between the bytes requested and the bytes held in pages is the
+ *    fragmentation (\c #ubi_slabFragmentation()).
+ *
+ *  Each chunk carries a small header, which holds its requested size and
+ *  links it into either its class's free list or its class's LRU list.
+ *  It also has room for a 16-bit tag that the caller may use as it likes
+ *  (\c #ubi_slabSetTag()).
+ *  Allocated chunks are not on the LRU list until you put them there with
+ *  \c #ubi_slabLink().  Linked chunks are "live": \c #ubi_slabTouch()
+ *  moves them to the front of the LRU list, and \c #ubi_slabVictim()
+ *  returns the least recently used one in a given class, so that it can
+ *  be freed to make room for another of the same size.
+ *
+ *  Once the arena is fully assigned, pages stay with their classes, and a
+ *  change in the mix of sizes will leave some classes starved while
+ *  others have room to spare.  \c #ubi_slabRebalance() moves one page
+ *  from the class that has needed the fewest victims to the class that
+ *  has needed the most, freeing the live chunks in that page by way of a
+ *  callback.  Call it now and then (say, once a second).
+ *
+ * \b Notes
+ *  - The memory returned by \c #ubi_slabAlloc() is aligned on a multiple
+ *    of \c #ubi_slabALIGN bytes.
+ *  - The \c ubi_Cache module can use a slab pool to hold its entries.
+ *    See \c #ubi_cacheSetSlab().
+ */
+
+#include "ubi_dLinkList.h"  /* Free and LRU lists. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Constants...
+ */
+
+/**
+ * @def     ubi_slabMAX_CLASSES
+ * @brief   The maximum number of size classes in a pool.
+ * @def     ubi_slabMIN_CHUNK
+ * @brief   The size of the smallest chunk, including the chunk header.
+ * @def     ubi_slabALIGN
+ * @brief   The alignment of chunk sizes, and of the memory returned.
+ */
+#define ubi_slabMAX_CLASSES 64
+#define ubi_slabMIN_CHUNK   64
+#define ubi_slabALIGN       8
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ */
+
+/**
+ * @struct  ubi_slabClass
+ * @brief   A size class.
+ * @var     ubi_slabClass::chunk_size
+ *          The size of each chunk, in bytes, including its header.
+ * @var     ubi_slabClass::per_page
+ *          The number of chunks that fit in a page.
+ * @var     ubi_slabClass::pages
+ *          The number of pages assigned to the class.
+ * @var     ubi_slabClass::used
+ *          The number of chunks allocated.
+ * @var     ubi_slabClass::requested
+ *          The total number of bytes requested for the allocated chunks.
+ * @var     ubi_slabClass::victims
+ *          The number of times a victim was needed since the last
+ *          rebalance.
+ * @var     ubi_slabClass::free
+ *          The free chunks.
+ * @var     ubi_slabClass::lru
+ *          The live chunks, most recently used first.
+ */
+typedef struct
+  {
+  unsigned long chunk_size;
+  unsigned long per_page;
+  unsigned long pages;
+  unsigned long used;
+  unsigned long requested;
+  unsigned long victims;
+  ubi_dlList    free;
+  ubi_dlList    lru;
+  } ubi_slabClass;
+
+/**
+ * @struct  ubi_slabPool
+ * @brief   Slab pool header structure.
+ * @var     ubi_slabPool::base
+ *          The first page of the arena.
+ * @var     ubi_slabPool::page_size
+ *          The size of each page, in bytes.
+ * @var     ubi_slabPool::page_count
+ *          The number of pages in the arena.
+ * @var     ubi_slabPool::pages_used
+ *          The number of pages that have been assigned to a class.  Pages
+ *          are assigned in order, and stay assigned.
+ * @var     ubi_slabPool::class_count
+ *          The number of size classes.
+ * @var     ubi_slabPool::classes
+ *          The size classes, smallest first.
+ */
+typedef struct
+  {
+  char          *base;
+  unsigned long  page_size;
+  unsigned long  page_count;
+  unsigned long  pages_used;
+  int            class_count;
+  ubi_slabClass  classes[ubi_slabMAX_CLASSES];
+  } ubi_slabPool;
+
+/**
+ * @typedef ubi_slabPoolPtr
+ * @brief   Pointer to a \c #ubi_slabPool.
+ */
+typedef ubi_slabPool *ubi_slabPoolPtr;
+
+/**
+ * @typedef ubi_slabEvictFunc
+ * @brief   Chunk eviction callback, for \c #ubi_slabRebalance().
+ * @details The first parameter is the user data pointer that was passed to
+ *          \c #ubi_slabRebalance().  The second is a live chunk (as
+ *          returned by \c #ubi_slabAlloc()).  The callback must release
+ *          the chunk: either free it with \c #ubi_slabFree(), or at least
+ *          \c #ubi_slabUnlink() it, to be freed later.
+ */
+typedef void (*ubi_slabEvictFunc)( void *, void * );
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ */
+
+/** Return the number of pages in use, in bytes. */
+#define ubi_slabBytesUsed( P ) \
+  (((ubi_slabPoolPtr)(P))->pages_used * ((ubi_slabPoolPtr)(P))->page_size)
+
+
+/* -------------------------------------------------------------------------- **
+ * Prototypes...
+ */
+
+ubi_slabPoolPtr ubi_slabInit( ubi_slabPoolPtr PoolPtr,
+                              void           *Arena,
+                              unsigned long   ArenaSize,
+                              unsigned long   PageSize,
+                              unsigned int    Growth );
+
+int ubi_slabClassOf( ubi_slabPoolPtr PoolPtr, unsigned long Size );
+
+void *ubi_slabAlloc( ubi_slabPoolPtr PoolPtr, unsigned long Size );
+
+void ubi_slabFree( ubi_slabPoolPtr PoolPtr, void *Ptr );
+
+unsigned long ubi_slabChunkSize( ubi_slabPoolPtr PoolPtr, void *Ptr );
+
+void ubi_slabSetTag( ubi_slabPoolPtr PoolPtr, void *Ptr, unsigned int Tag );
+
+unsigned int ubi_slabTag( ubi_slabPoolPtr PoolPtr, void *Ptr );
+
+void ubi_slabLink( ubi_slabPoolPtr PoolPtr, void *Ptr );
+
+void ubi_slabUnlink( ubi_slabPoolPtr PoolPtr, void *Ptr );
+
+void ubi_slabTouch( ubi_slabPoolPtr PoolPtr, void *Ptr );
+
+void *ubi_slabVictim( ubi_slabPoolPtr PoolPtr, unsigned long Size );
+
+int ubi_slabRebalance( ubi_slabPoolPtr   PoolPtr,
+                       ubi_slabEvictFunc Evict,
+                       void             *UserData );
+
+int ubi_slabFragmentation( ubi_slabPoolPtr PoolPtr );
+
+/* ================================ The End ================================= */
+#endif /* UBI_SLAB_H */
@@ -0,0 +1,311 @@
+/* ========================================================================== **
+ *                              ubi_TimerWheel.c
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module implements a hierarchical timing wheel.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ */
+
+#include "ubi_TimerWheel.h"   /* Header for *this* module. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Static Constants...
+ *
+ *  SlotMask  - Mask for the bucket index within a level.
+ *  TopShift  - The shift that selects the top level's bucket index.
+ */
+
+#define SlotMask  ((unsigned long)(ubi_timerSLOTS - 1))
+#define TopShift  (ubi_timerBITS * (ubi_timerLEVELS - 1))
+
+
+/* -------------------------------------------------------------------------- **
+ * Internal functions...
+ */
+
+static void Place( ubi_timerWheelPtr WheelPtr, ubi_timerNodePtr TimerPtr )
+  /* ------------------------------------------------------------------------ **
+   * Put a timer into the bucket that matches its expiry time.
+   *
+   *  Input:  WheelPtr  - The timing wheel.
+   *          TimerPtr  - The timer, which must not be in any bucket.
+   *
+   *  Output: <none>
+   *
+   *  Notes:  The level is chosen by how far in the future the timer
+   *          expires, and the bucket within the level by the expiry time
+   *          itself.  A timer that has already expired goes into the
+   *          bucket for the next tick to be processed.  A timer that is
+   *          beyond the range of the wheel is placed as if it expired at
+   *          the end of the range; it will be re-placed when that bucket
+   *          is cascaded.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long now   = WheelPtr->now;
+  unsigned long when  = TimerPtr->expires;
+  unsigned long delta = when - now;
+  int           lvl;
+
+  if( (long)delta < 0 )
+    {
+    lvl  = 0;
+    when = now;
+    }
+  else
+    {
+    for( lvl = 0; lvl < (ubi_timerLEVELS - 1); lvl++ )
+      {
+      if( delta < (1UL << (ubi_timerBITS * (lvl + 1))) )
+        break;
+      }
+    if( (lvl == (ubi_timerLEVELS - 1)) && ((delta >> TopShift) > SlotMask) )
+      when = now + (SlotMask << TopShift);
+    }
+
+  TimerPtr->bucket = &WheelPtr->slot[lvl][(when >> (ubi_timerBITS * lvl))
+                                          & SlotMask];
+  (void)ubi_dlAddTail( TimerPtr->bucket, TimerPtr );
+  } /* Place */
+
+static ubi_dlListPtr Detach( ubi_dlListPtr Bucket, ubi_dlListPtr Local )
+  /* ------------------------------------------------------------------------ **
+   * Move the contents of a bucket into a local list.
+   *
+   *  Input:  Bucket  - The bucket to be emptied.
+   *          Local   - The list that will receive the timers.
+   *
+   *  Output: A pointer to <Local>.
+   *
+   *  Notes:  The bucket pointer in each timer is updated, so that a timer
+   *          can still be cancelled while it is in the local list.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_dlNodePtr p;
+
+  *Local = *Bucket;
+  (void)ubi_dlInitList( Bucket );
+  for( p = ubi_dlFirst( Local ); NULL != p; p = ubi_dlNext( p ) )
+    ((ubi_timerNodePtr)p)->bucket = Local;
+  return( Local );
+  } /* Detach */
+
+static void Cascade( ubi_timerWheelPtr WheelPtr )
+  /* ------------------------------------------------------------------------ **
+   * Empty the upper level buckets that come due at the current tick.
+   *
+   *  Input:  WheelPtr  - The timing wheel.
+   *
+   *  Output: <none>
+   *
+   *  Notes:  At every multiple of 64 ticks, the level 1 bucket covering
+   *          the next 64 ticks is emptied into level 0.  At every multiple
+   *          of 4096, the level 2 bucket is first emptied into level 1 (and
+   *          below), and so on.  The higher levels are emptied first, so
+   *          that everything ends up in the right place in a single pass.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long now = WheelPtr->now;
+  ubi_dlList    Local[1];
+  ubi_dlNodePtr p;
+  int           lvl;
+  int           top;
+
+  /* Find the highest level whose bucket boundary we are on. */
+  for( top = 1; top < ubi_timerLEVELS; top++ )
+    {
+    if( 0 != ((now >> (ubi_timerBITS * (top - 1))) & SlotMask) )
+      break;
+    }
+
+  for( lvl = top - 1; lvl > 0; lvl-- )
+    {
+    (void)Detach( &WheelPtr->slot[lvl][(now >> (ubi_timerBITS * lvl))
+                                       & SlotMask], Local );
+    while( NULL != (p = ubi_dlRemHead( Local )) )
+      Place( WheelPtr, (ubi_timerNodePtr)p );
+    }
+  } /* Cascade */
+
+
+/* -------------------------------------------------------------------------- **
+ * Exported functions...
+ */
+
+ubi_timerWheelPtr ubi_timerInitWheel( ubi_timerWheelPtr WheelPtr,
+                                      unsigned long     Now )
+  /** Initialize a timing wheel.
+   *
+   * @param   WheelPtr  A pointer to the \c #ubi_timerWheel to be
+   *                    initialized.
+   * @param   Now       The current time, in ticks.
+   *
+   * @returns A pointer to the initialized wheel (i.e., the same as
+   *          \p WheelPtr).
+   */
+  {
+  int lvl, i;
+
+  if( WheelPtr )
+    {
+    WheelPtr->now   = Now;
+    WheelPtr->count = 0;
+    for( lvl = 0; lvl < ubi_timerLEVELS; lvl++ )
+      for( i = 0; i < ubi_timerSLOTS; i++ )
+        (void)ubi_dlInitList( &WheelPtr->slot[lvl][i] );
+    }
+  return( WheelPtr );
+  } /* ubi_timerInitWheel */
+
+ubi_timerNodePtr ubi_timerInitNode( ubi_timerNodePtr TimerPtr )
+  /** Initialize a timer.
+   *
+   * @param   TimerPtr  A pointer to the \c #ubi_timerNode to be
+   *                    initialized.
+   *
+   * @returns A pointer to the initialized timer (i.e., the same as
+   *          \p TimerPtr).
+   *
+   * \b Note: A timer must be initialized once, before it is first used.
+   *          After that, it may be added, cancelled, and re-added as often
+   *          as needed.
+   */
+  {
+  TimerPtr->node.Next = NULL;
+  TimerPtr->node.Prev = NULL;
+  TimerPtr->expires   = 0;
+  TimerPtr->bucket    = NULL;
+  return( TimerPtr );
+  } /* ubi_timerInitNode */
+
+ubi_timerNodePtr ubi_timerAdd( ubi_timerWheelPtr WheelPtr,
+                               ubi_timerNodePtr  TimerPtr,
+                               unsigned long     Expires )
+  /** Start a timer, or move a pending timer to a new expiry time.
+   *
+   * @param   WheelPtr  A pointer to the timing wheel.
+   * @param   TimerPtr  A pointer to the timer.
+   * @param   Expires   The tick at which the timer should expire.
+   *
+   * @returns A pointer to the timer (i.e., the same as \p TimerPtr).
+   *
+   * \b Notes
+   *  - If the timer is already pending, it is moved.  This is an O(1)
+   *    operation either way.  \c #ubi_timerReset() is an alias.
+   *  - A timer whose expiry time has already passed will fire on the next
+   *    tick that is processed.
+   */
+  {
+  if( NULL != TimerPtr->bucket )
+    (void)ubi_dlRemThis( TimerPtr->bucket, TimerPtr );
+  else
+    WheelPtr->count++;
+  TimerPtr->expires = Expires;
+  Place( WheelPtr, TimerPtr );
+  return( TimerPtr );
+  } /* ubi_timerAdd */
+
+ubi_timerNodePtr ubi_timerCancel( ubi_timerWheelPtr WheelPtr,
+                                  ubi_timerNodePtr  TimerPtr )
+  /** Stop a pending timer.
+   *
+   * @param   WheelPtr  A pointer to the timing wheel.
+   * @param   TimerPtr  A pointer to the timer.
+   *
+   * @returns A pointer to the timer if it was pending, or NULL if it was
+   *          not.
+   */
+  {
+  if( NULL == TimerPtr->bucket )
+    return( NULL );
+  (void)ubi_dlRemThis( TimerPtr->bucket, TimerPtr );
+  TimerPtr->bucket = NULL;
+  WheelPtr->count--;
+  return( TimerPtr );
+  } /* ubi_timerCancel */
+
+unsigned long ubi_timerAdvance( ubi_timerWheelPtr   WheelPtr,
+                                unsigned long       Now,
+                                ubi_timerExpireFunc Expire,
+                                void               *UserData )
+  /** Advance the wheel to the given time, firing expired timers.
+   *
+   * @param   WheelPtr  A pointer to the timing wheel.
+   * @param   Now       The current time, in ticks.  All timers that expire
+   *                    at or before this time will fire.
+   * @param   Expire    The function to call for each expired timer.  May
+   *                    be NULL, in which case expired timers are simply
+   *                    removed from the wheel.
+   * @param   UserData  A pointer that is passed to \p Expire.
+   *
+   * @returns The number of timers that expired.
+   *
+   * \b Notes
+   *  - Timers fire in order of expiry tick.  Each timer is removed from the
+   *    wheel before its callback is called.
+   *  - The wheel steps through every tick between the previous call and
+   *    this one.  Empty buckets cost very little, and if the wheel is
+   *    empty it jumps straight to \p Now.
+   *  - If \p Now is earlier than a previous call, nothing happens.
+   */
+  {
+  ubi_dlList       Local[1];
+  ubi_timerNodePtr t;
+  unsigned long    fired = 0;
+
+  while( (long)(Now - WheelPtr->now) >= 0 )
+    {
+    if( 0 == WheelPtr->count )
+      {
+      WheelPtr->now = Now + 1;
+      break;
+      }
+    if( 0 == (WheelPtr->now & SlotMask) )
+      Cascade( WheelPtr );
+
+    /* Detach the bucket before moving the clock forward, so that timers
+     * added by the callbacks land in the right place.
+     */
+    (void)Detach( &WheelPtr->slot[0][WheelPtr->now & SlotMask], Local );
+    WheelPtr->now++;
+    while( NULL != (t = (ubi_timerNodePtr)ubi_dlRemHead( Local )) )
+      {
+      t->bucket = NULL;
+      WheelPtr->count--;
+      fired++;
+      if( Expire )
+        (*Expire)( t, UserData );
+      }
+    }
+  return( fired );
+  } /* ubi_timerAdvance */
+
+/* ================================ The End ================================= */
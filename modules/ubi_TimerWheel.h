@@ -0,0 +1,209 @@
+#ifndef UBI_TIMERWHEEL_H
+#define UBI_TIMERWHEEL_H
+/* ========================================================================== **
+ *                              ubi_TimerWheel.h
+ *
+ *  Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This module implements a hierarchical timing wheel.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * -------------------------------------------------------------------------- **
+ *
+ * $Id$
+ * https://github.com/ubiqx-org/Modules
+ *
+ * ========================================================================== **
+ *//**
+ * @file      ubi_TimerWheel.h
+ * @author    Christopher R. Hertel
+ * @brief     Hierarchical timing wheel, built on \c ubi_dLinkList.
+ * @date      Oct 2026
+ * @version   \$Id$
+ * @copyright Copyright (C) 2026 by Christopher R. Hertel
+ *
+ * @details
+ *  Timeouts are usually set far more often than they fire.  A network
+ *  connection, for example, pushes its idle timeout forward every time a
+ *  packet arrives, and the timeout almost never expires.  Keeping timers
+ *  sorted (say, in an AVL tree keyed by deadline) makes every one of those
+ *  resets cost a removal and an insertion.
+ *
+ *  A timing wheel doesn't sort the timers.  Time is measured in ticks (the
+ *  unit is up to you), and each timer is dropped into a bucket (a
+ *  \c #ubi_dlList) chosen by its expiry time.  The wheel has
+ *  \c #ubi_timerLEVELS levels of \c #ubi_timerSLOTS buckets each.  Level 0
+ *  has one bucket per tick, level 1 one bucket per 64 ticks, level 2 one
+ *  per 4096 ticks, and so on.  As time advances, the buckets of the
+ *  coarser levels are emptied into the finer levels ("cascaded").
+ *
+ *  - Adding, cancelling, and resetting a timer are O(1).
+ *  - \c #ubi_timerAdvance() costs O(1) per tick, plus O(1) per expired
+ *    timer, plus the cascades.  A timer is cascaded at most once per
+ *    level, and most timers are cancelled or reset long before they get
+ *    that far.
+ *
+ *  A timer is an intrusive \c #ubi_timerNode, which should be the first
+ *  member of your own structure.  The wheel never allocates memory.
+ *
+ * \b Notes
+ *  - Times are <tt>unsigned long</tt> tick counts, and are compared using
+ *    modular arithmetic, so the counter may wrap.  Timers may be set up to
+ *    <tt>LONG_MAX</tt> ticks into the future.  Timers set beyond the range
+ *    of the wheel (2^36 ticks, if <tt>long</tt> is 64 bits) are parked in
+ *    the top level and re-sorted each time around.
+ *  - Timers fire in tick order.  Timers that expire on the same tick fire
+ *    in no particular order.
+ *
+ * @see Varghese and Lauck (1987), "Hashed and hierarchical timing wheels:
+ *      data structures for the efficient implementation of a timer
+ *      facility", Proceedings of the 11th ACM SOSP.
+ */
+
+#include "ubi_dLinkList.h"  /* Buckets are doubly linked lists. */
+
+
+/* -------------------------------------------------------------------------- **
+ * Constants...
+ */
+
+/**
+ * @def     ubi_timerBITS
+ * @brief   The number of bits of the expiry time covered by each level.
+ * @def     ubi_timerSLOTS
+ * @brief   The number of buckets in each level (2 ^ \c #ubi_timerBITS).
+ * @def     ubi_timerLEVELS
+ * @brief   The number of levels in the wheel.
+ */
+#define ubi_timerBITS    6
+#define ubi_timerSLOTS   (1 << ubi_timerBITS)
+#define ubi_timerLEVELS  6
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ */
+
+/**
+ * @struct  ubi_timerNode
+ * @brief   A timer.
+ * @var     ubi_timerNode::node
+ *          The list node that links the timer into its bucket.  This must
+ *          be the first member of the structure.
+ * @var     ubi_timerNode::expires
+ *          The tick at which the timer expires.
+ * @var     ubi_timerNode::bucket
+ *          The bucket that the timer is in, or NULL if the timer is not
+ *          pending.
+ */
+typedef struct
+  {
+  ubi_dlNode    node;
+  unsigned long expires;
+  ubi_dlListPtr bucket;
+  } ubi_timerNode;
+
+/**
+ * @typedef ubi_timerNodePtr
+ * @brief   Pointer to a \c #ubi_timerNode.
+ */
+typedef ubi_timerNode *ubi_timerNodePtr;
+
+/**
+ * @struct  ubi_timerWheel
+ * @brief   Timing wheel header structure.
+ * @var     ubi_timerWheel::now
+ *          The next tick to be processed.  Every timer that expired
+ *          before this tick has already fired.
+ * @var     ubi_timerWheel::count
+ *          The number of pending timers.
+ * @var     ubi_timerWheel::slot
+ *          The buckets.
+ */
+typedef struct
+  {
+  unsigned long now;
+  unsigned long count;
+  ubi_dlList    slot[ubi_timerLEVELS][ubi_timerSLOTS];
+  } ubi_timerWheel;
+
+/**
+ * @typedef ubi_timerWheelPtr
+ * @brief   Pointer to a \c #ubi_timerWheel.
+ */
+typedef ubi_timerWheel *ubi_timerWheelPtr;
+
+/**
+ * @typedef ubi_timerExpireFunc
+ * @brief   Timer expiry callback.
+ * @details This function is called by \c #ubi_timerAdvance() for each
+ *          timer that expires.  The first parameter is the timer, which
+ *          has already been removed from the wheel.  The second is the
+ *          user data pointer that was passed to \c #ubi_timerAdvance().
+ *
+ *          The callback may add, cancel, or reset any timer (including
+ *          the one that just fired), but must not call
+ *          \c #ubi_timerAdvance().
+ */
+typedef void (*ubi_timerExpireFunc)( ubi_timerNodePtr, void * );
+
+
+/* -------------------------------------------------------------------------- **
+ * Macros...
+ */
+
+/** Return the number of timers pending in the wheel. */
+#define ubi_timerCount( W ) (((ubi_timerWheelPtr)(W))->count)
+
+/** Return non-zero if the given timer is pending, else zero. */
+#define ubi_timerPending( T ) (NULL != ((ubi_timerNodePtr)(T))->bucket)
+
+/** Move a pending timer to a new expiry time, or start an idle one.
+ * @param   W The wheel.
+ * @param   T The timer.
+ * @param   E The new expiry time.
+ * @see     #ubi_timerAdd()
+ */
+#define ubi_timerReset( W, T, E ) ubi_timerAdd( (W), (T), (E) )
+
+
+/* -------------------------------------------------------------------------- **
+ * Prototypes...
+ */
+
+ubi_timerWheelPtr ubi_timerInitWheel( ubi_timerWheelPtr WheelPtr,
+                                      unsigned long     Now );
+
+ubi_timerNodePtr ubi_timerInitNode( ubi_timerNodePtr TimerPtr );
+
+ubi_timerNodePtr ubi_timerAdd( ubi_timerWheelPtr WheelPtr,
+                               ubi_timerNodePtr  TimerPtr,
+                               unsigned long     Expires );
+
+ubi_timerNodePtr ubi_timerCancel( ubi_timerWheelPtr WheelPtr,
+                                  ubi_timerNodePtr  TimerPtr );
+
+unsigned long ubi_timerAdvance( ubi_timerWheelPtr   WheelPtr,
+                                unsigned long       Now,
+                                ubi_timerExpireFunc Expire,
+                                void               *UserData );
+
+/* ================================ The End ================================= */
+#endif /* UBI_TIMERWHEEL_H */
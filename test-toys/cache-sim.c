@@ -0,0 +1,411 @@
+/* ========================================================================== **
+ *                                cache-sim.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Replay a synthetic trace against the cache eviction
+ *              policies and report hit ratios.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  A trace of key requests is generated from a Zipf distribution, and then
+ *  replayed against a ubi_Cache once for each eviction policy.  Every miss
+ *  is followed by a ubi_cachePut() of the missing key, as an application
+ *  would do after fetching the data.  The hit ratio and the time per
+ *  request are reported for each policy.
+ *
+ *  With -s, the Zipf requests are interrupted by scans: after every
+ *  <scan> Zipf requests come <scan> requests for keys that are never
+ *  seen again.  None of the scan requests can hit, and a scan-resistant
+ *  policy will not let them push the popular keys out of the cache.
+ *
+ *  With -a 1, each policy is run with a TinyLFU admission filter.  With
+ *  -a 2, each policy is run both without and with the filter.
+ *
+ *  With -b 1 or -b 2, entries vary in size.  Each key is given a size
+ *  between 100 bytes and 1MB (evenly spread on a log scale), the cache is
+ *  limited by memory instead of entry count, and the byte hit ratio is
+ *  reported as well.  The memory limit is <capacity> times the average
+ *  entry size.  With -b 2, the GDSF policy is given the entry size as the
+ *  cost of each entry, so that it favors the byte hit ratio.
+ *
+ *  -r sets the number of entries that the sampled policy compares for
+ *  each eviction.  Its hit ratio should come close to that of lru.
+ *
+ *  Usage:
+ *    ./cache-sim [-k keys] [-c capacity] [-n requests] [-z skew]
+ *                [-s scan] [-a admit] [-b sizes] [-r samples] [-p policy]
+ *
+ *  Defaults: 1000000 keys, a capacity of 50000 entries, 5000000 requests,
+ *  a skew of 0.9, no scans, no admission filter, entries of size 1, and
+ *  samples of 5.  By default, all policies are run.
+ *
+ *  Link with -lm.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.                */
+#include <stdlib.h>             /* Standard C library.          */
+#include <string.h>             /* strcmp(3).                   */
+#include <math.h>               /* pow(3), for the Zipf curve.  */
+#include <time.h>               /* clock(3).                    */
+
+#include "ubi_Cache.h"          /* Cache module.                */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Rec       - A cache entry with an integer key.
+ *  PolicyTab - Maps a policy name to its ubi_Cache constant.
+ */
+
+typedef struct
+  {
+  ubi_cacheEntryExt Entry;
+  unsigned long     Key;
+  } Rec;
+
+typedef struct
+  {
+  char *name;
+  int   policy;
+  } PolicyTab;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static PolicyTab Policies[] =
+  {
+  { "splay",    ubi_cacheSPLAY    },
+  { "lru",      ubi_cacheLRU      },
+  { "clock",    ubi_cacheCLOCK    },
+  { "clockpro", ubi_cacheCLOCKPRO },
+  { "arc",      ubi_cacheARC      },
+  { "gdsf",     ubi_cacheGDSF     },
+  { "sampled",  ubi_cacheSAMPLED  },
+  { NULL,       0                 }
+  };
+
+static Rec         **FreeStack;
+static unsigned long FreeCount;
+static unsigned long Seed    = 1;
+static int           Sizes   = 0;
+static unsigned long Slots   = 0;
+static unsigned long Samples = 5;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static unsigned long Random( void )
+  /* ------------------------------------------------------------------------ **
+   * A small LCG, returning 31 random bits.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Seed = (Seed * 6364136223846793005UL) + 1442695040888963407UL;
+  return( Seed >> 33 );
+  } /* Random */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Rec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static unsigned long HashFunc( ubi_trItemPtr ItemPtr )
+  /* ------------------------------------------------------------------------ **
+   * Hash an integer key.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( *(unsigned long *)ItemPtr * 0x9E3779B97F4A7C15UL );
+  } /* HashFunc */
+
+
+static unsigned long SizeOf( unsigned long key )
+  /* ------------------------------------------------------------------------ **
+   * Return the size of the entry for a key: between 100 bytes and 1MB,
+   * evenly spread on a log scale.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  double u = (double)(HashFunc( &key ) >> 11) / 9007199254740992.0;
+
+  return( (unsigned long)(100.0 * pow( 10000.0, u )) );
+  } /* SizeOf */
+
+
+static unsigned long CostFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * GDSF cost function: the cost of a miss is the number of bytes loaded.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( ((ubi_cacheEntryPtr)NodePtr)->entry_size );
+  } /* CostFunc */
+
+
+static void FreeFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Return an evicted entry to the free stack.  Entries of varying size
+   * are allocated one at a time, since there is no telling how many will
+   * fit.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( Sizes )
+    free( NodePtr );
+  else
+    FreeStack[FreeCount++] = (Rec *)NodePtr;
+  } /* FreeFunc */
+
+
+static unsigned long *MakeTrace( unsigned long keys,
+                                 unsigned long requests,
+                                 double        skew,
+                                 unsigned long scan )
+  /* ------------------------------------------------------------------------ **
+   * Generate a Zipf-distributed trace.
+   *
+   *  The popularity rank of each request is chosen by binary search of the
+   *  cumulative distribution.  Ranks are then scattered across the key
+   *  space (by multiplying with an odd constant), so that popular keys are
+   *  not also adjacent keys.  Scan keys lie above the Zipf key space.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  double        *cdf;
+  unsigned long *trace;
+  unsigned long  next = 4294967291UL;
+  double         sum = 0.0;
+  double         u;
+  unsigned long  i, lo, hi, mid;
+
+  cdf   = (double *)malloc( keys * sizeof( double ) );
+  trace = (unsigned long *)malloc( requests * sizeof( unsigned long ) );
+  if( (NULL == cdf) || (NULL == trace) )
+    return( NULL );
+
+  for( i = 0; i < keys; i++ )
+    {
+    sum   += 1.0 / pow( (double)(i + 1), skew );
+    cdf[i] = sum;
+    }
+  for( i = 0; i < requests; i++ )
+    {
+    if( scan && ((i / scan) & 1) )
+      {
+      trace[i] = next++;
+      continue;
+      }
+    u  = sum * ((double)Random() / 2147483648.0);
+    lo = 0;
+    hi = keys - 1;
+    while( lo < hi )
+      {
+      mid = (lo + hi) / 2;
+      if( cdf[mid] < u )
+        lo = mid + 1;
+      else
+        hi = mid;
+      }
+    trace[i] = (lo * 2654435761UL) % 4294967291UL;
+    }
+  free( cdf );
+  return( trace );
+  } /* MakeTrace */
+
+
+static void Replay( PolicyTab     *pt,
+                    unsigned long *trace,
+                    unsigned long  requests,
+                    unsigned long  capacity,
+                    unsigned long  memory,
+                    int            admit )
+  /* ------------------------------------------------------------------------ **
+   * Replay the trace against one policy, and report the results.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot      Cache[1];
+  ubi_cacheGhost    *ghosts;
+  ubi_cacheEntryPtr *slots;
+  unsigned char     *sketch;
+  Rec               *pool;
+  Rec               *rp;
+  unsigned long      i, size, hits = 0;
+  double             bytes = 0.0, hit_bytes = 0.0;
+  clock_t            start;
+  double             secs;
+
+  pool      = (Rec *)malloc( (capacity + 1) * sizeof( Rec ) );
+  FreeStack = (Rec **)malloc( (capacity + 1) * sizeof( Rec * ) );
+  ghosts    = (ubi_cacheGhost *)malloc( capacity * sizeof( ubi_cacheGhost ) );
+  slots     = (ubi_cacheEntryPtr *)malloc( Slots
+                                           * sizeof( ubi_cacheEntryPtr ) );
+  sketch    = (unsigned char *)malloc( ubi_cacheSketchSize( capacity ) );
+  if( (NULL == pool) || (NULL == FreeStack) || (NULL == ghosts)
+   || (NULL == slots) || (NULL == sketch) )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    exit( EXIT_FAILURE );
+    }
+  for( FreeCount = 0; FreeCount <= capacity; FreeCount++ )
+    FreeStack[FreeCount] = &pool[FreeCount];
+
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc,
+                       memory ? 0 : capacity, memory );
+  (void)ubi_cacheSetExtended( Cache, ubi_trTRUE );
+  (void)ubi_cacheSetHashFunc( Cache, HashFunc );
+  if( 2 == Sizes )
+    ubi_cacheSetCostFunc( Cache, CostFunc );
+  (void)ubi_cacheSetGhosts( Cache, ghosts, capacity );
+  (void)ubi_cacheSetSlots( Cache, slots, Slots );
+  (void)ubi_cacheSetSampleSize( Cache, Samples );
+  if( admit )
+    (void)ubi_cacheSetAdmission( Cache, sketch,
+                                 ubi_cacheSketchSize( capacity ) );
+  if( !ubi_cacheSetPolicy( Cache, pt->policy ) )
+    {
+    (void)fprintf( stderr, "Cannot set policy %s.\n", pt->name );
+    exit( EXIT_FAILURE );
+    }
+
+  start = clock();
+  for( i = 0; i < requests; i++ )
+    {
+    size   = Sizes ? SizeOf( trace[i] ) : 1;
+    bytes += (double)size;
+    if( ubi_cacheGet( Cache, &trace[i] ) )
+      {
+      hits++;
+      hit_bytes += (double)size;
+      }
+    else
+      {
+      rp = Sizes ? (Rec *)malloc( sizeof( Rec ) ) : FreeStack[--FreeCount];
+      if( NULL == rp )
+        {
+        (void)fprintf( stderr, "Out of memory.\n" );
+        exit( EXIT_FAILURE );
+        }
+      rp->Key = trace[i];
+      ubi_cachePut( Cache, size, &rp->Entry.base, &rp->Key );
+      }
+    }
+  secs = (double)(clock() - start) / (double)CLOCKS_PER_SEC;
+
+  (void)printf( "%-8s %-5s hit ratio %6.2f%%", pt->name, admit ? "tlfu" : "",
+                (100.0 * (double)hits) / (double)requests );
+  if( Sizes )
+    (void)printf( "  byte hit ratio %6.2f%%", (100.0 * hit_bytes) / bytes );
+  (void)printf( "  %7.1f ns/request\n", (1e9 * secs) / (double)requests );
+
+  (void)ubi_cacheClear( Cache );
+  free( sketch );
+  free( slots );
+  free( ghosts );
+  free( FreeStack );
+  free( pool );
+  } /* Replay */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long  keys     = 1000000;
+  unsigned long  capacity = 50000;
+  unsigned long  requests = 5000000;
+  double         skew     = 0.9;
+  unsigned long  scan     = 0;
+  unsigned long  memory   = 0;
+  unsigned long  k;
+  double         mean;
+  int            admit    = 0;
+  char          *policy   = NULL;
+  unsigned long *trace;
+  PolicyTab     *pt;
+  int            i;
+
+  for( i = 1; (i + 1) < argc; i += 2 )
+    {
+    if( 0 == strcmp( argv[i], "-k" ) )
+      keys = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-c" ) )
+      capacity = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-n" ) )
+      requests = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-z" ) )
+      skew = atof( argv[i+1] );
+    else if( 0 == strcmp( argv[i], "-s" ) )
+      scan = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-a" ) )
+      admit = atoi( argv[i+1] );
+    else if( 0 == strcmp( argv[i], "-b" ) )
+      Sizes = atoi( argv[i+1] );
+    else if( 0 == strcmp( argv[i], "-r" ) )
+      Samples = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-p" ) )
+      policy = argv[i+1];
+    else
+      break;
+    }
+  if( (i < argc) || (keys < 1) || (capacity < 1) || (Sizes < 0) || (Sizes > 2)
+   || (Samples < 1) )
+    {
+    (void)fprintf( stderr, "Usage: %s [-k keys] [-c capacity] [-n requests] "
+                           "[-z skew] [-s scan] [-a admit] [-b sizes] "
+                           "[-r samples] [-p policy]\n", argv[0] );
+    return( EXIT_FAILURE );
+    }
+
+  /* A cache limited by memory may hold as many entries as there are keys. */
+  Slots = Sizes ? keys : (capacity + 1);
+
+  trace = MakeTrace( keys, requests, skew, scan );
+  if( NULL == trace )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    return( EXIT_FAILURE );
+    }
+  (void)printf( "%lu keys, capacity %lu, %lu requests, skew %.2f, scan %lu\n",
+                keys, capacity, requests, skew, scan );
+  if( Sizes )
+    {
+    /* Give the cache room for <capacity> entries of average size. */
+    for( mean = 0.0, k = 0; k < keys; k++ )
+      mean += (double)SizeOf( (k * 2654435761UL) % 4294967291UL );
+    memory = (unsigned long)((mean / (double)keys) * (double)capacity);
+    (void)printf( "memory limit %lu bytes\n", memory );
+    }
+  for( pt = Policies; NULL != pt->name; pt++ )
+    {
+    if( (NULL == policy) || (0 == strcmp( policy, pt->name )) )
+      {
+      if( 1 != admit )
+        Replay( pt, trace, requests, capacity, memory, 0 );
+      if( 0 != admit )
+        Replay( pt, trace, requests, capacity, memory, 1 );
+      }
+    }
+  free( trace );
+  return( EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
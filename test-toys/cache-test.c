@@ -224,6 +224,7 @@ int main( int argc, char *argv[] )
    */
   {
   char s[1024];
+  char stats[4096];
 
   if( argc != 3 )
     Usage( argv[0] );
@@ -287,6 +288,11 @@ int main( int argc, char *argv[] )
   (void)puts( "\nCacheDump:" );
   dumpcache();
 
+  /* Dump the statistics, as they would be scraped.  */
+  (void)puts( "\nStatistics:" );
+  (void)ubi_cacheStatsFormat( CachePtr, "cache-test", stats, sizeof( stats ) );
+  (void)fputs( stats, stdout );
+
   /* Clear the cache and exit.  */
   ubi_cacheClear( CachePtr );
   return( EXIT_SUCCESS );
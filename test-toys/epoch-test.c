@@ -0,0 +1,349 @@
+/* ========================================================================== **
+ *                                epoch-test.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Exercise the epoch-based reclamation module.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  Several reader threads walk a linked list over and over, checking a
+ *  magic number in each node they visit.  Meanwhile, the main thread
+ *  removes nodes from the list at random.  Removed nodes are retired, and
+ *  the function that eventually frees them scribbles over the magic
+ *  number first.  If a reader ever sees a scribbled node, it was looking
+ *  at freed memory.
+ *
+ *  With -u ("unsafe"), nodes are freed as soon as they are removed.  The
+ *  readers will then usually report errors (or the program may crash),
+ *  which shows that the test is actually testing something.
+ *
+ *  A short single-threaded check of a cache that retires its entries via
+ *  the epoch domain follows.  The cache knows nothing of epochs; it hands
+ *  removed entries to RetireCacheRec(), which passes them on to
+ *  ubi_epochRetire().  The same is then done for a slab cache, whose
+ *  retired entries must all find their way back to the slab pool.
+ *
+ *  Usage:
+ *    ./epoch-test [-u] [readers [nodes]]
+ *
+ *  Compile with -pthread.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.            */
+#include <stdlib.h>             /* Standard C library.      */
+#include <string.h>             /* strcmp(3).               */
+#include <pthread.h>            /* POSIX threads.           */
+
+#include "ubi_dLinkList.h"      /* Doubly linked lists.     */
+#include "ubi_Cache.h"          /* Cache (and splay trees). */
+#include "ubi_Epoch.h"          /* Epoch reclamation.       */
+
+
+/* -------------------------------------------------------------------------- **
+ * Defines...
+ */
+
+#define MAX_READERS 64
+#define GOOD_MAGIC  0x600DF00DUL
+#define DEAD_MAGIC  0xDEADBEEFUL
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  ListRec   - A list node with a magic number.
+ *  CacheRec  - A cache entry with an integer key.
+ */
+
+typedef struct
+  {
+  ubi_dlNode    Node;
+  unsigned long Magic;
+  } ListRec;
+
+typedef struct
+  {
+  ubi_cacheEntry Entry;
+  long           Key;
+  } CacheRec;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static ubi_dlNewList( List );
+static ubi_epochDomain Domain[1];
+static ubi_epochReader Readers[MAX_READERS];
+static ubi_epochLimbo  Limbo[256];
+static volatile int    Done   = 0;
+static unsigned long   Errors[MAX_READERS];
+static unsigned long   Walks[MAX_READERS];
+static unsigned long   Frees  = 0;
+static ubi_slabPoolPtr SlabPool = NULL;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static void FreeRec( void *Ptr )
+  /* ------------------------------------------------------------------------ **
+   * Scribble on a node, then free it.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ((ListRec *)Ptr)->Magic = DEAD_MAGIC;
+  free( Ptr );
+  Frees++;
+  } /* FreeRec */
+
+
+static void *Reader( void *arg )
+  /* ------------------------------------------------------------------------ **
+   * Reader thread: walk the list, checking each node.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  int                         id  = (int)(long)arg;
+  ubi_epochReaderPtr          me  = &Readers[id];
+  ubi_dlNodePtr volatile     *pp;
+  ubi_dlNodePtr               p;
+
+  while( !Done )
+    {
+    ubi_epochEnter( Domain, me );
+    pp = (ubi_dlNodePtr volatile *)&List->Head;
+    for( p = *pp; NULL != p; p = *pp )
+      {
+      if( GOOD_MAGIC != *(volatile unsigned long *)&((ListRec *)p)->Magic )
+        Errors[id]++;
+      pp = (ubi_dlNodePtr volatile *)&p->Next;
+      }
+    ubi_epochExit( me );
+    Walks[id]++;
+    }
+  return( NULL );
+  } /* Reader */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  long A = *(long *)ItemPtr;
+  long B = ((CacheRec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static void FreeCacheRec( void *Ptr )
+  /* ------------------------------------------------------------------------ **
+   * Scribble on a cache entry, then free it (to the slab pool, if there is
+   * one).
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ((CacheRec *)Ptr)->Key = -1;
+  if( SlabPool )
+    ubi_slabFree( SlabPool, Ptr );
+  else
+    free( Ptr );
+  Frees++;
+  } /* FreeCacheRec */
+
+
+static void RetireCacheRec( void *Context, void *EntryPtr )
+  /* ------------------------------------------------------------------------ **
+   * The cache's retire function.  Context is the epoch domain.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_epochRetire( (ubi_epochDomainPtr)Context, EntryPtr, FreeCacheRec );
+  } /* RetireCacheRec */
+
+
+static int SlabCheck( void )
+  /* ------------------------------------------------------------------------ **
+   * Retire the entries of a slab cache, which has no free function.
+   * Returns the number of errors found.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot   Cache[1];
+  ubi_slabPool    Pool[1];
+  ubi_epochReader Me[1];
+  CacheRec       *rp;
+  void           *arena = malloc( 16 * 4096 );
+  long            i;
+  int             errs = 0;
+
+  if( (NULL == arena)
+   || (NULL == ubi_slabInit( Pool, arena, 16 * 4096, 4096, 125 )) )
+    return( 1 );
+  (void)ubi_epochInit( Domain, Me, 1, Limbo, 256 );
+  (void)ubi_cacheInit( Cache, CompareFunc, NULL, 4, 0 );
+  (void)ubi_cacheSetSlab( Cache, Pool );
+  ubi_cacheSetRetire( Cache, RetireCacheRec, Domain );
+  SlabPool = Pool;
+  Frees    = 0;
+
+  /* Evicted entries only go back to the pool once they are reclaimed. */
+  for( i = 0; i < 1000; i++ )
+    {
+    rp = (CacheRec *)ubi_cacheAlloc( Cache, sizeof( CacheRec ) );
+    if( NULL == rp )
+      {
+      ubi_epochSynchronize( Domain );
+      rp = (CacheRec *)ubi_cacheAlloc( Cache, sizeof( CacheRec ) );
+      }
+    if( NULL == rp )
+      {
+      errs++;
+      break;
+      }
+    rp->Key = i;
+    ubi_cachePut( Cache, sizeof( CacheRec ), &rp->Entry, &rp->Key );
+    }
+  (void)ubi_cacheClear( Cache );
+  ubi_epochSynchronize( Domain );
+  if( (Domain->retired != Frees) || (0 != ubi_epochPending( Domain )) )
+    errs++;
+  for( i = 0; i < Pool->class_count; i++ )
+    if( 0 != Pool->classes[i].used )
+      errs++;
+
+  (void)printf( "slab:  %lu retired, %lu freed, %d errors\n",
+                Domain->retired, Frees, errs );
+  SlabPool = NULL;
+  free( arena );
+  return( errs );
+  } /* SlabCheck */
+
+
+static int CacheCheck( void )
+  /* ------------------------------------------------------------------------ **
+   * Single-threaded check of the cache and tree integration.
+   * Returns the number of errors found.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot   Cache[1];
+  ubi_epochReader Me[1];
+  CacheRec       *rp;
+  CacheRec       *held;
+  long            i, key;
+  int             errs = 0;
+
+  (void)ubi_epochInit( Domain, Me, 1, Limbo, 256 );
+  (void)ubi_cacheInit( Cache, CompareFunc, NULL, 100, 0 );
+  ubi_cacheSetRetire( Cache, RetireCacheRec, Domain );
+  Frees = 0;
+
+  for( i = 0; i < 1000; i++ )
+    {
+    rp = (CacheRec *)malloc( sizeof( CacheRec ) );
+    rp->Key = i;
+    ubi_cachePut( Cache, sizeof( CacheRec ), &rp->Entry, &rp->Key );
+    }
+
+  /* Hold on to an entry, delete it, and make sure it's not freed. */
+  ubi_epochEnter( Domain, Me );
+  key  = 999;
+  held = (CacheRec *)ubi_cacheGet( Cache, &key );
+  if( (NULL == held) || !ubi_cacheDelete( Cache, &key ) )
+    errs++;
+  for( i = 0; i < 10; i++ )
+    (void)ubi_epochReclaim( Domain );
+  if( (NULL != held) && (999 != held->Key) )
+    errs++;
+  ubi_epochExit( Me );
+
+  (void)ubi_cacheClear( Cache );
+  ubi_epochSynchronize( Domain );
+  if( (1000 != Frees) || (0 != ubi_epochPending( Domain )) )
+    errs++;
+
+  (void)printf( "cache: %lu retired, %lu freed, %d errors\n",
+                Domain->retired, Domain->freed, errs );
+  return( errs + SlabCheck() );
+  } /* CacheCheck */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  pthread_t      tid[MAX_READERS];
+  ListRec      **live;
+  ListRec       *rp;
+  unsigned long  nodes   = 200000;
+  unsigned long  nlive, i, walks = 0, errs = 0;
+  unsigned long  seed    = 1;
+  int            readers = 4;
+  int            unsafe  = 0;
+  int            argi    = 1;
+  int            t;
+
+  if( (argc > argi) && (0 == strcmp( argv[argi], "-u" )) )
+    {
+    unsafe = 1;
+    argi++;
+    }
+  if( argc > argi )
+    readers = atoi( argv[argi++] );
+  if( argc > argi )
+    nodes = strtoul( argv[argi++], NULL, 0 );
+  if( (readers < 1) || (readers > MAX_READERS) )
+    readers = 4;
+
+  live = (ListRec **)malloc( nodes * sizeof( ListRec * ) );
+  for( i = 0; i < nodes; i++ )
+    {
+    live[i] = (ListRec *)malloc( sizeof( ListRec ) );
+    live[i]->Magic = GOOD_MAGIC;
+    (void)ubi_dlAddTail( List, live[i] );
+    }
+
+  (void)ubi_epochInit( Domain, Readers, readers, Limbo, 256 );
+  for( t = 0; t < readers; t++ )
+    (void)pthread_create( &tid[t], NULL, Reader, (void *)(long)t );
+
+  for( nlive = nodes; nlive > 0; nlive-- )
+    {
+    seed = (seed * 6364136223846793005UL) + 1442695040888963407UL;
+    i    = (seed >> 33) % nlive;
+    rp   = live[i];
+    live[i] = live[nlive - 1];
+    (void)ubi_dlRemThis( List, rp );
+    if( unsafe )
+      FreeRec( rp );
+    else
+      ubi_epochRetire( Domain, rp, FreeRec );
+    }
+
+  Done = 1;
+  for( t = 0; t < readers; t++ )
+    {
+    (void)pthread_join( tid[t], NULL );
+    walks += Walks[t];
+    errs  += Errors[t];
+    }
+  ubi_epochSynchronize( Domain );
+  free( live );
+
+  (void)printf( "list:  %lu nodes freed, %lu walks by %d readers, "
+                "%lu bad nodes seen\n", Frees, walks, readers, errs );
+  if( errs || (Frees != nodes) )
+    return( EXIT_FAILURE );
+  return( CacheCheck() ? EXIT_FAILURE : EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
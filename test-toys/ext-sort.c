@@ -0,0 +1,175 @@
+/* ========================================================================== **
+ *                                 ext-sort.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Exercise the ubiqx external sort module.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  This program has three modes:
+ *    ext-sort -g <count>                   - Generate <count> random lines
+ *                                            on stdout.
+ *    ext-sort [-m <MiB>] [-k <fanin>] [in [out]]
+ *                                          - Sort the input.
+ *    ext-sort -c [in]                      - Check that the input is in
+ *                                            sorted order.
+ *
+ *  Example, using a locally generated 10GB file (about 280 million
+ *  lines) and a 256MiB memory budget:
+ *    ./ext-sort -g 280000000 > /var/tmp/big.txt
+ *    TMPDIR=/var/tmp ./ext-sort -m 256 /var/tmp/big.txt /var/tmp/big.out
+ *    ./ext-sort -c /var/tmp/big.out
+ *
+ *  Run statistics are written to stderr.  With random input, each run
+ *  should hold about twice as many lines as fit in the budget at once.
+ *  Each line in memory costs its length plus a tree node and the malloc()
+ *  overhead, so that is well under twice the budget in bytes.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.              */
+#include <stdlib.h>             /* Standard C library header. */
+#include <string.h>             /* String functions.          */
+#include <time.h>               /* clock(3).                  */
+
+#include "ubi_ExtSort.h"        /* External sort module.      */
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static void Usage( char *name )
+  /* ------------------------------------------------------------------------ **
+   * Print a usage message and exit with an error code.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)fprintf( stderr,
+                 "Usage: %s -g <count>\n"
+                 "       %s [-m <MiB>] [-k <fanin>] [infile [outfile]]\n"
+                 "       %s -c [infile]\n",
+                 name, name, name );
+  exit( EXIT_FAILURE );
+  } /* Usage */
+
+
+static int Generate( unsigned long count )
+  /* ------------------------------------------------------------------------ **
+   * Write <count> lines of random digits to stdout.  Each line is 36
+   * characters long, including the newline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long i;
+  unsigned long x = 12345;
+
+  for( i = 0; i < count; i++ )
+    {
+    /* A simple LCG; rand() is too slow and too short on some systems. */
+    x = (x * 6364136223846793005UL) + 1442695040888963407UL;
+    (void)printf( "%020lu line %09lu\n", x, i );
+    }
+  return( ferror( stdout ) ? EXIT_FAILURE : EXIT_SUCCESS );
+  } /* Generate */
+
+
+static int Check( FILE *in )
+  /* ------------------------------------------------------------------------ **
+   * Verify that the lines read from <in> are in (strcmp) sorted order.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  static char   a[4096];
+  static char   b[4096];
+  char         *prev = a;
+  char         *cur  = b;
+  char         *tmp;
+  unsigned long n    = 0;
+
+  *prev = '\0';
+  while( fgets( cur, sizeof( a ), in ) )
+    {
+    if( n && (strcmp( prev, cur ) > 0) )
+      {
+      (void)fprintf( stderr, "Out of order at line %lu.\n", n + 1 );
+      return( EXIT_FAILURE );
+      }
+    tmp  = prev;
+    prev = cur;
+    cur  = tmp;
+    n++;
+    }
+  (void)fprintf( stderr, "%lu lines in order.\n", n );
+  return( EXIT_SUCCESS );
+  } /* Check */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_xsSort    Sort[1];
+  unsigned long mib   = 64;
+  unsigned int  fanin = 0;
+  FILE         *in    = stdin;
+  FILE         *out   = stdout;
+  clock_t       start;
+  int           i;
+
+  if( (argc == 3) && (0 == strcmp( argv[1], "-g" )) )
+    return( Generate( strtoul( argv[2], NULL, 0 ) ) );
+
+  if( (argc >= 2) && (0 == strcmp( argv[1], "-c" )) )
+    {
+    if( (argc > 2) && (NULL == (in = fopen( argv[2], "r" ))) )
+      {
+      perror( argv[2] );
+      return( EXIT_FAILURE );
+      }
+    return( Check( in ) );
+    }
+
+  for( i = 1; (i < argc) && ('-' == argv[i][0]); i += 2 )
+    {
+    if( i + 1 >= argc )
+      Usage( argv[0] );
+    if( 0 == strcmp( argv[i], "-m" ) )
+      mib = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-k" ) )
+      fanin = (unsigned int)strtoul( argv[i+1], NULL, 0 );
+    else
+      Usage( argv[0] );
+    }
+  if( (i < argc) && (NULL == (in = fopen( argv[i], "r" ))) )
+    {
+    perror( argv[i] );
+    return( EXIT_FAILURE );
+    }
+  if( (++i < argc) && (NULL == (out = fopen( argv[i], "w" ))) )
+    {
+    perror( argv[i] );
+    return( EXIT_FAILURE );
+    }
+
+  (void)ubi_xsInit( Sort, NULL, mib * 1024 * 1024, fanin );
+  start = clock();
+  if( !ubi_xsSortFile( Sort, in, out ) )
+    {
+    perror( "ubi_xsSortFile" );
+    return( EXIT_FAILURE );
+    }
+  (void)fprintf( stderr,
+                 "%lu lines, %lu runs (%.1f lines/run), %lu merges, "
+                 "%.2f s cpu\n",
+                 Sort->records, Sort->runs,
+                 Sort->runs ? (double)Sort->records / Sort->runs : 0.0,
+                 Sort->passes,
+                 (double)(clock() - start) / CLOCKS_PER_SEC );
+  return( EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
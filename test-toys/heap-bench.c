@@ -0,0 +1,338 @@
+/* ========================================================================== **
+ *                                heap-bench.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Compare the pairing heap against an AVL tree used as a
+ *              priority queue.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  Two workloads are run, each against both a ubi_Heap and an AVL tree
+ *  (the AVL tree is used the old way: ubi_trFirst() + ubi_trRemove()).
+ *  Both structures see exactly the same sequence of operations.
+ *
+ *    timer - A fixed population of timers.  The earliest timer is popped,
+ *            the clock is advanced to its deadline, and the timer is
+ *            re-armed with a new random deadline in the future.
+ *    sched - A fixed population of tasks.  Half of the operations pop the
+ *            task with the lowest priority value and requeue it; the other
+ *            half pick a random task and boost it (decrease its key).  The
+ *            heap uses ubi_hpDecrease(), the tree has to remove and
+ *            reinsert.
+ *
+ *  After each run, both structures are drained and the order of the
+ *  popped keys is checked.
+ *
+ *  Example:
+ *    ./heap-bench 100000 5000000
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.        */
+#include <stdlib.h>             /* Standard C library.  */
+#include <time.h>               /* clock(3).            */
+
+#include "ubi_Heap.h"           /* Pairing heap module. */
+#include "ubi_AVLtree.h"        /* AVL tree module.     */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  HeapRec - A heap node with an integer key.
+ *  TreeRec - A tree node with an integer key.
+ */
+
+typedef struct
+  {
+  ubi_hpNode Node;
+  long       Key;
+  } HeapRec;
+
+typedef struct
+  {
+  ubi_trNode Node;
+  long       Key;
+  } TreeRec;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static unsigned long Seed;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static unsigned long Random( void )
+  /* ------------------------------------------------------------------------ **
+   * A small LCG, so that both structures see the same sequence.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Seed = (Seed * 6364136223846793005UL) + 1442695040888963407UL;
+  return( Seed >> 33 );
+  } /* Random */
+
+
+static int HeapCompare( ubi_hpNodePtr A, ubi_hpNodePtr B )
+  /* ------------------------------------------------------------------------ **
+   * Compare the keys of two heap nodes.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  long a = ((HeapRec *)A)->Key;
+  long b = ((HeapRec *)B)->Key;
+
+  return( (a < b) ? -1 : ((a > b) ? 1 : 0) );
+  } /* HeapCompare */
+
+
+static int TreeCompare( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a tree node.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  long a = *(long *)ItemPtr;
+  long b = ((TreeRec *)NodePtr)->Key;
+
+  return( (a < b) ? -1 : ((a > b) ? 1 : 0) );
+  } /* TreeCompare */
+
+
+static double Elapsed( clock_t start )
+  /* ------------------------------------------------------------------------ **
+   * Return the number of seconds since <start>.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( (double)(clock() - start) / (double)CLOCKS_PER_SEC );
+  } /* Elapsed */
+
+
+static int HeapDrain( ubi_hpRootPtr Heap, unsigned long n )
+  /* ------------------------------------------------------------------------ **
+   * Empty the heap, checking that keys come out in order.
+   * Returns zero on success.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  HeapRec *p;
+  long     prev = 0;
+  unsigned long i;
+
+  for( i = 0; NULL != (p = (HeapRec *)ubi_hpRemoveFirst( Heap )); i++ )
+    {
+    if( i && (p->Key < prev) )
+      return( -1 );
+    prev = p->Key;
+    }
+  return( (i == n && 0 == ubi_hpCount( Heap )) ? 0 : -1 );
+  } /* HeapDrain */
+
+
+static int TreeDrain( ubi_trRootPtr Tree, unsigned long n )
+  /* ------------------------------------------------------------------------ **
+   * Empty the tree, checking that keys come out in order.
+   * Returns zero on success.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  TreeRec *p;
+  long     prev = 0;
+  unsigned long i;
+
+  for( i = 0; NULL != (p = (TreeRec *)ubi_trFirst( Tree->root )); i++ )
+    {
+    (void)ubi_trRemove( Tree, p );
+    if( i && (p->Key < prev) )
+      return( -1 );
+    prev = p->Key;
+    }
+  return( (i == n) ? 0 : -1 );
+  } /* TreeDrain */
+
+
+static void Report( char *name, char *what, unsigned long ops, double secs )
+  /* ------------------------------------------------------------------------ **
+   * Print a line of results.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)printf( "%-6s %-5s %lu ops  %8.3f s  %7.2f ns/op\n",
+                name, what, ops, secs, (1e9 * secs) / (double)ops );
+  } /* Report */
+
+
+static int Timer( HeapRec *hr, TreeRec *tr, unsigned long n, unsigned long ops )
+  /* ------------------------------------------------------------------------ **
+   * Timer workload: pop the earliest deadline, re-arm it in the future.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_hpRoot    Heap[1];
+  ubi_trRoot    Tree[1];
+  HeapRec      *hp;
+  TreeRec      *tp;
+  unsigned long i;
+  long          now;
+  clock_t       start;
+
+  (void)ubi_hpInitHeap( Heap, HeapCompare );
+  Seed = 1;
+  now  = 0;
+  start = clock();
+  for( i = 0; i < n; i++ )
+    {
+    hr[i].Key = (long)(Random() % 100000);
+    (void)ubi_hpInsert( Heap, &hr[i].Node );
+    }
+  for( i = 0; i < ops; i++ )
+    {
+    hp  = (HeapRec *)ubi_hpRemoveFirst( Heap );
+    now = hp->Key;
+    hp->Key = now + 1 + (long)(Random() % 100000);
+    (void)ubi_hpInsert( Heap, &hp->Node );
+    }
+  Report( "timer", "heap", ops, Elapsed( start ) );
+  if( HeapDrain( Heap, n ) )
+    return( -1 );
+
+  (void)ubi_trInitTree( Tree, TreeCompare, ubi_trDUPKEY );
+  Seed = 1;
+  now  = 0;
+  start = clock();
+  for( i = 0; i < n; i++ )
+    {
+    tr[i].Key = (long)(Random() % 100000);
+    (void)ubi_trInsert( Tree, &tr[i], &tr[i].Key, NULL );
+    }
+  for( i = 0; i < ops; i++ )
+    {
+    tp  = (TreeRec *)ubi_trFirst( Tree->root );
+    (void)ubi_trRemove( Tree, tp );
+    now = tp->Key;
+    tp->Key = now + 1 + (long)(Random() % 100000);
+    (void)ubi_trInsert( Tree, tp, &tp->Key, NULL );
+    }
+  Report( "timer", "avl", ops, Elapsed( start ) );
+  return( TreeDrain( Tree, n ) );
+  } /* Timer */
+
+
+static int Sched( HeapRec *hr, TreeRec *tr, unsigned long n, unsigned long ops )
+  /* ------------------------------------------------------------------------ **
+   * Scheduling workload: a mix of pop/requeue and priority boosts.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_hpRoot    Heap[1];
+  ubi_trRoot    Tree[1];
+  HeapRec      *hp;
+  TreeRec      *tp;
+  unsigned long i, r;
+  clock_t       start;
+
+  (void)ubi_hpInitHeap( Heap, HeapCompare );
+  Seed = 2;
+  start = clock();
+  for( i = 0; i < n; i++ )
+    {
+    hr[i].Key = (long)(Random() % 1000000);
+    (void)ubi_hpInsert( Heap, &hr[i].Node );
+    }
+  for( i = 0; i < ops; i++ )
+    {
+    r = Random();
+    if( r & 1 )
+      {
+      hp = &hr[(r >> 1) % n];
+      hp->Key -= (long)(Random() % 1000);
+      ubi_hpDecrease( Heap, &hp->Node );
+      }
+    else
+      {
+      hp = (HeapRec *)ubi_hpRemoveFirst( Heap );
+      hp->Key += (long)(Random() % 1000000);
+      (void)ubi_hpInsert( Heap, &hp->Node );
+      }
+    }
+  Report( "sched", "heap", ops, Elapsed( start ) );
+  if( HeapDrain( Heap, n ) )
+    return( -1 );
+
+  (void)ubi_trInitTree( Tree, TreeCompare, ubi_trDUPKEY );
+  Seed = 2;
+  start = clock();
+  for( i = 0; i < n; i++ )
+    {
+    tr[i].Key = (long)(Random() % 1000000);
+    (void)ubi_trInsert( Tree, &tr[i], &tr[i].Key, NULL );
+    }
+  for( i = 0; i < ops; i++ )
+    {
+    r = Random();
+    if( r & 1 )
+      {
+      tp = &tr[(r >> 1) % n];
+      (void)ubi_trRemove( Tree, tp );
+      tp->Key -= (long)(Random() % 1000);
+      }
+    else
+      {
+      tp = (TreeRec *)ubi_trFirst( Tree->root );
+      (void)ubi_trRemove( Tree, tp );
+      tp->Key += (long)(Random() % 1000000);
+      }
+    (void)ubi_trInsert( Tree, tp, &tp->Key, NULL );
+    }
+  Report( "sched", "avl", ops, Elapsed( start ) );
+  return( TreeDrain( Tree, n ) );
+  } /* Sched */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   *
+   *  Input:  argc  - Argument count.
+   *          argv  - [1] is the number of entries in the queue,
+   *                  [2] is the number of operations to perform.
+   *
+   *  Output: EXIT_SUCCESS, or EXIT_FAILURE if memory ran out or the
+   *          results were inconsistent.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long n   = (argc > 1) ? strtoul( argv[1], NULL, 0 ) : 100000;
+  unsigned long ops = (argc > 2) ? strtoul( argv[2], NULL, 0 ) : 2000000;
+  HeapRec      *hr;
+  TreeRec      *tr;
+
+  if( n < 1 )
+    n = 1;
+  hr = (HeapRec *)malloc( n * sizeof( HeapRec ) );
+  tr = (TreeRec *)malloc( n * sizeof( TreeRec ) );
+  if( (NULL == hr) || (NULL == tr) )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    return( EXIT_FAILURE );
+    }
+
+  if( Timer( hr, tr, n, ops ) || Sched( hr, tr, n, ops ) )
+    {
+    (void)fprintf( stderr, "Inconsistent results.\n" );
+    return( EXIT_FAILURE );
+    }
+
+  free( hr );
+  free( tr );
+  return( EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
@@ -0,0 +1,281 @@
+/* ========================================================================== **
+ *                               index-bench.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Compare the splay, AVL and hash indexes of ubi_Cache.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  A skewed trace of requests is replayed against caches that differ only
+ *  in their index, for each eviction policy that can use any index.  The
+ *  index does not take part in eviction, so every index must give the
+ *  same number of hits.  The time per request is reported for each.
+ *
+ *  Then, a tenth of the keys are deleted, and the cache is cleared.  The
+ *  deleted keys must not be found afterward, and every entry must have
+ *  been freed once the cache is cleared.
+ *
+ *  Usage:
+ *    ./index-bench [-k keys] [-c capacity] [-n requests]
+ *
+ *  Defaults: 1000000 keys, a capacity of 100000 entries, and 2000000
+ *  requests.  The hash index is given one bucket per entry.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.            */
+#include <stdlib.h>             /* Standard C library.      */
+#include <string.h>             /* strcmp(3).               */
+#include <time.h>               /* clock(3).                */
+
+#include "ubi_Cache.h"          /* Cache module.            */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Rec       - A cache entry with an integer key.
+ *  NameTab   - Maps a name to a ubi_Cache constant.
+ */
+
+typedef struct
+  {
+  ubi_cacheEntryExt Entry;
+  unsigned long     Key;
+  } Rec;
+
+typedef struct
+  {
+  char *name;
+  int   value;
+  } NameTab;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static NameTab Policies[] =
+  {
+  { "lru",      ubi_cacheLRU      },
+  { "clock",    ubi_cacheCLOCK    },
+  { "clockpro", ubi_cacheCLOCKPRO },
+  { "arc",      ubi_cacheARC      },
+  { "gdsf",     ubi_cacheGDSF     },
+  { NULL,       0                 }
+  };
+
+static NameTab Indexes[] =
+  {
+  { "splay",    ubi_cacheINDEX_SPLAY },
+  { "avl",      ubi_cacheINDEX_AVL   },
+  { "hash",     ubi_cacheINDEX_HASH  },
+  { NULL,       0                    }
+  };
+
+static unsigned long  Seed     = 1;
+static unsigned long  Keys     = 1000000;
+static unsigned long  Capacity = 100000;
+static unsigned long  Requests = 2000000;
+static unsigned long *Trace;
+static unsigned long  Live     = 0;
+static unsigned long  Errors   = 0;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static unsigned long Random( void )
+  /* ------------------------------------------------------------------------ **
+   * A small LCG, returning 31 random bits.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Seed = (Seed * 6364136223846793005UL) + 1442695040888963407UL;
+  return( Seed >> 33 );
+  } /* Random */
+
+
+static unsigned long Scramble( unsigned long k )
+  /* ------------------------------------------------------------------------ **
+   * Mix the bits of a key, so that keys do not arrive in sorted order.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  k ^= k >> 33;
+  k *= 0xFF51AFD7ED558CCDUL;
+  k ^= k >> 33;
+  return( k );
+  } /* Scramble */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Rec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static unsigned long HashFunc( ubi_trItemPtr ItemPtr )
+  /* ------------------------------------------------------------------------ **
+   * Hash an integer key.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( *(unsigned long *)ItemPtr * 0x9E3779B97F4A7C15UL );
+  } /* HashFunc */
+
+
+static void FreeFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Free an entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Live--;
+  free( NodePtr );
+  } /* FreeFunc */
+
+
+static unsigned long Run( NameTab        *pt,
+                          NameTab        *it,
+                          ubi_cacheGhost *Ghosts,
+                          ubi_btNodePtr  *Buckets )
+  /* ------------------------------------------------------------------------ **
+   * Replay the trace against one policy and index, and return the hits.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot Cache[1];
+  unsigned long i, key, hits = 0;
+  clock_t       start;
+  double        secs;
+  Rec          *rp;
+
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc, Capacity, 0 );
+  (void)ubi_cacheSetExtended( Cache, ubi_trTRUE );
+  (void)ubi_cacheSetHashFunc( Cache, HashFunc );
+  (void)ubi_cacheSetGhosts( Cache, Ghosts, Capacity );
+  if( !ubi_cacheSetIndex( Cache, it->value, Buckets, Capacity )
+   || !ubi_cacheSetPolicy( Cache, pt->value ) )
+    {
+    (void)fprintf( stderr, "Cannot set up %s with %s.\n", pt->name, it->name );
+    exit( EXIT_FAILURE );
+    }
+
+  start = clock();
+  for( i = 0; i < Requests; i++ )
+    {
+    if( ubi_cacheGet( Cache, &Trace[i] ) )
+      hits++;
+    else
+      {
+      rp = (Rec *)malloc( sizeof( Rec ) );
+      if( NULL == rp )
+        {
+        (void)fprintf( stderr, "Out of memory.\n" );
+        exit( EXIT_FAILURE );
+        }
+      rp->Key = Trace[i];
+      Live++;
+      ubi_cachePut( Cache, sizeof( Rec ), &rp->Entry.base, &rp->Key );
+      }
+    }
+  secs = (double)(clock() - start) / (double)CLOCKS_PER_SEC;
+  if( Live != ubi_cacheGetEntryCount( Cache ) )
+    Errors++;
+
+  /* Delete a tenth of the keys, and make sure that they are gone. */
+  for( i = 0; i < Keys; i += 10 )
+    {
+    key = Scramble( i );
+    (void)ubi_cacheDelete( Cache, &key );
+    if( ubi_cacheGet( Cache, &key ) )
+      Errors++;
+    }
+  if( Live != ubi_cacheGetEntryCount( Cache ) )
+    Errors++;
+  (void)ubi_cacheClear( Cache );
+  if( (0 != Live) || (0 != ubi_cacheGetEntryCount( Cache )) )
+    Errors++;
+
+  (void)printf( "  %-6s %6.2f%% hits  %7.1f ns/request\n", it->name,
+                (100.0 * (double)hits) / (double)Requests,
+                (secs * 1e9) / (double)Requests );
+  return( hits );
+  } /* Run */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheGhost *ghosts;
+  ubi_btNodePtr  *buckets;
+  NameTab        *pt, *it;
+  unsigned long   i, hits, first;
+  int             j;
+
+  for( j = 1; (j + 1) < argc; j += 2 )
+    {
+    if( 0 == strcmp( argv[j], "-k" ) )
+      Keys = strtoul( argv[j+1], NULL, 0 );
+    else if( 0 == strcmp( argv[j], "-c" ) )
+      Capacity = strtoul( argv[j+1], NULL, 0 );
+    else if( 0 == strcmp( argv[j], "-n" ) )
+      Requests = strtoul( argv[j+1], NULL, 0 );
+    else
+      break;
+    }
+  if( (j < argc) || (Keys < 1) || (Capacity < 1) || (Requests < 1) )
+    {
+    (void)fprintf( stderr, "Usage: %s [-k keys] [-c capacity] [-n requests]\n",
+                   argv[0] );
+    return( EXIT_FAILURE );
+    }
+
+  Trace   = (unsigned long *)malloc( Requests * sizeof( unsigned long ) );
+  ghosts  = (ubi_cacheGhost *)malloc( Capacity * sizeof( ubi_cacheGhost ) );
+  buckets = (ubi_btNodePtr *)malloc( Capacity * sizeof( ubi_btNodePtr ) );
+  if( (NULL == Trace) || (NULL == ghosts) || (NULL == buckets) )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    return( EXIT_FAILURE );
+    }
+  for( i = 0; i < Requests; i++ )
+    Trace[i] = Scramble( Random() % ((Random() % Keys) + 1) );
+
+  (void)printf( "%lu keys, capacity %lu, %lu requests\n",
+                Keys, Capacity, Requests );
+  for( pt = Policies; NULL != pt->name; pt++ )
+    {
+    (void)printf( "%s:\n", pt->name );
+    first = 0;
+    for( it = Indexes; NULL != it->name; it++ )
+      {
+      hits = Run( pt, it, ghosts, buckets );
+      if( it == Indexes )
+        first = hits;
+      else if( hits != first )
+        Errors++;
+      }
+    }
+
+  free( buckets );
+  free( ghosts );
+  free( Trace );
+  (void)printf( "%lu errors\n", Errors );
+  return( Errors ? EXIT_FAILURE : EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
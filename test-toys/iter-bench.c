@@ -0,0 +1,169 @@
+/* ========================================================================== **
+ *                                iter-bench.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Time tree iteration, with and without UBI_INLINE.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  This program builds an AVL tree of random integer keys and then walks
+ *  it from end to end, forwards and backwards, several times over.  The
+ *  time per step is reported.
+ *
+ *  The same source is compiled twice by the Makefile:
+ *    iter-bench        - calls ubi_btNext() and friends in libubiqx.
+ *    iter-bench-inline - compiled with -DUBI_INLINE, so the walking
+ *                        functions are inlined from ubi_BinTree.h.
+ *
+ *  To compile by hand (from within the test-toys directory):
+ *    cc -O2 -I ../modules -o iter-bench iter-bench.c \
+ *      ../modules/ubi_AVLtree.c ../modules/ubi_BinTree.c
+ *    cc -O2 -I ../modules -DUBI_INLINE -o iter-bench-inline iter-bench.c \
+ *      ../modules/ubi_AVLtree.c ../modules/ubi_BinTree.c
+ *
+ *  Example:
+ *    ./iter-bench 10000 2000 ; ./iter-bench-inline 10000 2000
+ *
+ *  Keep the tree small enough to fit in cache if you want to see the cost
+ *  of the function calls.  With a million nodes, the walk is dominated by
+ *  cache misses and the two versions run at about the same speed.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.        */
+#include <stdlib.h>             /* Standard C library.  */
+#include <time.h>               /* clock(3).            */
+
+#include "ubi_AVLtree.h"        /* AVL tree module.     */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  SampleRec     - A tree node with an integer key.
+ *  SampleRecPtr  - A pointer to a SampleRec.
+ */
+
+typedef struct
+  {
+  ubi_trNode Node;
+  long       Key;
+  } SampleRec;
+
+typedef SampleRec *SampleRecPtr;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static ubi_trRoot    Root;
+static ubi_trRootPtr RootPtr = &Root;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a node.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  long A = *(long *)ItemPtr;
+  long B = ((SampleRecPtr)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static double Elapsed( clock_t start )
+  /* ------------------------------------------------------------------------ **
+   * Return the number of seconds since <start>.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( (double)(clock() - start) / (double)CLOCKS_PER_SEC );
+  } /* Elapsed */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   *
+   *  Input:  argc  - Argument count.
+   *          argv  - [1] is the number of nodes to place in the tree,
+   *                  [2] is the number of passes to make over the tree.
+   *
+   *  Output: EXIT_SUCCESS, or EXIT_FAILURE if memory ran out or the
+   *          iteration returned something unexpected.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long  nodes  = (argc > 1) ? strtoul( argv[1], NULL, 0 ) : 10000;
+  unsigned long  passes = (argc > 2) ? strtoul( argv[2], NULL, 0 ) : 2000;
+  unsigned long  i, j, steps;
+  long           sum;
+  SampleRecPtr   Recs;
+  ubi_trNodePtr  p;
+  clock_t        start;
+  double         secs;
+
+  Recs = (SampleRecPtr)malloc( nodes * sizeof( SampleRec ) );
+  if( NULL == Recs )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    return( EXIT_FAILURE );
+    }
+
+  (void)ubi_trInitTree( RootPtr, CompareFunc, ubi_trDUPKEY );
+  srand( 1 );
+  for( i = 0; i < nodes; i++ )
+    {
+    Recs[i].Key = ((long)rand() << 16) ^ (long)rand();
+    (void)ubi_trInsert( RootPtr, &Recs[i], &Recs[i].Key, NULL );
+    }
+
+  /* Forward walks, using First() to find the starting point each time. */
+  sum   = 0;
+  steps = 0;
+  start = clock();
+  for( j = 0; j < passes; j++ )
+    {
+    for( p = ubi_trFirst( RootPtr->root ); p; p = ubi_trNext( p ) )
+      {
+      sum += ((SampleRecPtr)p)->Key & 1;
+      steps++;
+      }
+    }
+  secs = Elapsed( start );
+  (void)printf( "%-7s %lu steps  %8.3f s  %6.2f ns/step  (%ld)\n",
+                "Next:", steps, secs, (1e9 * secs) / (double)steps, sum );
+  if( steps != nodes * passes )
+    return( EXIT_FAILURE );
+
+  /* Backward walks, using Last() to find the starting point each time.  */
+  sum   = 0;
+  steps = 0;
+  start = clock();
+  for( j = 0; j < passes; j++ )
+    {
+    for( p = ubi_trLast( RootPtr->root ); p; p = ubi_trPrev( p ) )
+      {
+      sum += ((SampleRecPtr)p)->Key & 1;
+      steps++;
+      }
+    }
+  secs = Elapsed( start );
+  (void)printf( "%-7s %lu steps  %8.3f s  %6.2f ns/step  (%ld)\n",
+                "Prev:", steps, secs, (1e9 * secs) / (double)steps, sum );
+  if( steps != nodes * passes )
+    return( EXIT_FAILURE );
+
+  free( Recs );
+  return( EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
@@ -0,0 +1,303 @@
+/* ========================================================================== **
+ *                                load-test.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Check that threads missing on the same key share one load.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  Several threads start at the same time and ask a cold shard cache for
+ *  the same keys, in the same order, using ubi_shardGetOrLoad().  The
+ *  loader is slow (it sleeps for a while), as loading from a database or
+ *  over the network would be.
+ *
+ *  The test is run twice: first without wait functions, so that every
+ *  thread that misses runs the loader, and then with them, so that the
+ *  threads share each load.  The number of loads and the elapsed time are
+ *  reported.  With sharing, each key should be loaded exactly once.
+ *
+ *  Usage:
+ *    ./load-test [-t threads] [-k keys] [-d delay]
+ *
+ *  Defaults: 16 threads, 200 keys, and a 1000 microsecond load delay.
+ *
+ *  Compile with -pthread.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.            */
+#include <stdlib.h>             /* Standard C library.      */
+#include <string.h>             /* strcmp(3).               */
+#include <time.h>               /* nanosleep(2).            */
+#include <pthread.h>            /* POSIX threads.           */
+
+#include "ubi_ShardCache.h"     /* Sharded cache.           */
+
+
+/* -------------------------------------------------------------------------- **
+ * Defines...
+ */
+
+#define MAX_THREADS 256
+#define SHARDS      8
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Rec       - A cache entry with an integer key and a value.
+ *  Lock      - A shard lock: a mutex, and a condition to wait on.
+ */
+
+typedef struct
+  {
+  ubi_cacheEntry Entry;
+  unsigned long  Key;
+  unsigned long  Value;
+  } Rec;
+
+typedef struct
+  {
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+  } Lock;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static ubi_shardCache  Cache[1];
+static ubi_shard       Shards[SHARDS];
+static Lock            Locks[SHARDS];
+static pthread_mutex_t Counter = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long   Loads   = 0;
+static unsigned long   Errors  = 0;
+static unsigned long   Keys    = 200;
+static long            Delay   = 1000;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static void LockFunc( void *LockPtr )
+  /* ------------------------------------------------------------------------ **
+   * Shard lock function.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)pthread_mutex_lock( &((Lock *)LockPtr)->mutex );
+  } /* LockFunc */
+
+
+static void UnlockFunc( void *LockPtr )
+  /* ------------------------------------------------------------------------ **
+   * Shard unlock function.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)pthread_mutex_unlock( &((Lock *)LockPtr)->mutex );
+  } /* UnlockFunc */
+
+
+static void WaitFunc( void *LockPtr )
+  /* ------------------------------------------------------------------------ **
+   * Wait on a shard's condition.  The shard's mutex is held.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)pthread_cond_wait( &((Lock *)LockPtr)->cond,
+                           &((Lock *)LockPtr)->mutex );
+  } /* WaitFunc */
+
+
+static void WakeFunc( void *LockPtr )
+  /* ------------------------------------------------------------------------ **
+   * Wake all threads waiting on a shard.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)pthread_cond_broadcast( &((Lock *)LockPtr)->cond );
+  } /* WakeFunc */
+
+
+static unsigned long HashFunc( ubi_trItemPtr ItemPtr )
+  /* ------------------------------------------------------------------------ **
+   * Hash an integer key.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( *(unsigned long *)ItemPtr * 2654435761UL );
+  } /* HashFunc */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Rec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static void FreeFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Free an entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  free( NodePtr );
+  } /* FreeFunc */
+
+
+static ubi_cacheEntryPtr Loader( ubi_trItemPtr Key, void *Context )
+  /* ------------------------------------------------------------------------ **
+   * Slowly create an entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  struct timespec ts;
+  Rec            *rp;
+
+  (void)Context;
+  ts.tv_sec  = Delay / 1000000;
+  ts.tv_nsec = (Delay % 1000000) * 1000;
+  (void)nanosleep( &ts, NULL );
+
+  (void)pthread_mutex_lock( &Counter );
+  Loads++;
+  (void)pthread_mutex_unlock( &Counter );
+
+  rp = (Rec *)malloc( sizeof( Rec ) );
+  if( NULL == rp )
+    return( NULL );
+  rp->Entry.entry_size = sizeof( Rec );
+  rp->Key   = *(unsigned long *)Key;
+  rp->Value = ~rp->Key;
+  return( &rp->Entry );
+  } /* Loader */
+
+
+static void Check( ubi_trNodePtr NodePtr, void *UserData )
+  /* ------------------------------------------------------------------------ **
+   * Check the value in an entry, while its shard is locked.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  if( ((Rec *)NodePtr)->Value != ~*(unsigned long *)UserData )
+    {
+    (void)pthread_mutex_lock( &Counter );
+    Errors++;
+    (void)pthread_mutex_unlock( &Counter );
+    }
+  } /* Check */
+
+
+static void *Worker( void *arg )
+  /* ------------------------------------------------------------------------ **
+   * Worker thread: get (or load) every key.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long key;
+
+  (void)arg;
+  for( key = 0; key < Keys; key++ )
+    {
+    if( !ubi_shardGetOrLoad( Cache, &key, Loader, NULL, Check, &key ) )
+      {
+      (void)pthread_mutex_lock( &Counter );
+      Errors++;
+      (void)pthread_mutex_unlock( &Counter );
+      }
+    }
+  return( NULL );
+  } /* Worker */
+
+
+static double Run( int nthreads, int share )
+  /* ------------------------------------------------------------------------ **
+   * Run the threads against an empty cache.  Return the elapsed time, in
+   * milliseconds.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  pthread_t       tid[MAX_THREADS];
+  struct timespec start, stop;
+  int             t;
+
+  (void)ubi_shardInit( Cache, Shards, SHARDS, HashFunc, CompareFunc,
+                       FreeFunc, 0, 0 );
+  ubi_shardSetLocks( Cache, LockFunc, UnlockFunc, Locks, sizeof( Lock ) );
+  if( share )
+    ubi_shardSetWait( Cache, WaitFunc, WakeFunc );
+  Loads  = 0;
+  Errors = 0;
+
+  (void)clock_gettime( CLOCK_MONOTONIC, &start );
+  for( t = 0; t < nthreads; t++ )
+    (void)pthread_create( &tid[t], NULL, Worker, NULL );
+  for( t = 0; t < nthreads; t++ )
+    (void)pthread_join( tid[t], NULL );
+  (void)clock_gettime( CLOCK_MONOTONIC, &stop );
+
+  ubi_shardClear( Cache );
+  return( ((double)(stop.tv_sec - start.tv_sec) * 1e3)
+        + ((double)(stop.tv_nsec - start.tv_nsec) / 1e6) );
+  } /* Run */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  int    nthreads = 16;
+  int    i;
+  double ms;
+
+  for( i = 1; (i + 1) < argc; i += 2 )
+    {
+    if( 0 == strcmp( argv[i], "-t" ) )
+      nthreads = atoi( argv[i+1] );
+    else if( 0 == strcmp( argv[i], "-k" ) )
+      Keys = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-d" ) )
+      Delay = atol( argv[i+1] );
+    else
+      break;
+    }
+  if( (i < argc) || (nthreads < 1) || (nthreads > MAX_THREADS)
+   || (Keys < 1) || (Delay < 0) )
+    {
+    (void)fprintf( stderr, "Usage: %s [-t threads] [-k keys] [-d delay]\n",
+                   argv[0] );
+    return( EXIT_FAILURE );
+    }
+
+  for( i = 0; i < SHARDS; i++ )
+    {
+    (void)pthread_mutex_init( &Locks[i].mutex, NULL );
+    (void)pthread_cond_init( &Locks[i].cond, NULL );
+    }
+
+  (void)printf( "%d threads, %lu keys, %ld us per load\n",
+                nthreads, Keys, Delay );
+  ms = Run( nthreads, 0 );
+  (void)printf( "without sharing: %7lu loads %9.1f ms %lu errors\n",
+                Loads, ms, Errors );
+  ms = Run( nthreads, 1 );
+  (void)printf( "with sharing:    %7lu loads %9.1f ms %lu errors\n",
+                Loads, ms, Errors );
+
+  return( ((Loads == Keys) && (0 == Errors)) ? EXIT_SUCCESS : EXIT_FAILURE );
+  } /* main */
+
+/* ========================================================================== */
@@ -0,0 +1,292 @@
+/* ========================================================================== **
+ *                                mrc-test.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Compare a sampled miss ratio curve with real LRU caches.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  A skewed trace of requests is replayed against an LRU cache with a
+ *  ubi_MissRatio curve attached, and then, for several other sizes,
+ *  against LRU caches of that size.  The hit ratio predicted by the curve
+ *  is printed next to the one measured.  This is done twice: once with
+ *  the caches limited by entry count, and once with entries of varying
+ *  size (100 bytes to 13KB) and the caches limited by memory.
+ *
+ *  The trace is also replayed without the curve, to measure its cost,
+ *  and ubi_cacheTuneMemory() is asked for the smallest memory limit that
+ *  loses no more than half a percent.
+ *
+ *  The test fails if any prediction is off by more than three percent.
+ *
+ *  Usage:
+ *    ./mrc-test [-k keys] [-c capacity] [-n requests] [-s samples]
+ *
+ *  Defaults: 1000000 keys, a capacity of 50000 entries, 2000000
+ *  requests, and 8192 samples.  The initial sampling rate is 1%.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.            */
+#include <stdlib.h>             /* Standard C library.      */
+#include <string.h>             /* strcmp(3).               */
+#include <time.h>               /* clock(3).                */
+
+#include "ubi_Cache.h"          /* Cache module.            */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Rec       - A cache entry with an integer key.
+ */
+
+typedef struct
+  {
+  ubi_cacheEntry Entry;
+  unsigned long  Key;
+  } Rec;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static unsigned long  Seed     = 1;
+static unsigned long  Keys     = 1000000;
+static unsigned long  Capacity = 50000;
+static unsigned long  Requests = 2000000;
+static unsigned long  Samples  = 8192;
+static unsigned long *Trace;
+static unsigned long  Errors   = 0;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static unsigned long Random( void )
+  /* ------------------------------------------------------------------------ **
+   * A small LCG, returning 31 random bits.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Seed = (Seed * 6364136223846793005UL) + 1442695040888963407UL;
+  return( Seed >> 33 );
+  } /* Random */
+
+
+static unsigned long Scramble( unsigned long k )
+  /* ------------------------------------------------------------------------ **
+   * Mix the bits of a key, so that keys do not arrive in sorted order.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  k ^= k >> 33;
+  k *= 0xFF51AFD7ED558CCDUL;
+  k ^= k >> 33;
+  return( k );
+  } /* Scramble */
+
+
+static unsigned long SizeOf( unsigned long key )
+  /* ------------------------------------------------------------------------ **
+   * Return the size of a key's entry: 100 bytes to about 13KB, more or less
+   * evenly spread on a log scale.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long h = Scramble( key ^ 0x5555UL );
+
+  return( (100UL << (h % 8)) + ((h >> 8) % 100) );
+  } /* SizeOf */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Rec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static unsigned long HashFunc( ubi_trItemPtr ItemPtr )
+  /* ------------------------------------------------------------------------ **
+   * Hash an integer key.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( *(unsigned long *)ItemPtr * 0x9E3779B97F4A7C15UL );
+  } /* HashFunc */
+
+
+static void FreeFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Free an entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  free( NodePtr );
+  } /* FreeFunc */
+
+
+static int Replay( unsigned long  Entries,
+                   unsigned long  Memory,
+                   ubi_mrcRootPtr MrcPtr,
+                   double        *Secs )
+  /* ------------------------------------------------------------------------ **
+   * Replay the trace against an LRU cache, and return its hit ratio (times
+   * 10000).  If Memory is nonzero, entries have varying sizes.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot Cache[1];
+  unsigned long i, hits = 0;
+  clock_t       start;
+  Rec          *rp;
+
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc, Entries, Memory );
+  (void)ubi_cacheSetHashFunc( Cache, HashFunc );
+  (void)ubi_cacheSetPolicy( Cache, ubi_cacheLRU );
+  if( MrcPtr )
+    (void)ubi_cacheSetMissRatio( Cache, MrcPtr );
+
+  start = clock();
+  for( i = 0; i < Requests; i++ )
+    {
+    if( ubi_cacheGet( Cache, &Trace[i] ) )
+      hits++;
+    else
+      {
+      rp = (Rec *)malloc( sizeof( Rec ) );
+      if( NULL == rp )
+        {
+        (void)fprintf( stderr, "Out of memory.\n" );
+        exit( EXIT_FAILURE );
+        }
+      rp->Key = Trace[i];
+      ubi_cachePut( Cache, Memory ? SizeOf( Trace[i] ) : 1,
+                    &rp->Entry, &rp->Key );
+      }
+    }
+  if( Secs )
+    *Secs = (double)(clock() - start) / (double)CLOCKS_PER_SEC;
+  (void)ubi_cacheClear( Cache );
+  return( (int)((10000.0 * (double)hits) / (double)Requests) );
+  } /* Replay */
+
+
+static void Compare( ubi_mrcRootPtr MrcPtr, int Bytes, unsigned long Size )
+  /* ------------------------------------------------------------------------ **
+   * Print the predicted and measured hit ratios for one cache size.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  int predicted, actual, diff;
+
+  predicted = Bytes ? ubi_mrcHitRatio( MrcPtr, 0, Size )
+                    : ubi_mrcHitRatio( MrcPtr, Size, 0 );
+  actual    = Bytes ? Replay( 0, Size, NULL, NULL )
+                    : Replay( Size, 0, NULL, NULL );
+  diff      = predicted - actual;
+  (void)printf( "  %10lu %-7s predicted %6.2f%%  actual %6.2f%%  %+6.2f\n",
+                Size, Bytes ? "bytes" : "entries",
+                predicted / 100.0, actual / 100.0, diff / 100.0 );
+  if( (diff > 300) || (diff < -300) )
+    Errors++;
+  } /* Compare */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_mrcRoot    Mrc[1];
+  ubi_mrcSample *samples;
+  ubi_cacheRoot  Cache[1];
+  unsigned long  i, memory, tuned;
+  double         plain, with;
+  int            j;
+
+  for( j = 1; (j + 1) < argc; j += 2 )
+    {
+    if( 0 == strcmp( argv[j], "-k" ) )
+      Keys = strtoul( argv[j+1], NULL, 0 );
+    else if( 0 == strcmp( argv[j], "-c" ) )
+      Capacity = strtoul( argv[j+1], NULL, 0 );
+    else if( 0 == strcmp( argv[j], "-n" ) )
+      Requests = strtoul( argv[j+1], NULL, 0 );
+    else if( 0 == strcmp( argv[j], "-s" ) )
+      Samples = strtoul( argv[j+1], NULL, 0 );
+    else
+      break;
+    }
+  if( (j < argc) || (Keys < 1) || (Capacity < 8) || (Requests < 1)
+   || (Samples < 1) )
+    {
+    (void)fprintf( stderr, "Usage: %s [-k keys] [-c capacity] [-n requests]"
+                           " [-s samples]\n", argv[0] );
+    return( EXIT_FAILURE );
+    }
+
+  Trace   = (unsigned long *)malloc( Requests * sizeof( unsigned long ) );
+  samples = (ubi_mrcSample *)malloc( Samples * sizeof( ubi_mrcSample ) );
+  if( (NULL == Trace) || (NULL == samples) )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    return( EXIT_FAILURE );
+    }
+  for( i = 0; i < Requests; i++ )
+    Trace[i] = Scramble( Random() % ((Random() % ((Random() % Keys) + 1))
+                                     + 1) );
+
+  (void)printf( "%lu keys, capacity %lu, %lu requests, %lu samples\n",
+                Keys, Capacity, Requests, Samples );
+
+  /* Entry counts.  Time the replay with and without the curve. */
+  (void)Replay( Capacity, 0, NULL, &plain );
+  (void)ubi_mrcInit( Mrc, samples, Samples, 10000 );
+  (void)Replay( Capacity, 0, Mrc, &with );
+  (void)printf( "cost of the curve: %.1f ns per request (%+.1f%%), "
+                "final sampling rate %.4f%%\n",
+                ((with - plain) * 1e9) / (double)Requests,
+                (100.0 * (with - plain)) / plain, 100.0 * ubi_mrcRate( Mrc ) );
+  for( i = Capacity / 8; i <= Capacity * 4; i *= 2 )
+    Compare( Mrc, 0, i );
+
+  /* Bytes.  The average entry is about 3KB. */
+  memory = Capacity * 3000;
+  (void)ubi_mrcInit( Mrc, samples, Samples, 10000 );
+  (void)Replay( 0, memory, Mrc, NULL );
+  for( i = memory / 8; i <= memory * 4; i *= 2 )
+    Compare( Mrc, 1, i );
+
+  /* Tuning. */
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc, 0, memory );
+  (void)ubi_cacheSetHashFunc( Cache, HashFunc );
+  (void)ubi_cacheSetMissRatio( Cache, Mrc );
+  tuned = ubi_cacheTuneMemory( Cache, memory / 8, memory * 8, 50 );
+  (void)printf( "tuned memory limit, within 0.5%% of %lu bytes: %lu bytes "
+                "(predicted %.2f%% vs %.2f%%)\n",
+                memory * 8, tuned,
+                ubi_mrcHitRatio( Mrc, 0, tuned ) / 100.0,
+                ubi_mrcHitRatio( Mrc, 0, memory * 8 ) / 100.0 );
+  if( (tuned < memory / 8) || (tuned > memory * 8)
+   || (ubi_cacheGetMaxMemory( Cache ) != tuned) )
+    Errors++;
+
+  free( samples );
+  free( Trace );
+  (void)printf( "%lu errors\n", Errors );
+  return( Errors ? EXIT_FAILURE : EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
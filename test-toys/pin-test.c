@@ -0,0 +1,408 @@
+/* ========================================================================== **
+ *                                pin-test.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Check that pinned cache entries outlive eviction.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  For each eviction policy, with and without the TinyLFU admission
+ *  filter, a cache is filled and a tenth of its entries are pinned with
+ *  ubi_cacheAcquire().  A stream of random requests then churns the cache
+ *  many times over.  The pinned entries must all still be in the cache
+ *  afterward, and the cache must have stayed within its limit.  Without
+ *  the filter, being passed over by eviction must not have promoted them:
+ *  their GDSF use counts and ARC lists must not have changed.
+ *
+ *  Some of the pinned entries are then overwritten, some deleted, and
+ *  the cache is cleared.  None of them may be freed until the last
+ *  reference to it is released, and all of them must be freed after
+ *  that.  The free function counts an error if it is handed an entry
+ *  that is still pinned.
+ *
+ *  Then every entry of a small cache is pinned.  New entries must
+ *  then be evicted instead of the pinned ones.  If the limit is lowered,
+ *  the cache has to stay over it, and must come back within it once the
+ *  entries are released.
+ *
+ *  Finally, the sampled policy keeps entries that don't fit into its
+ *  slots on an overflow list, which it evicts from first.  A pinned entry
+ *  at the old end of that list must not stop eviction.
+ *
+ *  Usage:
+ *    ./pin-test [-c capacity] [-n requests]
+ *
+ *  Defaults: a capacity of 10000 entries, and 500000 requests.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.            */
+#include <stdlib.h>             /* Standard C library.      */
+#include <string.h>             /* strcmp(3).               */
+
+#include "ubi_Cache.h"          /* Cache module.            */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Rec       - A cache entry with an integer key and a value.
+ *  PolicyTab - Maps a policy name to its ubi_Cache constant.
+ */
+
+typedef struct
+  {
+  ubi_cacheEntryExt Entry;
+  unsigned long     Key;
+  unsigned long     Value;
+  } Rec;
+
+typedef struct
+  {
+  char *name;
+  int   policy;
+  } PolicyTab;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static PolicyTab Policies[] =
+  {
+  { "splay",    ubi_cacheSPLAY    },
+  { "lru",      ubi_cacheLRU      },
+  { "clock",    ubi_cacheCLOCK    },
+  { "clockpro", ubi_cacheCLOCKPRO },
+  { "arc",      ubi_cacheARC      },
+  { "gdsf",     ubi_cacheGDSF     },
+  { "sampled",  ubi_cacheSAMPLED  },
+  { NULL,       0                 }
+  };
+
+static unsigned long Seed     = 1;
+static unsigned long Capacity = 10000;
+static unsigned long Requests = 500000;
+static unsigned long Live     = 0;
+static unsigned long Errors   = 0;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static unsigned long Random( void )
+  /* ------------------------------------------------------------------------ **
+   * A small LCG, returning 31 random bits.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Seed = (Seed * 6364136223846793005UL) + 1442695040888963407UL;
+  return( Seed >> 33 );
+  } /* Random */
+
+
+static unsigned long Scramble( unsigned long k )
+  /* ------------------------------------------------------------------------ **
+   * Mix the bits of a key, so that keys do not arrive in sorted order.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  k ^= k >> 33;
+  k *= 0xFF51AFD7ED558CCDUL;
+  k ^= k >> 33;
+  return( k );
+  } /* Scramble */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Rec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static unsigned long HashFunc( ubi_trItemPtr ItemPtr )
+  /* ------------------------------------------------------------------------ **
+   * Hash an integer key.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( *(unsigned long *)ItemPtr * 0x9E3779B97F4A7C15UL );
+  } /* HashFunc */
+
+
+static void FreeFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Free an entry, which must not be pinned.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Rec *rp = (Rec *)NodePtr;
+
+  if( rp->Entry.base.refs || (rp->Value != ~rp->Key) )
+    Errors++;
+  Live--;
+  free( rp );
+  } /* FreeFunc */
+
+
+static Rec *Put( ubi_cacheRootPtr CachePtr, unsigned long Key )
+  /* ------------------------------------------------------------------------ **
+   * Create an entry and put it into the cache.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Rec *rp = (Rec *)malloc( sizeof( Rec ) );
+
+  if( NULL == rp )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    exit( EXIT_FAILURE );
+    }
+  rp->Key   = Key;
+  rp->Value = ~Key;
+  Live++;
+  ubi_cachePut( CachePtr, sizeof( Rec ), &rp->Entry.base, &rp->Key );
+  return( rp );
+  } /* Put */
+
+
+static void Run( PolicyTab *pt, ubi_trBool Admit )
+  /* ------------------------------------------------------------------------ **
+   * Pin, churn, overwrite, delete, clear and release, for one policy.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot      Cache[1];
+  ubi_cacheGhost    *ghosts;
+  ubi_cacheEntryPtr *slots;
+  unsigned char     *sketch;
+  Rec              **pins;
+  unsigned long     *uses;
+  unsigned long      i, n, key, over = 0, lost = 0, promoted = 0;
+  unsigned long      before = Errors;
+
+  ghosts = (ubi_cacheGhost *)malloc( Capacity * sizeof( ubi_cacheGhost ) );
+  slots  = (ubi_cacheEntryPtr *)malloc( (Capacity + 1)
+                                        * sizeof( ubi_cacheEntryPtr ) );
+  sketch = (unsigned char *)malloc( ubi_cacheSketchSize( Capacity ) );
+  pins   = (Rec **)malloc( (Capacity / 10) * sizeof( Rec * ) );
+  uses   = (unsigned long *)malloc( (Capacity / 10) * sizeof( long ) * 2 );
+  if( (NULL == ghosts) || (NULL == slots) || (NULL == sketch)
+   || (NULL == pins) || (NULL == uses) )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    exit( EXIT_FAILURE );
+    }
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc, Capacity, 0 );
+  (void)ubi_cacheSetExtended( Cache, ubi_trTRUE );
+  (void)ubi_cacheSetHashFunc( Cache, HashFunc );
+  (void)ubi_cacheSetGhosts( Cache, ghosts, Capacity );
+  (void)ubi_cacheSetSlots( Cache, slots, Capacity + 1 );
+  if( Admit )
+    (void)ubi_cacheSetAdmission( Cache, sketch,
+                                 ubi_cacheSketchSize( Capacity ) );
+  (void)ubi_cacheSetPolicy( Cache, pt->policy );
+
+  /* Fill the cache, and pin every tenth key that made it in. */
+  for( i = 0; i < Capacity; i++ )
+    (void)Put( Cache, Scramble( i ) );
+  for( i = n = 0; i < Capacity; i += 10 )
+    {
+    key = Scramble( i );
+    if( NULL != (pins[n] = (Rec *)ubi_cacheAcquire( Cache, &key )) )
+      {
+      uses[2 * n]       = pins[n]->Entry.pol.gdsf.freq;
+      uses[(2 * n) + 1] = pins[n]->Entry.base.flags;
+      n++;
+      }
+    }
+
+  /* Churn. */
+  for( i = 0; i < Requests; i++ )
+    {
+    key = Scramble( Capacity + (Random() % (Capacity * 4)) );
+    if( NULL == ubi_cacheGet( Cache, &key ) )
+      (void)Put( Cache, key );
+    if( ubi_cacheGetEntryCount( Cache ) > Capacity )
+      over++;
+    }
+  for( i = 0; (i < n) && !Admit; i++ )
+    if( (pins[i]->Entry.pol.gdsf.freq != uses[2 * i])
+     || ((ubi_cacheARC == pt->policy)
+      && (pins[i]->Entry.base.flags != uses[(2 * i) + 1])) )
+      promoted++;
+  for( i = 0; i < n; i++ )
+    if( (Rec *)ubi_cacheGet( Cache, &pins[i]->Key ) != pins[i] )
+      lost++;
+
+  /* Overwrite every third pinned entry, and delete every fifth. */
+  for( i = 0; i < n; i++ )
+    {
+    if( 0 == (i % 3) )
+      (void)Put( Cache, pins[i]->Key );
+    else if( 0 == (i % 5) )
+      (void)ubi_cacheDelete( Cache, &pins[i]->Key );
+    }
+  for( i = 0; i < n; i++ )
+    if( (0 == (i % 3)) || (0 == (i % 5)) )
+      if( (Rec *)ubi_cacheGet( Cache, &pins[i]->Key ) == pins[i] )
+        lost++;
+
+  /* Clear the cache, and release.  Only then may the pins be freed. */
+  (void)ubi_cacheClear( Cache );
+  if( Live != n )
+    Errors++;
+  for( i = 0; i < n; i++ )
+    {
+    if( pins[i]->Value != ~pins[i]->Key )
+      Errors++;
+    ubi_cacheRelease( Cache, &pins[i]->Entry.base );
+    }
+  if( (0 != Live) || (0 != Cache->pinned) )
+    Errors++;
+
+  Errors += over + lost + promoted;
+  (void)printf( "%-8s %-9s %5lu pinned, %lu over the limit, %lu lost, "
+                "%lu promoted, %s\n",
+                pt->name, Admit ? "+tinylfu" : "", n, over, lost, promoted,
+                (Errors == before) ? "ok" : "FAILED" );
+  free( uses );
+  free( pins );
+  free( sketch );
+  free( slots );
+  free( ghosts );
+  } /* Run */
+
+
+static void RunAllPinned( void )
+  /* ------------------------------------------------------------------------ **
+   * Pin every entry of a small LRU cache, and keep putting.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot Cache[1];
+  Rec          *pins[8];
+  unsigned long i, key, before = Errors;
+
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc, 8, 0 );
+  (void)ubi_cacheSetPolicy( Cache, ubi_cacheLRU );
+  for( i = 0; i < 8; i++ )
+    {
+    key = Scramble( i );
+    (void)Put( Cache, key );
+    pins[i] = (Rec *)ubi_cacheAcquire( Cache, &key );
+    if( NULL == pins[i] )
+      Errors++;
+    }
+  for( i = 8; i < 16; i++ )
+    (void)Put( Cache, Scramble( i ) );
+  for( i = 0; i < 8; i++ )
+    if( pins[i] && ((Rec *)ubi_cacheGet( Cache, &pins[i]->Key ) != pins[i]) )
+      Errors++;
+  (void)ubi_cacheSetMaxEntries( Cache, 4 );
+  if( ubi_cacheReduce( Cache, 1 ) || (8 != ubi_cacheGetEntryCount( Cache )) )
+    Errors++;
+
+  for( i = 0; i < 8; i++ )
+    if( pins[i] )
+      ubi_cacheRelease( Cache, &pins[i]->Entry.base );
+  (void)Put( Cache, Scramble( 16 ) );
+  if( 4 != ubi_cacheGetEntryCount( Cache ) )
+    Errors++;
+  (void)ubi_cacheClear( Cache );
+  if( 0 != Live )
+    Errors++;
+  (void)printf( "all pinned: %s\n", (Errors == before) ? "ok" : "FAILED" );
+  } /* RunAllPinned */
+
+
+static void RunOverflow( void )
+  /* ------------------------------------------------------------------------ **
+   * Pin the oldest overflow entry of a sampled cache, and keep putting.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot     Cache[1];
+  ubi_cacheEntryPtr slots[4];
+  Rec              *pin;
+  unsigned long     i, key, max = 0, before = Errors;
+
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc, 10, 0 );
+  (void)ubi_cacheSetSlots( Cache, slots, 4 );
+  /* The sampled policy needs extended entries. */
+  if( ubi_cacheSetPolicy( Cache, ubi_cacheSAMPLED ) )
+    Errors++;
+  (void)ubi_cacheSetExtended( Cache, ubi_trTRUE );
+  (void)ubi_cacheSetPolicy( Cache, ubi_cacheSAMPLED );
+  for( i = 0; i < 10; i++ )
+    (void)Put( Cache, Scramble( i ) );
+  /* The first four entries took the slots, so this one overflowed. */
+  key = Scramble( 4 );
+  if( NULL == (pin = (Rec *)ubi_cacheAcquire( Cache, &key )) )
+    Errors++;
+  for( i = 10; i < 110; i++ )
+    {
+    (void)Put( Cache, Scramble( i ) );
+    if( ubi_cacheGetEntryCount( Cache ) > max )
+      max = ubi_cacheGetEntryCount( Cache );
+    }
+  if( (max > 10) || (pin && ((Rec *)ubi_cacheGet( Cache, &key ) != pin)) )
+    Errors++;
+
+  if( pin )
+    ubi_cacheRelease( Cache, &pin->Entry.base );
+  (void)ubi_cacheClear( Cache );
+  if( 0 != Live )
+    Errors++;
+  (void)printf( "overflow: at most %lu entries, %s\n",
+                max, (Errors == before) ? "ok" : "FAILED" );
+  } /* RunOverflow */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  PolicyTab *pt;
+  int        i;
+
+  for( i = 1; (i + 1) < argc; i += 2 )
+    {
+    if( 0 == strcmp( argv[i], "-c" ) )
+      Capacity = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-n" ) )
+      Requests = strtoul( argv[i+1], NULL, 0 );
+    else
+      break;
+    }
+  if( (i < argc) || (Capacity < 100) )
+    {
+    (void)fprintf( stderr, "Usage: %s [-c capacity] [-n requests]\n",
+                   argv[0] );
+    return( EXIT_FAILURE );
+    }
+
+  for( pt = Policies; NULL != pt->name; pt++ )
+    {
+    Run( pt, ubi_trFALSE );
+    Run( pt, ubi_trTRUE );
+    }
+  RunAllPinned();
+  RunOverflow();
+
+  (void)printf( "%lu errors\n", Errors );
+  return( Errors ? EXIT_FAILURE : EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
@@ -0,0 +1,347 @@
+/* ========================================================================== **
+ *                                pool-test.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Compare a ubi_cachePool with fixed per-cache memory limits.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  A number of tenants each have a cache.  They come in four kinds:
+ *    hot   - Busy, with a small working set that fits in any share.
+ *    big   - Busy, with a large skewed working set that gains from memory.
+ *    scan  - Fairly busy, but almost never asks for the same key twice.
+ *    idle  - Busy for the first tenth of the run, and then silent.
+ *  The same stream of requests is replayed three times: with the memory
+ *  split evenly between the caches, with the caches in a pool that values
+ *  their memory by their recent hits, and with a pool that uses a miss
+ *  ratio curve for each cache.  The pool is updated every 20000 requests.
+ *
+ *  The aggregate hit ratio, and each kind's share of the memory at the
+ *  end, are printed.  The pool must stay within its budget, must account
+ *  for the memory of its members exactly, must not let a cache exceed its
+ *  maximum share, and must not do worse than the even split.  Then the
+ *  budget is halved, and the caches are taken out of the pool.
+ *
+ *  Usage:
+ *    ./pool-test [-t tenants] [-e entries] [-n requests]
+ *
+ *  Defaults: 16 tenants, 5000 entries (of 100 bytes) per tenant, and
+ *  2000000 requests.  Each cache in a pool has a minimum share of a
+ *  quarter of the even split, and a maximum of half of the budget.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.            */
+#include <stdlib.h>             /* Standard C library.      */
+#include <string.h>             /* strcmp(3).               */
+
+#include "ubi_Cache.h"          /* Cache module.            */
+#include "ubi_CachePool.h"      /* Shared memory budget.    */
+
+
+/* -------------------------------------------------------------------------- **
+ * Constants...
+ *
+ *  ENTRY_SIZE  - The size charged for each entry.
+ *  SAMPLES     - Miss ratio curve samples per cache.
+ *  INTERVAL    - Requests between pool updates.
+ */
+
+#define ENTRY_SIZE  100
+#define SAMPLES     1024
+#define INTERVAL    20000
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Rec       - A cache entry with an integer key.
+ *  Kind      - A kind of tenant.
+ */
+
+typedef struct
+  {
+  ubi_cacheEntry Entry;
+  unsigned long  Key;
+  } Rec;
+
+typedef struct
+  {
+  char         *name;
+  unsigned long keys;         /* Number of distinct keys.           */
+  unsigned long weight;       /* Share of the traffic, while busy.  */
+  int           skewed;       /* Nonzero for a skewed distribution. */
+  } Kind;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static Kind Kinds[] =
+  {
+  { "hot",  2000,      4, 1 },
+  { "big",  200000,    4, 1 },
+  { "scan", 100000000, 2, 0 },
+  { "idle", 20000,     3, 1 }
+  };
+
+static unsigned long Seed     = 1;
+static unsigned long Tenants  = 16;
+static unsigned long Entries  = 5000;
+static unsigned long Requests = 2000000;
+static unsigned long Live     = 0;
+static unsigned long Errors   = 0;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static unsigned long Random( void )
+  /* ------------------------------------------------------------------------ **
+   * A small LCG, returning 31 random bits.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Seed = (Seed * 6364136223846793005UL) + 1442695040888963407UL;
+  return( Seed >> 33 );
+  } /* Random */
+
+
+static unsigned long Scramble( unsigned long k )
+  /* ------------------------------------------------------------------------ **
+   * Mix the bits of a key, so that keys do not arrive in sorted order.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  k ^= k >> 33;
+  k *= 0xFF51AFD7ED558CCDUL;
+  k ^= k >> 33;
+  return( k );
+  } /* Scramble */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Rec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static unsigned long HashFunc( ubi_trItemPtr ItemPtr )
+  /* ------------------------------------------------------------------------ **
+   * Hash an integer key.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( *(unsigned long *)ItemPtr * 0x9E3779B97F4A7C15UL );
+  } /* HashFunc */
+
+
+static void FreeFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Free an entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Live--;
+  free( NodePtr );
+  } /* FreeFunc */
+
+
+static unsigned long Pick( unsigned long Request, unsigned long *Key )
+  /* ------------------------------------------------------------------------ **
+   * Choose the tenant and key of a request, and return the tenant.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long total = 0, r, t;
+  Kind         *kp;
+
+  for( t = 0; t < 4; t++ )
+    if( (3 != t) || (Request < Requests / 10) )
+      total += Kinds[t].weight;
+  r = Random() % total;
+  for( t = 0; r >= Kinds[t].weight; t++ )
+    r -= Kinds[t].weight;
+  kp = &Kinds[t];
+
+  /* Spread the requests for this kind over its tenants. */
+  t += 4 * (Random() % (Tenants / 4));
+  *Key = kp->skewed ? (Random() % ((Random() % kp->keys) + 1))
+                    : (Random() % kp->keys);
+  *Key = Scramble( *Key );
+  return( t );
+  } /* Pick */
+
+
+static double Run( char *Name, int Pooled, int Curves )
+  /* ------------------------------------------------------------------------ **
+   * Replay the requests, and return the hit ratio.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRootPtr       caches;
+  ubi_cachePoolMemberPtr members;
+  ubi_mrcRootPtr         curves  = NULL;
+  ubi_mrcSample         *samples = NULL;
+  ubi_cachePool          Pool[1];
+  unsigned long          budget  = Tenants * Entries * ENTRY_SIZE;
+  unsigned long          i, t, key, sum, hits = 0, over = 0;
+  unsigned long          share[4];
+  Rec                   *rp;
+
+  caches  = (ubi_cacheRootPtr)malloc( Tenants * sizeof( ubi_cacheRoot ) );
+  members = (ubi_cachePoolMemberPtr)malloc( Tenants
+                                            * sizeof( ubi_cachePoolMember ) );
+  if( Curves )
+    {
+    curves  = (ubi_mrcRootPtr)malloc( Tenants * sizeof( ubi_mrcRoot ) );
+    samples = (ubi_mrcSample *)malloc( Tenants * SAMPLES
+                                       * sizeof( ubi_mrcSample ) );
+    }
+  if( (NULL == caches) || (NULL == members)
+   || (Curves && ((NULL == curves) || (NULL == samples))) )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    exit( EXIT_FAILURE );
+    }
+
+  (void)ubi_cachePoolInit( Pool, budget );
+  for( t = 0; t < Tenants; t++ )
+    {
+    (void)ubi_cacheInit( &caches[t], CompareFunc, FreeFunc, 0,
+                         budget / Tenants );
+    (void)ubi_cacheSetHashFunc( &caches[t], HashFunc );
+    (void)ubi_cacheSetPolicy( &caches[t], ubi_cacheLRU );
+    if( Curves )
+      {
+      (void)ubi_mrcInit( &curves[t], &samples[t * SAMPLES], SAMPLES, 100000 );
+      (void)ubi_cacheSetMissRatio( &caches[t], &curves[t] );
+      }
+    if( Pooled
+     && !ubi_cachePoolAdd( Pool, &members[t], &caches[t],
+                           budget / (Tenants * 4), budget / 2 ) )
+      Errors++;
+    }
+
+  for( i = 0; i < Requests; i++ )
+    {
+    t = Pick( i, &key );
+    if( ubi_cacheGet( &caches[t], &key ) )
+      hits++;
+    else
+      {
+      rp = (Rec *)malloc( sizeof( Rec ) );
+      if( NULL == rp )
+        {
+        (void)fprintf( stderr, "Out of memory.\n" );
+        exit( EXIT_FAILURE );
+        }
+      rp->Key = key;
+      Live++;
+      ubi_cachePut( &caches[t], ENTRY_SIZE, &rp->Entry, &rp->Key );
+      }
+    if( Pooled && ((Pool->used > budget)
+                || (ubi_cacheGetMemUsed( &caches[t] ) > budget / 2)) )
+      over++;
+    if( Pooled && (0 == ((i + 1) % INTERVAL)) )
+      {
+      for( sum = t = 0; t < Tenants; t++ )
+        sum += ubi_cacheGetMemUsed( &caches[t] );
+      if( sum != Pool->used )
+        Errors++;
+      ubi_cachePoolUpdate( Pool );
+      }
+    }
+
+  share[0] = share[1] = share[2] = share[3] = 0;
+  for( t = 0; t < Tenants; t++ )
+    share[t % 4] += ubi_cacheGetMemUsed( &caches[t] );
+  (void)printf( "%-9s %6.2f%% hits   memory: hot %4.1f%%  big %4.1f%%  "
+                "scan %4.1f%%  idle %4.1f%%\n", Name,
+                (100.0 * (double)hits) / (double)Requests,
+                (100.0 * (double)share[0]) / (double)budget,
+                (100.0 * (double)share[1]) / (double)budget,
+                (100.0 * (double)share[2]) / (double)budget,
+                (100.0 * (double)share[3]) / (double)budget );
+  Errors += over;
+
+  /* Shrink the pool, then dissolve it. */
+  if( Pooled )
+    {
+    (void)ubi_cachePoolSetBudget( Pool, budget / 2 );
+    if( Pool->used > budget / 2 )
+      Errors++;
+    for( t = 0; t < Tenants; t++ )
+      ubi_cachePoolRemove( &caches[t] );
+    if( (0 != Pool->used) || (0 != Pool->reserved)
+     || (0 != ubi_dlCount( &Pool->members ))
+     || (0 != ubi_hpCount( &Pool->heap )) )
+      Errors++;
+    }
+  for( t = 0; t < Tenants; t++ )
+    (void)ubi_cacheClear( &caches[t] );
+  if( 0 != Live )
+    Errors++;
+
+  free( samples );
+  free( curves );
+  free( members );
+  free( caches );
+  return( (double)hits / (double)Requests );
+  } /* Run */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  double fixed, pooled, curves;
+  int    i;
+
+  for( i = 1; (i + 1) < argc; i += 2 )
+    {
+    if( 0 == strcmp( argv[i], "-t" ) )
+      Tenants = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-e" ) )
+      Entries = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-n" ) )
+      Requests = strtoul( argv[i+1], NULL, 0 );
+    else
+      break;
+    }
+  if( (i < argc) || (Tenants < 4) || (0 != (Tenants % 4)) || (Entries < 100)
+   || (Requests < INTERVAL) )
+    {
+    (void)fprintf( stderr, "Usage: %s [-t tenants (a multiple of 4)]"
+                           " [-e entries] [-n requests]\n", argv[0] );
+    return( EXIT_FAILURE );
+    }
+
+  (void)printf( "%lu tenants, %lu bytes each, %lu requests\n",
+                Tenants, Entries * ENTRY_SIZE, Requests );
+  Seed   = 1;
+  fixed  = Run( "fixed", 0, 0 );
+  Seed   = 1;
+  pooled = Run( "pool", 1, 0 );
+  Seed   = 1;
+  curves = Run( "pool+mrc", 1, 1 );
+  if( (pooled < fixed) || (curves < fixed) )
+    Errors++;
+
+  (void)printf( "%lu errors\n", Errors );
+  return( Errors ? EXIT_FAILURE : EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
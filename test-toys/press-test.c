@@ -0,0 +1,462 @@
+/* ========================================================================== **
+ *                                press-test.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Drive a cache's memory limit with simulated memory pressure.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  First, a scripted pressure source drives a ubi_pressMonitor, which sets
+ *  the memory limit of an LRU cache.  Between updates, a stream of random
+ *  requests refills the cache.  After each update, the cache must be
+ *  within the limit, and the limit must be between the floor and the base.
+ *  Pressure must cut the limit by no more than the shrink rate allows.
+ *  The limit may only grow after enough quiet updates, by no more than
+ *  the grow rate, and must be back at the base by the end of the script.
+ *
+ *  Then, fake PSI and cgroup v2 files are written to a temporary
+ *  directory, and read back with ubi_pressReadPSI(), ubi_pressReadCgroup()
+ *  and ubi_pressLinux().  Last, a simulated container is run: its cgroup
+ *  files are rewritten before each update, from the cache's memory and
+ *  that of "another process" that grows to most of the container's limit
+ *  and then goes away.  The container must never go over its limit, and
+ *  the cache must get all of its memory back afterward.
+ *
+ *  With -s, the real PSI and cgroup files are read once a second, and the
+ *  pressure is printed.  Nothing is checked.
+ *
+ *  Usage:
+ *    ./press-test [-e entries] [-s seconds]
+ *
+ *  Defaults: 10000 entries (of 100 bytes), and no reading of the real
+ *  files.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.            */
+#include <stdlib.h>             /* Standard C library.      */
+#include <string.h>             /* strcmp(3).               */
+#include <unistd.h>             /* sleep(3), rmdir(2).      */
+
+#include "ubi_Cache.h"          /* Cache module.            */
+#include "ubi_Pressure.h"       /* Pressure monitor.        */
+
+
+/* -------------------------------------------------------------------------- **
+ * Constants...
+ *
+ *  ENTRY_SIZE  - The size charged for each entry.
+ */
+
+#define ENTRY_SIZE  100
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Rec       - A cache entry with an integer key.
+ *  Step      - A run of updates with the same simulated pressure.
+ */
+
+typedef struct
+  {
+  ubi_cacheEntry Entry;
+  unsigned long  Key;
+  } Rec;
+
+typedef struct
+  {
+  int count;
+  int pressure;
+  } Step;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static Step Script[] =
+  {
+  { 20,   0 },          /* Fill the cache.                          */
+  {  5,  30 },          /* Some pressure...                         */
+  { 10, 100 },          /* ...then a lot, down to the floor.        */
+  {  3,   0 },          /* Not quiet for long enough to grow.       */
+  {  1,  20 },          /* A blip starts the count again.           */
+  {  5,  -1 },          /* The source can't tell; nothing changes.  */
+  { 40,   0 },          /* Back to the base.                        */
+  {  0,   0 }
+  };
+
+static unsigned long Seed     = 1;
+static unsigned long Entries  = 10000;
+static unsigned long Seconds  = 0;
+static int           Pressure = 0;
+static char          Dir[64];
+static unsigned long Live     = 0;
+static unsigned long Errors   = 0;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static unsigned long Random( void )
+  /* ------------------------------------------------------------------------ **
+   * A small LCG, returning 31 random bits.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Seed = (Seed * 6364136223846793005UL) + 1442695040888963407UL;
+  return( Seed >> 33 );
+  } /* Random */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Rec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static void FreeFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Free an entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Live--;
+  free( NodePtr );
+  } /* FreeFunc */
+
+
+static int ScriptSource( void *Context )
+  /* ------------------------------------------------------------------------ **
+   * Pressure source: whatever the script says.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( *(int *)Context );
+  } /* ScriptSource */
+
+
+static unsigned long ApplyLimit( void *Target, unsigned long Limit )
+  /* ------------------------------------------------------------------------ **
+   * Set the memory limit of a cache, and return the memory it uses.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)ubi_cacheSetMaxMemory( (ubi_cacheRootPtr)Target, Limit );
+  return( ubi_cacheGetMemUsed( (ubi_cacheRootPtr)Target ) );
+  } /* ApplyLimit */
+
+
+static void Churn( ubi_cacheRootPtr CachePtr, unsigned long Count )
+  /* ------------------------------------------------------------------------ **
+   * Send a number of random requests to the cache.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long i, key;
+  Rec          *rp;
+
+  for( i = 0; i < Count; i++ )
+    {
+    key = Random() % (Entries * 2);
+    if( NULL == ubi_cacheGet( CachePtr, &key ) )
+      {
+      rp = (Rec *)malloc( sizeof( Rec ) );
+      if( NULL == rp )
+        {
+        (void)fprintf( stderr, "Out of memory.\n" );
+        exit( EXIT_FAILURE );
+        }
+      rp->Key = key;
+      Live++;
+      ubi_cachePut( CachePtr, ENTRY_SIZE, &rp->Entry, &rp->Key );
+      }
+    }
+  } /* Churn */
+
+
+static void WriteFile( char *Name, char *Text )
+  /* ------------------------------------------------------------------------ **
+   * Write a fake pressure file into the temporary directory.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  char  path[128];
+  FILE *fp;
+
+  (void)sprintf( path, "%s/%s", Dir, Name );
+  if( (NULL == (fp = fopen( path, "w" ))) || (EOF == fputs( Text, fp )) )
+    {
+    (void)fprintf( stderr, "Cannot write %s.\n", path );
+    exit( EXIT_FAILURE );
+    }
+  (void)fclose( fp );
+  } /* WriteFile */
+
+
+static void RunScript( void )
+  /* ------------------------------------------------------------------------ **
+   * Follow the pressure script, and check the limit after each update.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot    Cache[1];
+  ubi_pressMonitor Mon[1];
+  unsigned long    base = Entries * ENTRY_SIZE;
+  unsigned long    before, from, used, least = base, bad = 0;
+  unsigned int     quiet = 0;
+  Step            *sp;
+  int              i, p;
+
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc, 0, base );
+  (void)ubi_cacheSetPolicy( Cache, ubi_cacheLRU );
+  (void)ubi_pressInit( Mon, base, ScriptSource, &Pressure, ApplyLimit, Cache );
+
+  for( sp = Script; sp->count > 0; sp++ )
+    {
+    for( i = 0; i < sp->count; i++ )
+      {
+      Churn( Cache, Entries / 2 );
+      Pressure = sp->pressure;
+      before   = ubi_pressGetLimit( Mon );
+      from     = ubi_cacheGetMemUsed( Cache );
+      if( from > before )
+        from = before;
+      p = ubi_pressUpdate( Mon );
+      used = ubi_cacheGetMemUsed( Cache );
+
+      if( (p != sp->pressure) || (used > Mon->limit)
+       || (Mon->limit < Mon->floor) || (Mon->limit > Mon->base) )
+        bad++;
+      if( p > 0 )
+        {
+        quiet = 0;
+        /* Cut, but by no more than p * shrink percent of the memory. */
+        if( (Mon->limit > from) && (Mon->limit != before) )
+          bad++;
+        if( (Mon->limit > Mon->floor) && ((double)Mon->limit + 1.0
+            < (double)from * (1.0 - ((double)p * Mon->shrink) / 10000.0)) )
+          bad++;
+        }
+      else if( 0 == p )
+        {
+        quiet++;
+        if( (Mon->limit > before)
+         && ((quiet < Mon->calm)
+          || ((Mon->limit - before) > (base * Mon->grow) / 100 + 1)) )
+          bad++;
+        }
+      else if( Mon->limit != before )
+        bad++;
+      if( Mon->limit < least )
+        least = Mon->limit;
+      }
+    (void)printf( "  %3d updates at %4d: limit %7lu, %7lu in use\n",
+                  sp->count, sp->pressure, Mon->limit,
+                  ubi_cacheGetMemUsed( Cache ) );
+    }
+  if( (Mon->limit != base) || (least != Mon->floor) )
+    bad++;
+
+  (void)ubi_cacheClear( Cache );
+  if( 0 != Live )
+    bad++;
+  Errors += bad;
+  (void)printf( "script: %lu shrinks, %lu grows, lowest %lu, %s\n",
+                Mon->shrinks, Mon->grows, least, bad ? "FAILED" : "ok" );
+  } /* RunScript */
+
+
+static void RunFiles( void )
+  /* ------------------------------------------------------------------------ **
+   * Read back fake PSI and cgroup files.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_pressFiles files[1];
+  char           psi[128];
+  unsigned long  current, limit, bad = 0;
+
+  (void)sprintf( psi, "%s/memory.pressure", Dir );
+  (void)ubi_pressInitFiles( files, psi, Dir );
+
+  /* Nothing there yet. */
+  if( (-1 != ubi_pressReadPSI( psi ))
+   || ubi_pressReadCgroup( Dir, &current, &limit )
+   || (-1 != ubi_pressLinux( files )) )
+    bad++;
+
+  WriteFile( "memory.pressure",
+             "some avg10=2.50 avg60=0.80 avg300=0.20 total=123456\n"
+             "full avg10=1.00 avg60=0.30 avg300=0.05 total=23456\n" );
+  if( (250 != ubi_pressReadPSI( psi )) || (24 != ubi_pressLinux( files )) )
+    bad++;
+
+  /* No high mark: fall back to memory.max. */
+  WriteFile( "memory.current", "950\n" );
+  WriteFile( "memory.high", "max\n" );
+  WriteFile( "memory.max", "1000\n" );
+  if( !ubi_pressReadCgroup( Dir, &current, &limit )
+   || (950 != current) || (1000 != limit)
+   || (50 != ubi_pressLinux( files )) )
+    bad++;
+
+  /* No limit at all: only PSI counts. */
+  WriteFile( "memory.max", "max\n" );
+  if( !ubi_pressReadCgroup( Dir, &current, &limit ) || (0 != limit)
+   || (24 != ubi_pressLinux( files )) )
+    bad++;
+
+  /* Over the high mark, and no stalls. */
+  WriteFile( "memory.high", "800\n" );
+  WriteFile( "memory.pressure",
+             "some avg10=0.05 avg60=0.00 avg300=0.00 total=123456\n" );
+  if( (5 != ubi_pressReadPSI( psi )) || (100 != ubi_pressLinux( files )) )
+    bad++;
+  WriteFile( "memory.current", "700\n" );
+  if( 0 != ubi_pressLinux( files ) )
+    bad++;
+
+  Errors += bad;
+  (void)printf( "files: %s\n", bad ? "FAILED" : "ok" );
+  } /* RunFiles */
+
+
+static void RunContainer( void )
+  /* ------------------------------------------------------------------------ **
+   * A cache and another process share a simulated cgroup.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot    Cache[1];
+  ubi_pressMonitor Mon[1];
+  ubi_pressFiles   files[1];
+  unsigned long    base = Entries * ENTRY_SIZE;
+  unsigned long    max  = base * 2;
+  unsigned long    other, total, peak = 0, least = base, over = 0;
+  char             text[32];
+  int              i;
+
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc, 0, base );
+  (void)ubi_cacheSetPolicy( Cache, ubi_cacheLRU );
+  (void)ubi_pressInitFiles( files, NULL, Dir );
+  (void)ubi_pressInit( Mon, base, ubi_pressLinux, files, ApplyLimit, Cache );
+  WriteFile( "memory.high", "max\n" );
+  (void)sprintf( text, "%lu\n", max );
+  WriteFile( "memory.max", text );
+
+  for( i = 0; i < 200; i++ )
+    {
+    /* The other process grows to 85% of the container, then goes. */
+    other = (i < 20) ? 0 : ((i < 60) ? ((max / 20) * 17 * (i - 19)) / 40
+                                     : ((i < 100) ? (max / 20) * 17 : 0));
+    Churn( Cache, Entries / 10 );
+    total = other + ubi_cacheGetMemUsed( Cache );
+    if( total > max )
+      over++;
+    if( total > peak )
+      peak = total;
+    (void)sprintf( text, "%lu\n", total );
+    WriteFile( "memory.current", text );
+    if( ubi_pressUpdate( Mon ) < 0 )
+      over++;
+    if( Mon->limit < least )
+      least = Mon->limit;
+    }
+  if( Mon->limit != base )
+    over++;
+
+  (void)ubi_cacheClear( Cache );
+  if( 0 != Live )
+    over++;
+  Errors += over;
+  (void)printf( "container: peak %.1f%% of the limit, cache down to %.1f%%,"
+                " %s\n", (100.0 * (double)peak) / (double)max,
+                (100.0 * (double)least) / (double)base,
+                over ? "FAILED" : "ok" );
+  } /* RunContainer */
+
+
+static void RunReal( void )
+  /* ------------------------------------------------------------------------ **
+   * Print the pressure of this system, once a second.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_pressFiles files[1];
+  unsigned long  current, limit, s;
+
+  (void)ubi_pressInitFiles( files, ubi_pressPSI_MEMORY, ubi_pressCGROUP_ROOT );
+  for( s = 0; s < Seconds; s++ )
+    {
+    if( !ubi_pressReadCgroup( ubi_pressCGROUP_ROOT, &current, &limit ) )
+      current = limit = 0;
+    (void)printf( "pressure %3d   psi %5ld   cgroup %lu of %lu\n",
+                  ubi_pressLinux( files ),
+                  ubi_pressReadPSI( ubi_pressPSI_MEMORY ), current, limit );
+    (void)fflush( stdout );
+    if( (s + 1) < Seconds )
+      (void)sleep( 1 );
+    }
+  } /* RunReal */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  static char *names[] =
+    { "memory.pressure", "memory.current", "memory.high", "memory.max", NULL };
+  char         path[128];
+  int          i;
+
+  for( i = 1; (i + 1) < argc; i += 2 )
+    {
+    if( 0 == strcmp( argv[i], "-e" ) )
+      Entries = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-s" ) )
+      Seconds = strtoul( argv[i+1], NULL, 0 );
+    else
+      break;
+    }
+  if( (i < argc) || (Entries < 1000) )
+    {
+    (void)fprintf( stderr, "Usage: %s [-e entries] [-s seconds]\n", argv[0] );
+    return( EXIT_FAILURE );
+    }
+
+  (void)strcpy( Dir, "/tmp/press-test.XXXXXX" );
+  if( NULL == mkdtemp( Dir ) )
+    {
+    (void)fprintf( stderr, "Cannot create a temporary directory.\n" );
+    return( EXIT_FAILURE );
+    }
+
+  RunScript();
+  RunFiles();
+  RunContainer();
+  for( i = 0; NULL != names[i]; i++ )
+    {
+    (void)sprintf( path, "%s/%s", Dir, names[i] );
+    (void)remove( path );
+    }
+  (void)rmdir( Dir );
+  RunReal();
+
+  (void)printf( "%lu errors\n", Errors );
+  return( Errors ? EXIT_FAILURE : EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
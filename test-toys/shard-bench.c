@@ -0,0 +1,278 @@
+/* ========================================================================== **
+ *                               shard-bench.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Measure lock contention on a shared cache.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  Several threads hammer one shard cache with lookups of random keys.
+ *  Each miss is followed by a put of the missing key.  The run is repeated
+ *  for a range of thread counts, first with a single shard (i.e., one
+ *  cache behind one lock) and then with many shards.  Total throughput
+ *  (wall clock) is reported for each combination.
+ *
+ *  With one shard, throughput should stay flat (or drop) as threads are
+ *  added.  With many shards, it should grow with the number of threads,
+ *  up to the number of CPUs available.
+ *
+ *  Usage:
+ *    ./shard-bench [-t maxthreads] [-s shards] [-n ops] [-k keys]
+ *                  [-c capacity]
+ *
+ *  Defaults: up to 32 threads, 64 shards, 200000 operations per thread,
+ *  100000 keys and a capacity of 50000 entries.
+ *
+ *  Compile with -pthread.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.            */
+#include <stdlib.h>             /* Standard C library.      */
+#include <string.h>             /* strcmp(3).               */
+#include <time.h>               /* clock_gettime(2).        */
+#include <pthread.h>            /* POSIX threads.           */
+
+#include "ubi_ShardCache.h"     /* Sharded cache.           */
+
+
+/* -------------------------------------------------------------------------- **
+ * Defines...
+ */
+
+#define MAX_THREADS 256
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Rec       - A cache entry with an integer key and a value.
+ */
+
+typedef struct
+  {
+  ubi_cacheEntry Entry;
+  unsigned long  Key;
+  unsigned long  Value;
+  } Rec;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static ubi_shardCache  Cache[1];
+static unsigned long   Ops  = 200000;
+static unsigned long   Keys = 100000;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static void Lock( void *LockPtr )
+  /* ------------------------------------------------------------------------ **
+   * Shard lock function.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)pthread_mutex_lock( (pthread_mutex_t *)LockPtr );
+  } /* Lock */
+
+
+static void Unlock( void *LockPtr )
+  /* ------------------------------------------------------------------------ **
+   * Shard unlock function.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)pthread_mutex_unlock( (pthread_mutex_t *)LockPtr );
+  } /* Unlock */
+
+
+static unsigned long HashFunc( ubi_trItemPtr ItemPtr )
+  /* ------------------------------------------------------------------------ **
+   * The keys are already random, so they are their own hash.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( *(unsigned long *)ItemPtr );
+  } /* HashFunc */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Rec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static void FreeFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Free an evicted entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  free( NodePtr );
+  } /* FreeFunc */
+
+
+static void CopyOut( ubi_trNodePtr NodePtr, void *UserData )
+  /* ------------------------------------------------------------------------ **
+   * Copy the value out of a cache entry, while its shard is locked.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  *(unsigned long *)UserData = ((Rec *)NodePtr)->Value;
+  } /* CopyOut */
+
+
+static void *Worker( void *arg )
+  /* ------------------------------------------------------------------------ **
+   * Worker thread: look up random keys, and fill in the misses.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long seed = 1 + (unsigned long)arg;
+  unsigned long i, key, value;
+  Rec          *rp;
+
+  for( i = 0; i < Ops; i++ )
+    {
+    seed = (seed * 6364136223846793005UL) + 1442695040888963407UL;
+    key  = ((seed >> 33) % Keys) * 2654435761UL;
+    if( !ubi_shardGet( Cache, &key, CopyOut, &value ) )
+      {
+      rp = (Rec *)malloc( sizeof( Rec ) );
+      if( NULL == rp )
+        break;
+      rp->Key   = key;
+      rp->Value = ~key;
+      ubi_shardPut( Cache, sizeof( Rec ), &rp->Entry, &rp->Key );
+      }
+    else if( value != ~key )
+      (void)fprintf( stderr, "Bad value for key %lu.\n", key );
+    }
+  return( NULL );
+  } /* Worker */
+
+
+static double Run( ubi_shardPtr     shards,
+                   pthread_mutex_t *locks,
+                   unsigned int     nshards,
+                   int              nthreads,
+                   unsigned long    capacity,
+                   unsigned long   *hits )
+  /* ------------------------------------------------------------------------ **
+   * Run one combination of shard and thread counts.
+   * Returns the throughput in millions of operations per second.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  pthread_t       tid[MAX_THREADS];
+  struct timespec start, stop;
+  ubi_shardStats  stats;
+  double          secs;
+  int             t;
+
+  (void)ubi_shardInit( Cache, shards, nshards, HashFunc, CompareFunc,
+                       FreeFunc, capacity, 0 );
+  ubi_shardSetLocks( Cache, Lock, Unlock, locks, sizeof( pthread_mutex_t ) );
+
+  (void)clock_gettime( CLOCK_MONOTONIC, &start );
+  for( t = 0; t < nthreads; t++ )
+    (void)pthread_create( &tid[t], NULL, Worker, (void *)(long)t );
+  for( t = 0; t < nthreads; t++ )
+    (void)pthread_join( tid[t], NULL );
+  (void)clock_gettime( CLOCK_MONOTONIC, &stop );
+
+  ubi_shardGetStats( Cache, &stats );
+  *hits = stats.lookups ? ((100 * stats.hits) / stats.lookups) : 0;
+  ubi_shardClear( Cache );
+
+  secs = (double)(stop.tv_sec - start.tv_sec)
+       + ((double)(stop.tv_nsec - start.tv_nsec) / 1e9);
+  return( ((double)Ops * (double)nthreads) / (secs * 1e6) );
+  } /* Run */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_shardPtr     shards;
+  pthread_mutex_t *locks;
+  unsigned long    capacity   = 50000;
+  unsigned long    hits;
+  unsigned int     nshards    = 64;
+  unsigned int     s;
+  int              maxthreads = 32;
+  int              t, i;
+  double           mops, base;
+
+  for( i = 1; (i + 1) < argc; i += 2 )
+    {
+    if( 0 == strcmp( argv[i], "-t" ) )
+      maxthreads = atoi( argv[i+1] );
+    else if( 0 == strcmp( argv[i], "-s" ) )
+      nshards = (unsigned int)strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-n" ) )
+      Ops = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-k" ) )
+      Keys = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-c" ) )
+      capacity = strtoul( argv[i+1], NULL, 0 );
+    else
+      break;
+    }
+  if( (i < argc) || (maxthreads < 1) || (maxthreads > MAX_THREADS)
+   || (nshards < 1) || (Keys < 1) )
+    {
+    (void)fprintf( stderr, "Usage: %s [-t maxthreads] [-s shards] [-n ops] "
+                           "[-k keys] [-c capacity]\n", argv[0] );
+    return( EXIT_FAILURE );
+    }
+
+  shards = (ubi_shard *)malloc( nshards * sizeof( ubi_shard ) );
+  locks  = (pthread_mutex_t *)malloc( nshards * sizeof( pthread_mutex_t ) );
+  if( (NULL == shards) || (NULL == locks) )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    return( EXIT_FAILURE );
+    }
+  for( s = 0; s < nshards; s++ )
+    (void)pthread_mutex_init( &locks[s], NULL );
+
+  (void)printf( "%lu keys, capacity %lu, %lu ops per thread\n",
+                Keys, capacity, Ops );
+  (void)printf( "shards threads   Mops/s  speedup  hits\n" );
+  for( s = 1; s <= nshards; s = (s == nshards) ? s + 1 : nshards )
+    {
+    base = 0.0;
+    for( t = 1; t <= maxthreads; t *= 2 )
+      {
+      mops = Run( shards, locks, s, t, capacity, &hits );
+      if( 1 == t )
+        base = mops;
+      (void)printf( "%6u %7d %8.2f %7.2fx %4lu%%\n",
+                    s, t, mops, mops / base, hits );
+      }
+    }
+
+  for( s = 0; s < nshards; s++ )
+    (void)pthread_mutex_destroy( &locks[s] );
+  free( locks );
+  free( shards );
+  return( EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
@@ -0,0 +1,527 @@
+/* ========================================================================== **
+ *                                 shm-test.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Share one shard cache among several worker processes.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  A shard cache, its locks, hash buckets and entries are all placed in a
+ *  shared mapping, which is made before the workers are forked.  The locks
+ *  are robust, process-shared mutexes.
+ *
+ *  First, the workers replay a skewed stream of requests against the one
+ *  shared cache.  Each miss allocates an entry from the shared slab pools
+ *  and puts it.  Every hit checks the data in the entry.  Then the same
+ *  is done with a private cache in each worker, with the memory divided
+ *  evenly among them.  The hit ratios of the two are printed.  The shared
+ *  cache should do better, since a key loaded by one worker is a hit for
+ *  all of them, and no key is cached twice.
+ *
+ *  Then a worker checks that it can see entries put by the parent, and
+ *  exits while holding the lock of one of the shards.  The parent must
+ *  be able to take the lock, must find that shard emptied, and must find
+ *  all of the other entries intact.  An entry allocated before a shard is
+ *  recovered must not be put, whether by ubi_shardPut() or by a loader
+ *  called from ubi_shardGetOrLoad().
+ *
+ *  Usage:
+ *    ./shm-test [-w workers] [-k keys] [-m megabytes] [-n requests]
+ *
+ *  Defaults: 4 workers, 200000 keys, 16MB of entries, and 500000 requests
+ *  per worker.
+ *
+ *  Compile with -pthread.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.            */
+#include <stdlib.h>             /* Standard C library.      */
+#include <string.h>             /* strcmp(3).               */
+#include <errno.h>              /* EOWNERDEAD.              */
+#include <unistd.h>             /* fork(2).                 */
+#include <pthread.h>            /* POSIX threads.           */
+#include <sys/mman.h>           /* mmap(2).                 */
+#include <sys/wait.h>           /* waitpid(2).              */
+
+#include "ubi_ShardCache.h"     /* Sharded cache.           */
+
+
+/* -------------------------------------------------------------------------- **
+ * Defines...
+ *
+ *  SHARDS      - The number of shards.
+ *  BUCKETS     - Hash buckets per shard.
+ *  PAGE_SIZE   - The slab page size.
+ *  MAX_WORKERS - The most worker processes.
+ *  CHECKED     - Entries put by the parent for the crash test.
+ */
+
+#define SHARDS      16
+#define BUCKETS     4093
+#define PAGE_SIZE   16384
+#define MAX_WORKERS 64
+#define CHECKED     1000
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Rec       - A cache entry with an integer key and some data.
+ *  Shared    - The start of the shared mapping.  The slab arena follows.
+ *  Results   - Counters filled in by the workers.
+ */
+
+typedef struct
+  {
+  ubi_cacheEntry Entry;
+  unsigned long  Key;
+  unsigned long  Check;
+  unsigned long  Len;
+  unsigned char  Data[1];
+  } Rec;
+
+typedef struct
+  {
+  ubi_shardCache  sc;
+  ubi_shard       shards[SHARDS];
+  pthread_mutex_t locks[SHARDS];
+  unsigned long   recovered[SHARDS];
+  ubi_btNodePtr   buckets[SHARDS][BUCKETS];
+  } Shared;
+
+typedef struct
+  {
+  unsigned long lookups[MAX_WORKERS];
+  unsigned long hits[MAX_WORKERS];
+  unsigned long errors[MAX_WORKERS];
+  } Results;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static Shared        *Shm;
+static Results       *Res;
+static size_t         ShmSize;
+static unsigned long  Seed     = 1;
+static unsigned long  Workers  = 4;
+static unsigned long  Keys     = 200000;
+static unsigned long  Megs     = 16;
+static unsigned long  Requests = 500000;
+static unsigned long  Errors   = 0;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static unsigned long Random( void )
+  /* ------------------------------------------------------------------------ **
+   * A small LCG, returning 31 random bits.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Seed = (Seed * 6364136223846793005UL) + 1442695040888963407UL;
+  return( Seed >> 33 );
+  } /* Random */
+
+
+static unsigned long Scramble( unsigned long k )
+  /* ------------------------------------------------------------------------ **
+   * Mix the bits of a key, so that keys do not arrive in sorted order.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  k ^= k >> 33;
+  k *= 0xFF51AFD7ED558CCDUL;
+  k ^= k >> 33;
+  return( k );
+  } /* Scramble */
+
+
+static void *Map( size_t Size )
+  /* ------------------------------------------------------------------------ **
+   * Map shared, anonymous memory.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  void *p = mmap( NULL, Size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+
+  if( MAP_FAILED == p )
+    {
+    perror( "mmap" );
+    exit( EXIT_FAILURE );
+    }
+  return( p );
+  } /* Map */
+
+
+static void Lock( void *LockPtr )
+  /* ------------------------------------------------------------------------ **
+   * Shard lock function.  If the last holder died, recover the shard.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  pthread_mutex_t *mp = (pthread_mutex_t *)LockPtr;
+  unsigned int     i  = (unsigned int)(mp - Shm->locks);
+
+  if( EOWNERDEAD == pthread_mutex_lock( mp ) )
+    {
+    (void)pthread_mutex_consistent( mp );
+    ubi_shardRecover( &Shm->sc, i );
+    Shm->recovered[i]++;
+    }
+  } /* Lock */
+
+
+static void Unlock( void *LockPtr )
+  /* ------------------------------------------------------------------------ **
+   * Shard unlock function.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)pthread_mutex_unlock( (pthread_mutex_t *)LockPtr );
+  } /* Unlock */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Rec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static unsigned long HashFunc( ubi_trItemPtr ItemPtr )
+  /* ------------------------------------------------------------------------ **
+   * Hash an integer key.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( *(unsigned long *)ItemPtr * 0x9E3779B97F4A7C15UL );
+  } /* HashFunc */
+
+
+static void Setup( unsigned long ArenaSize )
+  /* ------------------------------------------------------------------------ **
+   * Map a shard cache, with ArenaSize bytes for its entries.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  pthread_mutexattr_t attr;
+  size_t              head;
+  unsigned int        i;
+
+  head    = (sizeof( Shared ) + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+  ShmSize = head + ArenaSize;
+  Shm     = (Shared *)Map( ShmSize );
+
+  (void)pthread_mutexattr_init( &attr );
+  (void)pthread_mutexattr_setpshared( &attr, PTHREAD_PROCESS_SHARED );
+  (void)pthread_mutexattr_setrobust( &attr, PTHREAD_MUTEX_ROBUST );
+  for( i = 0; i < SHARDS; i++ )
+    (void)pthread_mutex_init( &Shm->locks[i], &attr );
+  (void)pthread_mutexattr_destroy( &attr );
+
+  (void)ubi_shardInit( &Shm->sc, Shm->shards, SHARDS, HashFunc, CompareFunc,
+                       NULL, 0, 0 );
+  if( !ubi_shardSetSlabs( &Shm->sc, (char *)Shm + head, ArenaSize,
+                          PAGE_SIZE, 125 ) )
+    Errors++;
+  for( i = 0; i < SHARDS; i++ )
+    if( !ubi_cacheSetIndex( &Shm->shards[i].cache, ubi_cacheINDEX_HASH,
+                            Shm->buckets[i], BUCKETS ) )
+      Errors++;
+  ubi_shardSetLocks( &Shm->sc, Lock, Unlock, Shm->locks,
+                     sizeof( pthread_mutex_t ) );
+  } /* Setup */
+
+
+static void CopyOut( ubi_trNodePtr NodePtr, void *UserData )
+  /* ------------------------------------------------------------------------ **
+   * Check the data in an entry that was found.  (A real program would copy
+   * it out, while the shard is locked.)
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Rec          *rp = (Rec *)NodePtr;
+  unsigned long i;
+
+  if( rp->Check != ~rp->Key )
+    (*(unsigned long *)UserData)++;
+  for( i = 0; i < rp->Len; i++ )
+    if( rp->Data[i] != (unsigned char)(rp->Key + i) )
+      {
+      (*(unsigned long *)UserData)++;
+      break;
+      }
+  } /* CopyOut */
+
+
+static ubi_trBool Put( unsigned long Key )
+  /* ------------------------------------------------------------------------ **
+   * Allocate, fill in and put an entry.  Return FALSE if there was no room.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long len  = 100 + (Key % 300);
+  unsigned long size = offsetof( Rec, Data ) + len;
+  unsigned long i;
+  Rec          *rp;
+
+  rp = (Rec *)ubi_shardAlloc( &Shm->sc, &Key, size );
+  if( NULL == rp )
+    return( ubi_trFALSE );
+  rp->Key   = Key;
+  rp->Check = ~Key;
+  rp->Len   = len;
+  for( i = 0; i < len; i++ )
+    rp->Data[i] = (unsigned char)(Key + i);
+  ubi_shardPut( &Shm->sc, size, &rp->Entry, &rp->Key );
+  return( ubi_trTRUE );
+  } /* Put */
+
+
+static ubi_cacheEntryPtr StaleLoad( ubi_trItemPtr Key, void *Context )
+  /* ------------------------------------------------------------------------ **
+   * A loader during whose load the shard is recovered, as it would be if
+   * another worker died holding the lock.  Context points to the index of
+   * the key's shard.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned int  victim = *(unsigned int *)Context;
+  unsigned long key    = *(unsigned long *)Key;
+  Rec          *rp;
+
+  rp = (Rec *)ubi_shardAlloc( &Shm->sc, Key, sizeof( Rec ) );
+  Lock( Shm->shards[victim].lock );
+  ubi_shardRecover( &Shm->sc, victim );
+  Unlock( Shm->shards[victim].lock );
+  if( NULL == rp )
+    return( NULL );
+  rp->Key   = key;
+  rp->Check = ~key;
+  rp->Len   = 0;
+  rp->Entry.entry_size = sizeof( Rec );
+  return( &rp->Entry );
+  } /* StaleLoad */
+
+
+static void Worker( unsigned long w )
+  /* ------------------------------------------------------------------------ **
+   * Replay one worker's requests.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long i, key;
+
+  Seed = w + 1;
+  for( i = 0; i < Requests; i++ )
+    {
+    key = Scramble( Random() % ((Random() % Keys) + 1) );
+    Res->lookups[w]++;
+    if( ubi_shardGet( &Shm->sc, &key, CopyOut, &Res->errors[w] ) )
+      Res->hits[w]++;
+    else
+      (void)Put( key );
+    }
+  } /* Worker */
+
+
+static void Wait( pid_t Pid )
+  /* ------------------------------------------------------------------------ **
+   * Wait for a worker, which must exit successfully.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  int status;
+
+  if( (Pid != waitpid( Pid, &status, 0 ))
+   || !WIFEXITED( status ) || (0 != WEXITSTATUS( status )) )
+    Errors++;
+  } /* Wait */
+
+
+static void Run( char *Name, int Together )
+  /* ------------------------------------------------------------------------ **
+   * Run the workers, with one shared cache or a cache each.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  pid_t           pids[MAX_WORKERS];
+  ubi_shardStats  stats;
+  unsigned long   w, hits = 0, lookups = 0;
+
+  (void)memset( Res, 0, sizeof( Results ) );
+  if( Together )
+    Setup( Megs << 20 );
+  for( w = 0; w < Workers; w++ )
+    {
+    pids[w] = fork();
+    if( 0 == pids[w] )
+      {
+      if( !Together )
+        Setup( (Megs << 20) / Workers );
+      Worker( w );
+      _exit( Errors ? EXIT_FAILURE : EXIT_SUCCESS );
+      }
+    if( pids[w] < 0 )
+      {
+      perror( "fork" );
+      exit( EXIT_FAILURE );
+      }
+    }
+  for( w = 0; w < Workers; w++ )
+    {
+    Wait( pids[w] );
+    hits    += Res->hits[w];
+    lookups += Res->lookups[w];
+    Errors  += Res->errors[w];
+    }
+  (void)printf( "%-8s %6.2f%% hits", Name,
+                (100.0 * (double)hits) / (double)lookups );
+  if( Together )
+    {
+    ubi_shardGetStats( &Shm->sc, &stats );
+    (void)printf( ", %lu entries in %lu bytes", stats.entries,
+                  stats.mem_used );
+    if( stats.hits != hits )
+      Errors++;
+    (void)munmap( (void *)Shm, ShmSize );
+    }
+  (void)printf( "\n" );
+  } /* Run */
+
+
+static void Crash( void )
+  /* ------------------------------------------------------------------------ **
+   * Let a worker die while it holds a shard's lock, and recover.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long key, i, lost = 0, kept = 0, errs = 0;
+  unsigned int  victim;
+  pid_t         pid;
+  Rec          *rp;
+
+  Setup( Megs << 20 );
+  for( i = 0; i < CHECKED; i++ )
+    if( !Put( Scramble( i ) ) )
+      Errors++;
+  key    = Scramble( 0 );
+  victim = ubi_shardIndex( &Shm->sc, &key );
+
+  pid = fork();
+  if( 0 == pid )
+    {
+    for( i = 0; i < CHECKED; i++ )
+      {
+      key = Scramble( i );
+      if( !ubi_shardGet( &Shm->sc, &key, CopyOut, &Res->errors[0] ) )
+        Res->errors[0]++;
+      }
+    Lock( Shm->shards[victim].lock );
+    _exit( EXIT_SUCCESS );
+    }
+  Res->errors[0] = 0;
+  Wait( pid );
+  Errors += Res->errors[0];
+
+  /* Only the entries in the victim's shard should be gone. */
+  for( i = 0; i < CHECKED; i++ )
+    {
+    key = Scramble( i );
+    if( ubi_shardGet( &Shm->sc, &key, CopyOut, &errs ) )
+      kept++;
+    else if( ubi_shardIndex( &Shm->sc, &key ) == victim )
+      lost++;
+    else
+      Errors++;
+    }
+  key = Scramble( 0 );
+  if( (1 != Shm->recovered[victim]) || (0 == lost) || (kept + lost != CHECKED)
+   || !Put( key ) || !ubi_shardGet( &Shm->sc, &key, NULL, NULL ) )
+    Errors++;
+
+  /* An entry allocated before a recovery must not get in. */
+  (void)ubi_shardDelete( &Shm->sc, &key );
+  rp  = (Rec *)ubi_shardAlloc( &Shm->sc, &key, sizeof( Rec ) );
+  Lock( Shm->shards[victim].lock );
+  ubi_shardRecover( &Shm->sc, victim );
+  Unlock( Shm->shards[victim].lock );
+  if( rp )
+    {
+    rp->Key   = key;
+    rp->Check = ~key;
+    rp->Len   = 0;
+    ubi_shardPut( &Shm->sc, sizeof( Rec ), &rp->Entry, &rp->Key );
+    }
+  if( (NULL == rp) || ubi_shardGet( &Shm->sc, &key, NULL, NULL )
+   || (0 != ubi_cacheGetEntryCount( &Shm->shards[victim].cache )) )
+    Errors++;
+
+  /* Nor may one that a loader allocated before a recovery. */
+  if( ubi_shardGetOrLoad( &Shm->sc, &key, StaleLoad, &victim, NULL, NULL )
+   || ubi_shardGet( &Shm->sc, &key, NULL, NULL )
+   || (0 != ubi_cacheGetEntryCount( &Shm->shards[victim].cache )) )
+    Errors++;
+
+  Errors += errs;
+  (void)printf( "crash: %lu of %lu entries lost with shard %u, %lu kept\n",
+                lost, (unsigned long)CHECKED, victim, kept );
+  ubi_shardClear( &Shm->sc );
+  (void)munmap( (void *)Shm, ShmSize );
+  } /* Crash */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  int i;
+
+  for( i = 1; (i + 1) < argc; i += 2 )
+    {
+    if( 0 == strcmp( argv[i], "-w" ) )
+      Workers = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-k" ) )
+      Keys = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-m" ) )
+      Megs = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-n" ) )
+      Requests = strtoul( argv[i+1], NULL, 0 );
+    else
+      break;
+    }
+  if( (i < argc) || (Workers < 1) || (Workers > MAX_WORKERS) || (Keys < 1)
+   || (Megs < Workers) || (Requests < 1) )
+    {
+    (void)fprintf( stderr, "Usage: %s [-w workers] [-k keys] [-m megabytes]"
+                           " [-n requests]\n", argv[0] );
+    return( EXIT_FAILURE );
+    }
+
+  Res = (Results *)Map( sizeof( Results ) );
+  (void)printf( "%lu workers, %lu keys, %luMB, %lu requests each\n",
+                Workers, Keys, Megs, Requests );
+  Run( "shared", 1 );
+  Run( "private", 0 );
+  Crash();
+
+  (void)printf( "%lu errors\n", Errors );
+  return( Errors ? EXIT_FAILURE : EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
@@ -0,0 +1,378 @@
+/* ========================================================================== **
+ *                                slab-test.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Check the slab allocator, and compare a cache that keeps
+ *              its entries in a slab pool with one that uses malloc().
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  The program runs in three parts.
+ *
+ *  The first part is a consistency check.  Chunks of random size are
+ *  allocated and freed, and each one is filled with a pattern that is
+ *  checked when it is freed.  The per-class counts must match what was
+ *  allocated.  Then the pool is filled with small chunks, and
+ *  ubi_slabRebalance() must be able to move a page to a larger class.
+ *
+ *  The second part puts entries of random size (a Rec plus up to 4K) into
+ *  a full cache, allocating them either with malloc() or with
+ *  ubi_cacheAlloc().  The time per put is reported.  For the slab cache,
+ *  the memory held in pages and the fragmentation are reported too.
+ *
+ *  The third part fills a slab cache with small entries, and then puts
+ *  only large ones.  Without rebalancing, the large entries can't get any
+ *  pages.  With ubi_cacheRebalance() called every 1000 puts, the pages
+ *  move over.
+ *
+ *  Usage:
+ *    ./slab-test [-n puts] [-m memory]
+ *
+ *  Defaults: 1000000 puts, and 64MB of memory.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.            */
+#include <stdlib.h>             /* Standard C library.      */
+#include <string.h>             /* memset(3), strcmp(3).    */
+#include <time.h>               /* clock(3).                */
+
+#include "ubi_Cache.h"          /* Cache module.            */
+
+
+/* -------------------------------------------------------------------------- **
+ * Defines...
+ */
+
+#define PAGE_SIZE (64 * 1024)
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Rec       - A cache entry with an integer key.  The data follows.
+ */
+
+typedef struct
+  {
+  ubi_cacheEntry Entry;
+  unsigned long  Key;
+  } Rec;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static ubi_slabPool  Pool[1];
+static unsigned long Seed = 1;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static unsigned long Random( void )
+  /* ------------------------------------------------------------------------ **
+   * A small LCG, returning 31 random bits.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Seed = (Seed * 6364136223846793005UL) + 1442695040888963407UL;
+  return( Seed >> 33 );
+  } /* Random */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Rec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static void FreeFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Free a malloc()ed entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  free( NodePtr );
+  } /* FreeFunc */
+
+
+static void SlabFreeFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Free an entry allocated from the slab pool.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_slabFree( Pool, NodePtr );
+  } /* SlabFreeFunc */
+
+
+static void EvictFunc( void *UserData, void *Ptr )
+  /* ------------------------------------------------------------------------ **
+   * Rebalance callback for the consistency check: just free the chunk.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (*(unsigned long *)UserData)++;
+  ubi_slabFree( Pool, Ptr );
+  } /* EvictFunc */
+
+
+static int Check( void )
+  /* ------------------------------------------------------------------------ **
+   * Consistency check.  Returns the number of errors found.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long  n = 4096;
+  unsigned long  arena = 4 * 1024 * 1024;
+  unsigned char *mem;
+  unsigned char **ptrs;
+  unsigned long *sizes;
+  unsigned long  i, k, used, requested, evicted = 0;
+  int            c, big, errs = 0;
+
+  mem   = (unsigned char *)malloc( arena );
+  ptrs  = (unsigned char **)calloc( n, sizeof( unsigned char * ) );
+  sizes = (unsigned long *)calloc( n, sizeof( unsigned long ) );
+  if( (NULL == mem) || (NULL == ptrs) || (NULL == sizes)
+   || (NULL == ubi_slabInit( Pool, mem, arena, PAGE_SIZE, 125 )) )
+    return( 1 );
+
+  for( i = 0; i < 200000; i++ )
+    {
+    k = Random() % n;
+    if( ptrs[k] )
+      {
+      /* Check the pattern, then free. */
+      for( c = 0; (unsigned long)c < sizes[k]; c++ )
+        {
+        if( ptrs[k][c] != (unsigned char)(k + c) )
+          {
+          errs++;
+          break;
+          }
+        }
+      ubi_slabFree( Pool, ptrs[k] );
+      ptrs[k] = NULL;
+      }
+    else
+      {
+      sizes[k] = 1 + (Random() % ((Random() & 1) ? 256 : 8192));
+      ptrs[k]  = (unsigned char *)ubi_slabAlloc( Pool, sizes[k] );
+      if( NULL == ptrs[k] )
+        continue;
+      if( ubi_slabChunkSize( Pool, ptrs[k] ) < sizes[k] )
+        errs++;
+      for( c = 0; (unsigned long)c < sizes[k]; c++ )
+        ptrs[k][c] = (unsigned char)(k + c);
+      }
+    }
+
+  /* The class counts must add up. */
+  for( used = requested = k = 0; k < n; k++ )
+    {
+    if( ptrs[k] )
+      {
+      used++;
+      requested += sizes[k];
+      }
+    }
+  for( c = 0; c < Pool->class_count; c++ )
+    {
+    used      -= Pool->classes[c].used;
+    requested -= Pool->classes[c].requested;
+    }
+  if( used || requested )
+    errs++;
+  (void)printf( "check: %d classes, %lu of %lu pages used, "
+                "%d%% fragmentation\n", Pool->class_count,
+                Pool->pages_used, Pool->page_count,
+                ubi_slabFragmentation( Pool ) );
+
+  for( k = 0; k < n; k++ )
+    ubi_slabFree( Pool, ptrs[k] );
+  for( c = 0; c < Pool->class_count; c++ )
+    {
+    if( Pool->classes[c].used || Pool->classes[c].requested
+     || ubi_dlCount( &Pool->classes[c].lru ) )
+      errs++;
+    }
+
+  /* Fill the pool with small live chunks, then ask for a big one. */
+  (void)ubi_slabInit( Pool, mem, arena, PAGE_SIZE, 125 );
+  while( NULL != (ptrs[0] = ubi_slabAlloc( Pool, 100 )) )
+    ubi_slabLink( Pool, ptrs[0] );
+  big = ubi_slabClassOf( Pool, 5000 );
+  if( (NULL != ubi_slabAlloc( Pool, 5000 ))
+   || (NULL != ubi_slabVictim( Pool, 5000 )) )
+    errs++;
+  if( !ubi_slabRebalance( Pool, EvictFunc, &evicted )
+   || (1 != Pool->classes[big].pages)
+   || (evicted != Pool->classes[ubi_slabClassOf( Pool, 100 )].per_page)
+   || (NULL == ubi_slabAlloc( Pool, 5000 )) )
+    errs++;
+  (void)printf( "check: rebalance evicted %lu chunks, %d errors\n",
+                evicted, errs );
+
+  free( sizes );
+  free( ptrs );
+  free( mem );
+  return( errs );
+  } /* Check */
+
+
+static double Bench( unsigned long count, unsigned long memory, int slab )
+  /* ------------------------------------------------------------------------ **
+   * Keep a full cache topped up with entries of random size.  Return the
+   * average time per put, in nanoseconds.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot Cache[1];
+  void         *mem = NULL;
+  Rec          *rp;
+  unsigned long i, size, failed = 0;
+  clock_t       start;
+  double        secs;
+
+  (void)ubi_cacheInit( Cache, CompareFunc, slab ? SlabFreeFunc : FreeFunc,
+                       0, memory );
+  if( slab )
+    {
+    mem = malloc( memory );
+    if( (NULL == mem)
+     || (NULL == ubi_slabInit( Pool, mem, memory, PAGE_SIZE, 125 )) )
+      {
+      (void)fprintf( stderr, "Out of memory.\n" );
+      exit( EXIT_FAILURE );
+      }
+    (void)ubi_cacheSetSlab( Cache, Pool );
+    }
+
+  start = clock();
+  for( i = 0; i < (count * 2); i++ )
+    {
+    /* The first half fills the cache; only the second half is timed. */
+    if( i == count )
+      start = clock();
+    size = sizeof( Rec ) + (Random() % 4033);
+    rp   = slab ? (Rec *)ubi_cacheAlloc( Cache, size )
+                : (Rec *)malloc( size );
+    if( NULL == rp )
+      {
+      failed++;
+      continue;
+      }
+    rp->Key = (Random() << 31) ^ Random();
+    ubi_cachePut( Cache, size, &rp->Entry, &rp->Key );
+    }
+  secs = (double)(clock() - start) / (double)CLOCKS_PER_SEC;
+
+  (void)printf( "%-6s %7.1f ns/put  %7lu entries  mem_used %9lu",
+                slab ? "slab" : "malloc", (1e9 * secs) / (double)count,
+                ubi_cacheGetEntryCount( Cache ), ubi_cacheGetMemUsed( Cache ) );
+  if( slab )
+    (void)printf( "  pages %9lu  frag %2d%%  failed %lu",
+                  ubi_slabBytesUsed( Pool ), ubi_slabFragmentation( Pool ),
+                  failed );
+  (void)printf( "\n" );
+  (void)ubi_cacheClear( Cache );
+  free( mem );
+  return( (1e9 * secs) / (double)count );
+  } /* Bench */
+
+
+static void Shift( unsigned long count, unsigned long memory, int rebalance )
+  /* ------------------------------------------------------------------------ **
+   * Fill a slab cache with small entries, then put large ones.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot Cache[1];
+  void         *mem;
+  Rec          *rp;
+  unsigned long i, size, failed = 0, moved = 0;
+
+  mem = malloc( memory );
+  if( (NULL == mem)
+   || (NULL == ubi_slabInit( Pool, mem, memory, PAGE_SIZE, 125 )) )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    exit( EXIT_FAILURE );
+    }
+  (void)ubi_cacheInit( Cache, CompareFunc, SlabFreeFunc, 0, 0 );
+  (void)ubi_cacheSetSlab( Cache, Pool );
+
+  for( i = 0; i < (count * 2); i++ )
+    {
+    size = sizeof( Rec ) + ((i < count) ? (Random() % 193)
+                                        : (2048 + (Random() % 2049)));
+    if( rebalance && (0 == (i % 1000)) && ubi_cacheRebalance( Cache ) )
+      moved++;
+    rp = (Rec *)ubi_cacheAlloc( Cache, size );
+    if( NULL == rp )
+      {
+      failed++;
+      continue;
+      }
+    rp->Key = (Random() << 31) ^ Random();
+    ubi_cachePut( Cache, size, &rp->Entry, &rp->Key );
+    }
+
+  (void)printf( "%-12s %7lu entries  %7lu failed puts  %5lu pages moved  "
+                "frag %2d%%\n", rebalance ? "rebalance" : "no rebalance",
+                ubi_cacheGetEntryCount( Cache ), failed, moved,
+                ubi_slabFragmentation( Pool ) );
+  (void)ubi_cacheClear( Cache );
+  free( mem );
+  } /* Shift */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long count  = 1000000;
+  unsigned long memory = 64 * 1024 * 1024;
+  int           i;
+
+  for( i = 1; (i + 1) < argc; i += 2 )
+    {
+    if( 0 == strcmp( argv[i], "-n" ) )
+      count = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-m" ) )
+      memory = strtoul( argv[i+1], NULL, 0 );
+    else
+      break;
+    }
+  if( (i < argc) || (count < 1) || (memory < (1024 * 1024)) )
+    {
+    (void)fprintf( stderr, "Usage: %s [-n puts] [-m memory]\n", argv[0] );
+    return( EXIT_FAILURE );
+    }
+
+  if( Check() )
+    return( EXIT_FAILURE );
+
+  (void)printf( "%lu puts, memory limit %lu\n", count, memory );
+  (void)Bench( count, memory, 0 );
+  (void)Bench( count, memory, 1 );
+  Shift( count, memory, 0 );
+  Shift( count, memory, 1 );
+  return( EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
@@ -0,0 +1,568 @@
+/* ========================================================================== **
+ *                               spill-test.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Check the disk-backed second tier of ubi_Cache.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  An LRU cache that is much smaller than its working set is run against
+ *  a skewed stream of requests, first on its own and then with a spill
+ *  log in a temporary file.  Entries that are evicted go to the log, and
+ *  misses are read back from it.  The hit ratio with the log (counting
+ *  hits in memory and in the log) must be better than without it.  There
+ *  is a record for every key, so afterward every key that was ever put
+ *  must still be found, in memory or in the log, with the right value.
+ *
+ *  The log is then compacted into a second temporary file.  That must
+ *  copy exactly the live bytes and leave no garbage, and every key must
+ *  still be found afterward.
+ *
+ *  Some smaller checks follow:
+ *  - A key that is deleted, or overwritten by an entry that later
+ *    expires, must not be read back from the log.
+ *  - With fewer records than evicted entries, only the most recently
+ *    spilled entries are kept.
+ *  - Entries that expire while in the log are not read back, and the
+ *    others keep their expiry times.
+ *  - A log can't be set without a hash function.
+ *
+ *  After each check the cache is cleared, which must forget the log and
+ *  free every entry.
+ *
+ *  Usage:
+ *    ./spill-test [-k keys] [-c capacity] [-n requests]
+ *
+ *  Defaults: 20000 keys, a capacity of 2000 entries, and 200000 requests.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.            */
+#include <stdlib.h>             /* Standard C library.      */
+#include <string.h>             /* strcmp(3).               */
+
+#include "ubi_Cache.h"          /* Cache module.            */
+#include "ubi_CacheSpill.h"     /* Spill log.               */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Rec - A cache entry with an integer key and a value.
+ */
+
+typedef struct
+  {
+  ubi_cacheEntryExt Entry;
+  unsigned long     Key;
+  unsigned long     Value;
+  } Rec;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static unsigned long Seed     = 1;
+static unsigned long Keys     = 20000;
+static unsigned long Capacity = 2000;
+static unsigned long Requests = 200000;
+static unsigned long Live     = 0;
+static unsigned long Errors   = 0;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static unsigned long Random( void )
+  /* ------------------------------------------------------------------------ **
+   * A small LCG, returning 31 random bits.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Seed = (Seed * 6364136223846793005UL) + 1442695040888963407UL;
+  return( Seed >> 33 );
+  } /* Random */
+
+
+static unsigned long NextKey( void )
+  /* ------------------------------------------------------------------------ **
+   * Return the next key in a skewed stream of requests, as an index from
+   * 0 to Keys - 1.  Small numbers are much more likely than large ones.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( Random() % ((Random() % ((Random() % Keys) + 1)) + 1) );
+  } /* NextKey */
+
+
+static unsigned long Scramble( unsigned long k )
+  /* ------------------------------------------------------------------------ **
+   * Mix the bits of a key, so that keys do not arrive in sorted order.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  k ^= k >> 33;
+  k *= 0xFF51AFD7ED558CCDUL;
+  k ^= k >> 33;
+  return( k );
+  } /* Scramble */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Rec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static unsigned long HashFunc( ubi_trItemPtr ItemPtr )
+  /* ------------------------------------------------------------------------ **
+   * Hash an integer key.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( *(unsigned long *)ItemPtr * 0x9E3779B97F4A7C15UL );
+  } /* HashFunc */
+
+
+static void FreeFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Free an entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Live--;
+  free( NodePtr );
+  } /* FreeFunc */
+
+
+static ubi_trBool Serialize( FILE *Stream, ubi_cacheEntryPtr EntryPtr,
+                             void *Context )
+  /* ------------------------------------------------------------------------ **
+   * Write the key and value of an entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Rec *rp = (Rec *)EntryPtr;
+
+  (void)Context;
+  return( (1 == fwrite( &rp->Key, sizeof( rp->Key ), 1, Stream ))
+       && (1 == fwrite( &rp->Value, sizeof( rp->Value ), 1, Stream )) );
+  } /* Serialize */
+
+
+static ubi_cacheEntryPtr Deserialize( FILE          *Stream,
+                                      ubi_trItemPtr *KeyPtr,
+                                      void          *Context )
+  /* ------------------------------------------------------------------------ **
+   * Read an entry written by Serialize().
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Rec *rp = (Rec *)malloc( sizeof( Rec ) );
+
+  (void)Context;
+  if( NULL == rp )
+    return( NULL );
+  if( (1 != fread( &rp->Key, sizeof( rp->Key ), 1, Stream ))
+   || (1 != fread( &rp->Value, sizeof( rp->Value ), 1, Stream )) )
+    {
+    free( rp );
+    return( NULL );
+    }
+  Live++;
+  rp->Entry.base.entry_size = sizeof( Rec );
+  *KeyPtr = &rp->Key;
+  return( &rp->Entry.base );
+  } /* Deserialize */
+
+
+static Rec *NewRec( unsigned long Key, unsigned long Value )
+  /* ------------------------------------------------------------------------ **
+   * Allocate an entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Rec *rp = (Rec *)malloc( sizeof( Rec ) );
+
+  if( NULL == rp )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    exit( EXIT_FAILURE );
+    }
+  rp->Key   = Key;
+  rp->Value = Value;
+  Live++;
+  return( rp );
+  } /* NewRec */
+
+
+static void Put( ubi_cacheRootPtr CachePtr, unsigned long Key )
+  /* ------------------------------------------------------------------------ **
+   * Put an entry, with the usual value for its key, into the cache.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Rec *rp = NewRec( Key, ~Key );
+
+  ubi_cachePut( CachePtr, sizeof( Rec ), &rp->Entry.base, &rp->Key );
+  } /* Put */
+
+
+static ubi_trBool Check( ubi_cacheRootPtr CachePtr, unsigned long Key )
+  /* ------------------------------------------------------------------------ **
+   * Look up a key.  Return TRUE if it was found, and count an error if its
+   * value is wrong.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Rec *rp = (Rec *)ubi_cacheGet( CachePtr, &Key );
+
+  if( NULL == rp )
+    return( ubi_trFALSE );
+  if( (rp->Key != Key) || (rp->Value != ~Key) )
+    Errors++;
+  return( ubi_trTRUE );
+  } /* Check */
+
+
+static FILE *TempFile( void )
+  /* ------------------------------------------------------------------------ **
+   * Open a temporary file for a spill log.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  FILE *fp = tmpfile();
+
+  if( NULL == fp )
+    {
+    perror( "tmpfile" );
+    exit( EXIT_FAILURE );
+    }
+  return( fp );
+  } /* TempFile */
+
+
+static void Setup( ubi_cacheRootPtr CachePtr, unsigned long Entries )
+  /* ------------------------------------------------------------------------ **
+   * Initialize an LRU cache that can hold the given number of entries.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)ubi_cacheInit( CachePtr, CompareFunc, FreeFunc, Entries, 0 );
+  (void)ubi_cacheSetExtended( CachePtr, ubi_trTRUE );
+  (void)ubi_cacheSetHashFunc( CachePtr, HashFunc );
+  (void)ubi_cacheSetPolicy( CachePtr, ubi_cacheLRU );
+  } /* Setup */
+
+
+static void Finish( ubi_cacheRootPtr CachePtr, char *Name,
+                    unsigned long Before )
+  /* ------------------------------------------------------------------------ **
+   * Clear the cache, check that nothing is left, and report.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)ubi_cacheClear( CachePtr );
+  if( (0 != Live) || (0 != ubi_cacheGetSpillCount( CachePtr )) )
+    Errors++;
+  (void)printf( "%-10s %s\n", Name, (Errors == Before) ? "ok" : "FAILED" );
+  } /* Finish */
+
+
+static double Stream( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Run the stream of requests against a cache, and return the share of
+   * requests that were found, in memory or in the log.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long i, key, found = 0;
+
+  Seed = 1;
+  for( i = 0; i < Requests; i++ )
+    {
+    key = Scramble( NextKey() );
+    if( Check( CachePtr, key ) )
+      found++;
+    else
+      Put( CachePtr, key );
+    }
+  return( (100.0 * found) / Requests );
+  } /* Stream */
+
+
+static void RunStream( void )
+  /* ------------------------------------------------------------------------ **
+   * Compare the hit ratio with and without a log, read every key back, and
+   * compact the log.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot     Cache[1];
+  ubi_cacheSpillLog Spill[1];
+  ubi_cacheSpillPtr records;
+  FILE             *log, *newlog;
+  double            cold, warm;
+  unsigned long     i, live, before = Errors;
+  long              copied;
+
+  records = (ubi_cacheSpillPtr)malloc( Keys * sizeof( ubi_cacheSpill ) );
+  if( NULL == records )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    exit( EXIT_FAILURE );
+    }
+
+  Setup( Cache, Capacity );
+  cold = Stream( Cache );
+  (void)ubi_cacheClear( Cache );
+
+  log = TempFile();
+  if( (NULL == ubi_cacheSpillInit( Spill, log, Serialize, Deserialize, NULL,
+                                   records, Keys ))
+   || !ubi_cacheSetSpill( Cache, Spill ) )
+    Errors++;
+  warm = Stream( Cache );
+  (void)printf( "hit ratio %.2f%% without a log, %.2f%% with one "
+                "(%lu written, %lu read back)\n",
+                cold, warm, (unsigned long)Cache->stats.spill_writes,
+                (unsigned long)Cache->stats.spill_hits );
+  if( warm <= cold )
+    Errors++;
+
+  /* Every key that was put is in memory or in the log. */
+  if( Live != ubi_cacheGetEntryCount( Cache ) )
+    Errors++;
+  Seed = 1;
+  for( i = 0; i < Requests; i++ )
+    if( !Check( Cache, Scramble( NextKey() ) ) )
+      Errors++;
+
+  /* Compact.  The copy holds exactly the live bytes. */
+  live   = Spill->live;
+  newlog = TempFile();
+  copied = ubi_cacheSpillCompact( Cache, newlog );
+  (void)printf( "compacted %lu live bytes, %lu bytes of garbage\n",
+                live, ubi_cacheGetSpillDead( Cache ) );
+  if( (copied < 0) || ((unsigned long)copied != live)
+   || (0 != ubi_cacheGetSpillDead( Cache )) || (Spill->file != newlog) )
+    Errors++;
+  (void)fclose( log );
+  Seed = 1;
+  for( i = 0; i < Requests; i++ )
+    if( !Check( Cache, Scramble( NextKey() ) ) )
+      Errors++;
+
+  Finish( Cache, "stream", before );
+  (void)fclose( newlog );
+  free( records );
+  } /* RunStream */
+
+
+static void RunStale( void )
+  /* ------------------------------------------------------------------------ **
+   * Deleted or overwritten keys must not come back from the log.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot     Cache[1];
+  ubi_cacheSpill    records[64];
+  ubi_cacheSpillLog Spill[1];
+  ubi_timerWheel    Wheel[1];
+  FILE             *log = TempFile();
+  Rec              *rp;
+  unsigned long     i, key, before = Errors;
+
+  Setup( Cache, 8 );
+  (void)ubi_timerInitWheel( Wheel, 0 );
+  (void)ubi_cacheSetWheel( Cache, Wheel );
+  (void)ubi_cacheSpillInit( Spill, log, Serialize, Deserialize, NULL,
+                            records, 64 );
+  (void)ubi_cacheSetSpill( Cache, Spill );
+  for( i = 0; i < 32; i++ )
+    Put( Cache, i );
+  if( 24 != ubi_cacheGetSpillCount( Cache ) )
+    Errors++;
+
+  /* Key 0 is deleted.  Key 1 is overwritten by an entry that expires. */
+  key = 0;
+  (void)ubi_cacheDelete( Cache, &key );
+  rp = NewRec( 1, 12345 );
+  ubi_cachePutExpires( Cache, sizeof( Rec ), &rp->Entry.base, &rp->Key, 10 );
+  (void)ubi_cacheExpire( Cache, 20 );
+  for( key = 0; key < 2; key++ )
+    if( NULL != ubi_cacheGet( Cache, &key ) )
+      Errors++;
+  for( key = 2; key < 32; key++ )
+    if( !Check( Cache, key ) )
+      Errors++;
+
+  Finish( Cache, "stale", before );
+  (void)fclose( log );
+  } /* RunStale */
+
+
+static void RunRecycle( void )
+  /* ------------------------------------------------------------------------ **
+   * With 16 records, only the last 16 entries evicted are kept.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot     Cache[1];
+  ubi_cacheSpill    records[16];
+  ubi_cacheSpillLog Spill[1];
+  FILE             *log = TempFile();
+  unsigned long     key, before = Errors;
+
+  Setup( Cache, 8 );
+  (void)ubi_cacheSpillInit( Spill, log, Serialize, Deserialize, NULL,
+                            records, 16 );
+  (void)ubi_cacheSetSpill( Cache, Spill );
+  for( key = 0; key < 64; key++ )
+    Put( Cache, key );
+  if( 16 != ubi_cacheGetSpillCount( Cache ) )
+    Errors++;
+  /* Keys 0..55 were evicted, in order.  Misses don't disturb the log. */
+  for( key = 0; key < 40; key++ )
+    if( NULL != ubi_cacheGet( Cache, &key ) )
+      Errors++;
+  for( key = 55; key >= 52; key-- )
+    if( !Check( Cache, key ) )
+      Errors++;
+  if( 16 != ubi_cacheGetSpillCount( Cache ) )
+    Errors++;
+
+  Finish( Cache, "recycle", before );
+  (void)fclose( log );
+  } /* RunRecycle */
+
+
+static void RunExpiry( void )
+  /* ------------------------------------------------------------------------ **
+   * Timed entries in the log expire; untimed ones don't.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot     Cache[1];
+  ubi_cacheSpill    records[64];
+  ubi_cacheSpillLog Spill[1];
+  ubi_timerWheel    Wheel[1];
+  FILE             *log = TempFile();
+  Rec              *rp;
+  unsigned long     key, before = Errors;
+
+  Setup( Cache, 4 );
+  (void)ubi_timerInitWheel( Wheel, 0 );
+  (void)ubi_cacheSetWheel( Cache, Wheel );
+  (void)ubi_cacheSpillInit( Spill, log, Serialize, Deserialize, NULL,
+                            records, 64 );
+  (void)ubi_cacheSetSpill( Cache, Spill );
+
+  /* Even keys expire at time 100, odd keys never. */
+  for( key = 0; key < 32; key++ )
+    {
+    rp = NewRec( key, ~key );
+    if( key & 1 )
+      ubi_cachePut( Cache, sizeof( Rec ), &rp->Entry.base, &rp->Key );
+    else
+      ubi_cachePutExpires( Cache, sizeof( Rec ), &rp->Entry.base, &rp->Key,
+                           100 );
+    }
+
+  /* Read key 0 back at time 50.  It must still expire at 100. */
+  ubi_cacheSetTime( Cache, 50 );
+  key = 0;
+  if( !Check( Cache, key ) )
+    Errors++;
+  (void)ubi_cacheExpire( Cache, 150 );
+  for( key = 0; key < 32; key++ )
+    if( Check( Cache, key ) != ((key & 1) ? ubi_trTRUE : ubi_trFALSE) )
+      Errors++;
+
+  Finish( Cache, "expiry", before );
+  (void)fclose( log );
+  } /* RunExpiry */
+
+
+static void RunRefused( void )
+  /* ------------------------------------------------------------------------ **
+   * A log needs a hash function, and the functions and records.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot     Cache[1];
+  ubi_cacheSpill    records[4];
+  ubi_cacheSpillLog Spill[1];
+  FILE             *log = TempFile();
+  unsigned long     before = Errors;
+
+  if( ubi_cacheSpillInit( Spill, log, Serialize, NULL, NULL, records, 4 )
+   || ubi_cacheSpillInit( Spill, log, Serialize, Deserialize, NULL,
+                          records, 0 )
+   || (Spill != ubi_cacheSpillInit( Spill, log, Serialize, Deserialize,
+                                    NULL, records, 4 )) )
+    Errors++;
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc, 4, 0 );
+  if( ubi_cacheSetSpill( Cache, Spill ) )
+    Errors++;
+  (void)ubi_cacheSetHashFunc( Cache, HashFunc );
+  if( !ubi_cacheSetSpill( Cache, Spill )
+   || ubi_cacheSetHashFunc( Cache, NULL ) )
+    Errors++;
+  if( !ubi_cacheSetSpill( Cache, NULL )
+   || (NULL != Cache->spill) || (0 != ubi_cacheGetSpillCount( Cache )) )
+    Errors++;
+
+  Finish( Cache, "refused", before );
+  (void)fclose( log );
+  } /* RunRefused */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  int i;
+
+  for( i = 1; (i + 1) < argc; i += 2 )
+    {
+    if( 0 == strcmp( argv[i], "-k" ) )
+      Keys = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-c" ) )
+      Capacity = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-n" ) )
+      Requests = strtoul( argv[i+1], NULL, 0 );
+    else
+      break;
+    }
+  if( (i < argc) || (Capacity < 1) || (Keys <= Capacity) || (Requests < 1) )
+    {
+    (void)fprintf( stderr,
+                   "Usage: %s [-k keys] [-c capacity] [-n requests]\n",
+                   argv[0] );
+    return( EXIT_FAILURE );
+    }
+
+  RunStream();
+  RunStale();
+  RunRecycle();
+  RunExpiry();
+  RunRefused();
+
+  (void)printf( "%lu errors\n", Errors );
+  return( Errors ? EXIT_FAILURE : EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
@@ -0,0 +1,336 @@
+/* ========================================================================== **
+ *                                timer-test.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Check the timing wheel, and compare it against an AVL tree
+ *              keyed by deadline.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  The program runs in two parts.
+ *
+ *  The first part is a consistency check.  A few thousand timers are set,
+ *  reset, and cancelled at random while the wheel is advanced in random
+ *  steps.  The clock starts just short of ULONG_MAX, so it wraps during
+ *  the run.  Every timer must fire exactly on its expiry tick, within the
+ *  call to ubi_timerAdvance() that passes that tick.
+ *
+ *  The second part is a benchmark of a connection timeout workload.  Each
+ *  event picks a random connection and pushes its idle timeout forward.
+ *  The clock ticks once every <per-tick> events.  Very few timeouts ever
+ *  fire.  The same workload is run against an AVL tree, which must remove
+ *  and re-insert the connection on every event.
+ *
+ *  Usage:
+ *    ./timer-test [connections [events [per-tick]]]
+ *
+ *  Example:
+ *    ./timer-test 1000000 10000000 100
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.        */
+#include <stdlib.h>             /* Standard C library.  */
+#include <limits.h>             /* ULONG_MAX.           */
+#include <time.h>               /* clock(3).            */
+
+#include "ubi_TimerWheel.h"     /* Timing wheel module. */
+#include "ubi_AVLtree.h"        /* AVL tree module.     */
+
+
+/* -------------------------------------------------------------------------- **
+ * Defines...
+ *
+ *  TIMEOUT - The connection idle timeout, in ticks.
+ */
+
+#define TIMEOUT 30000
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  TestTimer - A timer used in the consistency check.
+ *  WheelConn - A connection, with a timing wheel timer.
+ *  TreeConn  - A connection, with an AVL tree node.
+ */
+
+typedef struct
+  {
+  ubi_timerNode Timer;
+  int           fired;
+  } TestTimer;
+
+typedef struct
+  {
+  ubi_timerNode Timer;
+  unsigned long id;
+  } WheelConn;
+
+typedef struct
+  {
+  ubi_trNode    Node;
+  unsigned long Deadline;
+  } TreeConn;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static unsigned long    Seed = 1;
+static ubi_timerWheel   Wheel[1];
+static unsigned long    PrevNow;
+static unsigned long    Errors;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static unsigned long Random( void )
+  /* ------------------------------------------------------------------------ **
+   * A small LCG, so that both runs see the same sequence.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Seed = (Seed * 6364136223846793005UL) + 1442695040888963407UL;
+  return( Seed >> 33 );
+  } /* Random */
+
+
+static double Elapsed( clock_t start )
+  /* ------------------------------------------------------------------------ **
+   * Return the number of seconds since <start>.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( (double)(clock() - start) / (double)CLOCKS_PER_SEC );
+  } /* Elapsed */
+
+
+static void CheckFire( ubi_timerNodePtr TimerPtr, void *UserData )
+  /* ------------------------------------------------------------------------ **
+   * Expiry callback for the consistency check.
+   *
+   *  The tick being processed is (Wheel->now - 1).  The timer must expire
+   *  on that tick, and the tick must be later than the previous call's
+   *  <Now>.  Half of the timers are re-armed from within the callback.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long tick = Wheel->now - 1;
+  TestTimer    *tp   = (TestTimer *)TimerPtr;
+
+  (void)UserData;
+  if( (TimerPtr->expires != tick) || ((long)(tick - PrevNow) <= 0) )
+    Errors++;
+  if( ubi_timerPending( TimerPtr ) )
+    Errors++;
+  tp->fired++;
+  if( Random() & 1 )
+    (void)ubi_timerAdd( Wheel, TimerPtr, tick + 1 + (Random() % 100000) );
+  } /* CheckFire */
+
+
+static int Check( void )
+  /* ------------------------------------------------------------------------ **
+   * Consistency check.  Returns the number of errors found.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  static TestTimer T[5000];
+  unsigned long    now = ULONG_MAX - 1000000;
+  unsigned long    i, j, n, fired = 0;
+  int              k;
+
+  (void)ubi_timerInitWheel( Wheel, now );
+  for( i = 0; i < 5000; i++ )
+    {
+    (void)ubi_timerInitNode( &T[i].Timer );
+    T[i].fired = 0;
+    /* A few timers go far out, to exercise the upper levels. */
+    n = (i % 100) ? (Random() % 100000) : (Random() % 50000000);
+    (void)ubi_timerAdd( Wheel, &T[i].Timer, now + 1 + n );
+    }
+
+  for( j = 0; j < 20000; j++ )
+    {
+    for( k = 0; k < 10; k++ )
+      {
+      i = Random() % 5000;
+      switch( Random() % 3 )
+        {
+        case 0:
+          (void)ubi_timerCancel( Wheel, &T[i].Timer );
+          if( ubi_timerPending( &T[i].Timer ) )
+            Errors++;
+          break;
+        default:
+          (void)ubi_timerReset( Wheel, &T[i].Timer,
+                                now + 1 + (Random() % 200000) );
+          break;
+        }
+      }
+    PrevNow = now;
+    now    += 1 + (Random() % 5000);
+    fired  += ubi_timerAdvance( Wheel, now, CheckFire, NULL );
+    }
+
+  /* Everything still pending must be in the future. */
+  for( n = i = 0; i < 5000; i++ )
+    {
+    if( ubi_timerPending( &T[i].Timer ) )
+      {
+      n++;
+      if( (long)(T[i].Timer.expires - now) <= 0 )
+        Errors++;
+      }
+    }
+  if( n != ubi_timerCount( Wheel ) )
+    Errors++;
+
+  (void)printf( "check: %lu timers fired, %lu pending, %lu errors\n",
+                fired, n, Errors );
+  return( (int)Errors );
+  } /* Check */
+
+
+static int TreeCompare( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare a deadline against the deadline stored in a tree node.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long a = *(unsigned long *)ItemPtr;
+  unsigned long b = ((TreeConn *)NodePtr)->Deadline;
+
+  return( (a < b) ? -1 : ((a > b) ? 1 : 0) );
+  } /* TreeCompare */
+
+
+static void WheelExpire( ubi_timerNodePtr TimerPtr, void *UserData )
+  /* ------------------------------------------------------------------------ **
+   * Expiry callback for the benchmark.  Just count the timeouts.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)TimerPtr;
+  (*(unsigned long *)UserData)++;
+  } /* WheelExpire */
+
+
+static void Bench( unsigned long conns, unsigned long events,
+                   unsigned long per_tick )
+  /* ------------------------------------------------------------------------ **
+   * Connection timeout benchmark.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  WheelConn    *wc;
+  TreeConn     *tc;
+  ubi_trRoot    Tree[1];
+  TreeConn     *p;
+  unsigned long i, j, now, expired;
+  clock_t       start;
+
+  wc = (WheelConn *)malloc( conns * sizeof( WheelConn ) );
+  tc = (TreeConn *)malloc( conns * sizeof( TreeConn ) );
+  if( (NULL == wc) || (NULL == tc) )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    exit( EXIT_FAILURE );
+    }
+
+  /* Timing wheel. */
+  Seed    = 7;
+  now     = 0;
+  expired = 0;
+  start   = clock();
+  (void)ubi_timerInitWheel( Wheel, now );
+  for( i = 0; i < conns; i++ )
+    {
+    wc[i].id = i;
+    (void)ubi_timerInitNode( &wc[i].Timer );
+    (void)ubi_timerAdd( Wheel, &wc[i].Timer, now + (Random() % TIMEOUT) );
+    }
+  for( i = 0; i < events; i++ )
+    {
+    j = Random() % conns;
+    (void)ubi_timerReset( Wheel, &wc[j].Timer, now + TIMEOUT );
+    if( 0 == (i % per_tick) )
+      (void)ubi_timerAdvance( Wheel, ++now, WheelExpire, &expired );
+    }
+  (void)printf( "wheel: %lu events  %8.3f s  %7.2f ns/event  (%lu expired)\n",
+                events, Elapsed( start ),
+                (1e9 * Elapsed( start )) / (double)events, expired );
+
+  /* AVL tree. */
+  Seed    = 7;
+  now     = 0;
+  expired = 0;
+  start   = clock();
+  (void)ubi_trInitTree( Tree, TreeCompare, ubi_trDUPKEY );
+  for( i = 0; i < conns; i++ )
+    {
+    tc[i].Deadline = now + (Random() % TIMEOUT);
+    (void)ubi_trInsert( Tree, &tc[i], &tc[i].Deadline, NULL );
+    }
+  for( i = 0; i < events; i++ )
+    {
+    j = Random() % conns;
+    if( tc[j].Deadline != ULONG_MAX )
+      (void)ubi_trRemove( Tree, &tc[j] );
+    tc[j].Deadline = now + TIMEOUT;
+    (void)ubi_trInsert( Tree, &tc[j], &tc[j].Deadline, NULL );
+    if( 0 == (i % per_tick) )
+      {
+      ++now;
+      while( (NULL != (p = (TreeConn *)ubi_trFirst( Tree->root )))
+          && (p->Deadline <= now) )
+        {
+        (void)ubi_trRemove( Tree, p );
+        p->Deadline = ULONG_MAX;
+        expired++;
+        }
+      }
+    }
+  (void)printf( "avl:   %lu events  %8.3f s  %7.2f ns/event  (%lu expired)\n",
+                events, Elapsed( start ),
+                (1e9 * Elapsed( start )) / (double)events, expired );
+
+  free( wc );
+  free( tc );
+  } /* Bench */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   *
+   *  Input:  argc  - Argument count.
+   *          argv  - [1] is the number of connections,
+   *                  [2] is the number of events,
+   *                  [3] is the number of events per clock tick.
+   *
+   *  Output: EXIT_SUCCESS, or EXIT_FAILURE if the consistency check
+   *          failed.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long conns    = (argc > 1) ? strtoul( argv[1], NULL, 0 ) : 100000;
+  unsigned long events   = (argc > 2) ? strtoul( argv[2], NULL, 0 ) : 5000000;
+  unsigned long per_tick = (argc > 3) ? strtoul( argv[3], NULL, 0 ) : 100;
+
+  if( Check() )
+    return( EXIT_FAILURE );
+  if( conns < 1 )
+    conns = 1;
+  if( per_tick < 1 )
+    per_tick = 1;
+  Bench( conns, events, per_tick );
+  return( EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
@@ -0,0 +1,249 @@
+/* ========================================================================== **
+ *                                trim-bench.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Measure the cost of trimming the cache, and the stalls it
+ *              causes, with different watermarks and trim budgets.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  A cache with a memory limit is filled with entries of random size, and
+ *  then more random entries are put.  The average and the worst time per
+ *  put are reported.  Then the memory limit is cut in half, which is the
+ *  worst case for a synchronous trim.  The time taken by
+ *  ubi_cacheSetMaxMemory() is reported, along with the worst put time
+ *  while the cache catches up, and how far over the new limit the cache
+ *  was at its worst.
+ *
+ *  Each run uses a different combination of watermarks and trim budget.
+ *
+ *  Usage:
+ *    ./trim-bench [-n puts] [-m memory] [-p policy]
+ *
+ *  Defaults: 1000000 puts, a memory limit of 64MB, and the splay policy.
+ *  The policy may be "splay" or "lru".
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.            */
+#include <stdlib.h>             /* Standard C library.      */
+#include <string.h>             /* strcmp(3).               */
+#include <time.h>               /* clock_gettime(2).        */
+
+#include "ubi_Cache.h"          /* Cache module.            */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Rec       - A cache entry with an integer key.  The rest of the entry
+ *              is accounted for, but not allocated.
+ *  Setting   - Watermarks and trim budget for one run.
+ */
+
+typedef struct
+  {
+  ubi_cacheEntry Entry;
+  unsigned long  Key;
+  } Rec;
+
+typedef struct
+  {
+  unsigned int  high;
+  unsigned int  low;
+  unsigned long budget;
+  } Setting;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static unsigned long Seed = 1;
+
+static const Setting Settings[] =
+  {
+  { 100, 100,  0 },
+  { 100,  90,  0 },
+  { 100,  90, 16 },
+  {  90,  80, 16 },
+  {   0,   0,  0 }
+  };
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static unsigned long Random( void )
+  /* ------------------------------------------------------------------------ **
+   * A small LCG, returning 31 random bits.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Seed = (Seed * 6364136223846793005UL) + 1442695040888963407UL;
+  return( Seed >> 33 );
+  } /* Random */
+
+
+static double Now( void )
+  /* ------------------------------------------------------------------------ **
+   * Return the time, in microseconds.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  struct timespec ts;
+
+  (void)clock_gettime( CLOCK_MONOTONIC, &ts );
+  return( ((double)ts.tv_sec * 1e6) + ((double)ts.tv_nsec / 1e3) );
+  } /* Now */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Rec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static void FreeFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Free an evicted entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  free( NodePtr );
+  } /* FreeFunc */
+
+
+static double Put( ubi_cacheRootPtr CachePtr )
+  /* ------------------------------------------------------------------------ **
+   * Put one random entry, sized between 64 bytes and 4K.  Return the time
+   * taken, in microseconds.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Rec   *rp;
+  double start;
+
+  rp = (Rec *)malloc( sizeof( Rec ) );
+  if( NULL == rp )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    exit( EXIT_FAILURE );
+    }
+  rp->Key = (Random() << 31) ^ Random();
+  start = Now();
+  ubi_cachePut( CachePtr, 64 + (Random() % 4033), &rp->Entry, &rp->Key );
+  return( Now() - start );
+  } /* Put */
+
+
+static void Run( const Setting *sp,
+                 int            policy,
+                 unsigned long  memory,
+                 unsigned long  count )
+  /* ------------------------------------------------------------------------ **
+   * Run one setting, and print a line of results.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot Cache[1];
+  unsigned long i, excess, over = 0;
+  double        t, total = 0.0, worst = 0.0, setmax, after = 0.0;
+
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc, 0, memory );
+  (void)ubi_cacheSetPolicy( Cache, policy );
+  (void)ubi_cacheSetWatermarks( Cache, sp->high, sp->low );
+  (void)ubi_cacheSetTrimBudget( Cache, sp->budget );
+
+  /* Fill the cache, up to (nearly) its high watermark. */
+  while( ubi_cacheGetMemUsed( Cache ) < (((memory / 100) * sp->high) - 4096) )
+    (void)Put( Cache );
+
+  for( i = 0; i < count; i++ )
+    {
+    t = Put( Cache );
+    total += t;
+    if( t > worst )
+      worst = t;
+    }
+
+  /* Cut the limit in half, and keep putting. */
+  t = Now();
+  (void)ubi_cacheSetMaxMemory( Cache, memory / 2 );
+  setmax = Now() - t;
+  for( i = 0; i < (count / 10); i++ )
+    {
+    if( ubi_cacheGetMemUsed( Cache ) > (memory / 2) )
+      {
+      excess = ubi_cacheGetMemUsed( Cache ) - (memory / 2);
+      if( excess > over )
+        over = excess;
+      }
+    t = Put( Cache );
+    if( t > after )
+      after = t;
+    }
+
+  (void)printf( "%4u %4u %6lu %9.0f %9.1f %9.1f %9.1f %9lu\n",
+                sp->high, sp->low, sp->budget,
+                (1e3 * total) / (double)count, worst, setmax, after,
+                over / 1024 );
+  (void)ubi_cacheClear( Cache );
+  } /* Run */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long count  = 1000000;
+  unsigned long memory = 64 * 1024 * 1024;
+  int           policy = ubi_cacheSPLAY;
+  int           i;
+
+  for( i = 1; (i + 1) < argc; i += 2 )
+    {
+    if( 0 == strcmp( argv[i], "-n" ) )
+      count = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-m" ) )
+      memory = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-p" ) )
+      {
+      if( 0 == strcmp( argv[i+1], "lru" ) )
+        policy = ubi_cacheLRU;
+      else if( 0 == strcmp( argv[i+1], "splay" ) )
+        policy = ubi_cacheSPLAY;
+      else
+        break;
+      }
+    else
+      break;
+    }
+  if( (i < argc) || (count < 1) || (memory < (1024 * 1024)) )
+    {
+    (void)fprintf( stderr, "Usage: %s [-n puts] [-m memory] [-p policy]\n",
+                   argv[0] );
+    return( EXIT_FAILURE );
+    }
+
+  (void)printf( "%lu puts, memory limit %lu, then %lu\n",
+                count, memory, memory / 2 );
+  (void)printf( "high  low budget   ns/put  worst us setmax us  after us"
+                "  over KB\n" );
+  for( i = 0; Settings[i].high; i++ )
+    Run( &Settings[i], policy, memory, count );
+  return( EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
@@ -0,0 +1,313 @@
+/* ========================================================================== **
+ *                                 ttl-test.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Check cache entry expiry, and compare it against sweeping
+ *              the cache with ubi_trTraverse().
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  The program runs in two parts.
+ *
+ *  The first part is a consistency check.  Entries are put with random
+ *  lifetimes while the clock moves forward in random steps.  After every
+ *  call to ubi_cacheExpire(), the number of entries in the cache must
+ *  match the number that have not yet expired.  Every so often, the time
+ *  is moved forward with ubi_cacheSetTime() alone, and ubi_cacheGet() must
+ *  refuse to return entries that have expired.  Finally, the cache is
+ *  trimmed while some entries have expired, and those must go first.
+ *
+ *  The second part is a benchmark.  A full cache is kept topped up with
+ *  entries that live for <ttl> ticks, and the clock advances by one tick
+ *  per step.  Expired entries are removed either with ubi_cacheExpire()
+ *  or by walking the whole tree with ubi_trTraverse() on every step, as a
+ *  sweeper thread would.
+ *
+ *  Usage:
+ *    ./ttl-test [entries [ttl [steps]]]
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.        */
+#include <stdlib.h>             /* Standard C library.  */
+#include <time.h>               /* clock(3).            */
+
+#include "ubi_Cache.h"          /* Cache module.        */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Rec       - A cache entry with an integer key and an expiry time.
+ *  Sweep     - Context for the traversal sweep.
+ */
+
+typedef struct
+  {
+  ubi_cacheEntryExt Entry;
+  unsigned long     Key;
+  unsigned long     Expires;
+  } Rec;
+
+typedef struct
+  {
+  unsigned long  now;
+  Rec          **stale;
+  unsigned long  count;
+  } Sweep;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static ubi_timerWheel Wheel[1];
+static unsigned long  Seed  = 1;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static unsigned long Random( void )
+  /* ------------------------------------------------------------------------ **
+   * A small LCG, returning 31 random bits.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Seed = (Seed * 6364136223846793005UL) + 1442695040888963407UL;
+  return( Seed >> 33 );
+  } /* Random */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Rec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static void FreeFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Free an entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  free( NodePtr );
+  } /* FreeFunc */
+
+
+static void FindStale( ubi_trNodePtr NodePtr, void *UserData )
+  /* ------------------------------------------------------------------------ **
+   * Traversal callback: note entries that have expired.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Sweep *sp = (Sweep *)UserData;
+
+  if( (long)(((Rec *)NodePtr)->Expires - sp->now) <= 0 )
+    sp->stale[sp->count++] = (Rec *)NodePtr;
+  } /* FindStale */
+
+
+static Rec *NewRec( unsigned long key, unsigned long expires )
+  /* ------------------------------------------------------------------------ **
+   * Allocate an entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Rec *rp = (Rec *)malloc( sizeof( Rec ) );
+
+  if( NULL == rp )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    exit( EXIT_FAILURE );
+    }
+  rp->Key     = key;
+  rp->Expires = expires;
+  return( rp );
+  } /* NewRec */
+
+
+static int Check( void )
+  /* ------------------------------------------------------------------------ **
+   * Consistency check.  Returns the number of errors found.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot  Cache[1];
+  unsigned long *expires;
+  unsigned long  now = 1000;
+  unsigned long  i, k, live, n = 20000;
+  Rec           *rp;
+  int            errs = 0;
+
+  expires = (unsigned long *)calloc( n, sizeof( unsigned long ) );
+  (void)ubi_timerInitWheel( Wheel, now );
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc, 0, 0 );
+  /* Expiry needs extended entries. */
+  if( ubi_cacheSetWheel( Cache, Wheel ) )
+    errs++;
+  (void)ubi_cacheSetExtended( Cache, ubi_trTRUE );
+  (void)ubi_cacheSetWheel( Cache, Wheel );
+  if( ubi_cacheSetExtended( Cache, ubi_trFALSE ) )
+    errs++;
+
+  for( i = 0; i < 200; i++ )
+    {
+    /* Put (or replace) some entries. */
+    for( k = 0; k < 200; k++ )
+      {
+      rp = NewRec( Random() % n, now + 1 + (Random() % 5000) );
+      expires[rp->Key] = rp->Expires;
+      ubi_cachePutExpires( Cache, 1, &rp->Entry.base, &rp->Key, rp->Expires );
+      }
+
+    now += Random() % 100;
+    if( i & 1 )
+      {
+      /* Lazy expiry: move the clock, but don't expire anything. */
+      ubi_cacheSetTime( Cache, now );
+      for( k = 0; k < n; k++ )
+        {
+        rp = (Rec *)ubi_cacheGet( Cache, &k );
+        if( (NULL != rp) && ((long)(rp->Expires - now) <= 0) )
+          errs++;
+        if( (NULL == rp) && expires[k] && ((long)(expires[k] - now) > 0) )
+          errs++;
+        }
+      }
+    (void)ubi_cacheExpire( Cache, now );
+
+    for( live = k = 0; k < n; k++ )
+      {
+      if( expires[k] && ((long)(expires[k] - now) > 0) )
+        live++;
+      }
+    if( live != ubi_cacheGetEntryCount( Cache ) )
+      errs++;
+    }
+
+  /* Let half of the entries expire, then trim to half.  Only the expired
+   * entries should go.
+   */
+  (void)ubi_cacheClear( Cache );
+  for( k = 0; k < 1000; k++ )
+    {
+    rp = NewRec( k, now + ((k & 1) ? 10 : 10000) );
+    ubi_cachePutExpires( Cache, 1, &rp->Entry.base, &rp->Key, rp->Expires );
+    }
+  ubi_cacheSetTime( Cache, now + 10 );
+  (void)ubi_cacheSetMaxEntries( Cache, 500 );
+  for( k = 0; k < 1000; k += 2 )
+    {
+    if( NULL == ubi_cacheGet( Cache, &k ) )
+      errs++;
+    }
+
+  (void)printf( "check: " ubi_cacheCOUNTER_FMT " entries expired, "
+                "%lu left after trim, %d errors\n",
+                Cache->stats.evictions[ubi_cacheEVICT_EXPIRED],
+                ubi_cacheGetEntryCount( Cache ), errs );
+  (void)ubi_cacheClear( Cache );
+  free( expires );
+  return( errs );
+  } /* Check */
+
+
+static double Bench( unsigned long entries,
+                     unsigned long ttl,
+                     unsigned long steps,
+                     int           sweep )
+  /* ------------------------------------------------------------------------ **
+   * Keep the cache full of short-lived entries, and time the expiry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot Cache[1];
+  Sweep         sw;
+  Rec          *rp;
+  unsigned long now = 0;
+  unsigned long key = 0;
+  unsigned long i, k;
+  clock_t       start;
+  double        secs = 0.0;
+
+  sw.stale = (Rec **)malloc( entries * sizeof( Rec * ) );
+  (void)ubi_timerInitWheel( Wheel, now );
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc, 0, 0 );
+  (void)ubi_cacheSetExtended( Cache, ubi_trTRUE );
+  (void)ubi_cacheSetWheel( Cache, Wheel );
+
+  for( i = 0; i < steps; i++ )
+    {
+    while( ubi_cacheGetEntryCount( Cache ) < entries )
+      {
+      rp = NewRec( (key++ * 2654435761UL), now + 1 + (Random() % ttl) );
+      ubi_cachePutExpires( Cache, 1, &rp->Entry.base, &rp->Key, rp->Expires );
+      }
+    now++;
+
+    start = clock();
+    if( sweep )
+      {
+      ubi_cacheSetTime( Cache, now );
+      sw.now   = now;
+      sw.count = 0;
+      (void)ubi_trTraverse( Cache, FindStale, &sw );
+      for( k = 0; k < sw.count; k++ )
+        (void)ubi_cacheDelete( Cache, &sw.stale[k]->Key );
+      }
+    else
+      (void)ubi_cacheExpire( Cache, now );
+    secs += (double)(clock() - start) / (double)CLOCKS_PER_SEC;
+    }
+
+  (void)ubi_cacheClear( Cache );
+  free( sw.stale );
+  return( (1e6 * secs) / (double)steps );
+  } /* Bench */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long entries = 100000;
+  unsigned long ttl     = 1000;
+  unsigned long steps   = 200;
+
+  if( argc > 1 )
+    entries = strtoul( argv[1], NULL, 0 );
+  if( argc > 2 )
+    ttl = strtoul( argv[2], NULL, 0 );
+  if( argc > 3 )
+    steps = strtoul( argv[3], NULL, 0 );
+  if( (entries < 1) || (ttl < 1) || (steps < 1) )
+    {
+    (void)fprintf( stderr, "Usage: %s [entries [ttl [steps]]]\n", argv[0] );
+    return( EXIT_FAILURE );
+    }
+
+  if( Check() )
+    return( EXIT_FAILURE );
+
+  (void)printf( "%lu entries, ttl up to %lu ticks, %lu steps\n",
+                entries, ttl, steps );
+  (void)printf( "ubi_cacheExpire():  %10.1f us/step\n",
+                Bench( entries, ttl, steps, 0 ) );
+  (void)printf( "ubi_trTraverse():   %10.1f us/step\n",
+                Bench( entries, ttl, steps, 1 ) );
+  return( EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */
@@ -0,0 +1,479 @@
+/* ========================================================================== **
+ *                                warm-test.c
+ * -------------------------------------------------------------------------- **
+ * License: Public Domain
+ * Description: Dump a cache and reload it, as for a warm restart.
+ * $Id$
+ * -------------------------------------------------------------------------- **
+ * Notes:
+ *  For each eviction policy, a cache is warmed up with a skewed stream of
+ *  requests and dumped to a temporary file with ubi_cacheDump().  Then
+ *  the next part of the stream is replayed against three new caches:
+ *  - a cold one, which starts out empty,
+ *  - a partly warm one, which was given only the first tenth of the dump
+ *    (a single call to ubi_cacheLoad() with a small budget), and
+ *  - a warm one, which was given the whole dump, a thousand entries at a
+ *    time.
+ *  The hit ratio of each is reported.  The warm cache should do nearly as
+ *  well as the original (the policies' history is not saved), and the
+ *  partly warm one better than the cold one.
+ *
+ *  Along the way, the test checks that every entry comes back with the
+ *  right value and that the reloaded cache holds the same number of
+ *  entries as the original.  For the list policies (LRU, CLOCK, CLOCK-Pro
+ *  and ARC), a dump of the reloaded cache must be identical to the first
+ *  dump, which shows that the load kept the order.
+ *
+ *  Finally, the time to live of entries that expire is checked: entries
+ *  that had expired when the dump was taken must not come back, and the
+ *  others must keep the time that they had left.
+ *
+ *  Usage:
+ *    ./warm-test [-k keys] [-c capacity] [-n requests]
+ *
+ *  Defaults: 1000000 keys, a capacity of 50000 entries, and 200000
+ *  requests for each phase.
+ *
+ * ========================================================================== **
+ */
+
+#include <stdio.h>              /* Standard I/O.            */
+#include <stdlib.h>             /* Standard C library.      */
+#include <string.h>             /* strcmp(3), memcmp(3).    */
+
+#include "ubi_Cache.h"          /* Cache module.            */
+
+
+/* -------------------------------------------------------------------------- **
+ * Typedefs...
+ *
+ *  Rec       - A cache entry with an integer key and a value.
+ *  PolicyTab - Maps a policy name to its ubi_Cache constant.
+ */
+
+typedef struct
+  {
+  ubi_cacheEntryExt Entry;
+  unsigned long     Key;
+  unsigned long     Value;
+  } Rec;
+
+typedef struct
+  {
+  char *name;
+  int   policy;
+  } PolicyTab;
+
+
+/* -------------------------------------------------------------------------- **
+ * Global Variables...
+ */
+
+static PolicyTab Policies[] =
+  {
+  { "splay",    ubi_cacheSPLAY    },
+  { "lru",      ubi_cacheLRU      },
+  { "clock",    ubi_cacheCLOCK    },
+  { "clockpro", ubi_cacheCLOCKPRO },
+  { "arc",      ubi_cacheARC      },
+  { "gdsf",     ubi_cacheGDSF     },
+  { "sampled",  ubi_cacheSAMPLED  },
+  { NULL,       0                 }
+  };
+
+static unsigned long Seed     = 1;
+static unsigned long Keys     = 1000000;
+static unsigned long Capacity = 50000;
+static unsigned long Requests = 200000;
+static unsigned long Errors   = 0;
+
+
+/* -------------------------------------------------------------------------- **
+ * Functions...
+ */
+
+static unsigned long Random( void )
+  /* ------------------------------------------------------------------------ **
+   * A small LCG, returning 31 random bits.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Seed = (Seed * 6364136223846793005UL) + 1442695040888963407UL;
+  return( Seed >> 33 );
+  } /* Random */
+
+
+static unsigned long NextKey( void )
+  /* ------------------------------------------------------------------------ **
+   * Return the next key in a skewed stream of requests.  Small numbers are
+   * much more likely than large ones.  They are then scrambled, so that
+   * the keys do not arrive in anything like sorted order.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long k = Random() % ((Random() % ((Random() % Keys) + 1)) + 1);
+
+  k ^= k >> 33;
+  k *= 0xFF51AFD7ED558CCDUL;
+  k ^= k >> 33;
+  return( k );
+  } /* NextKey */
+
+
+static int CompareFunc( ubi_trItemPtr ItemPtr, ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Compare an integer key against the key stored in a cache entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long A = *(unsigned long *)ItemPtr;
+  unsigned long B = ((Rec *)NodePtr)->Key;
+
+  return( (A < B) ? -1 : ((A > B) ? 1 : 0) );
+  } /* CompareFunc */
+
+
+static unsigned long HashFunc( ubi_trItemPtr ItemPtr )
+  /* ------------------------------------------------------------------------ **
+   * Hash an integer key.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  return( *(unsigned long *)ItemPtr * 0x9E3779B97F4A7C15UL );
+  } /* HashFunc */
+
+
+static void FreeFunc( ubi_trNodePtr NodePtr )
+  /* ------------------------------------------------------------------------ **
+   * Free an entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  free( NodePtr );
+  } /* FreeFunc */
+
+
+static ubi_trBool Serialize( FILE *Stream, ubi_cacheEntryPtr EntryPtr,
+                             void *Context )
+  /* ------------------------------------------------------------------------ **
+   * Write the key and value of an entry.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Rec *rp = (Rec *)EntryPtr;
+
+  (void)Context;
+  return( (1 == fwrite( &rp->Key, sizeof( rp->Key ), 1, Stream ))
+       && (1 == fwrite( &rp->Value, sizeof( rp->Value ), 1, Stream )) );
+  } /* Serialize */
+
+
+static ubi_cacheEntryPtr Deserialize( FILE          *Stream,
+                                      ubi_trItemPtr *KeyPtr,
+                                      void          *Context )
+  /* ------------------------------------------------------------------------ **
+   * Read an entry written by Serialize(), and check its value.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  Rec *rp = (Rec *)malloc( sizeof( Rec ) );
+
+  (void)Context;
+  if( NULL == rp )
+    return( NULL );
+  if( (1 != fread( &rp->Key, sizeof( rp->Key ), 1, Stream ))
+   || (1 != fread( &rp->Value, sizeof( rp->Value ), 1, Stream )) )
+    {
+    free( rp );
+    return( NULL );
+    }
+  if( rp->Value != ~rp->Key )
+    Errors++;
+  rp->Entry.base.entry_size = sizeof( Rec );
+  *KeyPtr = &rp->Key;
+  return( &rp->Entry.base );
+  } /* Deserialize */
+
+
+static void Setup( ubi_cacheRootPtr   CachePtr,
+                   ubi_cacheGhostPtr  Ghosts,
+                   ubi_cacheEntryPtr *Slots,
+                   int                Policy )
+  /* ------------------------------------------------------------------------ **
+   * Initialize an empty cache.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  (void)ubi_cacheInit( CachePtr, CompareFunc, FreeFunc, Capacity, 0 );
+  (void)ubi_cacheSetExtended( CachePtr, ubi_trTRUE );
+  (void)ubi_cacheSetHashFunc( CachePtr, HashFunc );
+  (void)ubi_cacheSetGhosts( CachePtr, Ghosts, Capacity );
+  (void)ubi_cacheSetSlots( CachePtr, Slots, Capacity + 1 );
+  (void)ubi_cacheSetPolicy( CachePtr, Policy );
+  } /* Setup */
+
+
+static unsigned long Replay( ubi_cacheRootPtr CachePtr, unsigned long Start )
+  /* ------------------------------------------------------------------------ **
+   * Replay part of the request stream, starting at the given seed, and
+   * return the number of hits.  Every miss is followed by a put.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  unsigned long i, key, hits = 0;
+  Rec          *rp;
+
+  Seed = Start;
+  for( i = 0; i < Requests; i++ )
+    {
+    key = NextKey();
+    if( ubi_cacheGet( CachePtr, &key ) )
+      hits++;
+    else
+      {
+      rp = (Rec *)malloc( sizeof( Rec ) );
+      if( NULL == rp )
+        {
+        (void)fprintf( stderr, "Out of memory.\n" );
+        exit( EXIT_FAILURE );
+        }
+      rp->Key   = key;
+      rp->Value = ~key;
+      ubi_cachePut( CachePtr, sizeof( Rec ), &rp->Entry.base, &rp->Key );
+      }
+    }
+  return( hits );
+  } /* Replay */
+
+
+static long Dump( ubi_cacheRootPtr CachePtr, FILE *Stream )
+  /* ------------------------------------------------------------------------ **
+   * Dump a cache to the start of a temporary file.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  long n;
+
+  rewind( Stream );
+  n = ubi_cacheDump( CachePtr, Stream, Serialize, NULL );
+  if( (n < 0) || fflush( Stream ) )
+    {
+    (void)fprintf( stderr, "Dump failed.\n" );
+    exit( EXIT_FAILURE );
+    }
+  return( n );
+  } /* Dump */
+
+
+static ubi_trBool SameFile( FILE *A, FILE *B, long Size )
+  /* ------------------------------------------------------------------------ **
+   * Return TRUE if the first Size bytes of two files are the same.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  char bufA[4096], bufB[4096];
+  long n;
+
+  rewind( A );
+  rewind( B );
+  for( ; Size > 0; Size -= n )
+    {
+    n = (Size < (long)sizeof( bufA )) ? Size : (long)sizeof( bufA );
+    if( (1 != fread( bufA, (size_t)n, 1, A ))
+     || (1 != fread( bufB, (size_t)n, 1, B ))
+     || memcmp( bufA, bufB, (size_t)n ) )
+      return( ubi_trFALSE );
+    }
+  return( ubi_trTRUE );
+  } /* SameFile */
+
+
+static void Run( PolicyTab *pt, FILE *First, FILE *Second )
+  /* ------------------------------------------------------------------------ **
+   * Warm up, dump, and replay against cold, partly warm and warm caches.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot      Cache[1];
+  ubi_cacheGhost    *ghosts;
+  ubi_cacheEntryPtr *slots;
+  unsigned long      n, loaded, cold, part, warm, orig;
+  long               dumped, size;
+
+  ghosts = (ubi_cacheGhost *)malloc( Capacity * sizeof( ubi_cacheGhost ) );
+  slots  = (ubi_cacheEntryPtr *)malloc( (Capacity + 1)
+                                        * sizeof( ubi_cacheEntryPtr ) );
+  if( (NULL == ghosts) || (NULL == slots) )
+    {
+    (void)fprintf( stderr, "Out of memory.\n" );
+    exit( EXIT_FAILURE );
+    }
+
+  /* Warm up, dump, and see how the original cache does from here on. */
+  Setup( Cache, ghosts, slots, pt->policy );
+  (void)Replay( Cache, 1 );
+  dumped = Dump( Cache, First );
+  size   = ftell( First );
+  n      = ubi_cacheGetEntryCount( Cache );
+  orig   = Replay( Cache, 2 );
+  (void)ubi_cacheClear( Cache );
+
+  /* Cold. */
+  Setup( Cache, ghosts, slots, pt->policy );
+  cold = Replay( Cache, 2 );
+  (void)ubi_cacheClear( Cache );
+
+  /* Partly warm: the hottest tenth only. */
+  Setup( Cache, ghosts, slots, pt->policy );
+  rewind( First );
+  (void)ubi_cacheLoad( Cache, First, Deserialize, NULL, Capacity / 10 );
+  part = Replay( Cache, 2 );
+  (void)ubi_cacheClear( Cache );
+
+  /* Warm: everything, a thousand entries at a time. */
+  Setup( Cache, ghosts, slots, pt->policy );
+  rewind( First );
+  loaded = 0;
+  do
+    {
+    n = ubi_cacheLoad( Cache, First, Deserialize, NULL, 1000 );
+    loaded += n;
+    } while( 1000 == n );
+  if( ((long)loaded != dumped)
+   || (ubi_cacheGetEntryCount( Cache ) != (unsigned long)dumped) )
+    {
+    (void)printf( "%s: dumped %ld entries, loaded %lu\n",
+                  pt->name, dumped, loaded );
+    Errors++;
+    }
+  if( (ubi_cacheSPLAY != pt->policy) && (ubi_cacheGDSF != pt->policy)
+   && (ubi_cacheSAMPLED != pt->policy)
+   && ((Dump( Cache, Second ) != dumped) || (ftell( Second ) != size)
+    || !SameFile( First, Second, size )) )
+    {
+    (void)printf( "%s: reloaded cache dumps differently\n", pt->name );
+    Errors++;
+    }
+  warm = Replay( Cache, 2 );
+  (void)ubi_cacheClear( Cache );
+
+  (void)printf( "%-8s %6ld entries %8ld bytes   hit ratio: "
+                "original %6.2f%%  cold %6.2f%%  tenth %6.2f%%  "
+                "warm %6.2f%%\n",
+                pt->name, dumped, size,
+                (100.0 * (double)orig) / (double)Requests,
+                (100.0 * (double)cold) / (double)Requests,
+                (100.0 * (double)part) / (double)Requests,
+                (100.0 * (double)warm) / (double)Requests );
+  free( slots );
+  free( ghosts );
+  } /* Run */
+
+
+static void CheckExpiry( FILE *Stream )
+  /* ------------------------------------------------------------------------ **
+   * Check that expiry times survive a dump and reload.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  ubi_cacheRoot  Cache[1];
+  ubi_timerWheel Wheel[1];
+  unsigned long  i, n;
+  Rec           *rp;
+
+  /* Entry i expires at tick i + 1.  Dump at tick 10. */
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc, 0, 0 );
+  (void)ubi_cacheSetExtended( Cache, ubi_trTRUE );
+  (void)ubi_timerInitWheel( Wheel, 0 );
+  (void)ubi_cacheSetWheel( Cache, Wheel );
+  for( i = 0; i < 100; i++ )
+    {
+    rp = (Rec *)malloc( sizeof( Rec ) );
+    if( NULL == rp )
+      exit( EXIT_FAILURE );
+    rp->Key   = i;
+    rp->Value = ~i;
+    ubi_cachePutExpires( Cache, sizeof( Rec ), &rp->Entry.base, &rp->Key,
+                         i + 1 );
+    }
+  ubi_cacheSetTime( Cache, 10 );
+  if( 90 != Dump( Cache, Stream ) )
+    Errors++;
+  (void)ubi_cacheClear( Cache );
+
+  /* Reload at tick 1000.  Entry i should now expire at 990 + i + 1. */
+  (void)ubi_cacheInit( Cache, CompareFunc, FreeFunc, 0, 0 );
+  (void)ubi_cacheSetExtended( Cache, ubi_trTRUE );
+  (void)ubi_timerInitWheel( Wheel, 1000 );
+  (void)ubi_cacheSetWheel( Cache, Wheel );
+  ubi_cacheSetTime( Cache, 1000 );
+  rewind( Stream );
+  if( 90 != ubi_cacheLoad( Cache, Stream, Deserialize, NULL, 0 ) )
+    Errors++;
+  n = ubi_cacheExpire( Cache, 1040 );
+  if( (40 != n) || (50 != ubi_cacheGetEntryCount( Cache )) )
+    {
+    (void)printf( "expiry: %lu expired, %lu left\n",
+                  n, ubi_cacheGetEntryCount( Cache ) );
+    Errors++;
+    }
+  i = 49;
+  if( NULL != ubi_cacheGet( Cache, &i ) )
+    Errors++;
+  i = 50;
+  if( NULL == ubi_cacheGet( Cache, &i ) )
+    Errors++;
+  (void)ubi_cacheClear( Cache );
+  } /* CheckExpiry */
+
+
+int main( int argc, char *argv[] )
+  /* ------------------------------------------------------------------------ **
+   * Program mainline.
+   * ------------------------------------------------------------------------ **
+   */
+  {
+  FILE      *first, *second;
+  PolicyTab *pt;
+  int        i;
+
+  for( i = 1; (i + 1) < argc; i += 2 )
+    {
+    if( 0 == strcmp( argv[i], "-k" ) )
+      Keys = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-c" ) )
+      Capacity = strtoul( argv[i+1], NULL, 0 );
+    else if( 0 == strcmp( argv[i], "-n" ) )
+      Requests = strtoul( argv[i+1], NULL, 0 );
+    else
+      break;
+    }
+  if( (i < argc) || (Keys < 1) || (Capacity < 10) || (Requests < 1) )
+    {
+    (void)fprintf( stderr,
+                   "Usage: %s [-k keys] [-c capacity] [-n requests]\n",
+                   argv[0] );
+    return( EXIT_FAILURE );
+    }
+
+  first  = tmpfile();
+  second = tmpfile();
+  if( (NULL == first) || (NULL == second) )
+    {
+    (void)fprintf( stderr, "Cannot create temporary files.\n" );
+    return( EXIT_FAILURE );
+    }
+
+  (void)printf( "%lu keys, capacity %lu, %lu requests\n",
+                Keys, Capacity, Requests );
+  for( pt = Policies; pt->name; pt++ )
+    Run( pt, first, second );
+  CheckExpiry( first );
+
+  (void)fclose( first );
+  (void)fclose( second );
+  (void)printf( "%lu errors\n", Errors );
+  return( Errors ? EXIT_FAILURE : EXIT_SUCCESS );
+  } /* main */
+
+/* ========================================================================== */